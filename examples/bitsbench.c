@@ -0,0 +1,458 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * bitsbench.c: micro-benchmark of the bit_read_* and bit_write_* functions
+ *              in src/bits.c. Generates random values with a distribution
+ *              as seen in real DWG's (mostly 0.0, 1.0, small integers and
+ *              short handles), writes them starting at every bit offset
+ *              0-7, reads them back and verifies them, and prints ns/op,
+ *              the best of some repetitions.
+ */
+
+#include "../src/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dwg.h"
+#include "../src/bits.h"
+
+typedef enum BENCH_TYPE
+{
+  T_RC = 0,
+  T_RS,
+  T_RL,
+  T_RD,
+  T_BS,
+  T_BL,
+  T_BD,
+  T_MC,
+  T_UMC,
+  T_H,
+  T_DD,
+  T_CMC,
+  NUM_TYPES
+} Bench_Type;
+
+static const char *const type_names[NUM_TYPES]
+    = { "RC", "RS", "RL", "RD", "BS", "BL", "BD", "MC", "UMC", "H", "DD",
+        "CMC" };
+/* max. encoded bytes per value */
+static const int type_sizes[NUM_TYPES]
+    = { 1, 2, 4, 8, 3, 5, 9, 5, 5, 5, 9, 12 };
+
+#define NUM_ALIGN 8
+
+static long num = 1 << 18;
+static int reps = 5;
+static uint64_t seed = 0x2545F4914F6CDD1DULL;
+
+/* the generated values, per kind */
+static uint64_t *u;
+static int64_t *s;
+static double *d, *ddef;
+static Dwg_Handle *h;
+static Dwg_Color *c;
+static volatile uint64_t sink;
+
+/* xorshift64*, reproducible across platforms */
+static uint64_t
+rnd(void)
+{
+  seed ^= seed >> 12;
+  seed ^= seed << 25;
+  seed ^= seed >> 27;
+  return seed * 0x2545F4914F6CDD1DULL;
+}
+
+/* percentage */
+static int
+pct(void)
+{
+  return (int)(rnd() % 100);
+}
+
+static double
+rnd_double(void)
+{
+  /* coordinates mostly, with some fractions */
+  return ((double)(int64_t)(rnd() % 2000000) - 1000000.0) / 64.0
+         + (double)(rnd() % 1000) / 1000.0;
+}
+
+static void
+generate(const Bench_Type type)
+{
+  long i;
+  for (i = 0; i < num; i++)
+    {
+      const int p = pct();
+      switch (type)
+        {
+        case T_RC:
+          u[i] = rnd() & 0xff;
+          break;
+        case T_RS:
+          u[i] = rnd() & 0xffff;
+          break;
+        case T_RL:
+          u[i] = rnd() & 0xffffffff;
+          break;
+        case T_RD:
+          d[i] = rnd_double();
+          break;
+        case T_BS:
+          u[i] = p < 30 ? 0 : p < 50 ? 256 : p < 85 ? rnd() & 0xff
+                                                    : rnd() & 0xffff;
+          break;
+        case T_BL:
+          u[i] = p < 40 ? 0 : p < 80 ? rnd() & 0xff : rnd() & 0xffffffff;
+          break;
+        case T_BD:
+          d[i] = p < 40 ? 0.0 : p < 65 ? 1.0 : rnd_double();
+          break;
+        case T_MC:
+          s[i] = p < 70 ? (int64_t)(rnd() % 127) - 63
+                 : p < 95 ? (int64_t)(rnd() % 16383) - 8191
+                          : (int64_t)(rnd() % 0x1fffffff) - 0xfffffff;
+          break;
+        case T_UMC:
+          u[i] = p < 70 ? rnd() % 128 : p < 95 ? rnd() % 16384
+                                               : rnd() % 0x10000000;
+          break;
+        case T_H:
+          h[i].code = (unsigned int)(p < 50 ? 5 : 2 + rnd() % 4);
+          h[i].value = p < 10 ? 0 : p < 70 ? rnd() & 0xff
+                                  : p < 95 ? rnd() & 0xffff
+                                           : rnd() & 0xffffff;
+          break;
+        case T_DD:
+          ddef[i] = i ? d[i - 1] : 0.0;
+          if (p < 40)
+            d[i] = ddef[i];
+          else if (p < 70)
+            {
+              /* only bytes 0-3, or 4 and 5 differ */
+              uint64_t bits;
+              memcpy(&bits, &ddef[i], 8);
+              if (p < 55)
+                bits ^= rnd() & 0xffffffff;
+              else
+                bits ^= (rnd() & 0xffff) << 32;
+              memcpy(&d[i], &bits, 8);
+            }
+          else
+            d[i] = rnd_double();
+          break;
+        case T_CMC:
+          memset(&c[i], 0, sizeof(Dwg_Color));
+          c[i].index = (BITCODE_BS)(p < 60 ? 256 : p < 80 ? rnd() % 8
+                                                           : rnd() % 256);
+          c[i].rgb = p < 90 ? 0 : (BITCODE_BL)(0xc2000000 | (rnd() & 0xffffff));
+          break;
+        case NUM_TYPES:
+        default:
+          break;
+        }
+    }
+}
+
+static double
+now(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+#define TIMED_LOOP(stmt)                                                      \
+  t0 = now();                                                                 \
+  for (i = 0; i < num; i++)                                                   \
+    {                                                                         \
+      stmt;                                                                   \
+    }                                                                         \
+  t1 = now()
+
+/* Returns ns/op */
+static double
+bench_write(const Bench_Type type, Bit_Chain *dat, const int align)
+{
+  double t0 = 0.0, t1 = 0.0;
+  long i;
+
+  dat->byte = 0;
+  dat->bit = align;
+  switch (type)
+    {
+    case T_RC:  TIMED_LOOP(bit_write_RC(dat, (BITCODE_RC)u[i])); break;
+    case T_RS:  TIMED_LOOP(bit_write_RS(dat, (BITCODE_RS)u[i])); break;
+    case T_RL:  TIMED_LOOP(bit_write_RL(dat, (BITCODE_RL)u[i])); break;
+    case T_RD:  TIMED_LOOP(bit_write_RD(dat, d[i])); break;
+    case T_BS:  TIMED_LOOP(bit_write_BS(dat, (BITCODE_BS)u[i])); break;
+    case T_BL:  TIMED_LOOP(bit_write_BL(dat, (BITCODE_BL)u[i])); break;
+    case T_BD:  TIMED_LOOP(bit_write_BD(dat, d[i])); break;
+    case T_MC:  TIMED_LOOP(bit_write_MC(dat, (BITCODE_MC)s[i])); break;
+    case T_UMC: TIMED_LOOP(bit_write_UMC(dat, (BITCODE_UMC)u[i])); break;
+    case T_H:   TIMED_LOOP(bit_write_H(dat, &h[i])); break;
+    case T_DD:  TIMED_LOOP(bit_write_DD(dat, d[i], ddef[i])); break;
+    case T_CMC: TIMED_LOOP(bit_write_CMC(dat, &c[i])); break;
+    case NUM_TYPES:
+    default:
+      break;
+    }
+  return (t1 - t0) * 1e9 / (double)num;
+}
+
+/* Returns ns/op */
+static double
+bench_read(const Bench_Type type, Bit_Chain *dat, const int align)
+{
+  double t0 = 0.0, t1 = 0.0;
+  long i;
+  uint64_t acc = 0;
+  double dacc = 0.0;
+  Dwg_Handle hdl;
+  Dwg_Color col;
+
+  memset(&col, 0, sizeof(col));
+  dat->byte = 0;
+  dat->bit = align;
+  switch (type)
+    {
+    case T_RC:  TIMED_LOOP(acc += bit_read_RC(dat)); break;
+    case T_RS:  TIMED_LOOP(acc += bit_read_RS(dat)); break;
+    case T_RL:  TIMED_LOOP(acc += bit_read_RL(dat)); break;
+    case T_RD:  TIMED_LOOP(dacc += bit_read_RD(dat)); break;
+    case T_BS:  TIMED_LOOP(acc += bit_read_BS(dat)); break;
+    case T_BL:  TIMED_LOOP(acc += bit_read_BL(dat)); break;
+    case T_BD:  TIMED_LOOP(dacc += bit_read_BD(dat)); break;
+    case T_MC:  TIMED_LOOP(acc += (uint64_t)bit_read_MC(dat)); break;
+    case T_UMC: TIMED_LOOP(acc += bit_read_UMC(dat)); break;
+    case T_H:
+      TIMED_LOOP(bit_read_H(dat, &hdl); acc += hdl.value);
+      break;
+    case T_DD:  TIMED_LOOP(dacc += bit_read_DD(dat, ddef[i])); break;
+    case T_CMC:
+      TIMED_LOOP(bit_read_CMC(dat, &col); acc += col.index + col.rgb);
+      break;
+    case NUM_TYPES:
+    default:
+      break;
+    }
+  sink += acc + (uint64_t)dacc;
+  return (t1 - t0) * 1e9 / (double)num;
+}
+
+/* Untimed. Returns the number of wrong values. */
+static long
+verify(const Bench_Type type, Bit_Chain *dat, const int align)
+{
+  long i, errors = 0;
+  Dwg_Handle hdl;
+  Dwg_Color col;
+  double v;
+
+  memset(&col, 0, sizeof(col));
+  dat->byte = 0;
+  dat->bit = align;
+  for (i = 0; i < num; i++)
+    {
+      switch (type)
+        {
+        case T_RC:  errors += bit_read_RC(dat) != (BITCODE_RC)u[i]; break;
+        case T_RS:  errors += bit_read_RS(dat) != (BITCODE_RS)u[i]; break;
+        case T_RL:  errors += bit_read_RL(dat) != (BITCODE_RL)u[i]; break;
+        case T_RD:  v = bit_read_RD(dat); errors += v != d[i]; break;
+        case T_BS:  errors += bit_read_BS(dat) != (BITCODE_BS)u[i]; break;
+        case T_BL:  errors += bit_read_BL(dat) != (BITCODE_BL)u[i]; break;
+        case T_BD:  v = bit_read_BD(dat); errors += v != d[i]; break;
+        case T_MC:  errors += bit_read_MC(dat) != (BITCODE_MC)s[i]; break;
+        case T_UMC: errors += bit_read_UMC(dat) != (BITCODE_UMC)u[i]; break;
+        case T_H:
+          bit_read_H(dat, &hdl);
+          errors += hdl.value != h[i].value
+                    || (hdl.value && hdl.code != h[i].code);
+          break;
+        case T_DD:
+          v = bit_read_DD(dat, ddef[i]);
+          errors += v != d[i];
+          break;
+        case T_CMC:
+          bit_read_CMC(dat, &col);
+          errors += col.index != c[i].index || col.rgb != c[i].rgb;
+          break;
+        case NUM_TYPES:
+        default:
+          break;
+        }
+    }
+  return errors;
+}
+
+static int
+usage(void)
+{
+  printf("usage: examples/bitsbench [-n num] [-r reps] [-s seed] [-j] "
+         "[TYPE...]\n"
+         "  TYPE: RC RS RL RD BS BL BD MC UMC H DD CMC. Default: all\n"
+         "  -n num   values per type. Default: 262144\n"
+         "  -r reps  repetitions, the best is taken. Default: 5\n"
+         "  -j       print as JSON\n");
+  return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  Bit_Chain dat = { NULL, 0, 0, 0, NULL, R_2004, R_2004 };
+  double ns[NUM_TYPES][2][NUM_ALIGN];
+  int types[NUM_TYPES];
+  int json = 0, have_types = 0;
+  int i, t, a, r;
+  long errors = 0;
+
+  memset(types, 0, sizeof(types));
+  for (i = 1; i < argc; i++)
+    {
+      if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        num = atol(argv[++i]);
+      else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+        reps = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+        seed = strtoull(argv[++i], NULL, 0);
+      else if (!strcmp(argv[i], "-j"))
+        json = 1;
+      else
+        {
+          for (t = 0; t < NUM_TYPES; t++)
+            if (!strcmp(argv[i], type_names[t]))
+              break;
+          if (t == NUM_TYPES)
+            return usage();
+          types[t] = 1;
+          have_types = 1;
+        }
+    }
+  if (num < 1 || reps < 1 || !seed)
+    return usage();
+  if (!have_types)
+    for (t = 0; t < NUM_TYPES; t++)
+      types[t] = 1;
+
+  u = calloc(num, sizeof(uint64_t));
+  s = calloc(num, sizeof(int64_t));
+  d = calloc(num, sizeof(double));
+  ddef = calloc(num, sizeof(double));
+  h = calloc(num, sizeof(Dwg_Handle));
+  c = calloc(num, sizeof(Dwg_Color));
+  /* big enough, so that the writers never realloc */
+  dat.size = (num * 12) + 16;
+  dat.chain = calloc(dat.size, 1);
+  if (!u || !s || !d || !ddef || !h || !c || !dat.chain)
+    {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+
+  for (t = 0; t < NUM_TYPES; t++)
+    {
+      if (!types[t])
+        continue;
+      generate((Bench_Type)t);
+      for (a = 0; a < NUM_ALIGN; a++)
+        {
+          long size;
+          ns[t][0][a] = ns[t][1][a] = 1e30;
+          for (r = 0; r < reps; r++)
+            {
+              double w;
+              dat.size = (num * type_sizes[t]) + 16;
+              w = bench_write((Bench_Type)t, &dat, a);
+              if (w < ns[t][1][a])
+                ns[t][1][a] = w;
+            }
+          /* the readers check for overflow against the written size */
+          size = dat.byte + 1;
+          dat.size = size;
+          for (r = 0; r < reps; r++)
+            {
+              double rd = bench_read((Bench_Type)t, &dat, a);
+              if (rd < ns[t][0][a])
+                ns[t][0][a] = rd;
+            }
+          errors += verify((Bench_Type)t, &dat, a);
+        }
+    }
+
+  if (json)
+    {
+      int first = 1;
+      printf("{\n  \"num\": %ld,\n  \"reps\": %d,\n  \"ns_per_op\": {", num,
+             reps);
+      for (t = 0; t < NUM_TYPES; t++)
+        {
+          if (!types[t])
+            continue;
+          for (r = 0; r < 2; r++)
+            {
+              printf("%s\n    \"bit_%s_%s\": [", first ? "" : ",",
+                     r ? "write" : "read", type_names[t]);
+              first = 0;
+              for (a = 0; a < NUM_ALIGN; a++)
+                printf("%s%.3f", a ? ", " : "", ns[t][r][a]);
+              printf("]");
+            }
+        }
+      printf("\n  },\n  \"errors\": %ld\n}\n", errors);
+    }
+  else
+    {
+      printf("%-16s", "ns/op   bit");
+      for (a = 0; a < NUM_ALIGN; a++)
+        printf(" %7d", a);
+      printf(" %7s\n", "mean");
+      for (t = 0; t < NUM_TYPES; t++)
+        {
+          if (!types[t])
+            continue;
+          for (r = 0; r < 2; r++)
+            {
+              double sum = 0.0;
+              printf("bit_%s_%-*s", r ? "write" : "read", r ? 6 : 7,
+                     type_names[t]);
+              for (a = 0; a < NUM_ALIGN; a++)
+                {
+                  printf(" %7.2f", ns[t][r][a]);
+                  sum += ns[t][r][a];
+                }
+              printf(" %7.2f\n", sum / NUM_ALIGN);
+            }
+        }
+      if (errors)
+        printf("%ld values read back wrong\n", errors);
+    }
+
+  free(dat.chain);
+  free(c);
+  free(h);
+  free(ddef);
+  free(d);
+  free(s);
+  free(u);
+  return errors ? 1 : 0;
+}
@@ -25,6 +25,7 @@
 
 /* for uint64_t, but not in swig */
 #ifndef SWIGIMPORTED
+# include <stddef.h>
 /* with autotools you get better int types, esp. on 64bit */
 # ifdef HAVE_STDINT_H
 #  include <stdint.h>
@@ -459,6 +460,7 @@ typedef struct _dwg_object_ref
   struct _dwg_object* obj;
   Dwg_Handle handleref;
   long unsigned int absolute_ref;
+  BITCODE_BL generation; /* dwg->refs_generation when obj was resolved */
 } Dwg_Object_Ref;
 
 /**
@@ -1599,8 +1601,10 @@ typedef struct _dwg_entity_3DSOLID
   BITCODE_BS version;    /*!< DXF 70 Modeler format version =1*/
   BITCODE_BL num_blocks;
   BITCODE_BL* block_size;
-  BITCODE_RC** encr_sat_data;
-  unsigned char* acis_data; /*!< DXF 1, the decryted SAT data */
+  BITCODE_RC** encr_sat_data; /*!< pointers into one contiguous buffer,
+                                   owned by encr_sat_data[0] */
+  unsigned char* acis_data; /*!< DXF 1, the decryted SAT data.
+                                 Lazy, see dwg_ent_3dsolid_get_acis_data() */
   BITCODE_B wireframe_data_present;
   BITCODE_B point_present;
   BITCODE_3BD point;
@@ -5442,6 +5446,128 @@ typedef struct
   Dwg_Section **sections;
 } Dwg_Section_Info;
 
+/**
+ Phases of dwg_read_file, see Dwg_Stats.
+ */
+typedef enum DWG_STATS_PHASE
+{
+  DWG_PHASE_NONE = 0,  /* not accounted */
+  DWG_PHASE_READ,      /* reading the file into memory */
+  DWG_PHASE_HEADER,    /* file header, header variables */
+  DWG_PHASE_CLASSES,
+  DWG_PHASE_SECTIONS,  /* R2004+ section maps, reading and decompression */
+  DWG_PHASE_OBJECTMAP, /* walking the object map (handles section) */
+  DWG_PHASE_OBJECTS,   /* decoding the objects */
+  DWG_PHASE_REFS,      /* resolving the handle references */
+  DWG_PHASE_MAX
+} Dwg_Stats_Phase;
+
+/* One per DWG_ERR_* bit */
+#define DWG_STATS_NUM_ERRORS 14
+
+typedef struct _dwg_stats_type
+{
+  Dwg_Object_Type fixedtype;
+  char *name;                /*!< copy of the dxfname of the first object */
+  BITCODE_BL num_objects;
+  BITCODE_RLL bytes;         /*!< sum of the object sizes */
+} Dwg_Stats_Type;
+
+/**
+ Decode statistics, filled in by dwg_decode(). See dwg_get_stats().
+ The object map is interleaved with the objects, so their cpu time
+ is split in proportion to their wall time.
+ */
+typedef struct _dwg_stats
+{
+  double wall[DWG_PHASE_MAX]; /*!< seconds per phase */
+  double cpu[DWG_PHASE_MAX];  /*!< process cpu seconds per phase */
+  BITCODE_BL num_types;       /*!< size of type, entries may be empty */
+  Dwg_Stats_Type *type;       /*!< objects and bytes per type */
+  BITCODE_BL errors[DWG_STATS_NUM_ERRORS]; /*!< objects per DWG_ERR_* bit */
+  int error;                  /*!< the result of dwg_decode */
+  BITCODE_BL unresolved_refs; /*!< non-null refs to no object */
+  BITCODE_RLL peak_alloc;     /*!< peak heap bytes in use, if known. Only
+                                   sampled at the phase switches, so a
+                                   lower bound */
+  /* internal */
+  Dwg_Stats_Phase phase;
+  double phase_wall;
+  double phase_cpu;
+  double span_wall[DWG_PHASE_MAX];
+} Dwg_Stats;
+
+/**
+ Roles of a reference in the reverse reference index.
+ */
+typedef enum DWG_REF_ROLE
+{
+  DWG_REF_OWNER = 0, /* entity or table record owner, object parenthandle */
+  DWG_REF_LAYER,
+  DWG_REF_LTYPE,
+  DWG_REF_BLOCK,     /* INSERT, MINSERT and DIMENSION blocks */
+  DWG_REF_REACTOR,
+  DWG_REF_NUM_ROLES
+} Dwg_Ref_Role;
+
+/**
+ Reverse reference index in CSR form, see dwg_object_get_referrers().
+ The referrers of object i in role r are
+ sources[offsets[i * DWG_REF_NUM_ROLES + r] ..
+         offsets[i * DWG_REF_NUM_ROLES + r + 1]], in ascending order.
+ */
+typedef struct _dwg_ref_index
+{
+  BITCODE_BL num_objects;  /*!< 0 if not built */
+  BITCODE_BL generation;   /*!< dwg->refs_generation when built */
+  BITCODE_BL *offsets;     /*!< num_objects * DWG_REF_NUM_ROLES + 1 */
+  BITCODE_BL *sources;     /*!< object indices */
+} Dwg_Ref_Index;
+
+/* Rows of the type index: all fixedtypes up to the last variable type,
+   then FREED, UNKNOWN_ENT and UNKNOWN_OBJ, then one row per class. */
+#define DWG_TYPE_INDEX_FIXED_ROWS (DWG_TYPE_XREFPANELOBJECT + 4)
+
+/**
+ Objects grouped by type in CSR form, see dwg_get_objects_of_type().
+ The objects of row r are objects[offsets[r] .. offsets[r + 1]], sorted by
+ their owning block header and then by index, owners[] being parallel to
+ objects[]. Objects of a variable type are also in the row of their class.
+ The entities owned by block header h are
+ owned[owned_offsets[h] .. owned_offsets[h + 1]].
+ */
+typedef struct _dwg_type_index
+{
+  BITCODE_BL num_objects;  /*!< 0 if not built */
+  BITCODE_BL generation;   /*!< dwg->refs_generation when built */
+  BITCODE_BL num_rows;
+  BITCODE_BL *offsets;     /*!< num_rows + 1 */
+  BITCODE_BL *objects;     /*!< object indices */
+  BITCODE_BL *owners;      /*!< index of the owning BLOCK_HEADER, or -1 */
+  BITCODE_BL *owned_offsets; /*!< num_objects + 2, by owner index */
+  BITCODE_BL *owned;       /*!< object indices, grouped by owner */
+} Dwg_Type_Index;
+
+/**
+ Reentrant iterator over the entities owned by a block header, see
+ dwg_block_iter_init(). The entities are in object order.
+ */
+typedef struct _dwg_block_iter
+{
+  Dwg_Object *objects;     /*!< dwg->object when initialized */
+  const BITCODE_BL *owned;
+  BITCODE_BL num_owned;
+  BITCODE_BL pos;
+} Dwg_Block_Iter;
+
+/**
+ Output callback of the *_write_sink() functions, called with the
+ consecutive blocks of the output. Returns 0 on success, else no more
+ output is passed and the writer fails with DWG_ERR_IOERROR.
+ */
+typedef int (*Dwg_Write_Sink)(void *user, const unsigned char *data,
+                              size_t size);
+
 /**
  Main DWG struct
  */
@@ -5554,7 +5680,12 @@ typedef struct _dwg_struct
   BITCODE_BL num_object_refs;    /*!< number of object_ref's (resolved handles) */
   Dwg_Object_Ref **object_ref;   /*!< array of all handles */
   struct _inthash *object_map;   /*!< map of all handles */
-  int dirty_refs; /* 1 if we added an entity, and invalidated all the internal ref->obj's */
+  BITCODE_BL refs_generation;    /*!< bumped when object moved or a handle
+                                      was remapped, invalidating the cached
+                                      ref->obj's of older generations */
+  BITCODE_BL num_utf8_names;     /*!< size of utf8_names */
+  char **utf8_names;             /*!< r2007+ cache of UTF-8 table record names,
+                                      by object index */
 
   Dwg_Object * mspace_block;
   Dwg_Object * pspace_block;
@@ -5598,6 +5729,13 @@ typedef struct _dwg_struct
   long unsigned int measurement;
   unsigned int layout_number;
   unsigned int opts; /* 0xf: loglevel, ... */
+  unsigned int num_threads; /* of the JSON and DXF writers and the ASCII
+                               DXF reader, <= 1: serial */
+  unsigned int geojson_precision; /* decimals of the coordinates, 1-17,
+                                     else 6 */
+  Dwg_Stats stats;
+  Dwg_Ref_Index ref_index;
+  Dwg_Type_Index type_index;
 } Dwg_Data;
 
 /*--------------------------------------------------
@@ -5612,8 +5750,29 @@ dxf_read_file(const char *restrict filename, Dwg_Data *restrict dwg);
 #ifdef USE_WRITE
 EXPORT int
 dwg_write_file(const char *restrict filename, const Dwg_Data *restrict dwg);
+/** Encodes the DWG into a new buffer *data of *size bytes, which the
+    caller frees. */
+EXPORT int
+dwg_write_data(const Dwg_Data *restrict dwg, unsigned char **restrict data,
+               size_t *restrict size);
+EXPORT int
+dwg_write_sink(const Dwg_Data *restrict dwg, Dwg_Write_Sink sink, void *user);
 #endif
 
+/** Writes the DWG as ASCII DXF, or as JSON, of its own version into a new
+    buffer *data of *size bytes, which the caller frees. */
+EXPORT int
+dxf_write_data(const Dwg_Data *restrict dwg, unsigned char **restrict data,
+               size_t *restrict size);
+EXPORT int
+json_write_data(const Dwg_Data *restrict dwg, unsigned char **restrict data,
+                size_t *restrict size);
+/** As above, but passes the output in blocks to sink(user, ...) */
+EXPORT int
+dxf_write_sink(const Dwg_Data *restrict dwg, Dwg_Write_Sink sink, void *user);
+EXPORT int
+json_write_sink(const Dwg_Data *restrict dwg, Dwg_Write_Sink sink, void *user);
+
 EXPORT unsigned char*
 dwg_bmp(const Dwg_Data *restrict, BITCODE_RL *restrict);
 
@@ -5674,6 +5833,13 @@ EXPORT Dwg_Object*
 dwg_ref_object(const Dwg_Data *restrict dwg,
                Dwg_Object_Ref *restrict ref);
 
+/** As dwg_ref_object(), but without caching the result in the ref.
+    For concurrent readers, e.g. the output passes.
+*/
+EXPORT Dwg_Object*
+dwg_ref_object_const(const Dwg_Data *restrict dwg,
+                     const Dwg_Object_Ref *restrict ref);
+
 EXPORT Dwg_Object*
 dwg_ref_object_relative(const Dwg_Data *restrict dwg,
                         Dwg_Object_Ref *restrict ref,
@@ -5684,6 +5850,11 @@ get_first_owned_object(const Dwg_Object *restrict hdr);
 EXPORT Dwg_Object*
 get_next_owned_object(const Dwg_Object *restrict hdr,
                       const Dwg_Object *restrict current);
+EXPORT int
+dwg_block_iter_init(Dwg_Block_Iter *restrict iter,
+                    const Dwg_Object *restrict hdr);
+EXPORT Dwg_Object*
+dwg_block_iter_next(Dwg_Block_Iter *restrict iter);
 EXPORT Dwg_Object*
 get_first_owned_block(const Dwg_Object *hdr);
 EXPORT Dwg_Object*
@@ -5700,6 +5871,39 @@ dwg_resolve_handleref(Dwg_Object_Ref *restrict ref,
 EXPORT Dwg_Section_Type
 dwg_section_type(const DWGCHAR *wname);
 
+/** Returns the UTF-8 entry_name of the table record or MLINESTYLE obj,
+    or NULL. Since r2007
+    the converted name is cached in the DWG, before the name field itself.
+    Must not be freed.
+*/
+EXPORT const char *
+dwg_obj_table_utf8name(const Dwg_Object *obj);
+
+/** Drops the cached UTF-8 name of obj, after its entry_name was changed.
+*/
+EXPORT void
+dwg_obj_table_utf8name_reset(const Dwg_Object *obj);
+
+/** Fills the r2007+ cache of dwg_obj_table_utf8name for all objects.
+    Done after decoding, so the output passes can run concurrently.
+    Returns 0 or DWG_ERR_OUTOFMEM.
+*/
+EXPORT int
+dwg_fill_utf8names(Dwg_Data *dwg);
+
+/** Decrypt the obfuscated ACIS SAT version 1 data of a 3DSOLID, REGION
+    or BODY entity. Returns a malloced, zero-terminated string of size bytes,
+    or NULL.
+*/
+EXPORT unsigned char *
+dwg_decrypt_SAT1(const BITCODE_BL size,
+                 const BITCODE_RC *restrict encr_sat_data);
+
+/** Returns the decode statistics of the last dwg_read_file or dwg_decode.
+*/
+EXPORT const Dwg_Stats *
+dwg_get_stats(const Dwg_Data *dwg);
+
 /** Free the whole DWG. all tables, sections, objects, ...
 */
 EXPORT void
@@ -57,36 +57,27 @@ typedef struct _dwg_LWPLINE_widths
 EXPORT \
 Dwg_Entity_##token **dwg_get_##token (Dwg_Object_Ref * hdr);
 
-/* Checks now also variable classes */
+/* Checks now also variable classes. Uses the type index, the entities
+   are in object order. */
 #define DWG_GET_ENTITY(token) \
 EXPORT \
 Dwg_Entity_##token **dwg_get_##token (Dwg_Object_Ref * hdr) \
 { \
-  int i=0, counts=0; \
+  BITCODE_BL i, counts; \
+  int error; \
+  const BITCODE_BL *idx; \
   Dwg_Entity_##token ** ret_##token; \
-  Dwg_Object * obj; \
   if (!hdr || !hdr->obj) \
     return NULL; \
-  obj = get_first_owned_object(hdr->obj); \
-  while (obj) \
-    { \
-      if (obj->type == DWG_TYPE_##token || obj->fixedtype == DWG_TYPE_##token) \
-        counts++; \
-      obj = get_next_owned_object(hdr->obj, obj); \
-    } \
+  counts = dwg_block_get_objects_of_type(hdr->obj, DWG_TYPE_##token, \
+                                         &idx, &error); \
   if (!counts) \
     return NULL; \
   ret_##token = (Dwg_Entity_##token **)malloc ((counts+1) * sizeof(Dwg_Entity_##token *)); \
-  obj = get_first_owned_object(hdr->obj); \
-  while (obj) \
-    { \
-      if (obj->type == DWG_TYPE_##token || obj->fixedtype == DWG_TYPE_##token) \
-        { \
-          ret_##token[i] = obj->tio.entity->tio.token; \
-          i++; \
-        } \
-        obj = get_next_owned_object(hdr->obj, obj); \
-    } \
+  if (!ret_##token) \
+    return NULL; \
+  for (i=0; i < counts; i++) \
+    ret_##token[i] = hdr->obj->parent->object[idx[i]].tio.entity->tio.token; \
   ret_##token[i] = NULL; \
   return ret_##token; \
 }
@@ -100,30 +91,18 @@ Dwg_Object_##token **dwg_get_##token (Dwg_Data *dwg);
 EXPORT \
 Dwg_Object_##token **dwg_get_##token (Dwg_Data *dwg) \
 { \
-  BITCODE_BL i=0, counts=0; \
+  BITCODE_BL i, counts; \
+  int error; \
+  const BITCODE_BL *idx; \
   Dwg_Object_##token ** ret_##token; \
-  for (i=0; i < dwg->num_objects; i++) \
-    { \
-      if (dwg->object[i].supertype == DWG_SUPERTYPE_OBJECT \
-          && (dwg->object[i].type == DWG_TYPE_##token \
-              || dwg->object[i].fixedtype == DWG_TYPE_##token)) \
-        { \
-          counts++; \
-        } \
-    } \
+  counts = dwg_get_objects_of_type(dwg, DWG_TYPE_##token, &idx, &error); \
   if (!counts) \
     return NULL; \
   ret_##token = (Dwg_Object_##token **)malloc ((counts+1) * sizeof(Dwg_Object_##token *)); \
-  for (i=0; i < dwg->num_objects; i++) \
-    { \
-      const Dwg_Object *const obj = &dwg->object[i]; \
-      if (obj->supertype == DWG_SUPERTYPE_OBJECT \
-          && (obj->type == DWG_TYPE_##token || obj->fixedtype == DWG_TYPE_##token)) \
-        { \
-          ret_##token[i] = obj->tio.object->tio.token; \
-          i++; \
-        } \
-    } \
+  if (!ret_##token) \
+    return NULL; \
+  for (i=0; i < counts; i++) \
+    ret_##token[i] = dwg->object[idx[i]].tio.object->tio.token; \
   ret_##token[i] = NULL; \
   return ret_##token; \
 }
@@ -4923,6 +4902,39 @@ dwg_object_get_fixedtype(const dwg_object *obj);
 EXPORT char*
 dwg_object_get_dxfname(const dwg_object *obj);
 
+EXPORT int
+dwg_build_ref_index(dwg_data *dwg);
+
+EXPORT BITCODE_BL
+dwg_object_get_referrers(const dwg_object *restrict obj,
+                         const Dwg_Ref_Role role,
+                         const BITCODE_BL **restrict indices,
+                         int *restrict error);
+
+EXPORT int
+dwg_build_type_index(dwg_data *dwg);
+
+EXPORT BITCODE_BL
+dwg_get_objects_of_type(dwg_data *restrict dwg, const Dwg_Object_Type type,
+                        const BITCODE_BL **restrict indices,
+                        int *restrict error);
+
+EXPORT BITCODE_BL
+dwg_get_objects_of_class(dwg_data *restrict dwg, const BITCODE_BS klass,
+                         const BITCODE_BL **restrict indices,
+                         int *restrict error);
+
+EXPORT BITCODE_BL
+dwg_block_get_objects_of_type(const dwg_object *restrict hdr,
+                              const Dwg_Object_Type type,
+                              const BITCODE_BL **restrict indices,
+                              int *restrict error);
+
+EXPORT BITCODE_BL
+dwg_block_get_owned(const dwg_object *restrict hdr,
+                    const BITCODE_BL **restrict indices,
+                    int *restrict error);
+
 EXPORT BITCODE_BL
 dwg_ref_get_absref(const dwg_object_ref *restrict ref,
                    int *restrict error);
@@ -34,12 +34,13 @@
 static int opts = 1;
 int minimal = 0;
 int binary = 0;
+int jobs = 1;
 char buf[4096];
 /* the current version per spec block */
 static unsigned int cur_ver = 0;
 
 static int usage(void) {
-  printf("\nUsage: dwg2dxf [-v[N]] [--as rNNNN] [-m|--minimal] [-b|--binary] DWGFILES...\n");
+  printf("\nUsage: dwg2dxf [-v[N]] [--as rNNNN] [-m|--minimal] [-b|--binary] [-j N] DWGFILES...\n");
   return 1;
 }
 static int opt_version(void) {
@@ -61,6 +62,7 @@ static int help(void) {
   printf("             r9, r10, r11, r2018\n");
   printf("  -m, --minimal             only $ACADVER, HANDSEED and ENTITIES\n");
   printf("  -b, --binary              save as binary DXF\n");
+  printf("  -j N, --jobs N            write ASCII DXF with N threads\n");
   printf("  -o outfile, --file        only valid with one single DWGFILE\n");
   printf("      --help                display this help and exit\n");
   printf("      --version             output version information and exit\n"
@@ -74,6 +76,7 @@ static int help(void) {
   printf("                r9, r10, r11, r2004, r2007, r2010, r2013, r2018\n");
   printf("  -m          minimal, only $ACADVER, HANDSEED and ENTITIES\n");
   printf("  -b          save as binary DXF\n");
+  printf("  -j N        write ASCII DXF with N threads\n");
   printf("  -o dwgfile\n");
   printf("  -h          display this help and exit\n");
   printf("  -i          output version information and exit\n"
@@ -104,6 +107,7 @@ main (int argc, char *argv[])
         {"as",      1, 0, 'a'},
         {"minimal", 0, 0, 'm'},
         {"binary",  0, 0, 'b'},
+        {"jobs",    1, 0, 'j'},
         {"help",    0, 0, 0},
         {"version", 0, 0, 0},
         {NULL,      0, NULL, 0}
@@ -115,10 +119,10 @@ main (int argc, char *argv[])
 
   while
 #ifdef HAVE_GETOPT_LONG
-    ((c = getopt_long(argc, argv, ":mba:v::o:h",
+    ((c = getopt_long(argc, argv, ":mba:v::o:j:h",
                       long_options, &option_index)) != -1)
 #else
-    ((c = getopt(argc, argv, ":mba:v::o:hi")) != -1)
+    ((c = getopt(argc, argv, ":mba:v::o:j:hi")) != -1)
 #endif
     {
       if (c == -1) break;
@@ -166,6 +170,11 @@ main (int argc, char *argv[])
       case 'o':
         filename_out = optarg;
         break;
+      case 'j':
+        jobs = atoi(optarg);
+        if (jobs < 1)
+          return usage();
+        break;
       case 'a':
         dwg_version = dwg_version_as(optarg);
         if (dwg_version == R_INVALID)
@@ -221,6 +230,7 @@ main (int argc, char *argv[])
 
       memset(&dwg, 0, sizeof(Dwg_Data));
       dwg.opts = opts;
+      dwg.num_threads = jobs;
       fprintf(stderr, "Reading DWG file %s\n", filename_in);
       error = dwg_read_file (filename_in, &dwg);
       if (error >= DWG_ERR_CRITICAL) {
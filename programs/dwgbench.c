@@ -0,0 +1,921 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * dwgbench.c: time decode, free, encode and the output formats over a set
+ *             of DWG files, and report median and p95 times, MB/s and
+ *             objects/s, as table or JSON.
+ *             MB/s is always relative to the size of the input DWG.
+ *             Each phase is run in a forked child, so that a crash in one
+ *             phase does not abort the whole run.
+ */
+
+#include "../src/config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <getopt.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
+#include "dwg.h"
+#include "bits.h"
+#ifndef DISABLE_DXF
+#include "out_json.h"
+#include "out_dxf.h"
+#endif
+
+#if defined(HAVE_FORK) && defined(HAVE_SYS_WAIT_H)
+#define USE_FORK
+#endif
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+#define MAX_ITERATIONS 1000
+
+typedef enum BENCH_PHASE
+{
+  PHASE_DECODE = 0,
+  PHASE_FREE,
+  PHASE_ENCODE,
+  PHASE_DXF,
+  PHASE_DXFB,
+  PHASE_JSON,
+  PHASE_GEOJSON,
+  NUM_PHASES
+} Bench_Phase;
+
+static const char *const phase_names[NUM_PHASES]
+    = { "decode", "free", "encode", "dxf", "dxfb", "json", "geojson" };
+
+/* The result of one phase over one file, as sent from the child. */
+typedef struct _bench_result
+{
+  int phase;
+  int error;
+  int crashed;    /* the signal which killed the child, -1 or 0 */
+  int iterations; /* number of valid samples */
+  BITCODE_BL num_objects;
+  double median;
+  double p95;
+} Bench_Result;
+
+/* The medians of one file from a --baseline JSON, 0.0 if not measured. */
+typedef struct _bench_baseline
+{
+  char *file;
+  double median[NUM_PHASES];
+} Bench_Baseline;
+
+static int opts = 0;
+static int iterations = 5;
+static int phases[NUM_PHASES];
+
+static int usage(void) {
+  printf("\nUsage: dwgbench [-v[0-9]] [-n N] [-p PHASES] [-o JSONFILE] "
+         "[-b BASELINE [-t PCT]] [--json] DWGFILES...\n");
+  return 1;
+}
+static int opt_version(void) {
+  printf("dwgbench %s\n", PACKAGE_VERSION);
+  return 0;
+}
+static int help(void) {
+  printf("\nUsage: dwgbench [OPTION]... DWGFILES...\n");
+  printf("Times each phase N times per DWG, and prints the median and p95\n"
+         "time, MB/s of the input DWG and objects/s.\n"
+         "With a baseline JSON from an earlier -o run on the same machine,\n"
+         "fails if the total MB/s of a phase dropped by more than PCT,\n"
+         "or if the files differ from the baseline.\n"
+         "\n");
+#ifdef HAVE_GETOPT_LONG
+  printf("  -v[0-9], --verbose [0-9]  verbosity of the library\n");
+  printf("  -n N,    --iterations N   iterations per phase. Default: 5\n");
+  printf("  -p list, --phases list    comma-separated list of phases.\n"
+         "           Default: decode,free,encode,dxf,dxfb,json,geojson\n");
+  printf("  -o file, --file file      write the results as JSON to file\n");
+  printf("           --json           print the results as JSON to stdout\n");
+  printf("  -b file, --baseline file  compare with the results in file\n");
+  printf("  -t PCT,  --threshold PCT  allowed regression in percent. "
+         "Default: 10\n");
+  printf("           --help           display this help and exit\n");
+  printf("           --version        output version information and exit\n"
+         "\n");
+#else
+  printf("  -v[0-9]     verbosity of the library\n");
+  printf("  -n N        iterations per phase. Default: 5\n");
+  printf("  -p list     comma-separated list of phases.\n"
+         "              Default: decode,free,encode,dxf,dxfb,json,geojson\n");
+  printf("  -o file     write the results as JSON to file\n");
+  printf("  -b file     compare with the results in file\n");
+  printf("  -t PCT      allowed regression in percent. Default: 10\n");
+  printf("  -h          display this help and exit\n");
+  printf("  -i          output version information and exit\n"
+         "\n");
+#endif
+  printf("GNU LibreDWG online manual: <https://www.gnu.org/software/libredwg/>\n");
+  return 0;
+}
+
+static double
+now(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static int
+parse_phases(const char *list)
+{
+  char *copy = strdup(list);
+  char *p;
+  int i;
+
+  if (!copy)
+    return 1;
+  memset(phases, 0, sizeof(phases));
+  for (p = strtok(copy, ","); p; p = strtok(NULL, ","))
+    {
+      for (i = 0; i < NUM_PHASES; i++)
+        if (!strcmp(p, phase_names[i]))
+          break;
+      if (i == NUM_PHASES)
+        {
+          fprintf(stderr, "Unknown phase '%s'\n", p);
+          free(copy);
+          return 1;
+        }
+      phases[i] = 1;
+    }
+  free(copy);
+  return 0;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+  const double da = *(const double *)a;
+  const double db = *(const double *)b;
+  return da < db ? -1 : da > db ? 1 : 0;
+}
+
+/* sorts t */
+static void
+summarize(double *t, const int n, Bench_Result *r)
+{
+  int i95;
+  r->iterations = n;
+  if (!n)
+    return;
+  qsort(t, n, sizeof(double), cmp_double);
+  r->median = n & 1 ? t[n / 2] : (t[n / 2 - 1] + t[n / 2]) / 2.0;
+  i95 = (int)ceil(0.95 * n) - 1;
+  r->p95 = t[i95 < 0 ? 0 : i95];
+}
+
+static int
+read_dwg(const char *filename, Dwg_Data *dwg)
+{
+  memset(dwg, 0, sizeof(Dwg_Data));
+  dwg->opts = opts;
+  return dwg_read_file(filename, dwg);
+}
+
+#ifdef USE_WRITE
+/* Creates the file of the encoded DWG in $TMPDIR, not in the cwd. It
+   stays open until it is removed, so its name cannot be taken over. */
+static FILE *
+tmp_dwg_open(char *buf, const size_t size)
+{
+  const char *dir = getenv("TMPDIR");
+#ifdef HAVE_MKSTEMP
+  FILE *fh;
+  int fd;
+
+  if (!dir || !*dir)
+    dir = "/tmp";
+  snprintf(buf, size, "%s/dwgbench.XXXXXX", dir);
+  if ((fd = mkstemp(buf)) < 0)
+    return NULL;
+  if (!(fh = fdopen(fd, "wb")))
+    {
+      close(fd);
+      remove(buf);
+    }
+  return fh;
+#else
+  if (!dir || !*dir)
+    dir = ".";
+  snprintf(buf, size, "%s/dwgbench.tmp.dwg", dir);
+  return fopen(buf, "wb");
+#endif
+}
+
+/* Encodes the DWG and writes it over the start of fh, as
+   dwg_write_file() */
+static int
+tmp_dwg_write(FILE *fh, const Dwg_Data *dwg)
+{
+  unsigned char *data;
+  size_t size;
+  int error = dwg_write_data(dwg, &data, &size);
+
+  if (error >= DWG_ERR_CRITICAL)
+    return error;
+  rewind(fh);
+  if (fwrite(data, 1, size, fh) != size || fflush(fh))
+    error |= DWG_ERR_IOERROR;
+  free(data);
+  return error;
+}
+#endif
+
+/* Runs one phase n times. Everything but the phase itself is untimed. */
+static void
+run_phase(const Bench_Phase phase, const char *filename, double *t,
+          Bench_Result *r)
+{
+  Dwg_Data dwg;
+  int i, n = 0;
+#ifdef USE_WRITE
+  char tmp_dwg[1024];
+  FILE *tmp_fh = NULL;
+#endif
+
+  memset(r, 0, sizeof(Bench_Result));
+  r->phase = phase;
+#ifdef USE_WRITE
+  if (phase == PHASE_ENCODE
+      && !(tmp_fh = tmp_dwg_open(tmp_dwg, sizeof(tmp_dwg))))
+    {
+      r->error = DWG_ERR_IOERROR;
+      return;
+    }
+#endif
+  for (i = 0; i < iterations; i++)
+    {
+      Bit_Chain dat = { 0 };
+      double t0 = 0.0, t1 = 0.0;
+      int error;
+
+      if (phase == PHASE_DECODE)
+        t0 = now();
+      error = read_dwg(filename, &dwg);
+      if (phase == PHASE_DECODE)
+        t1 = now();
+      r->num_objects = dwg.num_objects;
+      if (error >= DWG_ERR_CRITICAL)
+        {
+          r->error |= error;
+          dwg_free(&dwg);
+          break;
+        }
+      if (phase == PHASE_DECODE)
+        r->error |= error;
+      dat.version = dat.from_version = dwg.header.version;
+
+      switch (phase)
+        {
+        case PHASE_DECODE:
+          break;
+        case PHASE_FREE:
+          t0 = now();
+          dwg_free(&dwg);
+          t1 = now();
+          break;
+        case PHASE_ENCODE:
+#ifdef USE_WRITE
+          t0 = now();
+          error = tmp_dwg_write(tmp_fh, &dwg);
+          t1 = now();
+#else
+          error = DWG_ERR_NOTYETSUPPORTED;
+#endif
+          break;
+#ifndef DISABLE_DXF
+        case PHASE_DXF:
+        case PHASE_DXFB:
+        case PHASE_JSON:
+        case PHASE_GEOJSON:
+          dat.fh = fopen(NULL_DEVICE, "wb");
+          if (!dat.fh)
+            {
+              error = DWG_ERR_IOERROR;
+              break;
+            }
+          t0 = now();
+          if (phase == PHASE_DXF)
+            error = dwg_write_dxf(&dat, &dwg);
+          else if (phase == PHASE_DXFB)
+            error = dwg_write_dxfb(&dat, &dwg);
+          else if (phase == PHASE_JSON)
+            error = dwg_write_json(&dat, &dwg);
+          else
+            error = dwg_write_geojson(&dat, &dwg);
+          fflush(dat.fh);
+          t1 = now();
+          fclose(dat.fh);
+          break;
+#else
+        case PHASE_DXF:
+        case PHASE_DXFB:
+        case PHASE_JSON:
+        case PHASE_GEOJSON:
+          error = DWG_ERR_NOTYETSUPPORTED;
+          break;
+#endif
+        case NUM_PHASES:
+        default:
+          break;
+        }
+      if (phase != PHASE_FREE)
+        dwg_free(&dwg);
+      if (phase != PHASE_DECODE)
+        r->error |= error;
+      if (error >= DWG_ERR_CRITICAL)
+        break;
+      t[n++] = t1 - t0;
+    }
+#ifdef USE_WRITE
+  if (tmp_fh)
+    {
+      fclose(tmp_fh);
+      remove(tmp_dwg);
+    }
+#endif
+  summarize(t, n, r);
+}
+
+#ifdef USE_FORK
+/* Every phase runs in its own child, which writes its result to the pipe.
+   If there is none, the child crashed. */
+static int
+bench_phase(const Bench_Phase phase, const char *filename, Bench_Result *r,
+            double *t)
+{
+  int fds[2];
+  pid_t pid;
+  int status = 0;
+
+  if (pipe(fds))
+    return 1;
+  fflush(stdout);
+  fflush(stderr);
+  pid = fork();
+  if (pid < 0)
+    {
+      close(fds[0]);
+      close(fds[1]);
+      return 1;
+    }
+  if (pid == 0)
+    {
+      close(fds[0]);
+      run_phase(phase, filename, t, r);
+      if (write(fds[1], r, sizeof(Bench_Result)) != sizeof(Bench_Result))
+        _exit(1);
+      close(fds[1]);
+      _exit(0);
+    }
+  close(fds[1]);
+  if (read(fds[0], r, sizeof(Bench_Result)) != sizeof(Bench_Result))
+    r->crashed = -1;
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+  if (r->crashed)
+    {
+      memset(r, 0, sizeof(Bench_Result));
+      r->phase = phase;
+      r->crashed = WIFSIGNALED(status) ? WTERMSIG(status) : -1;
+    }
+  return 0;
+}
+#else
+static int
+bench_phase(const Bench_Phase phase, const char *filename, Bench_Result *r,
+            double *t)
+{
+  run_phase(phase, filename, t, r);
+  return 0;
+}
+#endif
+
+static double
+mbps(const double size, const double time)
+{
+  return time > 0.0 ? size / time / 1e6 : 0.0;
+}
+
+static double
+objps(const double num, const double time)
+{
+  return time > 0.0 ? num / time : 0.0;
+}
+
+static void
+print_table(FILE *fp, char **files, const int num_files,
+            const long *sizes, Bench_Result *results)
+{
+  int f, i;
+  double total_time[NUM_PHASES] = { 0.0 };
+  double total_size[NUM_PHASES] = { 0.0 };
+  double total_objs[NUM_PHASES] = { 0.0 };
+
+  fprintf(fp, "%-28s %-8s %10s %10s %9s %11s %s\n", "file", "phase",
+          "median ms", "p95 ms", "MB/s", "objects/s", "error");
+  for (f = 0; f < num_files; f++)
+    {
+      const char *base = strrchr(files[f], '/');
+      base = base ? base + 1 : files[f];
+      for (i = 0; i < NUM_PHASES; i++)
+        {
+          Bench_Result *r = &results[f * NUM_PHASES + i];
+          if (!phases[i])
+            continue;
+          if (r->crashed)
+            {
+              fprintf(fp, "%-28s %-8s %10s %10s %9s %11s crashed (%d)\n",
+                      base, phase_names[i], "-", "-", "-", "-", r->crashed);
+              continue;
+            }
+          if (!r->iterations)
+            {
+              fprintf(fp, "%-28s %-8s %10s %10s %9s %11s 0x%x\n", base,
+                      phase_names[i], "-", "-", "-", "-", r->error);
+              continue;
+            }
+          fprintf(fp, "%-28s %-8s %10.3f %10.3f %9.2f %11.0f 0x%x\n", base,
+                  phase_names[i], r->median * 1e3, r->p95 * 1e3,
+                  mbps(sizes[f], r->median), objps(r->num_objects, r->median),
+                  r->error);
+          total_time[i] += r->median;
+          total_size[i] += sizes[f];
+          total_objs[i] += r->num_objects;
+        }
+    }
+  fprintf(fp, "\n%-28s %-8s %10s %10s %9s %11s\n", "total", "phase",
+          "median ms", "", "MB/s", "objects/s");
+  for (i = 0; i < NUM_PHASES; i++)
+    if (phases[i])
+      fprintf(fp, "%-28s %-8s %10.3f %10s %9.2f %11.0f\n", "", phase_names[i],
+              total_time[i] * 1e3, "", mbps(total_size[i], total_time[i]),
+              objps(total_objs[i], total_time[i]));
+}
+
+static void
+print_json_string(FILE *fp, const char *s)
+{
+  fputc('"', fp);
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        fputc('\\', fp);
+      if ((unsigned char)*s < 0x20)
+        fprintf(fp, "\\u%04x", (unsigned char)*s);
+      else
+        fputc(*s, fp);
+    }
+  fputc('"', fp);
+}
+
+static void
+print_json(FILE *fp, char **files, const int num_files, const long *sizes,
+           Bench_Result *results)
+{
+  int f, i, first;
+  double total_time[NUM_PHASES] = { 0.0 };
+  double total_size[NUM_PHASES] = { 0.0 };
+  double total_objs[NUM_PHASES] = { 0.0 };
+
+  fprintf(fp, "{\n  \"version\": \"%s\",\n  \"iterations\": %d,\n"
+              "  \"files\": [",
+          PACKAGE_VERSION, iterations);
+  for (f = 0; f < num_files; f++)
+    {
+      fprintf(fp, "%s\n    {\n      \"file\": ", f ? "," : "");
+      print_json_string(fp, files[f]);
+      fprintf(fp, ",\n      \"size\": %ld,\n      \"phases\": {", sizes[f]);
+      first = 1;
+      for (i = 0; i < NUM_PHASES; i++)
+        {
+          Bench_Result *r = &results[f * NUM_PHASES + i];
+          if (!phases[i])
+            continue;
+          fprintf(fp, "%s\n        \"%s\": { ", first ? "" : ",",
+                  phase_names[i]);
+          first = 0;
+          if (r->crashed)
+            {
+              fprintf(fp, "\"crashed\": %d }", r->crashed);
+              continue;
+            }
+          fprintf(fp,
+                  "\"iterations\": %d, \"median\": %.9f, \"p95\": %.9f, "
+                  "\"mbps\": %.3f, \"objps\": %.1f, \"objects\": %u, "
+                  "\"error\": %d }",
+                  r->iterations, r->median, r->p95, mbps(sizes[f], r->median),
+                  objps(r->num_objects, r->median),
+                  (unsigned)r->num_objects, r->error);
+          if (r->iterations)
+            {
+              total_time[i] += r->median;
+              total_size[i] += sizes[f];
+              total_objs[i] += r->num_objects;
+            }
+        }
+      fprintf(fp, "\n      }\n    }");
+    }
+  fprintf(fp, "\n  ],\n  \"total\": {");
+  first = 1;
+  for (i = 0; i < NUM_PHASES; i++)
+    {
+      if (!phases[i])
+        continue;
+      fprintf(fp,
+              "%s\n    \"%s\": { \"median\": %.9f, \"mbps\": %.3f, "
+              "\"objps\": %.1f }",
+              first ? "" : ",", phase_names[i], total_time[i],
+              mbps(total_size[i], total_time[i]),
+              objps(total_objs[i], total_time[i]));
+      first = 0;
+    }
+  fprintf(fp, "\n  }\n}\n");
+}
+
+static const char *
+basename_of(const char *filename)
+{
+  const char *base = strrchr(filename, '/');
+  return base ? base + 1 : filename;
+}
+
+/* Reads the per-file medians back from a JSON file written by print_json.
+   This is no general JSON parser, it relies on print_json's layout of
+   one line per phase. */
+static Bench_Baseline *
+read_baseline(const char *filename, int *num)
+{
+  FILE *fp = fopen(filename, "r");
+  Bench_Baseline *base = NULL;
+  char line[1024];
+  int n = 0;
+
+  *num = 0;
+  if (!fp)
+    {
+      fprintf(stderr, "Could not read %s\n", filename);
+      return NULL;
+    }
+  while (fgets(line, sizeof(line), fp))
+    {
+      char *s;
+      int i;
+      if (strstr(line, "\"total\": {"))
+        break;
+      if ((s = strstr(line, "\"file\": \"")))
+        {
+          Bench_Baseline *tmp;
+          char *d;
+          tmp = realloc(base, (n + 1) * sizeof(Bench_Baseline));
+          if (!tmp || !(d = strdup(s + 9)))
+            {
+              fprintf(stderr, "Out of memory\n");
+              break;
+            }
+          base = tmp;
+          memset(&base[n], 0, sizeof(Bench_Baseline));
+          base[n].file = d;
+          /* unescape up to the closing quote */
+          for (s = d; *s && *s != '"'; s++)
+            *d++ = *s == '\\' && s[1] ? *++s : *s;
+          *d = '\0';
+          n++;
+          continue;
+        }
+      if (!n || !(s = strstr(line, "\"median\": ")))
+        continue;
+      for (i = 0; i < NUM_PHASES; i++)
+        {
+          char key[20];
+          snprintf(key, sizeof(key), "\"%s\": {", phase_names[i]);
+          if (strstr(line, key))
+            {
+              base[n - 1].median[i] = strtod(s + 10, NULL);
+              break;
+            }
+        }
+    }
+  fclose(fp);
+  *num = n;
+  return base;
+}
+
+/* Prints the MB/s of the baseline and of this run per file and phase,
+   and the change of the totals over the files measured in both.
+   Single small files are too noisy to gate on, so only the totals per
+   phase count. A phase of the baseline which crashed, failed or did not
+   run now always counts, as does a file in only one of both. Returns the
+   number of such failures plus the number of phases which regressed more
+   than threshold percent. */
+static int
+compare_baseline(FILE *fp, char **files, const int num_files,
+                 const long *sizes, Bench_Result *results,
+                 const Bench_Baseline *base, const int num_base,
+                 const double threshold)
+{
+  int f, i, b, regressed = 0, failed = 0;
+  double base_time[NUM_PHASES] = { 0.0 };
+  double total_time[NUM_PHASES] = { 0.0 };
+  double total_size[NUM_PHASES] = { 0.0 };
+
+  fprintf(fp, "\n%-28s %-8s %10s %10s %8s\n", "file", "phase", "base MB/s",
+          "MB/s", "change");
+  for (f = 0; f < num_files; f++)
+    {
+      const char *name = basename_of(files[f]);
+      for (b = 0; b < num_base; b++)
+        if (!strcmp(basename_of(base[b].file), name))
+          break;
+      if (b == num_base)
+        {
+          fprintf(fp, "%-28s %-8s %10s %10s %8s NOT IN BASELINE\n", name,
+                  "-", "-", "-", "-");
+          failed++;
+          continue;
+        }
+      for (i = 0; i < NUM_PHASES; i++)
+        {
+          Bench_Result *r = &results[f * NUM_PHASES + i];
+          double old_mbps, new_mbps;
+          if (!phases[i] || base[b].median[i] <= 0.0)
+            continue;
+          old_mbps = mbps(sizes[f], base[b].median[i]);
+          if (r->crashed || !r->iterations)
+            {
+              fprintf(fp, "%-28s %-8s %10.2f %10s %8s FAILED\n", name,
+                      phase_names[i], old_mbps, "-", "-");
+              failed++;
+              continue;
+            }
+          new_mbps = mbps(sizes[f], r->median);
+          fprintf(fp, "%-28s %-8s %10.2f %10.2f %+7.1f%%\n", name,
+                  phase_names[i], old_mbps, new_mbps,
+                  (new_mbps / old_mbps - 1.0) * 100.0);
+          base_time[i] += base[b].median[i];
+          total_time[i] += r->median;
+          total_size[i] += sizes[f];
+        }
+    }
+  for (b = 0; b < num_base; b++)
+    {
+      const char *name = basename_of(base[b].file);
+      for (f = 0; f < num_files; f++)
+        if (!strcmp(basename_of(files[f]), name))
+          break;
+      if (f == num_files)
+        {
+          fprintf(fp, "%-28s %-8s %10s %10s %8s NOT RUN\n", name, "-", "-",
+                  "-", "-");
+          failed++;
+        }
+    }
+  fprintf(fp, "\n%-28s %-8s %10s %10s %8s\n", "total", "phase", "base MB/s",
+          "MB/s", "change");
+  for (i = 0; i < NUM_PHASES; i++)
+    {
+      double old_mbps, new_mbps, change;
+      if (!phases[i] || base_time[i] <= 0.0 || total_time[i] <= 0.0)
+        continue;
+      old_mbps = mbps(total_size[i], base_time[i]);
+      new_mbps = mbps(total_size[i], total_time[i]);
+      change = (new_mbps / old_mbps - 1.0) * 100.0;
+      fprintf(fp, "%-28s %-8s %10.2f %10.2f %+7.1f%%%s\n", "", phase_names[i],
+              old_mbps, new_mbps, change,
+              change < -threshold ? " REGRESSION" : "");
+      if (change < -threshold)
+        regressed++;
+    }
+  return failed + regressed;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, f, num_files;
+  int c;
+  int json = 0;
+  int status = 0;
+  const char *outfile = NULL;
+  const char *baseline = NULL;
+  double threshold = 10.0;
+  long *sizes;
+  double *t;
+  Bench_Result *results;
+#ifdef HAVE_GETOPT_LONG
+  int option_index = 0;
+  static struct option long_options[] = {
+        {"verbose",    1, &opts, 1}, //optional
+        {"iterations", 1, 0, 'n'},
+        {"phases",     1, 0, 'p'},
+        {"file",       1, 0, 'o'},
+        {"json",       0, 0, 0},
+        {"baseline",   1, 0, 'b'},
+        {"threshold",  1, 0, 't'},
+        {"help",       0, 0, 0},
+        {"version",    0, 0, 0},
+        {NULL,         0, NULL, 0}
+  };
+#endif
+
+  if (argc < 2)
+    return usage();
+  for (i = 0; i < NUM_PHASES; i++)
+    phases[i] = 1;
+
+  while
+#ifdef HAVE_GETOPT_LONG
+    ((c = getopt_long(argc, argv, ":v::n:p:o:b:t:h",
+                      long_options, &option_index)) != -1)
+#else
+    ((c = getopt(argc, argv, ":v::n:p:o:b:t:hi")) != -1)
+#endif
+    {
+      if (c == -1) break;
+      switch (c) {
+      case ':': // missing arg
+        if (optarg && !strcmp(optarg, "v")) {
+          opts = 1;
+          break;
+        }
+        fprintf(stderr, "%s: option '-%c' requires an argument\n",
+                argv[0], optopt);
+        break;
+#ifdef HAVE_GETOPT_LONG
+      case 0:
+        /* This option sets a flag */
+        if (!strcmp(long_options[option_index].name, "verbose"))
+          {
+            if (opts < 0 || opts > 9)
+              return usage();
+            break;
+          }
+        if (!strcmp(long_options[option_index].name, "json"))
+          {
+            json = 1;
+            break;
+          }
+        if (!strcmp(long_options[option_index].name, "version"))
+          return opt_version();
+        if (!strcmp(long_options[option_index].name, "help"))
+          return help();
+        break;
+#else
+      case 'i':
+        return opt_version();
+#endif
+      case 'n':
+        iterations = atoi(optarg);
+        if (iterations < 1 || iterations > MAX_ITERATIONS)
+          {
+            fprintf(stderr, "Invalid number of iterations %s\n", optarg);
+            return usage();
+          }
+        break;
+      case 'p':
+        if (parse_phases(optarg))
+          return usage();
+        break;
+      case 'o':
+        outfile = optarg;
+        break;
+      case 'b':
+        baseline = optarg;
+        break;
+      case 't':
+        {
+          char *end;
+          threshold = strtod(optarg, &end);
+          if (*end || threshold < 0.0)
+            {
+              fprintf(stderr, "Invalid threshold %s\n", optarg);
+              return usage();
+            }
+        }
+        break;
+      case 'v': // support -v3 and -v
+        i = (optind > 0 && optind < argc) ? optind-1 : 1;
+        if (!memcmp(argv[i], "-v", 2))
+          {
+            opts = argv[i][2] ? argv[i][2] - '0' : 1;
+          }
+        if (opts < 0 || opts > 9)
+          return usage();
+        break;
+      case 'h':
+        return help();
+      case '?':
+        fprintf(stderr, "%s: invalid option '-%c' ignored\n",
+                argv[0], optopt);
+        break;
+      default:
+        return usage();
+      }
+    }
+
+  if (optind == argc)
+    {
+      puts("No input file specified");
+      return 1;
+    }
+  num_files = argc - optind;
+  sizes = calloc(num_files, sizeof(long));
+  results = calloc(num_files * NUM_PHASES, sizeof(Bench_Result));
+  t = calloc(iterations, sizeof(double));
+  if (!sizes || !results || !t)
+    {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+
+  for (f = 0; f < num_files; f++)
+    {
+      struct stat attrib;
+      const char *filename = argv[optind + f];
+      if (!stat(filename, &attrib))
+        sizes[f] = (long)attrib.st_size;
+      if (!json)
+        fprintf(stderr, "%s\n", filename);
+      for (i = 0; i < NUM_PHASES; i++)
+        if (phases[i]
+            && bench_phase((Bench_Phase)i, filename,
+                           &results[f * NUM_PHASES + i], t))
+          {
+            fprintf(stderr, "Failed to benchmark %s\n", filename);
+            return 1;
+          }
+    }
+
+  if (json)
+    print_json(stdout, &argv[optind], num_files, sizes, results);
+  else
+    print_table(stdout, &argv[optind], num_files, sizes, results);
+  if (outfile)
+    {
+      FILE *fp = fopen(outfile, "w");
+      if (!fp)
+        {
+          fprintf(stderr, "Could not write %s\n", outfile);
+          return 1;
+        }
+      print_json(fp, &argv[optind], num_files, sizes, results);
+      fclose(fp);
+    }
+  if (baseline)
+    {
+      int num_base, b;
+      Bench_Baseline *base = read_baseline(baseline, &num_base);
+      if (!base)
+        return 1;
+      i = compare_baseline(json ? stderr : stdout, &argv[optind], num_files,
+                           sizes, results, base, num_base, threshold);
+      if (i)
+        {
+          fprintf(stderr, "%d file(s) or phase(s) failed or regressed by "
+                          "more than %.1f%% against %s\n", i, threshold,
+                  baseline);
+          status = 1;
+        }
+      for (b = 0; b < num_base; b++)
+        free(base[b].file);
+      free(base);
+    }
+
+  free(t);
+  free(results);
+  free(sizes);
+  return status;
+}
@@ -0,0 +1,881 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * dwggen.c: generate large synthetic drawings for benchmarks and tests.
+ *           Reads an r2000 template DWG, appends the requested number of
+ *           layers, XRECORDs, nested blocks and LINE, LWPOLYLINE, TEXT and
+ *           INSERT entities, and writes it as DWG or DXF.
+ *           The output only depends on the template, the counts and the seed.
+ */
+
+#include "../src/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <getopt.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <dwg.h>
+#include "../src/common.h"
+#include "bits.h"
+#include "out_dxf.h"
+
+#define REFS_PER_REALLOC 128
+/* the decoder rejects larger dictionaries */
+#define XRECORDS_PER_DICT 5000
+#define ENTITIES_PER_BLOCK 4
+#define MAX_TABLE_ENTRIES 32000
+#define EXTENT 1000.0
+
+static int opts = 0;
+
+/* entity and object counts */
+static BITCODE_BL num_lines, num_lwpolylines, num_texts, num_inserts;
+static BITCODE_BL num_blocks = 10, depth = 3, num_layers = 10;
+static BITCODE_BL num_xrecords = 100;
+static uint64_t rng = 0x2545F4914F6CDD1DULL;
+
+static int usage(void) {
+  printf("\nUsage: dwggen [-v[0-9]] [-n N] [OPTIONS] TEMPLATE.dwg "
+         "OUTFILE.{dwg,dxf}\n");
+  return 1;
+}
+static int opt_version(void) {
+  printf("dwggen %s\n", PACKAGE_VERSION);
+  return 0;
+}
+static int help(void) {
+  printf("\nUsage: dwggen [OPTION]... TEMPLATE.dwg OUTFILE\n");
+  printf("Appends synthetic objects to the r2000 TEMPLATE.dwg and writes it\n"
+         "to OUTFILE, as DXF with a .dxf suffix, else as DWG.\n"
+         "\n");
+#ifdef HAVE_GETOPT_LONG
+  printf("  -v[0-9], --verbose [0-9]  verbosity of the library\n");
+  printf("  -n N,    --entities N     model space entities: 50%% LINE,\n"
+         "                            20%% LWPOLYLINE, 20%% TEXT, 10%% INSERT.\n"
+         "                            Default: 10000\n");
+  printf("           --lines N        number of LINE entities\n");
+  printf("           --lwpolylines N  number of LWPOLYLINE entities\n");
+  printf("           --texts N        number of TEXT entities\n");
+  printf("           --inserts N      number of INSERT entities\n");
+  printf("  -b N,    --blocks N       number of blocks. Default: 10\n");
+  printf("  -d N,    --depth N        block nesting depth. Default: 3\n");
+  printf("  -l N,    --layers N       number of layers. Default: 10\n");
+  printf("  -x N,    --xrecords N     number of XRECORDs. Default: 100\n");
+  printf("  -s N,    --seed N         random seed\n");
+  printf("  -y,      --overwrite      overwrite an existing OUTFILE\n");
+  printf("           --help           display this help and exit\n");
+  printf("           --version        output version information and exit\n"
+         "\n");
+#else
+  printf("  -v[0-9]     verbosity of the library\n");
+  printf("  -n N        model space entities. Default: 10000\n");
+  printf("  -b N        number of blocks. Default: 10\n");
+  printf("  -d N        block nesting depth. Default: 3\n");
+  printf("  -l N        number of layers. Default: 10\n");
+  printf("  -x N        number of XRECORDs. Default: 100\n");
+  printf("  -s N        random seed\n");
+  printf("  -y          overwrite an existing OUTFILE\n");
+  printf("  -h          display this help and exit\n");
+  printf("  -i          output version information and exit\n"
+         "\n");
+#endif
+  printf("GNU LibreDWG online manual: <https://www.gnu.org/software/libredwg/>\n");
+  return 0;
+}
+
+/* xorshift64*, reproducible across platforms */
+static uint64_t
+rnd(void)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double
+rnd_coord(void)
+{
+  return (double)(rnd() >> 11) * (EXTENT / 9007199254740992.0);
+}
+
+static BITCODE_BL
+rnd_below(BITCODE_BL n)
+{
+  return n ? (BITCODE_BL)(rnd() % n) : 0;
+}
+
+static char *
+strnum(const char *prefix, BITCODE_BL n)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%s%u", prefix, (unsigned)n);
+  return strdup(buf);
+}
+
+/* The new objects are preallocated, and filled in handle order. */
+static Dwg_Object *
+next_object(Dwg_Data *dwg, BITCODE_BL *next)
+{
+  return &dwg->object[(*next)++];
+}
+
+/* New references are registered in dwg->object_ref, which frees them. */
+static Dwg_Object_Ref *
+new_ref(Dwg_Data *dwg, const unsigned int code, const Dwg_Object *obj)
+{
+  Dwg_Object_Ref *ref;
+  if (dwg->num_object_refs % REFS_PER_REALLOC == 0)
+    {
+      Dwg_Object_Ref **refs = realloc(dwg->object_ref,
+          (dwg->num_object_refs + REFS_PER_REALLOC) * sizeof(Dwg_Object_Ref*));
+      if (!refs)
+        return NULL;
+      dwg->object_ref = refs;
+    }
+  ref = calloc(1, sizeof(Dwg_Object_Ref));
+  if (!ref)
+    return NULL;
+  ref->obj = (Dwg_Object *)obj;
+  ref->handleref.code = code;
+  ref->handleref.size = obj->handle.size;
+  ref->handleref.value = obj->handle.value;
+  ref->absolute_ref = obj->handle.value;
+  ref->generation = dwg->refs_generation;
+  dwg->object_ref[dwg->num_object_refs++] = ref;
+  return ref;
+}
+
+static Dwg_Object *
+ref_obj(Dwg_Data *dwg, Dwg_Object_Ref *ref)
+{
+  return ref ? dwg_resolve_handle(dwg, ref->absolute_ref) : NULL;
+}
+
+static unsigned int
+handle_size(unsigned long value)
+{
+  unsigned int size = 0;
+  while (value)
+    {
+      size++;
+      value >>= 8;
+    }
+  return size;
+}
+
+/* Append n entries to a table control or dictionary handle vector. */
+static int
+grow_refs(BITCODE_H **vec, BITCODE_BL num, BITCODE_BL n)
+{
+  BITCODE_H *v;
+  if (!n)
+    return 0;
+  v = realloc(*vec, (num + n) * sizeof(BITCODE_H));
+  if (!v)
+    return 1;
+  *vec = v;
+  return 0;
+}
+
+static int
+add_entity_common(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *owner,
+                  Dwg_Object *layer)
+{
+  Dwg_Object_Entity *ent = obj->tio.entity;
+  /* entity_mode 0: the owner is stored explicitly, for blocks and
+     model space alike */
+  ent->entity_mode = 0;
+  ent->nolinks = 1;
+  ent->color.index = 256; /* BYLAYER */
+  ent->linetype_scale = 1.0;
+  ent->lineweight = 29;   /* BYLAYER */
+  ent->subentity = new_ref(dwg, 4, owner);
+  ent->layer = new_ref(dwg, 5, layer);
+  return !ent->subentity || !ent->layer;
+}
+
+static int
+add_line(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *owner, Dwg_Object *layer)
+{
+  Dwg_Entity_LINE *_obj;
+  if (dwg_add_LINE(obj))
+    return 1;
+  obj->type = DWG_TYPE_LINE;
+  _obj = obj->tio.entity->tio.LINE;
+  _obj->start.x = rnd_coord();
+  _obj->start.y = rnd_coord();
+  _obj->end.x = _obj->start.x + rnd_coord() / 10.0;
+  _obj->end.y = _obj->start.y + rnd_coord() / 10.0;
+  _obj->extrusion.z = 1.0;
+  return add_entity_common(dwg, obj, owner, layer);
+}
+
+static int
+add_lwpolyline(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *owner,
+               Dwg_Object *layer)
+{
+  Dwg_Entity_LWPOLYLINE *_obj;
+  BITCODE_BL i;
+  double x, y;
+  if (dwg_add_LWPOLYLINE(obj))
+    return 1;
+  obj->type = DWG_TYPE_LWPOLYLINE;
+  _obj = obj->tio.entity->tio.LWPOLYLINE;
+  _obj->flag = rnd() & 1 ? 512 : 0; /* closed */
+  _obj->extrusion.z = 1.0;
+  _obj->num_points = 4 + rnd_below(13);
+  _obj->points = calloc(_obj->num_points, sizeof(BITCODE_2RD));
+  if (!_obj->points)
+    return 1;
+  x = rnd_coord();
+  y = rnd_coord();
+  for (i = 0; i < _obj->num_points; i++)
+    {
+      x += rnd_coord() / 50.0 - EXTENT / 100.0;
+      y += rnd_coord() / 50.0 - EXTENT / 100.0;
+      _obj->points[i].x = x;
+      _obj->points[i].y = y;
+    }
+  return add_entity_common(dwg, obj, owner, layer);
+}
+
+static int
+add_text(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *owner, Dwg_Object *layer,
+         Dwg_Object *style, BITCODE_BL n)
+{
+  Dwg_Entity_TEXT *_obj;
+  if (dwg_add_TEXT(obj))
+    return 1;
+  obj->type = DWG_TYPE_TEXT;
+  _obj = obj->tio.entity->tio.TEXT;
+  /* no elevation, alignment_pt, oblique_ang, generation, alignments */
+  _obj->dataflags = 0x01 | 0x02 | 0x04 | 0x20 | 0x40 | 0x80;
+  _obj->insertion_pt.x = rnd_coord();
+  _obj->insertion_pt.y = rnd_coord();
+  _obj->extrusion.z = 1.0;
+  _obj->rotation = (double)rnd_below(360) * 0.017453292519943295;
+  _obj->height = 2.5;
+  _obj->width_factor = 1.0;
+  _obj->text_value = strnum("dwggen text ", n);
+  _obj->style = new_ref(dwg, 5, style);
+  if (!_obj->text_value || !_obj->style)
+    return 1;
+  return add_entity_common(dwg, obj, owner, layer);
+}
+
+static int
+add_insert(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *owner,
+           Dwg_Object *layer, Dwg_Object *block_header)
+{
+  Dwg_Entity_INSERT *_obj;
+  double scale;
+  if (dwg_add_INSERT(obj))
+    return 1;
+  obj->type = DWG_TYPE_INSERT;
+  _obj = obj->tio.entity->tio.INSERT;
+  _obj->ins_pt.x = rnd_coord();
+  _obj->ins_pt.y = rnd_coord();
+  scale = rnd() & 1 ? 1.0 : 0.5 + (double)rnd_below(4);
+  _obj->scale.x = _obj->scale.y = _obj->scale.z = scale;
+  _obj->rotation = (double)rnd_below(4) * 1.5707963267948966;
+  _obj->extrusion.z = 1.0;
+  _obj->block_header = new_ref(dwg, 5, block_header);
+  if (!_obj->block_header)
+    return 1;
+  return add_entity_common(dwg, obj, owner, layer);
+}
+
+static int
+add_layer(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *control,
+          const Dwg_Object_LAYER *tmpl, BITCODE_BL n)
+{
+  Dwg_Object_LAYER *_obj;
+  Dwg_Object_LAYER_CONTROL *ctrl = control->tio.object->tio.LAYER_CONTROL;
+  Dwg_Object *ltype = ref_obj(dwg, tmpl->linetype);
+  Dwg_Object *plotstyle = ref_obj(dwg, tmpl->plotstyle);
+  if (dwg_add_LAYER(obj))
+    return 1;
+  obj->type = DWG_TYPE_LAYER;
+  _obj = obj->tio.object->tio.LAYER;
+  _obj->entry_name = strnum("DWGGEN_", n);
+  _obj->flag = tmpl->flag;
+  _obj->xrefref = tmpl->xrefref;
+  _obj->color.index = 1 + n % 7;
+  _obj->layer_control = new_ref(dwg, 4, control);
+  if (ltype)
+    _obj->linetype = new_ref(dwg, 5, ltype);
+  if (plotstyle)
+    _obj->plotstyle = new_ref(dwg, 5, plotstyle);
+  ctrl->layers[ctrl->num_entries++] = new_ref(dwg, 2, obj);
+  return !_obj->entry_name || !_obj->layer_control
+    || !ctrl->layers[ctrl->num_entries - 1];
+}
+
+static int
+add_dictionary(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *nod,
+               BITCODE_BL num_items, BITCODE_BL n)
+{
+  Dwg_Object_DICTIONARY *_obj;
+  Dwg_Object_DICTIONARY *_nod = nod->tio.object->tio.DICTIONARY;
+  if (dwg_add_DICTIONARY(obj))
+    return 1;
+  obj->type = DWG_TYPE_DICTIONARY;
+  _obj = obj->tio.object->tio.DICTIONARY;
+  _obj->cloning = 1;
+  _obj->hard_owner = 1;
+  _obj->parenthandle = new_ref(dwg, 4, nod);
+  obj->tio.object->num_reactors = 1;
+  obj->tio.object->reactors = calloc(1, sizeof(BITCODE_H));
+  _obj->text = calloc(num_items, sizeof(BITCODE_TV));
+  _obj->itemhandles = calloc(num_items, sizeof(BITCODE_H));
+  if (!obj->tio.object->reactors || !_obj->text || !_obj->itemhandles)
+    return 1;
+  obj->tio.object->reactors[0] = new_ref(dwg, 4, nod);
+  _nod->text[_nod->numitems] = strnum("DWGGEN_", n);
+  _nod->itemhandles[_nod->numitems++] = new_ref(dwg, 2, obj);
+  return 0;
+}
+
+static Dwg_Resbuf *
+add_resbuf(Dwg_Resbuf **tail, short type, BITCODE_BL *num_databytes)
+{
+  Dwg_Resbuf *rbuf = calloc(1, sizeof(Dwg_Resbuf));
+  if (!rbuf)
+    return NULL;
+  rbuf->type = type;
+  *tail = rbuf;
+  *num_databytes += 2; /* the RS type */
+  return rbuf;
+}
+
+static int
+add_xrecord(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *dict, BITCODE_BL n)
+{
+  Dwg_Object_XRECORD *_obj;
+  Dwg_Object_DICTIONARY *_dict = dict->tio.object->tio.DICTIONARY;
+  Dwg_Resbuf *rbuf;
+  if (dwg_add_XRECORD(obj))
+    return 1;
+  obj->type = DWG_TYPE_XRECORD;
+  _obj = obj->tio.object->tio.XRECORD;
+  _obj->cloning_flags = 1;
+  _obj->parenthandle = new_ref(dwg, 4, dict);
+  obj->tio.object->num_reactors = 1;
+  obj->tio.object->reactors = calloc(1, sizeof(BITCODE_H));
+  if (!_obj->parenthandle || !obj->tio.object->reactors)
+    return 1;
+  obj->tio.object->reactors[0] = new_ref(dwg, 4, dict);
+
+  /* 1: string, 40: real, 70: int16, 10: point */
+  if (!(rbuf = add_resbuf(&_obj->xdata, 1, &_obj->num_databytes)))
+    return 1;
+  rbuf->value.str.u.data = strnum("dwggen xrecord ", n);
+  if (!rbuf->value.str.u.data)
+    return 1;
+  rbuf->value.str.size = strlen(rbuf->value.str.u.data);
+  rbuf->value.str.codepage = 30; /* ANSI_1252 */
+  _obj->num_databytes += 2 + 1 + rbuf->value.str.size;
+  if (!(rbuf = add_resbuf(&rbuf->next, 40, &_obj->num_databytes)))
+    return 1;
+  rbuf->value.dbl = rnd_coord();
+  _obj->num_databytes += 8;
+  if (!(rbuf = add_resbuf(&rbuf->next, 70, &_obj->num_databytes)))
+    return 1;
+  rbuf->value.i16 = (short)(n & 0x7fff);
+  _obj->num_databytes += 2;
+  if (!(rbuf = add_resbuf(&rbuf->next, 10, &_obj->num_databytes)))
+    return 1;
+  rbuf->value.pt[0] = rnd_coord();
+  rbuf->value.pt[1] = rnd_coord();
+  _obj->num_databytes += 24;
+  _obj->num_eed = 4;
+
+  _dict->text[_dict->numitems] = strnum("X", n);
+  _dict->itemhandles[_dict->numitems++] = new_ref(dwg, 2, obj);
+  return 0;
+}
+
+static int
+add_block_header(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *control,
+                 BITCODE_BL n)
+{
+  Dwg_Object_BLOCK_HEADER *_obj;
+  Dwg_Object_BLOCK_CONTROL *ctrl = control->tio.object->tio.BLOCK_CONTROL;
+  if (dwg_add_BLOCK_HEADER(obj))
+    return 1;
+  obj->type = DWG_TYPE_BLOCK_HEADER;
+  _obj = obj->tio.object->tio.BLOCK_HEADER;
+  _obj->entry_name = strnum("DWGGEN_", n);
+  _obj->xrefref = 1;
+  _obj->block_control = new_ref(dwg, 4, control);
+  ctrl->block_headers[ctrl->num_entries++] = new_ref(dwg, 2, obj);
+  return !_obj->entry_name || !_obj->block_control
+    || !ctrl->block_headers[ctrl->num_entries - 1];
+}
+
+/* BLOCK_HEADER, BLOCK, the entities, optionally an INSERT of the previous
+   block for the nesting, and ENDBLK. */
+static int
+add_block(Dwg_Data *dwg, BITCODE_BL *next, Dwg_Object *control,
+          Dwg_Object *layer, Dwg_Object *inner, BITCODE_BL n)
+{
+  Dwg_Object *hdr = next_object(dwg, next);
+  Dwg_Object_BLOCK_HEADER *_hdr;
+  Dwg_Object *obj;
+  BITCODE_BL i;
+
+  if (add_block_header(dwg, hdr, control, n))
+    return 1;
+  _hdr = hdr->tio.object->tio.BLOCK_HEADER;
+
+  obj = next_object(dwg, next);
+  if (dwg_add_BLOCK(obj))
+    return 1;
+  obj->type = DWG_TYPE_BLOCK;
+  obj->tio.entity->tio.BLOCK->name = strdup(_hdr->entry_name);
+  if (add_entity_common(dwg, obj, hdr, layer))
+    return 1;
+  _hdr->block_entity = new_ref(dwg, 3, obj);
+
+  for (i = 0; i < ENTITIES_PER_BLOCK; i++)
+    {
+      obj = next_object(dwg, next);
+      if (add_line(dwg, obj, hdr, layer))
+        return 1;
+      if (!i)
+        _hdr->first_entity = new_ref(dwg, 4, obj);
+    }
+  if (inner)
+    {
+      obj = next_object(dwg, next);
+      if (add_insert(dwg, obj, hdr, layer, inner))
+        return 1;
+    }
+  _hdr->last_entity = new_ref(dwg, 4, obj);
+
+  obj = next_object(dwg, next);
+  if (dwg_add_ENDBLK(obj))
+    return 1;
+  obj->type = DWG_TYPE_ENDBLK;
+  if (add_entity_common(dwg, obj, hdr, layer))
+    return 1;
+  _hdr->endblk_entity = new_ref(dwg, 3, obj);
+  return !_hdr->block_entity || !_hdr->first_entity || !_hdr->last_entity
+    || !_hdr->endblk_entity;
+}
+
+static int
+generate(Dwg_Data *dwg)
+{
+  Dwg_Header_Variables *vars = &dwg->header_vars;
+  Dwg_Object *layer_control, *block_control, *nod, *mspace, *clayer, *style;
+  Dwg_Object **layers, **blocks;
+  Dwg_Object_BLOCK_HEADER *_mspace;
+  Dwg_Object *obj = NULL, *dict = NULL;
+  BITCODE_BL num_dicts, num_entities, num_new, first, next, i;
+  BITCODE_BL todo[4];
+  unsigned long handle;
+  int error = 0;
+
+  if (dwg->header.version != R_2000)
+    {
+      fprintf(stderr, "The template must be a r2000 DWG\n");
+      return 1;
+    }
+  layer_control = ref_obj(dwg, vars->LAYER_CONTROL_OBJECT);
+  block_control = ref_obj(dwg, vars->BLOCK_CONTROL_OBJECT);
+  nod = ref_obj(dwg, vars->DICTIONARY_NAMED_OBJECTS);
+  mspace = ref_obj(dwg, vars->BLOCK_RECORD_MSPACE);
+  clayer = ref_obj(dwg, vars->CLAYER);
+  style = ref_obj(dwg, vars->TEXTSTYLE);
+  if (!layer_control || !block_control || !nod || !mspace || !clayer
+      || !style || !vars->HANDSEED)
+    {
+      fprintf(stderr, "The template lacks a table, dictionary or header "
+                      "variable\n");
+      return 1;
+    }
+
+  num_dicts = (num_xrecords + XRECORDS_PER_DICT - 1) / XRECORDS_PER_DICT;
+  if (!num_blocks)
+    num_inserts = 0;
+  num_entities = num_lines + num_lwpolylines + num_texts + num_inserts;
+  num_new = num_layers + num_dicts + num_xrecords + num_entities;
+  for (i = 0; i < num_blocks; i++)
+    num_new += 3 + ENTITIES_PER_BLOCK + (i % depth ? 1 : 0);
+
+  /* Add all new objects at once, so that the template refs only need to be
+     resolved once more after dwg->object moved. */
+  first = next = dwg->num_objects;
+  for (i = 0; i < num_new; i++)
+    if (dwg_add_object(dwg) > 0)
+      {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+      }
+  for (i = 0; i < dwg->num_object_refs; i++)
+    {
+      dwg->object_ref[i]->obj
+          = dwg_resolve_handle(dwg, dwg->object_ref[i]->absolute_ref);
+      dwg->object_ref[i]->generation = dwg->refs_generation;
+    }
+  layer_control = ref_obj(dwg, vars->LAYER_CONTROL_OBJECT);
+  block_control = ref_obj(dwg, vars->BLOCK_CONTROL_OBJECT);
+  nod = ref_obj(dwg, vars->DICTIONARY_NAMED_OBJECTS);
+  mspace = ref_obj(dwg, vars->BLOCK_RECORD_MSPACE);
+  clayer = ref_obj(dwg, vars->CLAYER);
+  style = ref_obj(dwg, vars->TEXTSTYLE);
+
+  /* the encoder recomputes the size of the changed template objects */
+  layer_control->size = layer_control->bitsize = 0;
+  block_control->size = block_control->bitsize = 0;
+  nod->size = nod->bitsize = 0;
+  mspace->size = mspace->bitsize = 0;
+
+  /* ascending handles from HANDSEED on, so the encoder needs no sorting */
+  handle = vars->HANDSEED->absolute_ref;
+  for (i = first; i < dwg->num_objects; i++)
+    {
+      dwg->object[i].handle.value = handle++;
+      dwg->object[i].handle.size = handle_size(dwg->object[i].handle.value);
+    }
+  vars->HANDSEED->handleref.value = vars->HANDSEED->absolute_ref = handle;
+  vars->HANDSEED->handleref.size = handle_size(handle);
+
+  layers = calloc(num_layers + 1, sizeof(Dwg_Object *));
+  blocks = calloc(num_blocks + 1, sizeof(Dwg_Object *));
+  if (!layers || !blocks
+      || grow_refs(&layer_control->tio.object->tio.LAYER_CONTROL->layers,
+                   layer_control->tio.object->tio.LAYER_CONTROL->num_entries,
+                   num_layers)
+      || grow_refs(&block_control->tio.object->tio.BLOCK_CONTROL->block_headers,
+                   block_control->tio.object->tio.BLOCK_CONTROL->num_entries,
+                   num_blocks)
+      || grow_refs(&nod->tio.object->tio.DICTIONARY->itemhandles,
+                   nod->tio.object->tio.DICTIONARY->numitems, num_dicts)
+      || (num_dicts && !(nod->tio.object->tio.DICTIONARY->text = realloc(
+              nod->tio.object->tio.DICTIONARY->text,
+              (nod->tio.object->tio.DICTIONARY->numitems + num_dicts)
+              * sizeof(BITCODE_TV)))))
+    {
+      fprintf(stderr, "Out of memory\n");
+      free(layers);
+      free(blocks);
+      return 1;
+    }
+
+  for (i = 0; i < num_layers && !error; i++)
+    {
+      layers[i] = next_object(dwg, &next);
+      error = add_layer(dwg, layers[i], layer_control,
+                        clayer->tio.object->tio.LAYER, i);
+    }
+  if (!num_layers)
+    layers[num_layers++] = clayer;
+
+  for (i = 0; i < num_xrecords && !error; i++)
+    {
+      if (i % XRECORDS_PER_DICT == 0)
+        {
+          BITCODE_BL left = num_xrecords - i;
+          dict = next_object(dwg, &next);
+          error = add_dictionary(dwg, dict, nod, left < XRECORDS_PER_DICT
+                                 ? left : XRECORDS_PER_DICT,
+                                 i / XRECORDS_PER_DICT);
+          if (error)
+            break;
+        }
+      error = add_xrecord(dwg, next_object(dwg, &next), dict, i);
+    }
+
+  /* chains of nested blocks: each one inserts the previous one, up to
+     depth levels */
+  for (i = 0; i < num_blocks && !error; i++)
+    {
+      blocks[i] = &dwg->object[next];
+      error = add_block(dwg, &next, block_control, layers[i % num_layers],
+                        i % depth ? blocks[i - 1] : NULL, i);
+    }
+
+  /* the model space entities, shuffled */
+  _mspace = mspace->tio.object->tio.BLOCK_HEADER;
+  todo[0] = num_lines;
+  todo[1] = num_lwpolylines;
+  todo[2] = num_texts;
+  todo[3] = num_inserts;
+  for (i = 0; i < num_entities && !error; i++)
+    {
+      BITCODE_BL r = rnd_below(num_entities - i);
+      Dwg_Object *layer = layers[rnd_below(num_layers)];
+      obj = next_object(dwg, &next);
+      if (r < todo[0])
+        {
+          todo[0]--;
+          error = add_line(dwg, obj, mspace, layer);
+        }
+      else if (r < todo[0] + todo[1])
+        {
+          todo[1]--;
+          error = add_lwpolyline(dwg, obj, mspace, layer);
+        }
+      else if (r < todo[0] + todo[1] + todo[2])
+        {
+          todo[2]--;
+          error = add_text(dwg, obj, mspace, layer, style, i);
+        }
+      else
+        {
+          todo[3]--;
+          error = add_insert(dwg, obj, mspace, layer,
+                             blocks[rnd_below(num_blocks)]);
+        }
+      if (!error && !_mspace->first_entity)
+        _mspace->first_entity = new_ref(dwg, 4, obj);
+    }
+  if (!error && num_entities)
+    error = !(_mspace->last_entity = new_ref(dwg, 4, obj));
+  /* the out_dxf tables iterate over the decoder's copies */
+  dwg->layer_control = *layer_control->tio.object->tio.LAYER_CONTROL;
+  dwg->block_control = *block_control->tio.object->tio.BLOCK_CONTROL;
+
+  free(layers);
+  free(blocks);
+  if (error)
+    fprintf(stderr, "Out of memory\n");
+  else if (next != dwg->num_objects)
+    {
+      fprintf(stderr, "Internal error: %u of %u new objects\n",
+              (unsigned)(next - first), (unsigned)num_new);
+      error = 1;
+    }
+  return error;
+}
+
+static int
+is_dxf(const char *filename)
+{
+  size_t len = strlen(filename);
+  return len > 4 && (!strcmp(&filename[len - 4], ".dxf")
+                     || !strcmp(&filename[len - 4], ".DXF"));
+}
+
+static int
+count_arg(const char *arg, BITCODE_BL *count)
+{
+  char *end;
+  long n = strtol(arg, &end, 10);
+  if (*end || n < 0 || n > 0x1000000)
+    {
+      fprintf(stderr, "Invalid count %s\n", arg);
+      return 1;
+    }
+  *count = (BITCODE_BL)n;
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i = 1;
+  int c;
+  int error;
+  int overwrite = 0;
+  long entities = 10000;
+  long lines = -1, lwpolylines = -1, texts = -1, inserts = -1;
+  const char *filename_in, *filename_out;
+  struct stat attrib;
+  Dwg_Data dwg;
+#ifdef HAVE_GETOPT_LONG
+  int option_index = 0;
+  static struct option long_options[] = {
+        {"verbose",     1, &opts, 1}, //optional
+        {"entities",    1, 0, 'n'},
+        {"lines",       1, 0, 0},
+        {"lwpolylines", 1, 0, 0},
+        {"texts",       1, 0, 0},
+        {"inserts",     1, 0, 0},
+        {"blocks",      1, 0, 'b'},
+        {"depth",       1, 0, 'd'},
+        {"layers",      1, 0, 'l'},
+        {"xrecords",    1, 0, 'x'},
+        {"seed",        1, 0, 's'},
+        {"overwrite",   0, 0, 'y'},
+        {"help",        0, 0, 0},
+        {"version",     0, 0, 0},
+        {NULL,          0, NULL, 0}
+  };
+#endif
+
+  if (argc < 2)
+    return usage();
+
+  while
+#ifdef HAVE_GETOPT_LONG
+    ((c = getopt_long(argc, argv, ":v::n:b:d:l:x:s:yh",
+                      long_options, &option_index)) != -1)
+#else
+    ((c = getopt(argc, argv, ":v::n:b:d:l:x:s:yhi")) != -1)
+#endif
+    {
+      BITCODE_BL n;
+      if (c == -1) break;
+      switch (c) {
+      case ':': // missing arg
+        if (optarg && !strcmp(optarg, "v")) {
+          opts = 1;
+          break;
+        }
+        fprintf(stderr, "%s: option '-%c' requires an argument\n",
+                argv[0], optopt);
+        break;
+#ifdef HAVE_GETOPT_LONG
+      case 0:
+        /* This option sets a flag */
+        if (!strcmp(long_options[option_index].name, "verbose"))
+          {
+            if (opts < 0 || opts > 9)
+              return usage();
+            break;
+          }
+        if (!strcmp(long_options[option_index].name, "version"))
+          return opt_version();
+        if (!strcmp(long_options[option_index].name, "help"))
+          return help();
+        if (count_arg(optarg, &n))
+          return usage();
+        if (!strcmp(long_options[option_index].name, "lines"))
+          lines = n;
+        else if (!strcmp(long_options[option_index].name, "lwpolylines"))
+          lwpolylines = n;
+        else if (!strcmp(long_options[option_index].name, "texts"))
+          texts = n;
+        else if (!strcmp(long_options[option_index].name, "inserts"))
+          inserts = n;
+        break;
+#else
+      case 'i':
+        return opt_version();
+#endif
+      case 'n':
+        if (count_arg(optarg, &n))
+          return usage();
+        entities = n;
+        break;
+      case 'b':
+        if (count_arg(optarg, &num_blocks) || num_blocks > MAX_TABLE_ENTRIES)
+          return usage();
+        break;
+      case 'd':
+        if (count_arg(optarg, &depth) || !depth)
+          return usage();
+        break;
+      case 'l':
+        if (count_arg(optarg, &num_layers) || num_layers > MAX_TABLE_ENTRIES)
+          return usage();
+        break;
+      case 'x':
+        if (count_arg(optarg, &num_xrecords))
+          return usage();
+        break;
+      case 's':
+        rng = strtoull(optarg, NULL, 10) | 1;
+        break;
+      case 'y':
+        overwrite = 1;
+        break;
+      case 'v': // support -v3 and -v
+        i = (optind > 0 && optind < argc) ? optind-1 : 1;
+        if (!memcmp(argv[i], "-v", 2))
+          {
+            opts = argv[i][2] ? argv[i][2] - '0' : 1;
+          }
+        if (opts < 0 || opts > 9)
+          return usage();
+        break;
+      case 'h':
+        return help();
+      case '?':
+        fprintf(stderr, "%s: invalid option '-%c' ignored\n",
+                argv[0], optopt);
+        break;
+      default:
+        return usage();
+      }
+    }
+
+  if (optind + 2 != argc)
+    return usage();
+  filename_in = argv[optind];
+  filename_out = argv[optind + 1];
+  num_lines = lines >= 0 ? lines : entities / 2;
+  num_lwpolylines = lwpolylines >= 0 ? lwpolylines : entities / 5;
+  num_texts = texts >= 0 ? texts : entities / 5;
+  num_inserts = inserts >= 0 ? inserts
+                : entities - entities / 2 - 2 * (entities / 5);
+  if (!stat(filename_out, &attrib))
+    {
+      if (!overwrite)
+        {
+          fprintf(stderr, "%s already exists. Use --overwrite\n",
+                  filename_out);
+          return 1;
+        }
+      unlink(filename_out);
+    }
+
+  memset(&dwg, 0, sizeof(Dwg_Data));
+  dwg.opts = opts;
+  error = dwg_read_file(filename_in, &dwg);
+  if (error >= DWG_ERR_CRITICAL)
+    {
+      fprintf(stderr, "READ ERROR 0x%x %s\n", error, filename_in);
+      dwg_free(&dwg);
+      return 1;
+    }
+  if (generate(&dwg))
+    {
+      dwg_free(&dwg);
+      return 1;
+    }
+
+  if (is_dxf(filename_out))
+    {
+      Bit_Chain dat = { 0 };
+      dat.version = dwg.header.version;
+      dat.from_version = dwg.header.from_version;
+      dat.fh = fopen(filename_out, "wb");
+      if (!dat.fh)
+        {
+          fprintf(stderr, "Could not write %s\n", filename_out);
+          dwg_free(&dwg);
+          return 1;
+        }
+      error = dwg_write_dxf(&dat, &dwg);
+      fclose(dat.fh);
+    }
+  else
+    error = dwg_write_file(filename_out, &dwg);
+  if (error >= DWG_ERR_CRITICAL)
+    fprintf(stderr, "WRITE ERROR 0x%x %s\n", error, filename_out);
+  else
+    printf("%s: %u objects, %u entities\n", filename_out,
+           (unsigned)dwg.num_objects, (unsigned)dwg.num_entities);
+  dwg_free(&dwg);
+  return error >= DWG_ERR_CRITICAL ? 1 : 0;
+}
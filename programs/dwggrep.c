@@ -366,12 +366,13 @@ static
 int match_3DSOLID(const char *restrict filename, const Dwg_Object *restrict obj)
 {
   char *text = NULL;
-  int found = 0;
+  int found = 0, error;
   BITCODE_BL j;
   Dwg_Entity_3DSOLID *_obj = obj->tio.entity->tio._3DSOLID;
 
   if (!_obj || !obj->tio.entity) return 0;
-  if (_obj->acis_data) {
+  // decrypted on demand
+  if (dwg_ent_3dsolid_get_acis_data(_obj, &error) && !error) {
     MATCH_NO16 (entity, _3DSOLID, acis_data, 1);
     //MATCH_ENTITY (_3DSOLID, acis_data, 1);
     //found += do_match(0, filename, "3DSOLID", 1, (char*)_obj->acis_data);
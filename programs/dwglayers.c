@@ -26,12 +26,13 @@
 #endif
 
 #include <dwg.h>
+#include "logging.h"
 #include "common.h"
 #include "bits.h"
-#include "logging.h"
+#include "dwg_api.h"
 
 static int usage(void) {
-  printf("\nUsage: dwglayers [-f|--flags] [--on] <input_file.dwg>\n");
+  printf("\nUsage: dwglayers [-f|--flags] [-c|--count] [--on] <input_file.dwg>\n");
   return 1;
 }
 static int opt_version(void) {
@@ -45,6 +46,7 @@ static int help(void) {
 #ifdef HAVE_GETOPT_LONG
   printf("  -f, --flags               prints also flags:\n"
          "                3 chars for: f for frozen, + or - for ON or OFF, l for locked\n");
+  printf("  -c, --count               prints also the number of entities on the layer\n");
   printf("      --on                  prints only ON layers\n");
   printf("      --help                display this help and exit\n");
   printf("      --version             output version information and exit\n"
@@ -52,6 +54,7 @@ static int help(void) {
 #else
   printf("  -f            prints also flags:\n"
          "                3 chars for: f for frozen, + or - for ON or OFF, l for locked\n");
+  printf("  -c            prints also the number of entities on the layer\n");
   printf("  -o            prints only ON layers\n");
   printf("  -h            display this help and exit\n");
   printf("  -i            output version information and exit\n"
@@ -66,7 +69,7 @@ main (int argc, char *argv[])
 {
   int error;
   long i = 1;
-  int flags = 0, on = 0;
+  int flags = 0, on = 0, count = 0;
   char* filename_in;
   Dwg_Data dwg;
   Dwg_Object_LAYER *layer;
@@ -75,6 +78,7 @@ main (int argc, char *argv[])
   int option_index = 0;
   static struct option long_options[] = {
         {"flags",   0, 0, 'f'},
+        {"count",   0, 0, 'c'},
         {"on",      0, 0, 'o'},
         {"help",    0, 0, 0},
         {"version", 0, 0, 0},
@@ -84,10 +88,10 @@ main (int argc, char *argv[])
 
   while
 #ifdef HAVE_GETOPT_LONG
-    ((c = getopt_long(argc, argv, "foh",
+    ((c = getopt_long(argc, argv, "fcoh",
                       long_options, &option_index)) != -1)
 #else
-    ((c = getopt(argc, argv, "fohi")) != -1)
+    ((c = getopt(argc, argv, "fcohi")) != -1)
 #endif
     {
       if (c == -1) break;
@@ -106,6 +110,9 @@ main (int argc, char *argv[])
       case 'f':
         flags = 1;
         break;
+      case 'c':
+        count = 1;
+        break;
       case 'o':
         on = 1;
         break;
@@ -132,6 +139,7 @@ main (int argc, char *argv[])
   for (i=0; i < dwg.layer_control.num_entries; i++)
     {
       Dwg_Object *obj = dwg.layer_control.layers[i]->obj;
+      const char *name;
       if (obj->type != DWG_TYPE_LAYER) //can be DICTIONARY also
         continue;
       layer = dwg.layer_control.layers[i]->obj->tio.object->tio.LAYER;
@@ -143,14 +151,16 @@ main (int argc, char *argv[])
                layer->frozen ? "f" : " ",
                layer->on ?     "+" : "-",
                layer->locked ? "l" : " ");
-      // since r2007 unicode, converted to utf-8
-      if (dwg.header.version >= R_2007) {
-        char *utf8 = bit_convert_TU((BITCODE_TU)layer->entry_name);
-        printf("%s\n", utf8);
-        free(utf8);
-      }
-      else
-        printf("%s\n", layer->entry_name);
+      if (count)
+        {
+          const BITCODE_BL *idx;
+          int err;
+          printf("%u\t", (unsigned)dwg_object_get_referrers(
+                             obj, DWG_REF_LAYER, &idx, &err));
+        }
+      // since r2007 unicode, converted to utf-8. NULL if invalid
+      name = dwg_obj_table_utf8name(obj);
+      printf("%s\n", name ? name : "");
     }
 
   // forget about valgrind. really huge DWG's need endlessly here.
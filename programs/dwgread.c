@@ -38,11 +38,17 @@
 #include "bits.h"
 #include "out_json.h"
 #include "out_dxf.h"
+#ifdef USE_PROFILE
+#include "profile.h"
+#endif
 
 static int opts = 1;
+static int stats = 0;
+static int jobs = 1;
+static int precision = 0;
 
 static int usage(void) {
-  printf("\nUsage: dwgread [-v[0-9]] [-O FMT] [-o OUTFILE] [DWGFILE|-]\n");
+  printf("\nUsage: dwgread [-v[0-9]] [-O FMT] [-o OUTFILE] [-j N] [-p N] [DWGFILE|-]\n");
   return 1;
 }
 static int opt_version(void) {
@@ -56,17 +62,25 @@ static int help(void) {
          "\n");
 #ifdef HAVE_GETOPT_LONG
   printf("  -v[0-9], --verbose [0-9]  verbosity\n");
-  printf("  -O fmt,  --format fmt     fmt: DXF, DXFB, JSON, GeoJSON\n");
+  printf("  -O fmt,  --format fmt     fmt: DXF, DXFB, JSON, GeoJSON, GeoJSONSeq\n");
   printf("           Planned output formats:  YAML, XML/OGR, GPX, SVG, PS\n");
   printf("  -o outfile                also defines the output fmt. Default: stdout\n");
+  printf("  -j N,    --jobs N         write JSON or DXF with N threads\n");
+  printf("  -p N,    --precision N    GeoJSON coordinates with N (1-17) decimals. Default: 6\n");
+  printf("           --stats          print decode timings and counters to stderr\n");
+#ifdef USE_PROFILE
+  printf("           --profile[=json] print the per-field decoder profile to stderr\n");
+#endif
   printf("           --help           display this help and exit\n");
   printf("           --version        output version information and exit\n"
          "\n");
 #else
   printf("  -v[0-9]     verbosity\n");
-  printf("  -O fmt      fmt: DXF, DXFB, JSON, GeoJSON\n");
+  printf("  -O fmt      fmt: DXF, DXFB, JSON, GeoJSON, GeoJSONSeq\n");
   printf("              Planned output formats:  YAML, XML/OGR, GPX, SVG, PS\n");
   printf("  -o outfile  also defines the output fmt. Default: stdout\n");
+  printf("  -j N        write JSON or DXF with N threads\n");
+  printf("  -p N        GeoJSON coordinates with N (1-17) decimals. Default: 6\n");
   printf("  -h          display this help and exit\n");
   printf("  -i          output version information and exit\n"
          "\n");
@@ -75,6 +89,52 @@ static int help(void) {
   return 0;
 }
 
+static void
+print_stats(const Dwg_Data *dwg)
+{
+  static const char *const phases[DWG_PHASE_MAX]
+      = { "other", "read", "header", "classes", "sections", "objectmap",
+          "objects", "refs" };
+  static const char *const errors[DWG_STATS_NUM_ERRORS]
+      = { "WRONGCRC",         "NOTYETSUPPORTED", "UNHANDLEDCLASS",
+          "INVALIDTYPE",      "INVALIDHANDLE",   "INVALIDEED",
+          "VALUEOUTOFBOUNDS", "CLASSESNOTFOUND", "SECTIONNOTFOUND",
+          "PAGENOTFOUND",     "INTERNALERROR",   "INVALIDDWG",
+          "IOERROR",          "OUTOFMEM" };
+  const Dwg_Stats *st = dwg_get_stats(dwg);
+  double wall = 0.0, cpu = 0.0;
+  BITCODE_BL i;
+
+  fprintf(stderr, "\n%-12s %10s %10s\n", "phase", "wall [s]", "cpu [s]");
+  for (i = 1; i < DWG_PHASE_MAX; i++)
+    {
+      fprintf(stderr, "%-12s %10.6f %10.6f\n", phases[i], st->wall[i],
+              st->cpu[i]);
+      wall += st->wall[i];
+      cpu += st->cpu[i];
+    }
+  fprintf(stderr, "%-12s %10.6f %10.6f\n", "total", wall, cpu);
+
+  fprintf(stderr, "\n%-32s %10s %12s\n", "type", "objects", "bytes");
+  for (i = 0; i < st->num_types; i++)
+    if (st->type[i].num_objects)
+      fprintf(stderr, "%-32s %10u %12llu\n",
+              st->type[i].name ? st->type[i].name : "?",
+              (unsigned)st->type[i].num_objects,
+              (unsigned long long)st->type[i].bytes);
+
+  for (i = 0; i < DWG_STATS_NUM_ERRORS; i++)
+    if (st->errors[i])
+      fprintf(stderr, "DWG_ERR_%-24s %10u\n", errors[i],
+              (unsigned)st->errors[i]);
+  if (st->unresolved_refs)
+    fprintf(stderr, "unresolved refs: %u\n", (unsigned)st->unresolved_refs);
+  if (st->peak_alloc)
+    fprintf(stderr, "peak alloc (sampled): %llu\n",
+             (unsigned long long)st->peak_alloc);
+  fprintf(stderr, "error: 0x%x\n", st->error);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -85,14 +145,23 @@ main(int argc, char *argv[])
   const char *outfile = NULL;
   int has_v = 0;
   int c;
+#ifdef USE_PROFILE
+  int profile = 0;
+#endif
 #ifdef HAVE_GETOPT_LONG
   int option_index = 0;
   static struct option long_options[] = {
         {"verbose", 1, &opts, 1}, //optional
         {"format",  1, 0, 'O'},
         {"file",    1, 0, 'o'},
+        {"jobs",    1, 0, 'j'},
+        {"precision", 1, 0, 'p'},
         {"help",    0, 0, 0},
         {"version", 0, 0, 0},
+        {"stats",   0, &stats, 1},
+#ifdef USE_PROFILE
+        {"profile", 2, 0, 0},
+#endif
         {NULL,      0, NULL, 0}
   };
 #endif
@@ -102,10 +171,10 @@ main(int argc, char *argv[])
 
   while
 #ifdef HAVE_GETOPT_LONG
-    ((c = getopt_long(argc, argv, ":v::O:o:h",
+    ((c = getopt_long(argc, argv, ":v::O:o:j:p:h",
                       long_options, &option_index)) != -1)
 #else
-    ((c = getopt(argc, argv, ":v::O:o:hi")) != -1)
+    ((c = getopt(argc, argv, ":v::O:o:j:p:hi")) != -1)
 #endif
     {
       if (c == -1) break;
@@ -141,6 +210,13 @@ main(int argc, char *argv[])
           return opt_version();
         if (!strcmp(long_options[option_index].name, "help"))
           return help();
+#ifdef USE_PROFILE
+        if (!strcmp(long_options[option_index].name, "profile"))
+          {
+            profile = optarg && !strcasecmp(optarg, "json") ? 2 : 1;
+            break;
+          }
+#endif
         break;
 #else
       case 'i':
@@ -163,6 +239,9 @@ main(int argc, char *argv[])
             if (strstr(outfile, ".dxfb") || strstr(outfile, ".DXFB"))
               fmt = (char*)"dxfb";
             else
+            if (strstr(outfile, ".geojsons") || strstr(outfile, ".GeoJSONs"))
+              fmt = (char*)"geojsonseq";
+            else
             if (strstr(outfile, ".geojson") || strstr(outfile, ".GeoJSON"))
               fmt = (char*)"geojson";
             else
@@ -170,6 +249,21 @@ main(int argc, char *argv[])
               fprintf(stderr, "Unknown output format for %s\n", outfile);
           }
         break;
+      case 'j':
+        jobs = atoi(optarg);
+        if (jobs < 1)
+          return usage();
+        break;
+      case 'p':
+        precision = atoi(optarg);
+        if (precision < 1 || precision > 17)
+          {
+            fprintf(stderr, "%s: invalid precision '%s', must be 1 to 17\n",
+                    argv[0], optarg);
+            usage();
+            return 1;
+          }
+        break;
       case 'v': // support -v3 and -v
         i = (optind > 0 && optind < argc) ? optind-1 : 1;
         if (!memcmp(argv[i], "-v", 2))
@@ -209,6 +303,8 @@ main(int argc, char *argv[])
   memset(&dwg, 0, sizeof(Dwg_Data));
   if (has_v || !fmt)
     dwg.opts = opts;
+  dwg.num_threads = jobs;
+  dwg.geojson_precision = precision;
 #if defined(USE_TRACING) && defined(HAVE_SETENV)
   if (!has_v)
     setenv("LIBREDWG_TRACE", "1", 0);
@@ -229,6 +325,12 @@ main(int argc, char *argv[])
         dat.fh = fopen(outfile, "w");
       else
         dat.fh = stdout;
+      if (!dat.fh)
+        {
+          fprintf(stderr, "Could not write %s\n", outfile);
+          dwg_free(&dwg);
+          return 1;
+        }
       dat.version = dat.from_version = dwg.header.version;
       // TODO --as-rNNNN version? for now not.
       // we want the native dump, converters are separate.
@@ -241,6 +343,8 @@ main(int argc, char *argv[])
         error = dwg_write_dxf(&dat, &dwg);
       else if (!strcasecmp(fmt, "geojson"))
         error = dwg_write_geojson(&dat, &dwg);
+      else if (!strcasecmp(fmt, "geojsonseq"))
+        error = dwg_write_geojsonseq(&dat, &dwg);
       else
 #endif
         fprintf(stderr, "Invalid output format '%s'\n", fmt);
@@ -254,6 +358,12 @@ main(int argc, char *argv[])
             printf("\nSUCCESS 0x%x\n", error);
         }
     }
+  if (stats)
+    print_stats(&dwg);
+#ifdef USE_PROFILE
+  if (profile)
+    dwg_profile_report(stderr, profile == 2);
+#endif
   // forget about valgrind. really huge DWG's need endlessly here.
   if ((dwg.header.version && dwg.num_objects < 1000)
 #ifdef HAVE_VALGRIND_VALGRIND_H
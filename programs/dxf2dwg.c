@@ -35,6 +35,7 @@ static int help(void);
 static int opts = 1;
 int minimal = 0;
 int binary = 0;
+int jobs = 1;
 char buf[4096];
 /* the current version per spec block */
 static unsigned int cur_ver = 0;
@@ -59,6 +60,7 @@ static int help(void) {
   printf("             r12, r14, r2000\n");
   printf("           Planned versions:\n");
   printf("             r9, r10, r11, r2004, r2007, r2010, r2013, r2018\n");
+  printf("  -j N, --jobs N            read ASCII DXF with N threads\n");
   printf("  -o outfile, --file        only valid with one single DXFFILE\n");
   printf("       --help               display this help and exit\n");
   printf("       --version            output version information and exit\n"
@@ -70,6 +72,7 @@ static int help(void) {
   printf("                r12, r14, r2000 (default)\n");
   printf("              Planned versions:\n");
   printf("                r9, r10, r11, r2004, r2007, r2010, r2013, r2018\n");
+  printf("  -j N        read ASCII DXF with N threads\n");
   printf("  -o dwgfile\n");
   printf("  -h          display this help and exit\n");
   printf("  -i          output version information and exit\n"
@@ -101,6 +104,7 @@ main (int argc, char *argv[])
         {"as",      1, 0, 'a'},
         {"minimal", 0, 0, 'm'},
         {"binary",  0, 0, 'b'},
+        {"jobs",    1, 0, 'j'},
         {"help",    0, 0, 0},
         {"version", 0, 0, 0},
         {NULL,      0, NULL, 0}
@@ -112,10 +116,10 @@ main (int argc, char *argv[])
 
   while
 #ifdef HAVE_GETOPT_LONG
-    ((c = getopt_long(argc, argv, ":a:v::o:h",
+    ((c = getopt_long(argc, argv, ":a:v::o:j:h",
                       long_options, &option_index)) != -1)
 #else
-    ((c = getopt(argc, argv, ":a:v::o:hi")) != -1)
+    ((c = getopt(argc, argv, ":a:v::o:j:hi")) != -1)
 #endif
     {
       if (c == -1) break;
@@ -157,6 +161,11 @@ main (int argc, char *argv[])
       case 'o':
         filename_out = optarg;
         break;
+      case 'j':
+        jobs = atoi(optarg);
+        if (jobs < 1)
+          return usage();
+        break;
       case 'a':
         dwg_version = dwg_version_as(optarg);
         if (dwg_version == R_INVALID)
@@ -213,6 +222,7 @@ main (int argc, char *argv[])
   printf("TODO: reading DXF not yet done\n");
   memset(&dwg, 0, sizeof(Dwg_Data));
   dwg.opts = opts;
+  dwg.num_threads = jobs;
 
   error = dxf_read_file(filename_in, &dwg);
   if (error)
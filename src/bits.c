@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <ctype.h>
 #include <stdint.h>
 #include <inttypes.h>
@@ -904,8 +905,9 @@ bit_write_MS(Bit_Chain * dat, BITCODE_MS value)
 {
   if (value > 0x7fff)
     {
-      bit_write_RS(dat, (value & 0xffff8000) >> 15);
-      bit_write_RS(dat, value & 0x7fff);
+      // low word first, with the continuation bit, as in bit_read_MS
+      bit_write_RS(dat, (value & 0x7fff) | 0x8000);
+      bit_write_RS(dat, (value >> 15) & 0x7fff);
     }
   else
     {
@@ -992,6 +994,7 @@ void
 bit_write_DD(Bit_Chain * dat, double value, double default_value)
 {
   unsigned char *uchar_value;
+  unsigned char *uchar_default;
 
   unsigned int *uint_value;
   unsigned int *uint_default;
@@ -1001,28 +1004,28 @@ bit_write_DD(Bit_Chain * dat, double value, double default_value)
   else
     {
       uchar_value = (unsigned char *) &value;
+      uchar_default = (unsigned char *) &default_value;
       uint_value = (unsigned int *) &value;
       uint_default = (unsigned int *) &default_value;
-      if (uint_value[0] == uint_default[0])
+      // 1: patch bytes 0-3, 2: patch bytes 4,5 and 0-3 of the default
+      if (uint_value[1] == uint_default[1])
         {
-          if (uint_value[1] != uint_default[1])
-            {
-              bit_write_BB(dat, 2);
-              bit_write_RC(dat, uchar_value[4]);
-              bit_write_RC(dat, uchar_value[5]);
-              bit_write_RC(dat, uchar_value[0]);
-              bit_write_RC(dat, uchar_value[1]);
-              bit_write_RC(dat, uchar_value[2]);
-              bit_write_RC(dat, uchar_value[3]);
-            }
-          else
-            {
-              bit_write_BB(dat, 1);
-              bit_write_RC(dat, uchar_value[0]);
-              bit_write_RC(dat, uchar_value[1]);
-              bit_write_RC(dat, uchar_value[2]);
-              bit_write_RC(dat, uchar_value[3]);
-            }
+          bit_write_BB(dat, 1);
+          bit_write_RC(dat, uchar_value[0]);
+          bit_write_RC(dat, uchar_value[1]);
+          bit_write_RC(dat, uchar_value[2]);
+          bit_write_RC(dat, uchar_value[3]);
+        }
+      else if (uchar_value[6] == uchar_default[6]
+               && uchar_value[7] == uchar_default[7])
+        {
+          bit_write_BB(dat, 2);
+          bit_write_RC(dat, uchar_value[4]);
+          bit_write_RC(dat, uchar_value[5]);
+          bit_write_RC(dat, uchar_value[0]);
+          bit_write_RC(dat, uchar_value[1]);
+          bit_write_RC(dat, uchar_value[2]);
+          bit_write_RC(dat, uchar_value[3]);
         }
       else
         {
@@ -1185,12 +1188,35 @@ bit_write_CRC(Bit_Chain * dat, long unsigned int start_address,
   return (crc);
 }
 
+/* Read length bytes at once. The bounds are checked only once, the
+   slow bytewise path is only taken near the end of the chain.
+ */
 void
 bit_read_fixed(Bit_Chain *restrict dat, BITCODE_RC *restrict dest, int length)
 {
-  for (int i = 0; i < length; i++)
+  if (length <= 0)
+    return;
+  // bit_advance_position() stops at the last byte, so keep that
+  if (dat->byte + (unsigned long)length < dat->size)
     {
-      dest[i] = bit_read_RC(dat);
+      const unsigned char *restrict src = &dat->chain[dat->byte];
+      if (dat->bit == 0)
+        memcpy(dest, src, length);
+      else
+        {
+          const unsigned int shift = dat->bit;
+          const unsigned int rshift = 8 - shift;
+          for (int i = 0; i < length; i++)
+            dest[i] = (BITCODE_RC)((src[i] << shift) | (src[i+1] >> rshift));
+        }
+      dat->byte += length;
+    }
+  else
+    {
+      for (int i = 0; i < length; i++)
+        {
+          dest[i] = bit_read_RC(dat);
+        }
     }
 }
 
@@ -1224,23 +1250,14 @@ bit_write_TF(Bit_Chain *restrict dat, BITCODE_TF restrict chain, int length)
 BITCODE_TV
 bit_read_TV(Bit_Chain *restrict dat)
 {
-  unsigned int i;
   unsigned int length;
   unsigned char *chain;
 
   length = bit_read_BS(dat);
   // if (length > AVAIL_BITS()) return DWG_ERR_VALUEOUTOFBOUNDS;
   chain = (unsigned char *) malloc(length + 1);
-  for (i = 0; i < length; i++)
-    {
-      chain[i] = bit_read_RC(dat);
-#if 0
-      /* we support encode and codepages */
-      if (!isprint (chain[i]))
-        chain[i] = '~';
-#endif
-    }
-  chain[i] = '\0';
+  bit_read_fixed(dat, chain, (int)length);
+  chain[length] = '\0';
 
   return (char *)chain;
 }
@@ -1265,16 +1282,20 @@ bit_write_TV(Bit_Chain *restrict dat, char *restrict chain)
 BITCODE_TU
 bit_read_TU(Bit_Chain *restrict dat)
 {
-  unsigned int i;
   unsigned int length;
   BITCODE_TU chain;
 
   length = bit_read_BS(dat);
   chain = (BITCODE_TU) malloc((length + 1) * 2);
-  for (i = 0; i < length; i++)
+  // little-endian UCS-2, read as bytes at once
+  bit_read_fixed(dat, (BITCODE_RC *)chain, (int)(length * 2));
+#ifdef WORDS_BIGENDIAN
+  for (unsigned int i = 0; i < length; i++)
     {
-      chain[i] = bit_read_RS(dat); // probably without byte swapping
+      const unsigned char *p = (const unsigned char *)&chain[i];
+      chain[i] = (uint16_t)(p[0] | (p[1] << 8));
     }
+#endif
   chain[length] = 0;
 
   return chain;
@@ -1308,46 +1329,128 @@ bit_write_TU(Bit_Chain *restrict dat, BITCODE_TU restrict chain)
   bit_write_RS(dat, 0); //?? unsure about that
 }
 
-/* converts UCS-2 to UTF-8 */
+/* Returns the number of UTF-8 bytes needed for the UCS-2/UTF-16 string,
+   without the final zero, and its length in 16-bit units. */
+static size_t
+bit_TU_utf8_len(const BITCODE_TU restrict wstr, size_t *restrict wlenp)
+{
+  const uint16_t *w = (const uint16_t *)wstr;
+  size_t len = 0;
+  size_t i = 0;
+  uint16_t c;
+  while ((c = w[i]))
+    {
+      if (c < 0x80)
+        len++;
+      else if (c < 0x800)
+        len += 2;
+      else if (c >= 0xd800 && c < 0xdc00 && w[i+1] >= 0xdc00 && w[i+1] < 0xe000)
+        {
+          len += 4; // surrogate pair
+          i++;
+        }
+      else
+        len += 3;
+      i++;
+    }
+  *wlenp = i;
+  return len;
+}
+
+/* Converts wlen UCS-2/UTF-16 units to UTF-8, into a big enough dest.
+   Runs of ASCII are copied 4 units at once. */
+static void
+bit_TU_to_utf8(char *restrict dest, const BITCODE_TU restrict wstr,
+               const size_t wlen)
+{
+  const uint16_t *w = (const uint16_t *)wstr;
+  unsigned char *s = (unsigned char *)dest;
+  size_t i = 0;
+  while (i < wlen)
+    {
+      uint32_t c;
+      while (i + 4 <= wlen)
+        {
+          uint64_t x;
+          memcpy(&x, &w[i], 8);
+          if (x & UINT64_C(0xff80ff80ff80ff80))
+            break;
+          s[0] = (unsigned char)w[i];
+          s[1] = (unsigned char)w[i+1];
+          s[2] = (unsigned char)w[i+2];
+          s[3] = (unsigned char)w[i+3];
+          s += 4;
+          i += 4;
+        }
+      if (i >= wlen)
+        break;
+      c = w[i++];
+      if (c < 0x80)
+        *s++ = (unsigned char)c;
+      else if (c < 0x800)
+        {
+          *s++ = (unsigned char)(0xc0 | (c >> 6));
+          *s++ = (unsigned char)(0x80 | (c & 0x3f));
+        }
+      else if (c >= 0xd800 && c < 0xdc00 && i < wlen
+               && w[i] >= 0xdc00 && w[i] < 0xe000)
+        {
+          c = 0x10000 + ((c - 0xd800) << 10) + (w[i++] - 0xdc00);
+          *s++ = (unsigned char)(0xf0 | (c >> 18));
+          *s++ = (unsigned char)(0x80 | ((c >> 12) & 0x3f));
+          *s++ = (unsigned char)(0x80 | ((c >> 6) & 0x3f));
+          *s++ = (unsigned char)(0x80 | (c & 0x3f));
+        }
+      else /* windows ucs-2 may have unpaired surrogates. go straight up */
+        {
+          *s++ = (unsigned char)(0xe0 | (c >> 12));
+          *s++ = (unsigned char)(0x80 | ((c >> 6) & 0x3f));
+          *s++ = (unsigned char)(0x80 | (c & 0x3f));
+        }
+    }
+  *s = '\0';
+}
+
+/* converts UCS-2/UTF-16 to UTF-8 */
 char*
 bit_convert_TU(BITCODE_TU restrict wstr)
 {
-  BITCODE_TU tmp = wstr;
   char *str;
-  int i, len = 0;
-  uint16_t c;
-  while (*tmp++) {
-    len++;
-  }
+  size_t wlen;
+  size_t len;
+  if (!wstr)
+    return NULL;
+  len = bit_TU_utf8_len(wstr, &wlen);
   str = malloc(len+1);
-  i = 0;
-  while ((c = *wstr++)) {
-    if (c < 256) {
-      str[i++] = c & 0xff;
-    }
-    else if (c < 0x800) {
-      if (i+3 > len) {
-        str = realloc(str, i+3);
-        len = i+2;
-      }
-      str[i+1] = (c & 0x3f) | 0x80;
-      str[i] = (c >> 6) & 0xc0;
-      i += 2;
-    }
-    else { /* windows ucs-2 has no D800-DC00 surrogate pairs. go straight up */
-      if (i+3 > len) {
-        str = realloc(str, i+4);
-        len = i+3;
-      }
-      str[i+3] = (c & 0x3f) | 0x80;
-      c >>= 6;
-      str[i+2] = (c & 0x3f) | 0x80;
-      c >>= 6;
-      str[i] = c & 0xe0;
-      i += 3;
+  if (!str)
+    return NULL;
+  bit_TU_to_utf8(str, wstr, wlen);
+  return str;
+}
+
+/* converts UCS-2/UTF-16 to UTF-8 into buf, or to a malloced copy
+   if buf is too small. */
+char*
+bit_convert_TU_buf(BITCODE_TU restrict wstr, char *restrict buf,
+                   const size_t size)
+{
+  char *str;
+  size_t wlen;
+  size_t len;
+  if (!wstr)
+    {
+      *buf = '\0';
+      return buf;
     }
-  }
-  str[i] = '\0';
+  len = bit_TU_utf8_len(wstr, &wlen);
+  if (len < size)
+    str = buf;
+  else if (!(str = malloc(len+1)))
+    {
+      *buf = '\0';
+      return buf;
+    }
+  bit_TU_to_utf8(str, wstr, wlen);
   return str;
 }
 
@@ -1592,6 +1695,139 @@ bit_chain_alloc(Bit_Chain * dat)
     }
 }
 
+/*
+ * Passes len bytes of the output of a writer to dat->fh,
+ * or else to the dat->sink callback.
+ */
+void
+bit_output(Bit_Chain *restrict dat, const void *restrict s, const size_t len)
+{
+  if (dat->fh)
+    fwrite(s, 1, len, dat->fh);
+  else if (dat->sink)
+    dat->sink(dat->sink_user, (const unsigned char *)s, len);
+}
+
+/*
+ * Starts the buffered output of a writer into a new dat->chain of size
+ * bytes. See bit_sink_room.
+ */
+int
+bit_sink_begin(Bit_Chain *restrict dat, const size_t size)
+{
+  dat->chain = (unsigned char *)malloc(size);
+  dat->size = dat->chain ? size : 0;
+  dat->byte = 0;
+  return dat->chain ? 0 : DWG_ERR_OUTOFMEM;
+}
+
+/*
+ * Ends the buffered output. With dat->fh or dat->sink the buffer is freed
+ * and the chain of orig restored, else the output is returned in
+ * dat->chain, of dat->size bytes. Returns error, or out of memory if the
+ * output was lost.
+ */
+int
+bit_sink_end(Bit_Chain *restrict dat, const Bit_Chain *restrict orig,
+             const int error)
+{
+  bit_sink_flush(dat);
+  if (!dat->fh && !dat->sink)
+    {
+      dat->size = dat->byte;
+      return dat->chain ? error : DWG_ERR_OUTOFMEM;
+    }
+  free(dat->chain);
+  dat->chain = orig->chain;
+  dat->size = orig->size;
+  dat->byte = orig->byte;
+  return error;
+}
+
+void
+bit_sink_flush(Bit_Chain *restrict dat)
+{
+  if (!dat->fh && !dat->sink)
+    return;
+  if (dat->byte)
+    bit_output(dat, dat->chain, dat->byte);
+  dat->byte = 0;
+}
+
+/*
+ * The slow path of bit_sink_room: flushes, or grows the buffer if there
+ * is no output.
+ */
+int
+bit_sink_grow(Bit_Chain *restrict dat, const size_t len)
+{
+  unsigned char *chain;
+  size_t size;
+
+  if (dat->byte + len <= dat->size)
+    return 1;
+  if (dat->fh || dat->sink)
+    {
+      bit_sink_flush(dat);
+      return len <= dat->size;
+    }
+  if (!dat->chain)
+    return 0;
+  for (size = dat->size * 2; size < dat->byte + len; size *= 2)
+    ;
+  chain = (unsigned char *)realloc(dat->chain, size);
+  if (!chain)
+    {
+      free(dat->chain);
+      dat->chain = NULL;
+      dat->size = dat->byte = 0;
+      return 0;
+    }
+  dat->chain = chain;
+  dat->size = size;
+  return 1;
+}
+
+/*
+ * Formats into the buffer, or directly to the output if it does not fit.
+ */
+void
+bit_sink_printf(Bit_Chain *restrict dat, const char *restrict fmt, ...)
+{
+  va_list ap;
+  const size_t avail = dat->size - dat->byte;
+  int len;
+
+  if (!dat->chain)
+    return;
+  va_start(ap, fmt);
+  len = vsnprintf((char *)&dat->chain[dat->byte], avail, fmt, ap);
+  va_end(ap);
+  if (len < 0)
+    return;
+  if ((size_t)len >= avail)
+    {
+      va_start(ap, fmt);
+      if (bit_sink_room(dat, len + 1))
+        vsnprintf((char *)&dat->chain[dat->byte], len + 1, fmt, ap);
+      else
+        {
+          char *s;
+          if (dat->fh)
+            vfprintf(dat->fh, fmt, ap);
+          else if (dat->sink && (s = (char *)malloc(len + 1)))
+            {
+              vsnprintf(s, len + 1, fmt, ap);
+              bit_output(dat, s, len);
+              free(s);
+            }
+          len = 0;
+        }
+      va_end(ap);
+    }
+  dat->byte += len;
+}
+
 void
 bit_print(Bit_Chain * dat, long unsigned int size)
 {
@@ -33,6 +33,7 @@
 #define BITS_H
 
 #include <stdio.h>
+#include <string.h>
 #include "config.h"
 #ifdef HAVE_WCHAR_H
 # include <wchar.h>
@@ -54,6 +55,8 @@ typedef struct _bit_chain
   FILE *fh;
   Dwg_Version_Type version;
   Dwg_Version_Type from_version;
+  Dwg_Write_Sink sink; /* the output of the writers without fh */
+  void *sink_user;
 } Bit_Chain;
 
 /* Functions for raw data manipulations.
@@ -250,10 +253,16 @@ bit_read_TU(Bit_Chain *restrict dat);
 void
 bit_write_TU(Bit_Chain *restrict dat, BITCODE_TU restrict value);
 
-/* Converts UCS-2 to UTF-8, returning a copy. */
+/* Converts UCS-2/UTF-16 to UTF-8, returning a copy. */
 EXPORT char*
 bit_convert_TU(BITCODE_TU restrict wstr);
 
+/* Converts UCS-2/UTF-16 to UTF-8 into buf of size bytes. If too small,
+   returns a malloced copy instead, which must be freed when != buf. */
+EXPORT char*
+bit_convert_TU_buf(BITCODE_TU restrict wstr, char *restrict buf,
+                   const size_t size);
+
 /** Converts UTF-8 to UCS-2. Returns a copy.
     Eventually needed by dwg writers (dxf2dwg) */
 EXPORT BITCODE_TU
@@ -292,6 +301,57 @@ bit_write_sentinel(Bit_Chain *dat, unsigned char sentinel[16]);
 void
 bit_chain_alloc(Bit_Chain *dat);
 
+void
+bit_output(Bit_Chain *restrict dat, const void *restrict s, const size_t len);
+
+/* The buffered output of the writers: while writing, dat->chain is a
+   private buffer of dat->size bytes and dat->byte its fill, which is
+   flushed to dat->fh, or else to dat->sink. Without both the output stays
+   in dat->chain, which grows as needed, and is freed and NULL when it
+   could not. Nothing is ever taken back, so the output may be a pipe.
+   dat->bit is left to the writer. */
+int
+bit_sink_begin(Bit_Chain *restrict dat, const size_t size);
+
+int
+bit_sink_end(Bit_Chain *restrict dat, const Bit_Chain *restrict orig,
+             const int error);
+
+void
+bit_sink_flush(Bit_Chain *restrict dat);
+
+int
+bit_sink_grow(Bit_Chain *restrict dat, const size_t len);
+
+/* Makes room for len more bytes at dat->chain[dat->byte]. Returns 0 if
+   len is larger than the buffer for the output, or on out of memory. */
+static ALWAYS_INLINE int
+bit_sink_room(Bit_Chain *restrict dat, const size_t len)
+{
+  return dat->byte + len <= dat->size || bit_sink_grow(dat, len);
+}
+
+/* Appends len bytes, or passes them directly to the output if larger than
+   the buffer */
+static ALWAYS_INLINE void
+bit_sink_write(Bit_Chain *restrict dat, const void *restrict s,
+               const size_t len)
+{
+  if (!bit_sink_room(dat, len))
+    {
+      bit_output(dat, s, len);
+      return;
+    }
+  memcpy(&dat->chain[dat->byte], s, len);
+  dat->byte += len;
+}
+
+#ifdef __GNUC__
+__attribute__((format(printf, 2, 3)))
+#endif
+void
+bit_sink_printf(Bit_Chain *restrict dat, const char *restrict fmt, ...);
+
 void
 bit_print(Bit_Chain *dat, long unsigned int size);
 
@@ -61,6 +61,24 @@
 # endif
 #endif
 
+#ifdef HAVE_ATTRIBUTE_ALWAYS_INLINE
+#  define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#  define ALWAYS_INLINE inline
+#endif
+
+/* for the static state of the output passes, which may run concurrently
+   on the same dwg */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#  define THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#  define THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#  define THREAD_LOCAL __declspec(thread)
+#else
+#  define THREAD_LOCAL
+#endif
+
 #define TODO_ENCODER fprintf(stderr, "TODO: Encoder\n");
 #define TODO_DECODER fprintf(stderr, "TODO: Decoder\n");
 
@@ -59,8 +59,10 @@
   VERSIONS(R_13, R_14) //ODA bug
     {
       FIELD_B (isbylayerlt, 0);
-      if (FIELD_VALUE(isbylayerlt))
-        FIELD_VALUE(linetype_flags) = FIELD_VALUE(isbylayerlt) ? 0 : 3;
+      SET_DERIVED {
+        if (FIELD_VALUE(isbylayerlt))
+          FIELD_VALUE(linetype_flags) = FIELD_VALUE(isbylayerlt) ? 0 : 3;
+      }
     }
   SINCE(R_2004) //ODA bug
     {
@@ -3,7 +3,8 @@
   #include "spec.h"
 
   //free: avoid double-free #43
-  if ((FIELD_VALUE(entity_mode) == 0 && !IF_IS_FREE) || IF_IS_ENCODER)
+  //encode: only with entity_mode 0, as the decoder reads it
+  if (FIELD_VALUE(entity_mode) == 0 && !IF_IS_FREE)
     {
       FIELD_HANDLE(subentity, 4, 0); // doc: owner ref always?
     }
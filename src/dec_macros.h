@@ -26,6 +26,51 @@
 #define ACTION decode
 #define IS_DECODER
 
+/* The range of versions the current decoder was specialised for.
+   Inside the per-family object decoders (see DWG_ENTITY) these are the
+   constant arguments _vmin and _vmax, so the compiler folds away all
+   version checks which cannot be true for this family. */
+#ifndef DWG_VMIN
+#  define DWG_VMIN R_INVALID
+#  define DWG_VMAX R_AFTER
+#endif
+#define DEC_SINCE(v) \
+  (DWG_VMIN >= (v) || (DWG_VMAX >= (v) && dat->version >= (v)))
+#define DEC_UNTIL(v) \
+  (DWG_VMAX <= (v) || (DWG_VMIN <= (v) && dat->version <= (v)))
+
+#undef VERSION
+#undef NOT_VERSION
+#undef VERSIONS
+#undef PRE
+#undef SINCE
+#undef UNTIL
+#define VERSION(v) cur_ver = v; if (DEC_SINCE(v) && DEC_UNTIL(v))
+#define NOT_VERSION(v) cur_ver = v; if (!DEC_SINCE(v) || !DEC_UNTIL(v))
+#define VERSIONS(v1,v2) cur_ver = v2; if (DEC_SINCE(v1) && DEC_UNTIL(v2))
+#define PRE(v) cur_ver = v; if (!DEC_SINCE(v))
+#define SINCE(v) cur_ver = v; if (DEC_SINCE(v))
+#define UNTIL(v) cur_ver = v; if (DEC_UNTIL(v))
+
+/* Per-field profiling, see profile.h. PROFILE_BEGIN opens a block,
+   PROFILE_END closes it. A field which returns an error in between is not
+   recorded. PROFILE_TYPE(NULL) is called by the caller of the per-type
+   decoder, so it is also reset on its early returns. */
+#ifdef USE_PROFILE
+#  include "profile.h"
+#  define PROFILE_TYPE(type) dwg_profile_type (type);
+#  define PROFILE_BEGIN(stream) \
+  { const unsigned long _prof_bits = bit_position (stream); \
+    const uint64_t _prof_ticks = dwg_profile_ticks ();
+#  define PROFILE_END(name, stream) \
+    dwg_profile_add (#name, bit_position (stream) - _prof_bits, \
+                     dwg_profile_ticks () - _prof_ticks); }
+#else
+#  define PROFILE_TYPE(type)
+#  define PROFILE_BEGIN(stream)
+#  define PROFILE_END(name, stream)
+#endif
+
 #define VALUE(value,type,dxf) \
   LOG_TRACE(FORMAT_##type " [" #type " %d]\n", value, dxf)
 #define VALUE_RC(value,dxf) VALUE(value, RC, dxf)
@@ -34,16 +79,22 @@
 #define VALUE_RD(value,dxf) VALUE(value, RD, dxf)
 
 #define FIELDG(name,type,dxf) \
-  { _obj->name = bit_read_##type(dat); \
-    FIELD_G_TRACE(name,type,dxf); }
+  { PROFILE_BEGIN (dat) \
+    _obj->name = bit_read_##type(dat); \
+    FIELD_G_TRACE(name,type,dxf); \
+    PROFILE_END (name, dat) }
 
 #define FIELD(name,type) \
-  { _obj->name = bit_read_##type(dat); \
-    FIELD_TRACE(name,type); }
+  { PROFILE_BEGIN (dat) \
+    _obj->name = bit_read_##type(dat); \
+    FIELD_TRACE(name,type); \
+    PROFILE_END (name, dat) }
 
 #define FIELD_CAST(name,type,cast,dxf)\
-  { _obj->name = (BITCODE_##cast)bit_read_##type(dat); \
-    FIELD_G_TRACE(name,cast,dxf); }
+  { PROFILE_BEGIN (dat) \
+    _obj->name = (BITCODE_##cast)bit_read_##type(dat); \
+    FIELD_G_TRACE(name,cast,dxf); \
+    PROFILE_END (name, dat) }
 
 #define FIELD_G_TRACE(name,type,dxfgroup) \
   LOG_TRACE(#name ": " FORMAT_##type " [" #type " %d]\n", _obj->name, dxfgroup)
@@ -76,7 +127,7 @@
 
 #define ANYCODE -1
 #define VALUE_HANDLE(handleptr, name, handle_code, dxf) \
-  { \
+  { PROFILE_BEGIN (hdl_dat) \
     if (handle_code >= 0) \
       {\
         handleptr = dwg_decode_handleref_with_code(hdl_dat, obj, dwg, handle_code);\
@@ -97,11 +148,12 @@
       {\
         LOG_TRACE(#name ": NULL HANDLE(%x) [%d]\n", handle_code, dxf); \
       }\
+    PROFILE_END (name, hdl_dat) \
   }
 #define FIELD_HANDLE(name, handle_code, dxf) VALUE_HANDLE(_obj->name, name, handle_code, dxf)
 
 #define VALUE_HANDLE_N(handleptr, name, vcount, handle_code, dxf) \
-  {\
+  { PROFILE_BEGIN (hdl_dat) \
     if (handle_code >= 0) \
       {\
         handleptr = dwg_decode_handleref_with_code(hdl_dat, obj, dwg, handle_code);\
@@ -123,18 +175,20 @@
       {\
         LOG_TRACE(#name ": NULL HANDLE(%x) [%d]\n", handle_code, dxf); \
       }\
+    PROFILE_END (name, hdl_dat) \
   }
 #define FIELD_HANDLE_N(name, vcount, handle_code, dxf) \
   VALUE_HANDLE_N(_obj->name, name, vcount, handle_code, dxf)
 
 #define FIELD_DATAHANDLE(name, handle_code, dxf) \
-  { \
+  { PROFILE_BEGIN (dat) \
     _obj->name = dwg_decode_handleref(dat, obj, dwg);\
     LOG_TRACE(#name ": HANDLE(%x.%d.%lX) absolute:%lX [%d]\n",\
               _obj->name->handleref.code,  \
               _obj->name->handleref.size,  \
               _obj->name->handleref.value, \
               _obj->name->absolute_ref, dxf);\
+    PROFILE_END (name, dat) \
   }
 
 #define FIELD_B(name,dxf) FIELDG(name, B, dxf)
@@ -143,7 +197,7 @@
 #define FIELD_BS(name,dxf) FIELDG(name, BS, dxf)
 #define FIELD_BL(name,dxf) FIELDG(name, BL, dxf)
 #define FIELD_BLL(name,dxf) FIELDG(name, BLL, dxf)
-#define FIELD_BD(name,dxf) { \
+#define FIELD_BD(name,dxf) { PROFILE_BEGIN (dat) \
   _obj->name = bit_read_BD(dat); \
   if (bit_isnan(_obj->name)) { \
     FIELD_G_TRACE(name,BD,dxf); \
@@ -156,27 +210,40 @@
   } else { \
     FIELD_G_TRACE(name,BD,dxf); \
   } \
+  PROFILE_END (name, dat) \
 }
 #define FIELD_BLx(name,dxf) \
-  { _obj->name = bit_read_BL(dat); \
-    LOG_TRACE(#name ": 0x%x [BL %d]\n", (uint32_t)_obj->name, dxf); }
+  { PROFILE_BEGIN (dat) \
+    _obj->name = bit_read_BL(dat); \
+    LOG_TRACE(#name ": 0x%x [BL %d]\n", (uint32_t)_obj->name, dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_RLx(name,dxf) \
-  { _obj->name = bit_read_RL(dat); \
-    LOG_TRACE(#name ": 0x%x [RL %d]\n", (uint32_t)_obj->name, dxf); }
+  { PROFILE_BEGIN (dat) \
+    _obj->name = bit_read_RL(dat); \
+    LOG_TRACE(#name ": 0x%x [RL %d]\n", (uint32_t)_obj->name, dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_BSx(name,dxf) \
-  { _obj->name = bit_read_BS(dat); \
-    LOG_TRACE(#name ": 0x%x [BS %d]\n", _obj->name, dxf); }
+  { PROFILE_BEGIN (dat) \
+    _obj->name = bit_read_BS(dat); \
+    LOG_TRACE(#name ": 0x%x [BS %d]\n", _obj->name, dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_RC(name,dxf) FIELDG(name, RC, dxf)
 #define FIELD_RCu(name,dxf) \
-  { _obj->name = bit_read_RC(dat); \
-    LOG_TRACE(#name ": %u [RC %d]\n", (unsigned)((unsigned char)_obj->name), dxf); }
+  { PROFILE_BEGIN (dat) \
+    _obj->name = bit_read_RC(dat); \
+    LOG_TRACE(#name ": %u [RC %d]\n", (unsigned)((unsigned char)_obj->name), dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_RCd(name,dxf) \
-  { _obj->name = bit_read_RC(dat); \
-    LOG_TRACE(#name ": %d [RC %d]\n", (int)((signed char)_obj->name), dxf); }
+  { PROFILE_BEGIN (dat) \
+    _obj->name = bit_read_RC(dat); \
+    LOG_TRACE(#name ": %d [RC %d]\n", (int)((signed char)_obj->name), dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_RS(name,dxf) FIELDG(name, RS, dxf)
 #define FIELD_RSx(name,dxf) \
-  { _obj->name = bit_read_RS(dat); \
-    LOG_TRACE(#name ": %04X [RSx %d]\n", (uint16_t)_obj->name, dxf); }
+  { PROFILE_BEGIN (dat) \
+    _obj->name = bit_read_RS(dat); \
+    LOG_TRACE(#name ": %04X [RSx %d]\n", (uint16_t)_obj->name, dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_RD(name,dxf) { \
   FIELDG(name, RD, dxf); \
   if (bit_isnan(_obj->name)) { \
@@ -189,21 +256,27 @@
 #define FIELD_MC(name,dxf)  FIELDG(name, MC, dxf)
 #define FIELD_MS(name,dxf)  FIELDG(name, MS, dxf)
 #define FIELD_TF(name,len,dxf) \
-  { VECTOR_CHKCOUNT(name,TF,len) \
+  { PROFILE_BEGIN (dat) \
+    VECTOR_CHKCOUNT(name,TF,len) \
     _obj->name = bit_read_TF(dat,(int)len); \
     LOG_INSANE( #name ": [%d TF " #dxf "]\n", len); \
-    LOG_INSANE_TF(FIELD_VALUE(name), (int)len); }
+    LOG_INSANE_TF(FIELD_VALUE(name), (int)len); \
+    PROFILE_END (name, dat) }
 #define FIELD_TFF(name,len,dxf) \
-  { VECTOR_CHKCOUNT(name,TF,len) \
+  { PROFILE_BEGIN (dat) \
+    VECTOR_CHKCOUNT(name,TF,len) \
     bit_read_fixed(dat,_obj->name,(int)len); \
     LOG_INSANE( #name ": [%d TFF " #dxf "]\n", len); \
-    LOG_INSANE_TF(FIELD_VALUE(name), (int)len); }
+    LOG_INSANE_TF(FIELD_VALUE(name), (int)len); \
+    PROFILE_END (name, dat) }
 #define FIELD_TV(name,dxf) FIELDG(name, TV, dxf)
 #define FIELD_TU(name,dxf) \
-  { _obj->name = (char*)bit_read_TU(str_dat); \
-    LOG_TRACE_TU(#name, (BITCODE_TU)FIELD_VALUE(name), dxf); }
+  { PROFILE_BEGIN (str_dat) \
+    _obj->name = (char*)bit_read_TU(str_dat); \
+    LOG_TRACE_TU(#name, (BITCODE_TU)FIELD_VALUE(name), dxf); \
+    PROFILE_END (name, str_dat) }
 #define FIELD_T(name,dxf) \
-  { if (dat->version < R_2007) { \
+  { if (!DEC_SINCE(R_2007)) { \
       FIELD_TV(name,dxf) \
     } else { \
       if (obj->has_strings) { \
@@ -215,17 +288,22 @@
   }
 #define FIELD_BT(name,dxf) FIELDG(name, BT, dxf)
 #define FIELD_4BITS(name,dxf) \
-    { _obj->name = bit_read_4BITS(dat); \
-      FIELD_G_TRACE(name,4BITS,dxf); }
+    { PROFILE_BEGIN (dat) \
+      _obj->name = bit_read_4BITS(dat); \
+      FIELD_G_TRACE(name,4BITS,dxf); \
+      PROFILE_END (name, dat) }
 
 #define FIELD_BE(name,dxf) \
-    bit_read_BE(dat, &_obj->name.x, &_obj->name.y, &_obj->name.z)
-#define FIELD_DD(name, _default, dxf) { \
+  { PROFILE_BEGIN (dat) \
+    bit_read_BE(dat, &_obj->name.x, &_obj->name.y, &_obj->name.z); \
+    PROFILE_END (name, dat) }
+#define FIELD_DD(name, _default, dxf) { PROFILE_BEGIN (dat) \
   FIELD_VALUE(name) = bit_read_DD(dat, _default); \
   if (bit_isnan(_obj->name)) { \
     LOG_ERROR("Invalid DD " #name); \
     return DWG_ERR_VALUEOUTOFBOUNDS; \
   } \
+  PROFILE_END (name, dat) \
 }
 #define FIELD_2DD(name, d1, d2, dxf) { \
     FIELD_DD(name.x, d1, dxf); FIELD_DD(name.y, d2, dxf+10); \
@@ -236,57 +314,69 @@
     FIELD_DD(name.z, FIELD_VALUE(def.z), dxf+20); \
     FIELD_3PT_TRACE(name, DD, dxf); }
 #define FIELD_3RD(name,dxf) \
-  { _obj->name.x = bit_read_RD(dat); \
+  { PROFILE_BEGIN (dat) \
+    _obj->name.x = bit_read_RD(dat); \
     _obj->name.y = bit_read_RD(dat); \
     _obj->name.z = bit_read_RD(dat); \
     if (bit_isnan(_obj->name.x) || bit_isnan(_obj->name.y) || bit_isnan(_obj->name.z)) { \
       LOG_ERROR("Invalid 3RD " #name); \
       return DWG_ERR_VALUEOUTOFBOUNDS; \
     } \
-    FIELD_3PT_TRACE(name,RD,dxf); }
+    FIELD_3PT_TRACE(name,RD,dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_3BD(name,dxf) \
-  { _obj->name.x = bit_read_BD(dat); \
+  { PROFILE_BEGIN (dat) \
+    _obj->name.x = bit_read_BD(dat); \
     _obj->name.y = bit_read_BD(dat); \
     _obj->name.z = bit_read_BD(dat); \
     if (bit_isnan(_obj->name.x) || bit_isnan(_obj->name.y) || bit_isnan(_obj->name.z)) { \
       LOG_ERROR("Invalid 3BD " #name); \
       return DWG_ERR_VALUEOUTOFBOUNDS; \
     } \
-    FIELD_3PT_TRACE(name,BD,dxf); }
+    FIELD_3PT_TRACE(name,BD,dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_2RD(name,dxf) \
-  { _obj->name.x = bit_read_RD(dat); \
+  { PROFILE_BEGIN (dat) \
+    _obj->name.x = bit_read_RD(dat); \
     _obj->name.y = bit_read_RD(dat); \
     if (bit_isnan(_obj->name.x) || bit_isnan(_obj->name.y)) { \
       LOG_ERROR("Invalid 2RD " #name); \
       return DWG_ERR_VALUEOUTOFBOUNDS; \
     } \
-    FIELD_2PT_TRACE(name,RD,dxf); }
+    FIELD_2PT_TRACE(name,RD,dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_2BD(name,dxf) \
-  { _obj->name.x = bit_read_BD(dat); \
+  { PROFILE_BEGIN (dat) \
+    _obj->name.x = bit_read_BD(dat); \
     _obj->name.y = bit_read_BD(dat); \
     if (bit_isnan(_obj->name.x) || bit_isnan(_obj->name.y)) { \
       LOG_ERROR("Invalid 2BD " #name); \
       return DWG_ERR_VALUEOUTOFBOUNDS; \
     } \
-    FIELD_2PT_TRACE(name,BD,dxf); }
+    FIELD_2PT_TRACE(name,BD,dxf); \
+    PROFILE_END (name, dat) }
 #define FIELD_2BD_1(name,dxf) \
-  { _obj->name.x = bit_read_BD(dat); \
+  { PROFILE_BEGIN (dat) \
+    _obj->name.x = bit_read_BD(dat); \
     _obj->name.y = bit_read_BD(dat); \
     if (bit_isnan(_obj->name.x) || bit_isnan(_obj->name.y)) { \
       LOG_ERROR("Invalid 2BD_1 " #name); \
       return DWG_ERR_VALUEOUTOFBOUNDS; \
     } \
-    FIELD_2PT_TRACE(name,BD,dxf); }
+    FIELD_2PT_TRACE(name,BD,dxf); \
+    PROFILE_END (name, dat) }
 // FIELDG(name.x, BD, dxf); FIELDG(name.y, BD, dxf+1);
 #define FIELD_3BD_1(name,dxf) \
-  { _obj->name.x = bit_read_BD(dat); \
+  { PROFILE_BEGIN (dat) \
+    _obj->name.x = bit_read_BD(dat); \
     _obj->name.y = bit_read_BD(dat); \
     _obj->name.z = bit_read_BD(dat); \
     if (bit_isnan(_obj->name.x) || bit_isnan(_obj->name.y) || bit_isnan(_obj->name.z)) { \
       LOG_ERROR("Invalid 3BD_1 " #name); \
       return DWG_ERR_VALUEOUTOFBOUNDS; \
     } \
-    FIELD_3PT_TRACE(name,BD,dxf); }
+    FIELD_3PT_TRACE(name,BD,dxf); \
+    PROFILE_END (name, dat) }
 //    FIELDG(name.x, BD, dxf); FIELDG(name.y, BD, dxf+1);
 //    FIELDG(name.z, BD, dxf+2); }
 #define FIELD_3DPOINT(name,dxf)  FIELD_3BD(name,dxf)
@@ -296,9 +386,10 @@
     LOG_TRACE(#name ": %.8f  (" FORMAT_BL ", " FORMAT_BL ") [TIMEBLL %d]\n", \
               _obj->name.value, _obj->name.days, _obj->name.ms, dxf); }
 #define FIELD_CMC(color,dxf1,dxf2) \
-  { bit_read_CMC(dat, &_obj->color); \
+  { PROFILE_BEGIN (dat) \
+    bit_read_CMC(dat, &_obj->color); \
     LOG_TRACE(#color ".index: %d [CMC.BS %d]\n", _obj->color.index, dxf1); \
-    if (dat->version >= R_2004) { \
+    if (DEC_SINCE(R_2004)) { \
       LOG_TRACE(#color ".rgb: 0x%06x [CMC.BL %d]\n", (unsigned)_obj->color.rgb, dxf2); \
       LOG_TRACE(#color ".flag: 0x%x [CMC.RC]\n", (unsigned)_obj->color.flag); \
       if (_obj->color.flag & 1) \
@@ -306,11 +397,13 @@
       if (_obj->color.flag & 2) \
         LOG_TRACE(#color ".bookname: %s [CMC.TV]\n", _obj->color.book_name); \
     }\
+    PROFILE_END (color, dat) \
   }
 #define FIELD_EMC(color,dxf1,dxf2) \
-  { bit_read_EMC(dat, &_obj->color); \
+  { PROFILE_BEGIN (dat) \
+    bit_read_EMC(dat, &_obj->color); \
     LOG_TRACE(#color ".index: %d [EMC.BS %d]\n", _obj->color.index, dxf1); \
-    if (dat->version >= R_2004) { \
+    if (DEC_SINCE(R_2004)) { \
       if (_obj->color.flag) \
         LOG_TRACE(#color ".flag: 0x%x\n", (unsigned)_obj->color.flag); \
       if (_obj->color.flag & 0x20) \
@@ -322,6 +415,7 @@
       if ((_obj->color.flag & 0x42) == 0x42) \
         LOG_TRACE(#color ".bookname: %s [EMC.TV]\n", _obj->color.book_name); \
     }\
+    PROFILE_END (color, dat) \
   }
 
 #undef DEBUG_POS
@@ -427,7 +521,7 @@
 // it all in the vector called 'name'.
 #define FIELD_VECTOR_N(name, type, size, dxf) \
   if (size > 0) \
-    { \
+    { PROFILE_BEGIN (dat) \
       VECTOR_CHKCOUNT(name,type,size) \
       _obj->name = (BITCODE_##type*) calloc(size, sizeof(BITCODE_##type)); \
       for (vcount=0; vcount<(BITCODE_BL)size; vcount++) \
@@ -436,11 +530,12 @@
           LOG_INSANE(#name "[%ld]: " FORMAT_##type "\n", \
                      (long)vcount, _obj->name[vcount]) \
         }\
+      PROFILE_END (name, dat) \
     }
 #define FIELD_VECTOR_T(name, size, dxf) \
   if (_obj->size > 0) \
-    { \
-      _VECTOR_CHKCOUNT(name,_obj->size,dat->version>=R_2007 ? 18 : 2) \
+    { PROFILE_BEGIN (dat) \
+      _VECTOR_CHKCOUNT(name,_obj->size,DEC_SINCE(R_2007) ? 18 : 2) \
       _obj->name = calloc(_obj->size, sizeof(char*)); \
       for (vcount=0; vcount<(BITCODE_BL)_obj->size; vcount++) \
         {\
@@ -453,10 +548,11 @@
             LOG_TRACE_TU_I(#name, vcount, _obj->name[vcount], dxf) \
           } \
         } \
+      PROFILE_END (name, dat) \
     }
 #define FIELD_VECTOR_N1(name, type, size, dxf) \
   if (size > 0) \
-    { \
+    { PROFILE_BEGIN (dat) \
       int _dxf = dxf;\
       VECTOR_CHKCOUNT(name,type,size) \
       _obj->name = (BITCODE_##type*) calloc(size, sizeof(BITCODE_##type)); \
@@ -466,6 +562,7 @@
           LOG_INSANE(#name "[%ld]: " FORMAT_##type " [" #type " %d]\n", \
                      (long)vcount, _obj->name[vcount], _dxf++) \
         }\
+      PROFILE_END (name, dat) \
     }
 
 #define FIELD_VECTOR(name, type, size, dxf) FIELD_VECTOR_N(name, type, _obj->size, dxf)
@@ -613,7 +710,7 @@
 /* just skip the has_strings bit */
 #define START_HANDLE_STREAM \
   *hdl_dat = *dat; \
-  if (dat->version >= R_2007) { \
+  if (DEC_SINCE(R_2007)) { \
     vcount = bit_position(dat); \
     if (obj->hdlpos != (unsigned long)vcount) { \
       bit_set_position(hdl_dat, obj->hdlpos); \
@@ -631,7 +728,7 @@
   } \
   LOG_INSANE("REPEAT_CHKCOUNT %s." #name " x %ld: %lld > %lld?\n", \
     obj->dxfname, (long)times, (long long)((times)*sizeof(type)), AVAIL_BITS()); \
-  if (dat->version >= R_2004 && (long long)((times)*sizeof(type)) > AVAIL_BITS()) { \
+  if (DEC_SINCE(R_2004) && (long long)((times)*sizeof(type)) > AVAIL_BITS()) { \
     LOG_ERROR("Invalid %s." #name " x %ld\n", obj->dxfname, (long)times); \
     return DWG_ERR_VALUEOUTOFBOUNDS; }
 #define REPEAT_CHKCOUNT_LVAL(name,times,type) \
@@ -642,7 +739,7 @@
   } \
   LOG_INSANE("REPEAT_CHKCOUNT_LVAL %s." #name " x %ld: %lld > %lld?\n", \
     obj->dxfname, (long)times, (long long)((times)*sizeof(type)), AVAIL_BITS()); \
-  if (dat->version >= R_2004 && (long long)((times)*sizeof(type)) > AVAIL_BITS()) { \
+  if (DEC_SINCE(R_2004) && (long long)((times)*sizeof(type)) > AVAIL_BITS()) { \
     LOG_ERROR("Invalid %s." #name " x %ld\n", obj->dxfname, (long)times); \
     times = 0; \
     return DWG_ERR_VALUEOUTOFBOUNDS; }
@@ -684,6 +781,47 @@
     error |= dwg_decode_common_entity_handle_data(dat, hdl_dat, obj); \
   }
 
+/* Dispatch to the body of the object decoder, specialised for each
+   version family: preR13, R13-R2000, R2004, R2007 and R2010+.
+   The body is inlined into each branch with constant version bounds,
+   so that the version checks inside the spec fold away.
+   This doubles the size of the decoder, so it is only enabled with
+   configure --enable-version-families.  */
+#ifdef ENABLE_VERSION_FAMILIES
+#define DECODE_VERSION_FAMILIES(token) \
+static ALWAYS_INLINE int \
+dwg_decode_##token##_fam (Bit_Chain *dat, Bit_Chain *str_dat, \
+                          Dwg_Object *restrict obj, \
+                          const Dwg_Version_Type _vmin, \
+                          const Dwg_Version_Type _vmax); \
+static int dwg_decode_##token##_private (Bit_Chain *dat, Bit_Chain *str_dat, \
+                                         Dwg_Object *restrict obj) \
+{ \
+  if (dat->version >= R_2010) \
+    return dwg_decode_##token##_fam (dat, str_dat, obj, R_2010, R_AFTER); \
+  else if (dat->version == R_2007) \
+    return dwg_decode_##token##_fam (dat, str_dat, obj, R_2007, R_2007); \
+  else if (dat->version == R_2004) \
+    return dwg_decode_##token##_fam (dat, str_dat, obj, R_2004, R_2004); \
+  else if (dat->version >= R_13) \
+    return dwg_decode_##token##_fam (dat, str_dat, obj, R_13, R_2000); \
+  else \
+    return dwg_decode_##token##_fam (dat, str_dat, obj, R_INVALID, R_11); \
+}
+#else
+#define DECODE_VERSION_FAMILIES(token) \
+static ALWAYS_INLINE int \
+dwg_decode_##token##_fam (Bit_Chain *dat, Bit_Chain *str_dat, \
+                          Dwg_Object *restrict obj, \
+                          const Dwg_Version_Type _vmin, \
+                          const Dwg_Version_Type _vmax); \
+static int dwg_decode_##token##_private (Bit_Chain *dat, Bit_Chain *str_dat, \
+                                         Dwg_Object *restrict obj) \
+{ \
+  return dwg_decode_##token##_fam (dat, str_dat, obj, R_INVALID, R_AFTER); \
+}
+#endif
+
 /** Add the empty entity or object with its three structs to the DWG.
     All fields are zero'd. TODO: some are initialized with default values, as
     defined in dwg.spec.
@@ -728,14 +866,20 @@ static int dwg_decode_##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj
     str_dat = dat; \
   } \
   error = dwg_decode_##token##_private (dat, str_dat, obj); \
+  PROFILE_TYPE(NULL) \
   if (dat->version >= R_2007) { \
     free(str_dat); \
   } \
   return error; \
 } \
 \
-static int dwg_decode_##token##_private (Bit_Chain *dat, Bit_Chain *str_dat, \
-                                         Dwg_Object *restrict obj) \
+DECODE_VERSION_FAMILIES(token) \
+\
+static ALWAYS_INLINE int \
+dwg_decode_##token##_fam (Bit_Chain *dat, Bit_Chain *str_dat, \
+                          Dwg_Object *restrict obj, \
+                          const Dwg_Version_Type _vmin, \
+                          const Dwg_Version_Type _vmax) \
 { \
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4; \
   int error; \
@@ -744,13 +888,14 @@ static int dwg_decode_##token##_private (Bit_Chain *dat, Bit_Chain *str_dat, \
   Dwg_Data* dwg = obj->parent; \
   Bit_Chain* hdl_dat = dat; \
   LOG_INFO("Decode entity " #token " ")\
+  PROFILE_TYPE(#token) \
   _ent = obj->tio.entity; \
   ent = obj->tio.entity->tio.token;\
   _obj = ent;\
   _ent->dwg = dwg; \
   _ent->objid = obj->index; /* obj ptr itself might move */ \
   _obj->parent = obj->tio.entity;\
-  if (dat->version >= R_13) { \
+  if (DEC_SINCE(R_13)) { \
     error = dwg_decode_entity(dat, hdl_dat, str_dat, _ent); \
   } else { \
     error = decode_entity_preR13(dat, obj, _ent); \
@@ -760,7 +905,7 @@ static int dwg_decode_##token##_private (Bit_Chain *dat, Bit_Chain *str_dat, \
 
 // Does size include the CRC?
 #define DWG_ENTITY_END \
-  if (dat->version >= R_2007) { \
+  if (DEC_SINCE(R_2007)) { \
     vcount  = (obj->size+obj->address)*8 - bit_position(hdl_dat); \
   } else { \
     vcount  = (obj->size+obj->address)*8 - bit_position(dat); \
@@ -804,14 +949,20 @@ static int dwg_decode_##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj
     str_dat = dat; \
   } \
   error = dwg_decode_##token##_private (dat, str_dat, obj); \
+  PROFILE_TYPE(NULL) \
   if (dat->version >= R_2007) { \
     free(str_dat); \
   } \
   return error; \
 } \
 \
-static int dwg_decode_##token##_private (Bit_Chain *dat, Bit_Chain *str_dat, \
-                                         Dwg_Object *restrict obj) \
+DECODE_VERSION_FAMILIES(token) \
+\
+static ALWAYS_INLINE int \
+dwg_decode_##token##_fam (Bit_Chain *dat, Bit_Chain *str_dat, \
+                          Dwg_Object *restrict obj, \
+                          const Dwg_Version_Type _vmin, \
+                          const Dwg_Version_Type _vmax) \
 { \
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4; \
   int error; \
@@ -819,6 +970,7 @@ static int dwg_decode_##token##_private (Bit_Chain *dat, Bit_Chain *str_dat, \
   Dwg_Data* dwg = obj->parent;\
   Bit_Chain* hdl_dat = dat; /* handle stream initially the same */ \
   LOG_INFO("Decode object " #token " ")\
+  PROFILE_TYPE(#token) \
   _obj = obj->tio.object->tio.token;\
   error = dwg_decode_object(dat, hdl_dat, str_dat, obj->tio.object); \
   if (error >= DWG_ERR_CRITICAL) return error;
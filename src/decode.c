@@ -37,6 +37,8 @@
 #include "decode.h"
 #include "print.h"
 #include "free.h"
+#include "stats.h"
+#include "type_index.h"
 
 /* The logging level for the read (decode) path.  */
 static unsigned int loglevel;
@@ -54,6 +56,8 @@ static bool env_var_checked_p;
 #include "dec_macros.h"
 
 #define REFS_PER_REALLOC 128
+/* refs resolved per parallel chunk */
+#define REFS_PER_CHUNK 65536
 
 #define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
 #define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
@@ -115,8 +119,25 @@ dwg_decode_entity(Bit_Chain* dat, Bit_Chain* hdl_dat, Bit_Chain* str_dat,
  * everything in dwg is cleared
  * and then either read from dat, or set to a default.
  */
+static int
+decode_dwg(Bit_Chain *restrict dat, Dwg_Data *restrict dwg);
+
 int
 dwg_decode(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+{
+  int error;
+
+  /* dwg_read_file already started with the READ phase */
+  if (dwg->stats.phase != DWG_PHASE_READ)
+    dwg_stats_init(dwg);
+  dwg_stats_phase(dwg, DWG_PHASE_HEADER);
+  error = decode_dwg(dat, dwg);
+  dwg_stats_done(dwg, error);
+  return error;
+}
+
+static int
+decode_dwg(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 {
   int i;
   char version[7];
@@ -286,7 +307,10 @@ decode_preR13_section(Dwg_Section_Type_r11 id, Bit_Chain *restrict dat, Dwg_Data
             (long)(tbl->address + tbl->number * tbl->size))
   dat->byte = tbl->address;
   if (dwg->num_objects % REFS_PER_REALLOC == 0)
-    dwg->object = realloc(dwg->object, old_size + size + REFS_PER_REALLOC);
+    {
+      dwg->object = realloc(dwg->object, old_size + size + REFS_PER_REALLOC);
+      dwg->refs_generation++;
+    }
 
   // TODO: move to a spec dwg_r11.spec, and dwg_decode_r11_NAME
 #define PREP_TABLE(name)\
@@ -911,6 +935,7 @@ decode_R13_R2000(Bit_Chain* dat, Dwg_Data * dwg)
   /*-------------------------------------------------------------------------
    * Classes, section 1
    */
+  dwg_stats_phase(dwg, DWG_PHASE_CLASSES);
   LOG_INFO("\n"
            "=======> CLASS 1 (start): %8lX\n",
            (long)dwg->header.section[SECTION_CLASSES_R13].address)
@@ -1016,6 +1041,7 @@ decode_R13_R2000(Bit_Chain* dat, Dwg_Data * dwg)
    * Object-map, section 2
    */
 
+  dwg_stats_phase(dwg, DWG_PHASE_OBJECTMAP);
   dat->byte = dwg->header.section[SECTION_OBJECTS_R13].address;
   dat->bit = 0;
 
@@ -1103,6 +1129,7 @@ decode_R13_R2000(Bit_Chain* dat, Dwg_Data * dwg)
     }
   while (section_size > 2);
 
+  dwg_stats_phase(dwg, DWG_PHASE_HEADER);
   LOG_INFO("Num objects: %lu\n", (unsigned long)dwg->num_objects)
   LOG_INFO("\n"
            "=======> Object Data 2 (start)  : %8lX\n",
@@ -1268,11 +1295,67 @@ decode_R13_R2000(Bit_Chain* dat, Dwg_Data * dwg)
   return error;
 }
 
+/* Resolves the refs [from, to) without logging. The refs of one object
+   often repeat a handle (owner and reactors, layers), so a run of equal
+   handles needs only one lookup. Returns the number of unresolved
+   non-null refs. */
+static BITCODE_BL
+resolve_objectref_chunk(Dwg_Data *restrict dwg, const BITCODE_BL from,
+                        const BITCODE_BL to)
+{
+  Dwg_Object_Ref **restrict refs = dwg->object_ref;
+  const BITCODE_BL generation = dwg->refs_generation;
+  unsigned long last_ref = 0;
+  Dwg_Object *last_obj = NULL;
+  BITCODE_BL i, unresolved = 0;
+
+  for (i = from; i < to; i++)
+    {
+      Dwg_Object_Ref *ref = refs[i];
+      if (ref->absolute_ref != last_ref)
+        {
+          last_ref = ref->absolute_ref;
+          last_obj = dwg_resolve_handle(dwg, last_ref);
+        }
+      ref->obj = last_obj;
+      ref->generation = generation;
+      if (!last_obj && last_ref)
+        unresolved++;
+    }
+  return unresolved;
+}
+
 static int
 resolve_objectref_vector(Bit_Chain* dat, Dwg_Data * dwg)
 {
   BITCODE_BL i;
   Dwg_Object * obj;
+  BITCODE_BL unresolved = 0;
+
+  dwg_stats_phase(dwg, DWG_PHASE_REFS);
+  if (DWG_LOGLEVEL < DWG_LOGLEVEL_TRACE)
+    {
+      /* Fixed chunks, so that the count does not depend on the threads.
+         The hash is only read, and dwg_resolve_handle only logs warnings
+         below the trace level. */
+      const long num_chunks
+          = (long)((dwg->num_object_refs + REFS_PER_CHUNK - 1)
+                   / REFS_PER_CHUNK);
+      long c;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:unresolved) \
+    if (num_chunks > 1)
+#endif
+      for (c = 0; c < num_chunks; c++)
+        {
+          BITCODE_BL from = (BITCODE_BL)c * REFS_PER_CHUNK;
+          BITCODE_BL to = from + REFS_PER_CHUNK;
+          if (to > dwg->num_object_refs)
+            to = dwg->num_object_refs;
+          unresolved += resolve_objectref_chunk(dwg, from, to);
+        }
+      goto done;
+    }
 
   for (i = 0; i < dwg->num_object_refs; i++)
     {
@@ -1291,8 +1374,11 @@ resolve_objectref_vector(Bit_Chain* dat, Dwg_Data * dwg)
                     obj->handle.code, obj->handle.size,
                     obj->handle.value, obj->index)
         }
+      else if (ref->absolute_ref)
+        unresolved++;
       //assign found pointer to objectref vector
       ref->obj = obj;
+      ref->generation = dwg->refs_generation;
 
       if (DWG_LOGLEVEL >= DWG_LOGLEVEL_INSANE)
         {
@@ -1302,6 +1388,13 @@ resolve_objectref_vector(Bit_Chain* dat, Dwg_Data * dwg)
             LOG_TRACE("Null object pointer: object_ref[%ld]\n", (long)i)
         }
     }
+ done:
+  dwg->stats.unresolved_refs = unresolved;
+  // the block owners are resolved now, group the objects by type
+  if (dwg_type_index_build(dwg))
+    LOG_ERROR("Out of memory for the type index")
+  if (dwg_fill_utf8names(dwg))
+    LOG_ERROR("Out of memory for the UTF-8 names")
   return dwg->num_object_refs ? 0 : DWG_ERR_VALUEOUTOFBOUNDS;
 }
 
@@ -1313,13 +1406,14 @@ dwg_resolve_objectrefs_silent(Dwg_Data *restrict dwg)
   int oldloglevel = loglevel;
 
   loglevel = 0;
-  // Dwg_Object_Ref->obj are stored all over. dirty it to update dynamically.
-  dwg->dirty_refs = 1; // TODO: this is now forever. find a way to resolve all objs also.
+  // Dwg_Object_Ref->obj are stored all over. Those not in object_ref
+  // keep an older generation, and are updated dynamically in dwg_ref_object.
   for (i = 0; i < dwg->num_object_refs; i++)
     {
       //scan num_objects for the id (absolute_ref)
       obj = dwg_resolve_handle(dwg, dwg->object_ref[i]->absolute_ref);
       dwg->object_ref[i]->obj = obj;
+      dwg->object_ref[i]->generation = dwg->refs_generation;
     }
   //TODO: scan dwg->num_objects also to update it's handlerefs
   loglevel = oldloglevel;
@@ -1905,7 +1999,9 @@ read_2004_section_classes(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   int error;
   Bit_Chain sec_dat = {0}, str_dat = {0};
 
+  dwg_stats_phase(dwg, DWG_PHASE_SECTIONS);
   error = read_2004_compressed_section(dat, dwg, &sec_dat, SECTION_CLASSES);
+  dwg_stats_phase(dwg, DWG_PHASE_CLASSES);
   if (error)
     {
       LOG_ERROR("Failed to read compressed class section");
@@ -2034,7 +2130,9 @@ read_2004_section_header(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   int error;
   Bit_Chain sec_dat = { 0 };
 
+  dwg_stats_phase(dwg, DWG_PHASE_SECTIONS);
   error = read_2004_compressed_section(dat, dwg, &sec_dat, SECTION_HEADER);
+  dwg_stats_phase(dwg, DWG_PHASE_HEADER);
   if (error)
     return error;
 
@@ -2078,6 +2176,7 @@ read_2004_section_handles(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   long unsigned int endpos;
   int error;
 
+  dwg_stats_phase(dwg, DWG_PHASE_SECTIONS);
   error = read_2004_compressed_section(dat, dwg, &obj_dat, SECTION_OBJECTS);
   if (error)
     return error;
@@ -2088,6 +2187,7 @@ read_2004_section_handles(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       free(obj_dat.chain);
       return error;
     }
+  dwg_stats_phase(dwg, DWG_PHASE_OBJECTMAP);
 
   endpos = hdl_dat.byte + hdl_dat.size;
   dwg->num_objects = 0;
@@ -2244,6 +2344,7 @@ decode_R2004(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 
   }
 
+  dwg_stats_phase(dwg, DWG_PHASE_SECTIONS);
   error |= decode_R2004_header(dat, dwg);
   if (error > DWG_ERR_CRITICAL)
     return error;
@@ -2841,7 +2942,7 @@ dwg_decode_object(Bit_Chain* dat, Bit_Chain* hdl_dat, Bit_Chain* str_dat,
   return error;
 }
 
-static int
+int
 dwg_decode_add_object_ref(Dwg_Data *restrict dwg, Dwg_Object_Ref *ref)
 {
   Dwg_Object_Ref **object_ref_old = dwg->object_ref;
@@ -3058,11 +3159,11 @@ dwg_decode_handleref_with_code(Bit_Chain *restrict dat,
   return ref;
 }
 
-int
-dwg_decode_header_variables(Bit_Chain* dat,
-                            Bit_Chain* hdl_dat,
-                            Bit_Chain* str_dat,
-                            Dwg_Data *restrict dwg)
+static int
+decode_header_variables(Bit_Chain* dat,
+                        Bit_Chain* hdl_dat,
+                        Bit_Chain* str_dat,
+                        Dwg_Data *restrict dwg)
 {
   Dwg_Header_Variables* _obj = &dwg->header_vars;
   Dwg_Object* obj = NULL;
@@ -3073,6 +3174,20 @@ dwg_decode_header_variables(Bit_Chain* dat,
   return error;
 }
 
+int
+dwg_decode_header_variables(Bit_Chain* dat,
+                            Bit_Chain* hdl_dat,
+                            Bit_Chain* str_dat,
+                            Dwg_Data *restrict dwg)
+{
+  int error;
+  // the spec returns early on errors, so the type is reset out here
+  PROFILE_TYPE("HEADER")
+  error = decode_header_variables(dat, hdl_dat, str_dat, dwg);
+  PROFILE_TYPE(NULL)
+  return error;
+}
+
 static int
 dwg_decode_common_entity_handle_data(Bit_Chain* dat, Bit_Chain* hdl_dat,
                                      Dwg_Object *restrict obj)
@@ -3315,8 +3430,20 @@ dwg_decode_xdata(Bit_Chain *restrict dat, Dwg_Object_XRECORD *restrict obj, int
 
 /* OBJECTS *******************************************************************/
 
+/* Within the object decoders the version bounds are the constant
+   arguments of each specialised version family. */
+#undef DWG_VMIN
+#undef DWG_VMAX
+#define DWG_VMIN _vmin
+#define DWG_VMAX _vmax
+
 #include "dwg.spec"
 
+#undef DWG_VMIN
+#undef DWG_VMAX
+#define DWG_VMIN R_INVALID
+#define DWG_VMAX R_AFTER
+
 /*--------------------------------------------------------------------------------
  * Private functions which depend on the preceding
  */
@@ -3339,8 +3466,11 @@ decode_preR13_entities(unsigned long start, unsigned long end,
       if (!num)
         dwg->object = (Dwg_Object *) malloc(REFS_PER_REALLOC * sizeof(Dwg_Object));
       else if (num % REFS_PER_REALLOC == 0)
-        dwg->object = realloc(dwg->object,
-            (num + REFS_PER_REALLOC) * sizeof(Dwg_Object));
+        {
+          dwg->object = realloc(dwg->object,
+              (num + REFS_PER_REALLOC) * sizeof(Dwg_Object));
+          dwg->refs_generation++;
+        }
       if (!dwg->object)
         {
           LOG_ERROR("Out of memory");
@@ -3491,6 +3621,8 @@ EXPORT int dwg_add_object (Dwg_Data *dwg)
     Dwg_Object *old = dwg->object;
     dwg->object = realloc(dwg->object, (num + REFS_PER_REALLOC) * sizeof(Dwg_Object));
     realloced = old != dwg->object;
+    if (realloced)
+      dwg->refs_generation++;
   }
   if (!dwg->object) return DWG_ERR_OUTOFMEM;
 
@@ -3518,6 +3650,7 @@ dwg_decode_add_object(Dwg_Data *restrict dwg, Bit_Chain* dat, Bit_Chain* hdl_dat
   BITCODE_BL num = dwg->num_objects;
   int error = 0;
   int realloced = 0;
+  Dwg_Stats_Phase phase;
 
   /* Keep the previous address
    */
@@ -3541,6 +3674,7 @@ dwg_decode_add_object(Dwg_Data *restrict dwg, Bit_Chain* dat, Bit_Chain* hdl_dat
       return realloced; // i.e. DWG_ERR_OUTOFMEM
     }
   obj = &dwg->object[num];
+  phase = dwg_stats_wall_phase(dwg, DWG_PHASE_OBJECTS);
   LOG_INFO("==========================================\n"
            "Object number: %lu/%lX", (unsigned long)num, (unsigned long)num)
 
@@ -3866,6 +4000,8 @@ dwg_decode_add_object(Dwg_Data *restrict dwg, Bit_Chain* dat, Bit_Chain* hdl_dat
             obj->type = 0;
             dat->byte = oldpos;
             dat->bit  = previous_bit;
+            dwg_stats_object(dwg, obj, error | DWG_ERR_VALUEOUTOFBOUNDS);
+            dwg_stats_wall_phase(dwg, phase);
             return error | DWG_ERR_VALUEOUTOFBOUNDS;
           }
           // properly dwg_decode_object/_entity for eed, reactors, xdic
@@ -3911,7 +4047,9 @@ dwg_decode_add_object(Dwg_Data *restrict dwg, Bit_Chain* dat, Bit_Chain* hdl_dat
 
   if (obj->handle.value) { // empty only with UNKNOWN
     LOG_HANDLE("object_map{%lX} = %lu\n", obj->handle.value, (unsigned long)num);
-    hash_set(dwg->object_map, obj->handle.value, (uint32_t)num);
+    // a new handle invalidates no cached ref->obj, a remapped one does
+    if (hash_set(dwg->object_map, obj->handle.value, (uint32_t)num))
+      dwg->refs_generation++;
   }
 
   /* Now 1 padding bits until next byte, and then a RS CRC */
@@ -3945,6 +4083,8 @@ dwg_decode_add_object(Dwg_Data *restrict dwg, Bit_Chain* dat, Bit_Chain* hdl_dat
    */
   dat->byte = oldpos;
   dat->bit = previous_bit;
+  dwg_stats_object(dwg, obj, error);
+  dwg_stats_wall_phase(dwg, phase);
   return realloced ? -1 : error; //re-alloced or not
 }
 
@@ -64,6 +64,10 @@ int
 dwg_decode_add_object(Dwg_Data* dwg, Bit_Chain* dat, Bit_Chain* hdl_dat,
                       long unsigned int address);
 
+/* reused with in_dxf */
+int
+dwg_decode_add_object_ref(Dwg_Data *restrict dwg, Dwg_Object_Ref *ref);
+
 /* reused with free */
 void
 dwg_free_xdata_resbuf(Dwg_Resbuf *rbuf);
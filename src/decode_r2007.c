@@ -25,6 +25,7 @@
 #include "bits.h"
 #include "dec_macros.h"
 #include "decode.h"
+#include "stats.h"
 
 /* The logging level for the read (decode) path.  */
 static unsigned int loglevel;
@@ -1224,8 +1225,10 @@ read_2007_section_classes(Bit_Chain*restrict dat, Dwg_Data *restrict dwg,
   int error;
   char c;
 
+  dwg_stats_phase(dwg, DWG_PHASE_SECTIONS);
   error = read_data_section(&sec_dat, dat, sections_map,
                             pages_map, SECTION_CLASSES);
+  dwg_stats_phase(dwg, DWG_PHASE_CLASSES);
   if (error)
     {
       LOG_ERROR("Failed to read class section");
@@ -1342,8 +1345,10 @@ read_2007_section_header(Bit_Chain*restrict dat, Bit_Chain*restrict hdl_dat,
   Bit_Chain sec_dat = { 0 }, str_dat = { 0 };
   int error;
   LOG_TRACE("\nSection Header\n-------------------\n");
+  dwg_stats_phase(dwg, DWG_PHASE_SECTIONS);
   error = read_data_section(&sec_dat, dat, sections_map,
                             pages_map, SECTION_HEADER);
+  dwg_stats_phase(dwg, DWG_PHASE_HEADER);
   if (error)
     {
       LOG_ERROR("Failed to read header section");
@@ -1399,6 +1404,7 @@ read_2007_section_handles(Bit_Chain* dat, Bit_Chain* hdl,
   long unsigned int endpos;
   int error;
 
+  dwg_stats_phase(dwg, DWG_PHASE_SECTIONS);
   error = read_data_section(&obj_dat, dat, sections_map,
                             pages_map, SECTION_OBJECTS);
   if (error >= DWG_ERR_CRITICAL)
@@ -1412,6 +1418,7 @@ read_2007_section_handles(Bit_Chain* dat, Bit_Chain* hdl,
   LOG_TRACE("\nHandles\n-------------------\n")
   error = read_data_section(&hdl_dat, dat, sections_map,
                             pages_map, SECTION_HANDLES);
+  dwg_stats_phase(dwg, DWG_PHASE_OBJECTMAP);
   if (error >= DWG_ERR_CRITICAL)
     {
       LOG_ERROR("Failed to read handles section");
@@ -1512,6 +1519,7 @@ read_r2007_meta_data(Bit_Chain *dat, Bit_Chain *hdl_dat,
     loglevel = atoi (probe);
 #endif
   // @ 0x62
+  dwg_stats_phase(dwg, DWG_PHASE_SECTIONS);
   error = read_file_header(dat, &file_header);
   if (error >= DWG_ERR_VALUEOUTOFBOUNDS)
     return error;
@@ -34,7 +34,11 @@
 #include "hash.h"
 #include "encode.h"
 #include "in_dxf.h"
+#include "out_dxf.h"
+#include "out_json.h"
 #include "free.h"
+#include "stats.h"
+#include "type_index.h"
 
 /* The logging level per .o */
 static unsigned int loglevel;
@@ -120,7 +124,8 @@ static int dat_read_stream (Bit_Chain *restrict dat, FILE *restrict fp)
 /** dwg_read_file
  * returns 0 on success.
  *
- * everything in dwg is cleared
+ * everything in dwg is cleared, except the options opts, num_threads
+ * and geojson_precision set by the caller for the later writers,
  * and then either read from dat, or set to a default.
  */
 int
@@ -131,10 +136,17 @@ dwg_read_file(const char *restrict filename, Dwg_Data *restrict dwg)
   size_t size;
   Bit_Chain bit_chain = { 0 };
   int error;
+  // the options of the writers
+  const unsigned int num_threads = dwg->num_threads;
+  const unsigned int geojson_precision = dwg->geojson_precision;
 
   loglevel = dwg->opts;
   memset(dwg, 0, sizeof(Dwg_Data));
   dwg->opts = loglevel;
+  dwg->num_threads = num_threads;
+  dwg->geojson_precision = geojson_precision;
+  dwg_stats_init(dwg);
+  dwg_stats_phase(dwg, DWG_PHASE_READ);
 
   if (!strcmp(filename, "-"))
     {
@@ -208,7 +220,7 @@ dwg_read_file(const char *restrict filename, Dwg_Data *restrict dwg)
  * returns 0 on success.
  *
  * detects binary or ascii file.
- * everything in dwg is cleared
+ * everything in dwg is cleared, except opts and num_threads,
  * and then either read from dat, or set to a default.
  */
 int
@@ -219,6 +231,8 @@ dxf_read_file(const char *restrict filename, Dwg_Data *restrict dwg)
   struct stat attrib;
   size_t size;
   Bit_Chain dat = { 0 };
+  // the threads of the ENTITIES and OBJECTS parser
+  const unsigned int num_threads = dwg->num_threads;
 
   if (stat(filename, &attrib))
     {
@@ -246,6 +260,7 @@ dxf_read_file(const char *restrict filename, Dwg_Data *restrict dwg)
   loglevel = dwg->opts;
   memset(dwg, 0, sizeof(Dwg_Data));
   dwg->opts = loglevel;
+  dwg->num_threads = num_threads;
   memset(&dat, 0, sizeof(Bit_Chain));
   dat.size = attrib.st_size;
   dat.chain = (unsigned char *) calloc(1, dat.size);
@@ -305,68 +320,190 @@ dxf_read_file(const char *restrict filename, Dwg_Data *restrict dwg)
   return 0;
 }
 
+/** dwg_write_data
+ * returns 0 on success.
+ *
+ * *data is NULL on a critical error, else a new buffer of the
+ * encoded DWG, of *size bytes, which the caller frees.
+ */
 int
-dwg_write_file(const char *restrict filename, const Dwg_Data *restrict dwg)
+dwg_write_data(const Dwg_Data *restrict dwg, unsigned char **restrict data,
+               size_t *restrict size)
 {
-  FILE *fh;
-  struct stat attrib;
   Bit_Chain dat = { 0 };
   int error;
 
-  assert(filename);
   assert(dwg);
+  *data = NULL;
+  *size = 0;
   dat.version = (Dwg_Version_Type)dwg->header.version;
   dat.from_version = (Dwg_Version_Type)dwg->header.from_version;
 
   // Encode the DWG struct
-  dat.size = 0;
   error = dwg_encode ((Dwg_Data *)dwg, &dat);
   if (error >= DWG_ERR_CRITICAL)
     {
       LOG_ERROR("Failed to encode datastructure.\n")
-      if (dat.size > 0) {
-        free (dat.chain);
-        dat.chain = NULL;
-        dat.size = 0;
-      }
+      free (dat.chain);
       return error;
     }
+  *data = dat.chain;
+  *size = dat.size;
+  return error;
+}
+
+/* The DWG is encoded in memory, and passed at once */
+int
+dwg_write_sink(const Dwg_Data *restrict dwg, Dwg_Write_Sink sink, void *user)
+{
+  unsigned char *data;
+  size_t size;
+  int error = dwg_write_data(dwg, &data, &size);
+
+  if (error >= DWG_ERR_CRITICAL)
+    return error;
+  if (size && sink(user, data, size))
+    error |= DWG_ERR_IOERROR;
+  free(data);
+  return error;
+}
+
+int
+dwg_write_file(const char *restrict filename, const Dwg_Data *restrict dwg)
+{
+  FILE *fh;
+  struct stat attrib;
+  unsigned char *data;
+  size_t size;
+  int error;
+
+  assert(filename);
+  assert(dwg);
+  error = dwg_write_data(dwg, &data, &size);
+  if (error >= DWG_ERR_CRITICAL)
+    return error;
 
   // try opening the output file in write mode
   if (!stat (filename, &attrib))
     {
       LOG_ERROR("The file already exists. We won't overwrite it.")
+      free (data);
       return error | DWG_ERR_IOERROR;
     }
   fh = fopen (filename, "wb");
   if (!fh)
     {
       LOG_ERROR("Failed to create the file: %s\n", filename)
+      free (data);
       return error | DWG_ERR_IOERROR;
     }
 
   // Write the data into the file
-  if (fwrite (dat.chain, sizeof (char), dat.size, fh) != dat.size)
+  if (fwrite (data, sizeof (char), size, fh) != size)
     {
       LOG_ERROR("Failed to write data into the file: %s\n", filename)
       fclose (fh);
-      free (dat.chain);
-      dat.chain = NULL;
-      dat.size = 0;
+      free (data);
       return error | DWG_ERR_IOERROR;
     }
   fclose (fh);
-
-  if (dat.size > 0) {
-    free (dat.chain);
-    dat.chain = NULL;
-    dat.size = 0;
-  }
+  free (data);
 
   return error;
 }
 #endif /* USE_WRITE */
 
+#ifndef DISABLE_DXF
+
+/* The sink of the *_write_sink functions, passing no more output after
+   the first failure */
+typedef struct _write_sink
+{
+  Dwg_Write_Sink sink;
+  void *user;
+  int error;
+} Write_Sink;
+
+static int
+write_sink_block(void *user, const unsigned char *data, size_t size)
+{
+  Write_Sink *ws = (Write_Sink *)user;
+  if (!ws->error && size && ws->sink(ws->user, data, size))
+    ws->error = DWG_ERR_IOERROR;
+  return ws->error;
+}
+
+typedef int (*Dwg_Writer)(Bit_Chain *restrict dat,
+                          const Dwg_Data *restrict dwg);
+
+/* Without fh nor sink the writer returns its output in dat.chain */
+static int
+write_data(Dwg_Writer writer, const Dwg_Data *restrict dwg,
+           unsigned char **restrict data, size_t *restrict size)
+{
+  Bit_Chain dat = { 0 };
+  int error;
+
+  assert(dwg);
+  dat.version = dat.from_version = dwg->header.version;
+  error = writer(&dat, dwg);
+  *data = dat.chain;
+  *size = dat.chain ? dat.size : 0;
+  return error;
+}
+
+static int
+write_sink(Dwg_Writer writer, const Dwg_Data *restrict dwg,
+           Dwg_Write_Sink sink, void *user)
+{
+  Bit_Chain dat = { 0 };
+  Write_Sink ws;
+
+  assert(dwg);
+  assert(sink);
+  ws.sink = sink;
+  ws.user = user;
+  ws.error = 0;
+  dat.version = dat.from_version = dwg->header.version;
+  dat.sink = write_sink_block;
+  dat.sink_user = &ws;
+  return writer(&dat, dwg) | ws.error;
+}
+
+/** dxf_write_data, json_write_data
+ * returns 0 on success.
+ *
+ * *data is the new output of *size bytes, which the caller frees,
+ * or NULL when out of memory.
+ */
+int
+dxf_write_data(const Dwg_Data *restrict dwg, unsigned char **restrict data,
+               size_t *restrict size)
+{
+  return write_data(dwg_write_dxf, dwg, data, size);
+}
+
+int
+json_write_data(const Dwg_Data *restrict dwg, unsigned char **restrict data,
+                size_t *restrict size)
+{
+  return write_data(dwg_write_json, dwg, data, size);
+}
+
+int
+dxf_write_sink(const Dwg_Data *restrict dwg, Dwg_Write_Sink sink, void *user)
+{
+  return write_sink(dwg_write_dxf, dwg, sink, user);
+}
+
+int
+json_write_sink(const Dwg_Data *restrict dwg, Dwg_Write_Sink sink, void *user)
+{
+  return write_sink(dwg_write_json, dwg, sink, user);
+}
+
+#endif /* DISABLE_DXF */
+
 /* THUMBNAIL IMAGE DATA (R13C3+) */
 unsigned char *
 dwg_bmp(const Dwg_Data *restrict dwg, BITCODE_RL *restrict size)
@@ -604,13 +741,14 @@ dwg_ref_object(const Dwg_Data *restrict dwg, Dwg_Object_Ref *restrict ref)
 {
   if (!ref)
     return NULL;
-  if (ref->obj && !dwg->dirty_refs)
+  if (ref->obj && ref->generation == dwg->refs_generation)
     return ref->obj;
   // Without obj we don't get an absolute_ref from relative OFFSETOBJHANDLE handle types.
   if (ref->handleref.code < 6 &&
       dwg_resolve_handleref((Dwg_Object_Ref*)ref, NULL))
     {
       ref->obj = dwg_resolve_handle(dwg, ref->absolute_ref);
+      ref->generation = dwg->refs_generation;
       return ref->obj;
     }
   else
@@ -626,11 +764,12 @@ dwg_ref_object_relative(const Dwg_Data *restrict dwg,
                             Dwg_Object_Ref *restrict ref,
                             const Dwg_Object *restrict obj)
 {
-  if (ref->obj && !dwg->dirty_refs)
+  if (ref->obj && ref->generation == dwg->refs_generation)
     return ref->obj;
   if (dwg_resolve_handleref((Dwg_Object_Ref*)ref, obj))
     {
       ref->obj = dwg_resolve_handle(dwg, ref->absolute_ref);
+      ref->generation = dwg->refs_generation;
       return ref->obj;
     }
   else
@@ -660,9 +799,12 @@ dwg_resolve_handle(const Dwg_Data * dwg, const BITCODE_BL absref)
   return &dwg->object[i]; // allow value 0
 }
 
-/* set ref->absolute_ref from obj, for a subsequent dwg_resolve_handle() */
-int
-dwg_resolve_handleref(Dwg_Object_Ref *restrict ref, const Dwg_Object *restrict obj)
+/* The absolute handle of ref, relative to obj for OFFSETOBJHANDLE codes.
+   Returns 0 on an invalid code. */
+static int
+handleref_absolute(const Dwg_Object_Ref *restrict ref,
+                   const Dwg_Object *restrict obj,
+                   unsigned long *restrict absref)
 {
   /*
    * With TYPEDOBJHANDLE 2-5 the code indicates the type of ownership:
@@ -675,31 +817,58 @@ dwg_resolve_handleref(Dwg_Object_Ref *restrict ref, const Dwg_Object *restrict o
  switch (ref->handleref.code)
     {
     case 0x06:
-      ref->absolute_ref = (obj->handle.value + 1);
+      *absref = (obj->handle.value + 1);
       break;
     case 0x08:
-      ref->absolute_ref = (obj->handle.value - 1);
+      *absref = (obj->handle.value - 1);
       break;
     case 0x0A:
-      ref->absolute_ref = (obj->handle.value + ref->handleref.value);
+      *absref = (obj->handle.value + ref->handleref.value);
       break;
     case 0x0C:
-      ref->absolute_ref = (obj->handle.value - ref->handleref.value);
+      *absref = (obj->handle.value - ref->handleref.value);
       break;
     case 2: case 3: case 4: case 5:
-      ref->absolute_ref = ref->handleref.value;
+      *absref = ref->handleref.value;
       break;
     case 0: // ignore?
-      ref->absolute_ref = ref->handleref.value;
+      *absref = ref->handleref.value;
       break;
     default:
-      ref->absolute_ref = ref->handleref.value;
+      *absref = ref->handleref.value;
       LOG_WARN("Invalid handle pointer code %d", ref->handleref.code);
       return 0;
     }
   return 1;
 }
 
+/* set ref->absolute_ref from obj, for a subsequent dwg_resolve_handle() */
+int
+dwg_resolve_handleref(Dwg_Object_Ref *restrict ref, const Dwg_Object *restrict obj)
+{
+  return handleref_absolute(ref, obj, &ref->absolute_ref);
+}
+
+/**
+ * Find an object given its handle, as dwg_ref_object(), but never store
+ * into the ref. For the output passes, which may run concurrently on one
+ * DWG, also over unresolved or null refs.
+ */
+Dwg_Object*
+dwg_ref_object_const(const Dwg_Data *restrict dwg,
+                     const Dwg_Object_Ref *restrict ref)
+{
+  unsigned long absref;
+  if (!ref)
+    return NULL;
+  if (ref->obj && ref->generation == dwg->refs_generation)
+    return ref->obj;
+  if (ref->handleref.code < 6 && handleref_absolute(ref, NULL, &absref))
+    return dwg_resolve_handle(dwg, (BITCODE_BL)absref);
+  else
+    return NULL;
+}
+
 /** Returns the block_control for the DWG,
     containing the list of all blocks headers.
 */
@@ -732,6 +901,8 @@ dwg_paper_space_ref(Dwg_Data *dwg)
     ? dwg->block_control.paper_space : NULL;
 }
 
+/* Not reentrant for r2004+, the position is kept in the BLOCK_HEADER.
+   See dwg_block_iter_init() */
 Dwg_Object*
 get_first_owned_object(const Dwg_Object *hdr)
 {
@@ -793,6 +964,47 @@ get_next_owned_object(const Dwg_Object *restrict hdr,
   return NULL;
 }
 
+/** Initializes a reentrant iterator over the entities owned by the block
+    header, in object order, for all versions. Unlike
+    get_next_owned_object() it keeps no state in the BLOCK_HEADER, so
+    several threads may walk the same block, after dwg_build_type_index().
+    Returns 0 or an error.
+*/
+int
+dwg_block_iter_init(Dwg_Block_Iter *restrict iter,
+                    const Dwg_Object *restrict hdr)
+{
+  const Dwg_Type_Index *idx;
+  int error;
+
+  memset(iter, 0, sizeof(Dwg_Block_Iter));
+  if (!hdr || !hdr->parent || hdr->type != DWG_TYPE_BLOCK_HEADER)
+    {
+      LOG_ERROR("Invalid BLOCK_HEADER")
+      return DWG_ERR_INVALIDTYPE;
+    }
+  if ((error = dwg_type_index_build(hdr->parent)))
+    return error;
+  idx = &hdr->parent->type_index;
+  if (hdr->index >= idx->num_objects)
+    return DWG_ERR_INVALIDHANDLE;
+  iter->objects = hdr->parent->object;
+  iter->owned = &idx->owned[idx->owned_offsets[hdr->index]];
+  iter->num_owned = idx->owned_offsets[hdr->index + 1]
+                    - idx->owned_offsets[hdr->index];
+  return 0;
+}
+
+/** Returns the next owned entity, or NULL at the end.
+*/
+Dwg_Object*
+dwg_block_iter_next(Dwg_Block_Iter *restrict iter)
+{
+  if (iter->pos >= iter->num_owned)
+    return NULL;
+  return &iter->objects[iter->owned[iter->pos++]];
+}
+
 Dwg_Object*
 get_first_owned_block(const Dwg_Object *hdr)
 {
@@ -873,6 +1085,13 @@ dwg_obj_is_table(const Dwg_Object *obj)
          type == DWG_TYPE_VPORT_ENTITY_HEADER;
 }
 
+/* Timings and counters of the last dwg_read_file or dwg_decode. */
+const Dwg_Stats *
+dwg_get_stats(const Dwg_Data *dwg)
+{
+  return &dwg->stats;
+}
+
 Dwg_Section_Type
 dwg_section_type(const DWGCHAR *wname)
 {
@@ -927,3 +1146,115 @@ dwg_section_type(const DWGCHAR *wname)
   }
   return SECTION_UNKNOWN;
 }
+
+const char *
+dwg_obj_table_utf8name(const Dwg_Object *obj)
+{
+  Dwg_Data *dwg;
+  char *name;
+  if (!obj || obj->supertype != DWG_SUPERTYPE_OBJECT)
+    return NULL;
+  dwg = obj->parent;
+  // HACK: the table entry_name is always at the same offset, by COMMON_TABLE_FLAGS
+  if (dwg_obj_is_table(obj))
+    name = obj->tio.object->tio.STYLE->entry_name;
+  else if (obj->type == DWG_TYPE_MLINESTYLE)
+    name = obj->tio.object->tio.MLINESTYLE->entry_name;
+  else
+    return NULL;
+  if (!dwg || !name || dwg->header.version < R_2007)
+    return name;
+  if (obj->index >= dwg->num_utf8_names)
+    {
+      BITCODE_BL num = dwg->num_objects > obj->index
+        ? dwg->num_objects : obj->index + 1;
+      char **names = (char **)realloc(dwg->utf8_names, num * sizeof(char *));
+      if (!names)
+        return NULL;
+      memset(&names[dwg->num_utf8_names], 0,
+             (num - dwg->num_utf8_names) * sizeof(char *));
+      dwg->utf8_names = names;
+      dwg->num_utf8_names = num;
+    }
+  if (!dwg->utf8_names[obj->index])
+    dwg->utf8_names[obj->index] = bit_convert_TU((BITCODE_TU)name);
+  return dwg->utf8_names[obj->index];
+}
+
+void
+dwg_obj_table_utf8name_reset(const Dwg_Object *obj)
+{
+  Dwg_Data *dwg = obj ? obj->parent : NULL;
+  if (!dwg || obj->index >= dwg->num_utf8_names)
+    return;
+  free(dwg->utf8_names[obj->index]);
+  dwg->utf8_names[obj->index] = NULL;
+}
+
+/* Convert all r2007+ table record names upfront, so that concurrent
+   output passes only read the cache. */
+int
+dwg_fill_utf8names(Dwg_Data *dwg)
+{
+  BITCODE_BL i;
+  if (!dwg || dwg->header.version < R_2007 || !dwg->num_objects)
+    return 0;
+  for (i = 0; i < dwg->num_objects; i++)
+    {
+      const Dwg_Object *obj = &dwg->object[i];
+      const char *name;
+      if (obj->supertype != DWG_SUPERTYPE_OBJECT || !obj->tio.object
+          || !obj->tio.object->tio.UNKNOWN_OBJ)
+        continue;
+      name = obj->type == DWG_TYPE_MLINESTYLE
+        ? (const char *)obj->tio.object->tio.MLINESTYLE->entry_name
+        : dwg_obj_is_table(obj)
+          ? (const char *)obj->tio.object->tio.STYLE->entry_name
+          : NULL;
+      // the first call sizes the cache for all objects
+      if (name && !dwg_obj_table_utf8name(obj))
+        return DWG_ERR_OUTOFMEM;
+    }
+  return 0;
+}
+
+/* Decrypt the SAT version 1 data, 8 bytes at once.
+   Every byte c > 32 is mapped to (unsigned char)(159 - c), all others
+   are kept.
+ */
+unsigned char *
+dwg_decrypt_SAT1(const BITCODE_BL size,
+                 const BITCODE_RC *restrict encr_sat_data)
+{
+  const uint64_t hi = UINT64_C(0x8080808080808080);
+  const uint64_t lo7 = UINT64_C(0x7f7f7f7f7f7f7f7f);
+  const uint64_t c95 = UINT64_C(0x5f5f5f5f5f5f5f5f); // 128 - 33
+  const uint64_t c159 = UINT64_C(0x9f9f9f9f9f9f9f9f);
+  unsigned char *acis_data;
+  BITCODE_BL i = 0;
+
+  if (!encr_sat_data)
+    return NULL;
+  acis_data = (unsigned char *)malloc(size + 1);
+  if (!acis_data)
+    return NULL;
+  for (; i + 8 <= size; i += 8)
+    {
+      uint64_t x, m, d;
+      memcpy(&x, &encr_sat_data[i], 8);
+      // high bit set in each byte >= 33, without carries
+      m = (x | ((x & lo7) + c95)) & hi;
+      m = (m >> 7) * 0xff;
+      // 159 - x per byte, modulo 256, without borrows between the bytes
+      d = ((c159 | hi) - (x & lo7)) ^ ((c159 ^ ~x) & hi);
+      x = (d & m) | (x & ~m);
+      memcpy(&acis_data[i], &x, 8);
+    }
+  for (; i < size; i++)
+    {
+      const unsigned char c = encr_sat_data[i];
+      acis_data[i] = c > 32 ? (unsigned char)(159 - c) : c;
+    }
+  acis_data[size] = '\0';
+  return acis_data;
+}
@@ -1358,10 +1358,8 @@ DWG_ENTITY(VIEWPORT)
     FIELD_BD (height, 41);
   }
   DXF {
-    FIELD_VALUE (on_off) = 1;
-    FIELD_VALUE (id) = 1;
-    FIELD_RS(on_off, 68);
-    FIELD_RS(id, 69);
+    VALUE_RS (1, 68); // on_off
+    VALUE_RS (1, 69); // id
   }
 
   SINCE(R_2000)
@@ -1446,10 +1444,12 @@ DWG_ENTITY(SPLINE)
   SINCE(R_2013) {
     FIELD_BL (splineflags1, 0);
     FIELD_BL (knotparam, 0);
-    if (FIELD_VALUE(splineflags1) & 1)
-      FIELD_VALUE(scenario) = 2;
-    if (FIELD_VALUE(knotparam) == 15)
-      FIELD_VALUE(scenario) = 1;
+    SET_DERIVED {
+      if (FIELD_VALUE(splineflags1) & 1)
+        FIELD_VALUE(scenario) = 2;
+      if (FIELD_VALUE(knotparam) == 15)
+        FIELD_VALUE(scenario) = 1;
+    }
   }
 
   DXF {
@@ -1461,9 +1461,11 @@ DWG_ENTITY(SPLINE)
 
   if (FIELD_VALUE(scenario) & 2) // bezier spline
     {
-      FIELD_VALUE(flag) = 8 + 32 + //planar, not rational
-        // ignore method fit points and closed bits
-        ((FIELD_VALUE(splineflags1) & ~5) << 7);
+      SET_DERIVED {
+        FIELD_VALUE(flag) = 8 + 32 + //planar, not rational
+          // ignore method fit points and closed bits
+          ((FIELD_VALUE(splineflags1) & ~5) << 7);
+      }
       FIELD_BD (fit_tol, 44); // def: 0.0000001
       FIELD_3BD (beg_tan_vec, 12);
       FIELD_3BD (end_tan_vec, 13);
@@ -1480,11 +1482,13 @@ DWG_ENTITY(SPLINE)
       FIELD_BL (num_ctrl_pts, 73);
       FIELD_B (weighted, 0);
 
-      FIELD_VALUE(flag) = 8 + //planar
-        FIELD_VALUE(closed_b) +
-        (FIELD_VALUE(periodic) << 1) +
-        (FIELD_VALUE(rational) << 2) +
-        (FIELD_VALUE(weighted) << 3);
+      SET_DERIVED {
+        FIELD_VALUE(flag) = 8 + //planar
+          FIELD_VALUE(closed_b) +
+          (FIELD_VALUE(periodic) << 1) +
+          (FIELD_VALUE(rational) << 2) +
+          (FIELD_VALUE(weighted) << 3);
+      }
     }
 
   if (FIELD_VALUE(scenario) & 1) {
@@ -1492,9 +1496,9 @@ DWG_ENTITY(SPLINE)
     REPEAT(num_ctrl_pts, ctrl_pts, Dwg_SPLINE_control_point)
       {
         FIELD_3BD (ctrl_pts[rcount1], 10);
-        if (!FIELD_VALUE(weighted))
-          FIELD_VALUE(ctrl_pts[rcount1].w) = 0; // skipped when encoding
-        else
+        if (!FIELD_VALUE(weighted)) {
+          SET_DERIVED { FIELD_VALUE(ctrl_pts[rcount1].w) = 0; } // skipped when encoding
+        } else
           FIELD_BD (ctrl_pts[rcount1].w, 41);
       }
     SET_PARENT_OBJ(ctrl_pts);
@@ -1537,14 +1541,16 @@ DWG_ENTITY_END
 
 #if defined(IS_DECODER)
 
-#define DECODE_3DSOLID decode_3dsolid(dat, hdl_dat, obj, (Dwg_Entity_3DSOLID *)_obj);
+#define DECODE_3DSOLID decode_3dsolid(dat, hdl_dat, obj, (Dwg_Entity_3DSOLID *)_obj, \
+                                      _vmin, _vmax);
 
 static int decode_3dsolid(Bit_Chain* dat, Bit_Chain* hdl_dat,
                           Dwg_Object *restrict obj,
-                          Dwg_Entity_3DSOLID *restrict _obj)
+                          Dwg_Entity_3DSOLID *restrict _obj,
+                          const Dwg_Version_Type _vmin,
+                          const Dwg_Version_Type _vmax)
 {
   Dwg_Data* dwg = obj->parent;
-  BITCODE_BL j;
   BITCODE_BL vcount, rcount1, rcount2;
   BITCODE_BL i = 0;
   BITCODE_BL total_size = 0;
@@ -1563,41 +1569,66 @@ static int decode_3dsolid(Bit_Chain* dat, Bit_Chain* hdl_dat,
       // which is SAT format ACIS 4.0 (since r2000+)
       if (FIELD_VALUE(version) == 1)
         {
+          BITCODE_RC *sat = NULL;
+          // read all encrypted blocks into one contiguous buffer.
+          // acis_data is decrypted on demand, see dwg_ent_3dsolid_get_acis_data()
           do
             {
-              FIELD_VALUE(encr_sat_data) = (char**)
-                realloc(FIELD_VALUE(encr_sat_data), (i+1) * sizeof (char*));
               FIELD_VALUE(block_size) = (BITCODE_BL*)
                 realloc(FIELD_VALUE(block_size), (i+1) * sizeof (BITCODE_BL));
               FIELD_BL (block_size[i], 0);
-              FIELD_TF (encr_sat_data[i], FIELD_VALUE(block_size[i]), 1);
-              total_size += FIELD_VALUE (block_size[i]);
+              if (FIELD_VALUE(block_size[i]))
+                {
+                  BITCODE_RC *tmp;
+                  if (FIELD_VALUE(block_size[i]) > obj->size)
+                    {
+                      LOG_ERROR("Invalid ACIS 1 SAT block_size[%d] %d. Max. %d",
+                                (int)i, FIELD_VALUE(block_size[i]), obj->size);
+                      free(sat);
+                      FIELD_VALUE(num_blocks) = 0;
+                      return DWG_ERR_VALUEOUTOFBOUNDS;
+                    }
+                  tmp = (BITCODE_RC*)realloc(sat, total_size
+                                             + FIELD_VALUE(block_size[i]) + 1);
+                  if (!tmp)
+                    {
+                      free(sat);
+                      FIELD_VALUE(num_blocks) = 0;
+                      return DWG_ERR_OUTOFMEM;
+                    }
+                  sat = tmp;
+                  bit_read_fixed(dat, &sat[total_size],
+                                 (int)FIELD_VALUE(block_size[i]));
+                  LOG_INSANE("encr_sat_data[%d]: [%d TF 1]\n", (int)i,
+                             FIELD_VALUE(block_size[i]));
+                  total_size += FIELD_VALUE (block_size[i]);
+                }
             } while (FIELD_VALUE (block_size[i++]));
 
-          // de-obfuscate SAT data
-          FIELD_VALUE(acis_data) = malloc (total_size+1);
           num_blocks = i-1;
           FIELD_VALUE(num_blocks) = num_blocks;
-          index = 0;
-          for (i=0; i<num_blocks; i++)
+          FIELD_VALUE(acis_data) = NULL;
+          if (num_blocks)
             {
-              for (j=0; j < FIELD_VALUE (block_size[i]); j++)
+              sat[total_size] = '\0';
+              // the block pointers all point into sat, owned by encr_sat_data[0]
+              FIELD_VALUE(encr_sat_data) = (char**)
+                calloc(num_blocks, sizeof (char*));
+              if (!FIELD_VALUE(encr_sat_data))
                 {
-                  if (FIELD_VALUE(encr_sat_data[i][j] <= 32))
-                    {
-                      FIELD_VALUE(acis_data)[index++]
-                        = FIELD_VALUE (encr_sat_data[i][j]);
-                    }
-                  else
-                    {
-                      FIELD_VALUE(acis_data)[index++]
-                        = 159 - FIELD_VALUE (encr_sat_data[i][j]);
-                    }
+                  free(sat);
+                  FIELD_VALUE(num_blocks) = 0;
+                  return DWG_ERR_OUTOFMEM;
+                }
+              index = 0;
+              for (i=0; i<num_blocks; i++)
+                {
+                  FIELD_VALUE(encr_sat_data[i]) = (char*)&sat[index];
+                  index += FIELD_VALUE (block_size[i]);
                 }
             }
-          FIELD_VALUE(acis_data)[index] = '\0';
-          // DXF 1 + 3 if >255
-          LOG_TRACE("acis_data [1]:\n%s\n", FIELD_VALUE (acis_data));
+          LOG_TRACE("encr_sat_data: %d blocks, %d bytes\n", (int)num_blocks,
+                    (int)total_size);
         }
       // version 2, the binary, unencrypted SAT format for ACIS 7.0/ShapeManager.
       /* ACIS versions:
@@ -1611,21 +1642,41 @@ static int decode_3dsolid(Bit_Chain* dat, Bit_Chain* hdl_dat,
        */
       else //if (FIELD_VALUE(version)==2)
         {
+          BITCODE_RC *sat, *tmp;
           FIELD_VALUE(acis_data) = NULL;
           //TODO string in strhdl, even <r2007
           FIELD_VALUE(num_blocks) = 2;
           FIELD_VALUE(block_size) = calloc(2, sizeof (BITCODE_RL));
           FIELD_VALUE(encr_sat_data) = calloc(2, sizeof (char*));
-          FIELD_TF (encr_sat_data[0], 15, 1); // "ACIS BinaryFile"
+          sat = (BITCODE_RC*)malloc(15 + 1);
+          if (!FIELD_VALUE(block_size) || !FIELD_VALUE(encr_sat_data) || !sat)
+            {
+              free(sat);
+              FIELD_VALUE(num_blocks) = 0;
+              return DWG_ERR_OUTOFMEM;
+            }
+          bit_read_fixed(dat, sat, 15); // "ACIS BinaryFile"
           FIELD_VALUE(block_size[0]) = 15;
+          FIELD_VALUE(encr_sat_data[0]) = (char*)sat;
           FIELD_RL (block_size[1], 0);
           if (_obj->block_size[1] > obj->size) {
             LOG_ERROR("Invalid ACIS 2 SAB block_size[1] %d. Max. %d",
                       _obj->block_size[1], obj->size);
+            sat[15] = '\0';
             return DWG_ERR_VALUEOUTOFBOUNDS;
           }
+          tmp = (BITCODE_RC*)realloc(sat, 15 + _obj->block_size[1] + 1);
+          if (!tmp)
+            {
+              sat[15] = '\0';
+              return DWG_ERR_OUTOFMEM;
+            }
+          sat = tmp;
           // Binary SAB, unencrypted
-          FIELD_TF (encr_sat_data[1], FIELD_VALUE(block_size[1]), 1);
+          bit_read_fixed(dat, &sat[15], (int)_obj->block_size[1]);
+          sat[15 + _obj->block_size[1]] = '\0';
+          FIELD_VALUE(encr_sat_data[0]) = (char*)sat;
+          FIELD_VALUE(encr_sat_data[1]) = (char*)&sat[15];
           total_size = FIELD_VALUE (block_size[1]);
         }
 
@@ -1722,9 +1773,10 @@ static int free_3dsolid(Dwg_Object* obj, Dwg_Entity_3DSOLID* _obj)
   BITCODE_BL i;
   BITCODE_BL vcount, rcount1, rcount2;
 
-  for (i=0; i < FIELD_VALUE(num_blocks); i++)
+  // all blocks share one contiguous buffer
+  if (FIELD_VALUE(num_blocks) && FIELD_VALUE(encr_sat_data))
     {
-      FIELD_TF (encr_sat_data[i], block_size[i], 0);
+      FREE_IF(FIELD_VALUE(encr_sat_data[0]));
     }
   FREE_IF(FIELD_VALUE(encr_sat_data));
   FREE_IF(FIELD_VALUE(block_size));
@@ -2119,7 +2171,9 @@ DWG_ENTITY(MLINE)
       FIELD_3DPOINT (verts[rcount1].vertex, 10);
       FIELD_3DPOINT (verts[rcount1].vertex_direction, 210);
       FIELD_3DPOINT (verts[rcount1].miter_direction, 11);
-      FIELD_VALUE (verts[rcount1].num_lines) = FIELD_VALUE (num_lines);
+      SET_DERIVED {
+        FIELD_VALUE (verts[rcount1].num_lines) = FIELD_VALUE (num_lines);
+      }
 
       REPEAT2_C(num_lines, verts[rcount1].lines, Dwg_MLINE_line)
         {
@@ -2192,10 +2246,12 @@ DWG_OBJECT(BLOCK_HEADER)
     FIELD_CAST (num_inserts, RS, RL, 0);
     FIELD_RS (flag3, 0);
 
-    FIELD_VALUE(anonymous)    = FIELD_VALUE(flag) & 1;
-    FIELD_VALUE(hasattrs)     = FIELD_VALUE(flag) & 2;
-    FIELD_VALUE(blkisxref)    = FIELD_VALUE(flag) & 4;
-    FIELD_VALUE(xrefoverlaid) = FIELD_VALUE(flag) & 8;
+    SET_DERIVED {
+      FIELD_VALUE(anonymous)    = FIELD_VALUE(flag) & 1;
+      FIELD_VALUE(hasattrs)     = FIELD_VALUE(flag) & 2;
+      FIELD_VALUE(blkisxref)    = FIELD_VALUE(flag) & 4;
+      FIELD_VALUE(xrefoverlaid) = FIELD_VALUE(flag) & 8;
+    }
   }
   SINCE(R_13) {
     FIELD_B (anonymous, 0); // bit 1
@@ -2207,12 +2263,14 @@ DWG_OBJECT(BLOCK_HEADER)
     FIELD_B (loaded_bit, 0); // bit 32
   }
   SINCE(R_13) {
-    FIELD_VALUE(flag) = FIELD_VALUE(anonymous) |
-                        FIELD_VALUE(hasattrs) << 1 |
-                        FIELD_VALUE(blkisxref) << 2 |
-                        FIELD_VALUE(xrefoverlaid) << 3 |
-                        FIELD_VALUE(xrefdep) << 4 |
-                        FIELD_VALUE(xrefref) << 6;
+    SET_DERIVED {
+      FIELD_VALUE(flag) = FIELD_VALUE(anonymous) |
+                          FIELD_VALUE(hasattrs) << 1 |
+                          FIELD_VALUE(blkisxref) << 2 |
+                          FIELD_VALUE(xrefoverlaid) << 3 |
+                          FIELD_VALUE(xrefdep) << 4 |
+                          FIELD_VALUE(xrefref) << 6;
+    }
   }
   SINCE(R_2004) { // but not in 2007
     FIELD_BL (num_owned, 0);
@@ -2315,10 +2373,12 @@ DWG_OBJECT(LAYER)
     FIELD_RS (color_rs, 62);     // color
     FIELD_RS (linetype_rs, 7);   // style
 
-    FIELD_VALUE(on)            = FIELD_VALUE(color_rs) >= 0;
-    FIELD_VALUE(frozen)        = FIELD_VALUE(flag) & 1;
-    FIELD_VALUE(frozen_in_new) = FIELD_VALUE(flag) & 2;
-    FIELD_VALUE(locked)        = FIELD_VALUE(flag) & 4;
+    SET_DERIVED {
+      FIELD_VALUE(on)            = FIELD_VALUE(color_rs) >= 0;
+      FIELD_VALUE(frozen)        = FIELD_VALUE(flag) & 1;
+      FIELD_VALUE(frozen_in_new) = FIELD_VALUE(flag) & 2;
+      FIELD_VALUE(locked)        = FIELD_VALUE(flag) & 4;
+    }
   }
   VERSIONS(R_13, R_14)
   {
@@ -2326,12 +2386,14 @@ DWG_OBJECT(LAYER)
     FIELD_B (on, 0); // unused, negate the color
     FIELD_B (frozen_in_new, 0);
     FIELD_B (locked, 0);
-    FIELD_VALUE(flag) = FIELD_VALUE(frozen) |
-      (FIELD_VALUE(frozen_in_new) << 1) |
-      (FIELD_VALUE(locked) << 2) |
-      (FIELD_VALUE(color_rs) < 0 ? 32 : 0) |
-      (FIELD_VALUE(xrefdep) << 4) |
-      (FIELD_VALUE(xrefref) << 6);
+    SET_DERIVED {
+      FIELD_VALUE(flag) = FIELD_VALUE(frozen) |
+        (FIELD_VALUE(frozen_in_new) << 1) |
+        (FIELD_VALUE(locked) << 2) |
+        (FIELD_VALUE(color_rs) < 0 ? 32 : 0) |
+        (FIELD_VALUE(xrefdep) << 4) |
+        (FIELD_VALUE(xrefref) << 6);
+    }
   }
   SINCE(R_2000) {
     int flag = FIELD_VALUE(flag);
@@ -2339,15 +2401,17 @@ DWG_OBJECT(LAYER)
     // contains frozen (1 bit), on (2 bit), frozen by default in new viewports (4 bit),
     // locked (8 bit), plotting flag (16 bit), and lineweight (mask with 0x03E0)
     //FIELD_VALUE(flag) = (BITCODE_RC)FIELD_VALUE(flag_s) & 0xff;
-    FIELD_VALUE(frozen) = flag & 1;
-    FIELD_VALUE(on) = flag & 2;
-    FIELD_VALUE(frozen_in_new) = flag & 4;
-    FIELD_VALUE(locked) = flag & 8;
-    FIELD_VALUE(plotflag) = flag & (1<<15) ? 1 : 0;
-    FIELD_VALUE(linewidth) = (flag & 0x03E0) >> 5;
+    SET_DERIVED {
+      FIELD_VALUE(frozen) = flag & 1;
+      FIELD_VALUE(on) = flag & 2;
+      FIELD_VALUE(frozen_in_new) = flag & 4;
+      FIELD_VALUE(locked) = flag & 8;
+      FIELD_VALUE(plotflag) = flag & (1<<15) ? 1 : 0;
+      FIELD_VALUE(linewidth) = (flag & 0x03E0) >> 5;
+    }
     DXF {
-      FIELD_B(plotflag, 290);
-      FIELD_RS(linewidth, 370);
+      VALUE_B ((flag & (1<<15)) ? 1 : 0, 290); // plotflag
+      VALUE_RS ((flag & 0x03E0) >> 5, 370);  // linewidth
     }
   }
   FIELD_CMC (color, 62,420);
@@ -2394,8 +2458,10 @@ DWG_OBJECT(STYLE)
   {
     FIELD_B (shape_file, 0);   //wrong oda doc
     FIELD_B (vertical, 0);     //
-    FIELD_VALUE(flag) |= (FIELD_VALUE(vertical) ? 4 : 0) +
-                         (FIELD_VALUE(shape_file) ? 1 : 0);
+    SET_DERIVED {
+      FIELD_VALUE(flag) |= (FIELD_VALUE(vertical) ? 4 : 0) +
+                           (FIELD_VALUE(shape_file) ? 1 : 0);
+    }
   }
   PRE(R_13)
   {
@@ -2752,9 +2818,8 @@ DWG_OBJECT(VPORT)
   PRE(R_13) {
     FIELD_RC (UCSFOLLOW, 71);
   }
-  else {
-    FIELD_VALUE(VIEWMODE) += (FIELD_VALUE(UCSFOLLOW) << 2);
-    FIELD_4BITS (VIEWMODE, 71); // UCSFOLLOW is bit 3 of 71
+  else { // UCSFOLLOW is bit 3 of 71
+    VALUE_RC ((BITCODE_RC)(FIELD_VALUE(VIEWMODE) + (FIELD_VALUE(UCSFOLLOW) << 2)), 71);
   }
   FIELD_RS (circle_zoom, 72);
   FIELD_RC (FASTZOOM, 73);
@@ -3206,9 +3271,11 @@ DWG_OBJECT(DIMSTYLE)
   SINCE(R_13)
   {
     FIELD_B (flag, 70); // Bit 0 of 70
-    FIELD_VALUE(flag) = FIELD_VALUE(flag) |
-                        FIELD_VALUE(xrefdep) << 4 |
-                        FIELD_VALUE(xrefref) << 6;
+    SET_DERIVED {
+      FIELD_VALUE(flag) = FIELD_VALUE(flag) |
+                          FIELD_VALUE(xrefdep) << 4 |
+                          FIELD_VALUE(xrefref) << 6;
+    }
 
     START_HANDLE_STREAM;
     FIELD_HANDLE (dimstyle_control, 4, 0);
@@ -3258,10 +3325,12 @@ DWG_OBJECT(VPORT_ENTITY_HEADER)
     } else {
       FIELD_B (flag1, 70); // bit 1 of 70
     }
-    FIELD_VALUE(flag) =
-      (FIELD_VALUE(flag1) << 1) |
-      (FIELD_VALUE(xrefdep) << 4) |
-      (FIELD_VALUE(xrefref) << 6);
+    SET_DERIVED {
+      FIELD_VALUE(flag) =
+        (FIELD_VALUE(flag1) << 1) |
+        (FIELD_VALUE(xrefdep) << 4) |
+        (FIELD_VALUE(xrefref) << 6);
+    }
 
     FIELD_HANDLE (vport_entity_control, 4, 0);
     XDICOBJHANDLE(3);
@@ -3306,12 +3375,14 @@ DWG_OBJECT(MLINESTYLE)
   FIELD_CMC (fill_color, 62,420); /*!< default 256 */
 #ifdef IS_DXF
   // 0 - 90
-  FIELD_VALUE(start_angle) = rad2deg(FIELD_VALUE(start_angle));
-  FIELD_VALUE(end_angle)   = rad2deg(FIELD_VALUE(end_angle));
-  while (FIELD_VALUE(start_angle) > 90.0) FIELD_VALUE(start_angle) -= 90.0;
-  while (FIELD_VALUE(end_angle)   > 90.0) FIELD_VALUE(end_angle)   -= 90.0;
-  VALUE (FIELD_VALUE(start_angle), RD, 51)
-  VALUE (FIELD_VALUE(end_angle), RD, 52)
+  {
+    BITCODE_BD start_angle = rad2deg(FIELD_VALUE(start_angle));
+    BITCODE_BD end_angle   = rad2deg(FIELD_VALUE(end_angle));
+    while (start_angle > 90.0) start_angle -= 90.0;
+    while (end_angle   > 90.0) end_angle   -= 90.0;
+    VALUE (start_angle, RD, 51)
+    VALUE (end_angle, RD, 52)
+  }
 #else
   FIELD_BD (start_angle, 51); /*!< default 90 deg */
   FIELD_BD (end_angle, 52);   /*!< default 90 deg */
@@ -5917,10 +5988,12 @@ DWG_ENTITY(HELIX)
   SINCE(R_2013) {
     FIELD_BL (splineflags1, 0);
     FIELD_BL (knotparam, 0);
-    if (FIELD_VALUE(splineflags1) & 1)
-      FIELD_VALUE(scenario) = 2;
-    if (FIELD_VALUE(knotparam) == 15)
-      FIELD_VALUE(scenario) = 1;
+    SET_DERIVED {
+      if (FIELD_VALUE(splineflags1) & 1)
+        FIELD_VALUE(scenario) = 2;
+      if (FIELD_VALUE(knotparam) == 15)
+        FIELD_VALUE(scenario) = 1;
+    }
   }
 
   DXF {
@@ -5932,9 +6005,11 @@ DWG_ENTITY(HELIX)
 
   if (FIELD_VALUE(scenario) & 2) // bezier spline
     {
-      FIELD_VALUE(flag) = 8 + 32 + //planar, not rational
-        // ignore method fit points and closed bits
-        ((FIELD_VALUE(splineflags1) & ~5) << 7);
+      SET_DERIVED {
+        FIELD_VALUE(flag) = 8 + 32 + //planar, not rational
+          // ignore method fit points and closed bits
+          ((FIELD_VALUE(splineflags1) & ~5) << 7);
+      }
       FIELD_BD (fit_tol, 44); // def: 0.0000001
       FIELD_3BD (beg_tan_vec, 12);
       FIELD_3BD (end_tan_vec, 13);
@@ -5951,11 +6026,13 @@ DWG_ENTITY(HELIX)
       FIELD_BL (num_ctrl_pts, 73);
       FIELD_B (weighted, 0);
 
-      FIELD_VALUE(flag) = 8 + //planar
-        FIELD_VALUE(closed_b) +
-        (FIELD_VALUE(periodic) << 1) +
-        (FIELD_VALUE(rational) << 2) +
-        (FIELD_VALUE(weighted) << 3);
+      SET_DERIVED {
+        FIELD_VALUE(flag) = 8 + //planar
+          FIELD_VALUE(closed_b) +
+          (FIELD_VALUE(periodic) << 1) +
+          (FIELD_VALUE(rational) << 2) +
+          (FIELD_VALUE(weighted) << 3);
+      }
     }
 
   if (FIELD_VALUE(scenario) & 1) {
@@ -5963,9 +6040,9 @@ DWG_ENTITY(HELIX)
     REPEAT(num_ctrl_pts, ctrl_pts, Dwg_SPLINE_control_point)
       {
         FIELD_3BD (ctrl_pts[rcount1], 10);
-        if (!FIELD_VALUE(weighted))
-          FIELD_VALUE(ctrl_pts[rcount1].w) = 0; // skipped when encoding
-        else
+        if (!FIELD_VALUE(weighted)) {
+          SET_DERIVED { FIELD_VALUE(ctrl_pts[rcount1].w) = 0; } // skipped when encoding
+        } else
           FIELD_BD (ctrl_pts[rcount1].w, 41);
       }
     SET_PARENT(ctrl_pts, (Dwg_Entity_SPLINE*)_obj);
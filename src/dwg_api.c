@@ -18,6 +18,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <math.h>
@@ -32,6 +33,8 @@
 #include "logging.h"
 #include "bits.h"
 #include "dwg_api.h"
+#include "ref_index.h"
+#include "type_index.h"
 
 /** We don't pass in Dwg_Object*'s, so we don't know if the object
    is >= r2007 or <r13 or what. Default is r2000.
@@ -5095,6 +5098,9 @@ dwg_obj_mlinestyle_set_name(dwg_obj_mlinestyle *restrict mlinestyle,
         mlinestyle->entry_name = (char*)bit_utf8_to_TU((char*)name);
       else
         mlinestyle->entry_name = (char*)name;
+      if (mlinestyle->parent && mlinestyle->parent->dwg)
+        dwg_obj_table_utf8name_reset(
+            &mlinestyle->parent->dwg->object[mlinestyle->parent->objid]);
     }
   else
     {
@@ -14165,6 +14171,9 @@ dwg_ent_3dsolid_get_version(const dwg_ent_3dsolid *restrict _3dsolid,
 }
 
 /** Returns the decrypted _dwg_entity_3DSOLID::acis_data string.
+    The SAT data is decrypted on the first call and kept in the entity,
+    which owns it, so it is freed with dwg_free(). Concurrent first calls
+    each decrypt, only one copy is stored and returned to all.
  */
 unsigned char *
 dwg_ent_3dsolid_get_acis_data(const dwg_ent_3dsolid *restrict _3dsolid,
@@ -14172,8 +14181,43 @@ dwg_ent_3dsolid_get_acis_data(const dwg_ent_3dsolid *restrict _3dsolid,
 {
   if (_3dsolid)
     {
+      dwg_ent_3dsolid *_obj = (dwg_ent_3dsolid *)_3dsolid;
+      unsigned char *acis_data;
+      BITCODE_BL i, size = 0;
+
       *error = 0;
-      return _3dsolid->acis_data;
+#ifdef __GNUC__
+      acis_data = __atomic_load_n(&_obj->acis_data, __ATOMIC_ACQUIRE);
+#else
+      acis_data = _obj->acis_data;
+#endif
+      if (acis_data || _obj->version != 1 || !_obj->num_blocks
+          || !_obj->encr_sat_data)
+        return acis_data;
+      for (i = 0; i < _obj->num_blocks; i++)
+        size += _obj->block_size[i];
+      acis_data = dwg_decrypt_SAT1(size, (BITCODE_RC *)_obj->encr_sat_data[0]);
+      if (!acis_data)
+        {
+          *error = 1;
+          return NULL;
+        }
+#ifdef __GNUC__
+      {
+        unsigned char *none = NULL;
+        // another thread was faster, use its copy
+        if (!__atomic_compare_exchange_n(&_obj->acis_data, &none, acis_data,
+                                         0, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE))
+          {
+            free(acis_data);
+            acis_data = none;
+          }
+      }
+#else
+      _obj->acis_data = acis_data;
+#endif
+      return acis_data;
     }
   else
     {
@@ -19034,6 +19078,211 @@ dwg_object_get_dxfname(const dwg_object *obj)
     }
 }
 
+/** Builds the reverse reference index, if missing or stale, i.e. after
+    objects were added or moved. dwg_object_get_referrers() does it on
+    demand, but not thread-safe. Call this first when querying from
+    several threads.
+\code Usage: error = dwg_build_ref_index(dwg);
+\endcode
+\param[in]  dwg   dwg_data*
+*/
+int
+dwg_build_ref_index(dwg_data *dwg)
+{
+  if (!dwg)
+    {
+      LOG_ERROR("%s: empty dwg", __FUNCTION__)
+      return DWG_ERR_INTERNALERROR;
+    }
+  return dwg_ref_index_build(dwg);
+}
+
+/** Returns the number of objects which reference obj in the given role,
+    e.g. all entities on a layer, all INSERTs of a block, or everything
+    owned by a dictionary. *indices points to their object indices, in
+    ascending order, valid until the index is rebuilt.
+    \sa dwg_build_ref_index
+\code Usage:
+  const BITCODE_BL *idx;
+  BITCODE_BL n = dwg_object_get_referrers(layer, DWG_REF_LAYER, &idx, &error);
+  for (i = 0; i < n; i++)
+    ent = dwg_get_object(dwg, idx[i]);
+\endcode
+\param[in]  obj     dwg_object*
+\param[in]  role    Dwg_Ref_Role
+\param[out] indices const BITCODE_BL**
+\param[out] error   int*, is set to 0 for ok, 1 on error
+*/
+BITCODE_BL
+dwg_object_get_referrers(const dwg_object *restrict obj,
+                         const Dwg_Ref_Role role,
+                         const BITCODE_BL **restrict indices,
+                         int *restrict error)
+{
+  Dwg_Data *dwg;
+  BITCODE_BL row;
+  *indices = NULL;
+  if (!obj || !obj->parent || (unsigned)role >= DWG_REF_NUM_ROLES)
+    {
+      *error = 1;
+      LOG_ERROR("%s: empty obj or invalid role", __FUNCTION__)
+      return 0;
+    }
+  dwg = obj->parent;
+  if (dwg_ref_index_build(dwg) || obj->index >= dwg->ref_index.num_objects)
+    {
+      *error = 1;
+      return 0;
+    }
+  *error = 0;
+  row = obj->index * DWG_REF_NUM_ROLES + role;
+  *indices = &dwg->ref_index.sources[dwg->ref_index.offsets[row]];
+  return dwg->ref_index.offsets[row + 1] - dwg->ref_index.offsets[row];
+}
+
+/** Builds the type index, if missing or stale. It is built after decoding,
+    and rebuilt on demand after objects were added or moved, but not
+    thread-safe. Call this first when querying from several threads.
+\code Usage: error = dwg_build_type_index(dwg);
+\endcode
+\param[in]  dwg   dwg_data*
+*/
+int
+dwg_build_type_index(dwg_data *dwg)
+{
+  if (!dwg)
+    {
+      LOG_ERROR("%s: empty dwg", __FUNCTION__)
+      return DWG_ERR_INTERNALERROR;
+    }
+  return dwg_type_index_build(dwg);
+}
+
+static BITCODE_BL
+dwg_type_index_get(dwg_data *restrict dwg, const BITCODE_BL row,
+                   const dwg_object *restrict hdr,
+                   const BITCODE_BL **restrict indices, int *restrict error)
+{
+  if (dwg_type_index_build(dwg))
+    {
+      *error = 1;
+      return 0;
+    }
+  *error = 0;
+  return dwg_type_index_find(dwg, row, hdr ? hdr->index : 0, hdr != NULL,
+                             indices);
+}
+
+/** Returns the number of all objects of a fixedtype, without scanning,
+    e.g. all TEXT or all HATCH entities. *indices points to their object
+    indices, sorted by their owning block and index, valid until the index
+    is rebuilt.
+    \sa dwg_build_type_index
+\code Usage:
+  const BITCODE_BL *idx;
+  BITCODE_BL n = dwg_get_objects_of_type(dwg, DWG_TYPE_TEXT, &idx, &error);
+  for (i = 0; i < n; i++)
+    text = dwg->object[idx[i]].tio.entity->tio.TEXT;
+\endcode
+\param[in]  dwg     dwg_data*
+\param[in]  type    Dwg_Object_Type, the fixedtype
+\param[out] indices const BITCODE_BL**
+\param[out] error   int*, is set to 0 for ok, 1 on error
+*/
+BITCODE_BL
+dwg_get_objects_of_type(dwg_data *restrict dwg, const Dwg_Object_Type type,
+                        const BITCODE_BL **restrict indices,
+                        int *restrict error)
+{
+  *indices = NULL;
+  if (!dwg)
+    {
+      *error = 1;
+      LOG_ERROR("%s: empty dwg", __FUNCTION__)
+      return 0;
+    }
+  return dwg_type_index_get(dwg, dwg_type_index_row(dwg, type, 0), NULL,
+                            indices, error);
+}
+
+/** Returns the number of all objects of a class, i.e. of type
+    500 + klass, same as \sa dwg_get_objects_of_type
+\param[in]  dwg     dwg_data*
+\param[in]  klass   BITCODE_BS, the index into dwg->dwg_class
+\param[out] indices const BITCODE_BL**
+\param[out] error   int*, is set to 0 for ok, 1 on error
+*/
+BITCODE_BL
+dwg_get_objects_of_class(dwg_data *restrict dwg, const BITCODE_BS klass,
+                         const BITCODE_BL **restrict indices,
+                         int *restrict error)
+{
+  *indices = NULL;
+  if (!dwg)
+    {
+      *error = 1;
+      LOG_ERROR("%s: empty dwg", __FUNCTION__)
+      return 0;
+    }
+  return dwg_type_index_get(dwg, dwg_type_index_row(dwg, klass, 1), NULL,
+                            indices, error);
+}
+
+/** Returns the number of objects of a fixedtype owned by the block header,
+    e.g. all LWPOLYLINE in model space, same as
+    \sa dwg_get_objects_of_type
+\param[in]  hdr     dwg_object*, a BLOCK_HEADER
+\param[in]  type    Dwg_Object_Type, the fixedtype
+\param[out] indices const BITCODE_BL**
+\param[out] error   int*, is set to 0 for ok, 1 on error
+*/
+BITCODE_BL
+dwg_block_get_objects_of_type(const dwg_object *restrict hdr,
+                              const Dwg_Object_Type type,
+                              const BITCODE_BL **restrict indices,
+                              int *restrict error)
+{
+  *indices = NULL;
+  if (!hdr || !hdr->parent || hdr->type != DWG_TYPE_BLOCK_HEADER)
+    {
+      *error = 1;
+      LOG_ERROR("%s: empty or invalid BLOCK_HEADER", __FUNCTION__)
+      return 0;
+    }
+  return dwg_type_index_get(hdr->parent,
+                            dwg_type_index_row(hdr->parent, type, 0), hdr,
+                            indices, error);
+}
+
+/** Returns the number of entities owned by the block header, in all
+    versions, and without the BLOCK and ENDBLK entities. *indices points
+    to their object indices, in ascending order, valid until the type
+    index is rebuilt. \sa dwg_block_iter_init
+\code Usage:
+  const BITCODE_BL *idx;
+  BITCODE_BL n = dwg_block_get_owned(mspace, &idx, &error);
+\endcode
+\param[in]  hdr     dwg_object*, a BLOCK_HEADER
+\param[out] indices const BITCODE_BL**
+\param[out] error   int*, is set to 0 for ok, 1 on error
+*/
+BITCODE_BL
+dwg_block_get_owned(const dwg_object *restrict hdr,
+                    const BITCODE_BL **restrict indices,
+                    int *restrict error)
+{
+  Dwg_Block_Iter iter;
+  *indices = NULL;
+  if (dwg_block_iter_init(&iter, hdr))
+    {
+      *error = 1;
+      return 0;
+    }
+  *error = 0;
+  *indices = iter.owned;
+  return iter.num_owned;
+}
+
 /*******************************************************************
 *                    FUNCTIONS FOR DWG OBJECT SUBCLASSES           *
 ********************************************************************/
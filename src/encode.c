@@ -356,10 +356,25 @@ static bool env_var_checked_p;
     *dat = sav_dat; \
   }
 #define START_HANDLE_STREAM \
+  PATCH_BITSIZE \
   *hdl_dat = *dat; \
   if (dat->version >= R_2007) bit_set_position(hdl_dat, obj->hdlpos); \
   RESET_VER
 
+/* New objects have no bitsize yet. Until r2000 the handle stream follows
+   inline, so patch it at its start, relative to the object start after
+   the 2 byte MS size. */
+#define PATCH_BITSIZE \
+  if (obj->bitsize == 0 && obj->bitsize_address && \
+      dat->version >= R_13 && dat->version <= R_2000) \
+    { \
+      unsigned long _pos = bit_position(dat); \
+      obj->bitsize = _pos - (obj->address + 2) * 8; \
+      bit_set_position(dat, obj->bitsize_address); \
+      bit_write_RL(dat, obj->bitsize); \
+      bit_set_position(dat, _pos); \
+    }
+
 #if 0
 /** See dec_macro.h instead.
    Returns -1 if not added, else returns the new objid.
@@ -855,12 +870,12 @@ dwg_encode(Dwg_Data *restrict dwg, Bit_Chain *restrict dat)
               pvzmap.handle = omap[k].handle;
               pvzmap.index  = omap[k].index;
 
-              omap[k - 1].handle = pvzmap.handle;
-              omap[k - 1].index  = pvzmap.index;
-
               omap[k].handle = omap[k - 1].handle;
               omap[k].index  = omap[k - 1].index;
 
+              omap[k - 1].handle = pvzmap.handle;
+              omap[k - 1].index  = pvzmap.index;
+
               k--;
               if (k == 0)
                 break;
@@ -916,20 +931,18 @@ dwg_encode(Dwg_Data *restrict dwg, Bit_Chain *restrict dat)
   last_handle = 0;
   for (j = 0; j < dwg->num_objects; j++)
     {
-      BITCODE_BL index;
       long int pvz;
 
-      index = omap[j].index;
-
-      pvz = omap[index].handle - last_handle;
+      // omap is sorted by handle already
+      pvz = omap[j].handle - last_handle;
       bit_write_UMC(dat, pvz);
       //printf ("Handle(%i): %6lu / ", j, pvz);
-      last_handle = omap[index].handle;
+      last_handle = omap[j].handle;
 
-      pvz = omap[index].address - last_address;
+      pvz = omap[j].address - last_address;
       bit_write_MC(dat, pvz);
       //printf ("Address: %08X\n", pvz);
-      last_address = omap[index].address;
+      last_address = omap[j].address;
 
       //dwg dwg_encode_add_object(dwg->object[j], dat, last_address);
 
@@ -1478,10 +1491,30 @@ dwg_encode_add_object(Dwg_Object* obj, Bit_Chain* dat,
       bit_write_B(dat, 1);
     }
   }
+  /* New objects have no size yet. Patch it, moving the object
+     2 bytes up for a 4 byte MS from 0x8000 on. */
+  if (!obj->size)
+    {
+      unsigned long end = dat->byte;
+      BITCODE_RL size = end - address - 2;
+      if (size > 0x7fff)
+        {
+          while (end + 4 >= dat->size)
+            bit_chain_alloc(dat);
+          memmove(&dat->chain[address + 4], &dat->chain[address + 2], size);
+          end += 2;
+        }
+      obj->size = size;
+      dat->byte = address;
+      bit_write_MS(dat, obj->size);
+      dat->byte = end;
+      LOG_TRACE("size: %u [MS] patched\n", obj->size)
+    }
   bit_write_CRC(dat, address, 0xC0C1);
 
   {
-    unsigned long next_addr = address + obj->size + 4;
+    unsigned long next_addr = address + obj->size
+                              + (obj->size > 0x7fff ? 6 : 4);
     if (next_addr != dat->byte)
       {
         if (obj->size)
@@ -1606,6 +1639,7 @@ dwg_encode_common_entity_handle_data(Bit_Chain* dat, Bit_Chain* hdl_dat,
   ent = obj->tio.entity;
   _obj = ent;
 
+  PATCH_BITSIZE
   #include "common_entity_handle_data.spec"
 
   return error;
@@ -1749,6 +1783,7 @@ dwg_encode_xdata(Bit_Chain* dat, Dwg_Object_XRECORD *obj, int size)
   while (rbuf)
     {
       tmp = rbuf->next;
+      bit_write_RS(dat, rbuf->type);
       type = get_base_value_type(rbuf->type);
       switch (type)
         {
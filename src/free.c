@@ -31,6 +31,9 @@
 #include "decode.h"
 #include "free.h"
 #include "hash.h"
+#include "stats.h"
+#include "ref_index.h"
+#include "type_index.h"
 
 static unsigned int loglevel;
 #ifdef USE_TRACING
@@ -745,9 +748,18 @@ dwg_free(Dwg_Data * dwg)
           FREE_IF(dwg->object_ref[i]);
         }
       FREE_IF(dwg->object_ref);
+      for (i=0; i < dwg->num_utf8_names; ++i)
+        {
+          FREE_IF(dwg->utf8_names[i]);
+        }
+      FREE_IF(dwg->utf8_names);
+      dwg->num_utf8_names = 0;
       FREE_IF(dwg->object);
       if (dwg->object_map)
         hash_free (dwg->object_map);
+      dwg_stats_free(dwg);
+      dwg_ref_index_free(dwg);
+      dwg_type_index_free(dwg);
 #undef FREE_IF
     }
 }
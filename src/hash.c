@@ -106,26 +106,28 @@ uint32_t hash_get(dwg_inthash *hash, uint32_t key)
 }
 
 // search or insert. key 0 is forbidden.
-void hash_set(dwg_inthash *hash, uint32_t key, uint32_t value)
+// Returns 1 if an existing key was mapped to another value, else 0.
+int hash_set(dwg_inthash *hash, uint32_t key, uint32_t value)
 {
   uint32_t i = hash_func(key) % hash->size;
   uint32_t j = i;
   if (key == 0) {
       fprintf(stderr, "forbidden 0 key\n");
-      return;
+      return 0;
   }
   // empty slot
   if (!hash->array[i].key) {
     hash->array[i].key = key;
     hash->array[i].value = value;
     hash->elems++;
-    return;
+    return 0;
   }
   while (hash->array[i].key)
     {
       if (hash->array[i].key == key) { // found
+        int changed = hash->array[i].value != value;
         hash->array[i].value = value;
-        return;
+        return changed;
       }
       //fprintf(stderr, "set collision at %d\n", i);
       i++; // linear probing with wrap around
@@ -151,15 +153,14 @@ void hash_set(dwg_inthash *hash, uint32_t key, uint32_t value)
                 {
                   //fprintf(stderr, "not found resize at %d\n", hash->size);
                   hash_resize(hash); // guarantees new empty slots
-                  hash_set(hash, key, value);
-                  return;
+                  return hash_set(hash, key, value);
                 }
               else
                 { // insert at empty slot
                   hash->array[i].key = key;
                   hash->array[i].value = value;
                   hash->elems++;
-                  return;
+                  return 0;
                 }
             }
         }
@@ -168,7 +169,7 @@ void hash_set(dwg_inthash *hash, uint32_t key, uint32_t value)
   hash->array[i].key = key;
   hash->array[i].value = value;
   hash->elems++;
-  return;
+  return 0;
 }
 
 void hash_free(dwg_inthash *hash)
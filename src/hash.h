@@ -39,7 +39,7 @@ typedef struct _inthash {
 
 dwg_inthash *hash_new(uint32_t size);
 uint32_t hash_get(dwg_inthash *hash, uint32_t key);
-void hash_set(dwg_inthash *hash, uint32_t key, uint32_t value);
+int hash_set(dwg_inthash *hash, uint32_t key, uint32_t value);
 void hash_free(dwg_inthash *hash);
 
 #endif
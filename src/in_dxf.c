@@ -39,7 +39,6 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
-#include <ctype.h>
 
 #include "common.h"
 #include "bits.h"
@@ -48,6 +47,8 @@
 #include "out_dxf.h"
 #include "decode.h"
 #include "encode.h"
+#include "numfmt.h"
+#include "hash.h"
 
 static unsigned int loglevel;
 #define DWG_LOGLEVEL loglevel
@@ -55,162 +56,200 @@ static unsigned int loglevel;
 
 /* the current version per spec block */
 static unsigned int cur_ver = 0;
-static char buf[4096];
-static long start, end; //stream offsets
 
+/* One DXF group. The value is a view into dat->chain without the line end,
+   not NUL-terminated, and only converted when it is assigned to a field. */
 typedef struct _dxf_pair {
   short code;
   enum RES_BUF_VALUE_TYPE type;
-  union {
-    int i;
-    char *s;
-    long l;
-    double d;
-  } value;
+  const char *value;
+  unsigned int len;
 } Dxf_Pair;
 
-static long num_dxf_objs;  // how many elements are added
-static long size_dxf_objs; // how many elements are allocated
-static Dxf_Objs* dxf_objs;
-
-static inline void dxf_skip_ws(Bit_Chain *dat)
+/* A header variable of the spec, and where its value goes */
+typedef struct _dxf_field {
+  const char *name; // the string literals of the spec, not copied
+  const char *type;
+  int dxf;
+  void *value; // in dwg->header_vars, or NULL if not assigned
+  size_t size;
+} Dxf_Field;
+
+/* The header variables of the spec, found by name. All zero is empty. */
+typedef struct _dxf_registry {
+  int num_fields;
+  int size_fields;
+  Dxf_Field *fields;
+  unsigned int size_index; // a power of 2
+  int *index; // field + 1, by name
+} Dxf_Registry;
+
+/* Returns the line at dat->byte without its line end, and advances past it.
+   NULL at the end. With *crlf set only CR LF ends the line, as a LF alone
+   may be part of a string. Sets *crlf if the line ended with CR LF. */
+static const char *
+dxf_read_line(Bit_Chain *restrict dat, unsigned int *restrict len,
+              int *restrict crlf)
 {
-  for (; !dat->chain[dat->byte] || isspace(dat->chain[dat->byte]); dat->byte++) ;
-}
+  const char *s, *nl;
+  size_t n;
 
-static int dxf_read_code(Bit_Chain *dat)
-{
-  char *endptr;
-  long num = strtol((char*)&dat->chain[dat->byte], &endptr, 10);
-  dat->byte += (unsigned char *)endptr - &dat->chain[dat->byte];
-  dxf_skip_ws(dat);
-  if (num > INT_MAX)
-    LOG_ERROR("%s: int overflow %ld (at %lu)", __FUNCTION__, num, dat->byte)
-  return (int)num;
+  if (!dat->chain || dat->byte >= dat->size)
+    {
+      *len = 0;
+      return NULL;
+    }
+  s = (const char *)&dat->chain[dat->byte];
+  n = dat->size - dat->byte;
+  nl = (const char *)memchr(s, '\n', n);
+  if (*crlf)
+    while (nl && (nl == s || nl[-1] != '\r'))
+      nl = (const char *)memchr(nl + 1, '\n', n - (size_t)(nl + 1 - s));
+  if (nl)
+    {
+      n = (size_t)(nl - s);
+      dat->byte += n + 1;
+    }
+  else
+    dat->byte = dat->size;
+  *crlf = n && s[n - 1] == '\r';
+  if (*crlf)
+    n--;
+  *len = (unsigned int)n;
+  return s;
 }
 
+/* Skips the next group code if it is dxf */
 static int dxf_read_group(Bit_Chain *dat, int dxf)
 {
-  char *endptr;
-  long num = strtol((char*)&dat->chain[dat->byte], &endptr, 10);
-  if ((int)num == dxf) {
+  const unsigned long pos = dat->byte;
+  unsigned int len;
+  int crlf = 0;
+  long num;
+  const char *s = dxf_read_line(dat, &len, &crlf);
+
+  if (s && numfmt_parse_long(s, len, &num) && num == dxf) {
     LOG_HANDLE("group %d\n", dxf);
-    dat->byte += (unsigned char *)endptr - &dat->chain[dat->byte];
-    dxf_skip_ws(dat);
     return 1;
   }
+  dat->byte = pos;
   return 0;
 }
 
+/* Reads the value line, into a new *string if not NULL */
 static void dxf_read_string(Bit_Chain *dat, char **string)
 {
-  int i;
-  dxf_skip_ws(dat);
-  for (i = 0; !isspace(dat->chain[dat->byte]); dat->byte++)
-    {
-      buf[i++] = dat->chain[dat->byte];
-    }
-  buf[i] = '\0';
-  //int i = sscanf(&dat->chain[dat->byte], "%s", buf);
-  if (i) {
-    dxf_skip_ws(dat);
-    if (!string)
-      return; // ignore
-    if (!*string)
-      *string = malloc(strlen(buf)+1);
-    strcpy(*string, buf);
+  unsigned int len;
+  int crlf = 0;
+  const char *s = dxf_read_line(dat, &len, &crlf);
+
+  if (!s || !string)
+    return; // ignore
+  *string = malloc(len + 1);
+  if (*string) {
+    memcpy(*string, s, len);
+    (*string)[len] = '\0';
   }
 }
 
-#define STRADD(field, string) \
-  field = malloc(strlen(string)+1); strcpy(field, string)
-
-static void dxf_free_pair(Dxf_Pair* pair)
+/* Reads the next group code and value. Returns 0 at the end. */
+static int dxf_read_pair(Bit_Chain *restrict dat, Dxf_Pair *restrict pair)
 {
-  if (pair->type == VT_STRING ||
-      pair->type == VT_BINARY)
-    {
-      free(pair->value.s);
-    }
-  free(pair);
-  pair = NULL;
+  unsigned int len;
+  int crlf = 0;
+  long code;
+  const char *s = dxf_read_line(dat, &len, &crlf);
+
+  if (!s)
+    return 0;
+  if (!numfmt_parse_long(s, len, &code) || code < -5 || code > 1071) {
+    LOG_ERROR("Invalid DXF group code %.*s (at %lu)", (int)len, s, dat->byte)
+    return 0;
+  }
+  pair->code = (short)code;
+  pair->type = get_base_value_type(pair->code);
+  // the value ends as its code, with CR LF or LF
+  pair->value = dxf_read_line(dat, &pair->len, &crlf);
+  if (!pair->value) {
+    LOG_ERROR("Missing DXF value for group code %d", pair->code)
+    return 0;
+  }
+  if (pair->type == VT_INVALID)
+    LOG_WARN("Invalid DXF group code: %d", pair->code)
+  LOG_TRACE("dxf{%d, %.*s}\n", (int)pair->code, (int)pair->len, pair->value)
+  return 1;
 }
 
-static Dxf_Pair* dxf_read_pair(Bit_Chain *dat)
+/* The value of the group just read by GROUP */
+static int dxf_read_value(Bit_Chain *restrict dat, Dxf_Pair *restrict pair,
+                          int dxf)
 {
-  Dxf_Pair *pair = calloc(1, sizeof(Dxf_Pair));
-  pair->code = (short)dxf_read_code(dat);
+  int crlf = 0;
+  pair->code = (short)dxf;
   pair->type = get_base_value_type(pair->code);
-  switch (pair->type)
-    {
-    case VT_STRING:
-      dxf_read_string(dat, &pair->value.s);
-      LOG_TRACE("dxf{%d, %s}\n", (int)pair->code, pair->value.s);
-      SINCE(R_2007) {
-        BITCODE_TU wstr = bit_utf8_to_TU(pair->value.s);
-        free(pair->value.s);
-        pair->value.s = (char*)wstr;
-      }
-      break;
-    case VT_BOOL:
-    case VT_INT8:
-    case VT_INT16:
-    case VT_INT32:
-      pair->value.i = dxf_read_code(dat);
-      LOG_TRACE("dxf{%d, %d}\n", (int)pair->code, pair->value.i);
-      break;
-    case VT_REAL:
-    case VT_POINT3D:
-      dxf_skip_ws(dat);
-      sscanf((char*)&dat->chain[dat->byte], "%lf", &pair->value.d);
-      LOG_TRACE("dxf{%d, %f}\n", pair->code, pair->value.d);
-      break;
-    case VT_BINARY:
-      //read into buf only?
-      dxf_read_string(dat, &pair->value.s);
-      //TODO convert %02X to string
-      LOG_TRACE("dxf{%d, %s}\n", (int)pair->code, pair->value.s);
-      break;
-    case VT_HANDLE:
-    case VT_OBJECTID:
-      dxf_read_string(dat, NULL);
-      sscanf(buf, "%X", &pair->value.i);
-      LOG_TRACE("dxf{%d,%X}\n", (int)pair->code, pair->value.i);
-      break;
-    case VT_INVALID:
-    default:
-      LOG_ERROR("Invalid DXF group code: %d", pair->code);
-      return NULL;
-    }
-  return pair;
+  pair->value = dxf_read_line(dat, &pair->len, &crlf);
+  return pair->value != NULL;
 }
 
-#define DXF_CHECK_EOF           \
-  if (dat->byte >= dat->size || \
-      (pair->code == 0 && !strcmp(pair->value.s, "EOF"))) \
-    return 1
+static int dxf_pair_is(const Dxf_Pair *restrict pair, const char *restrict str)
+{
+  const size_t len = strlen(str);
+  return pair->len == len && !memcmp(pair->value, str, len);
+}
 
-static int dxf_skip_comment(Bit_Chain *dat, Dxf_Pair *pair)
+static char *dxf_pair_strdup(const Dxf_Pair *pair)
 {
-  while (pair->code == 999)
-    {
-      dxf_free_pair(pair);
-      pair = dxf_read_pair(dat);
-      DXF_CHECK_EOF;
-    }
-  return 0;
+  char *s = malloc(pair->len + 1);
+  if (s) {
+    memcpy(s, pair->value, pair->len);
+    s[pair->len] = '\0';
+  }
+  return s;
 }
 
-static int dxf_check_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
+static double dxf_pair_double(const Dxf_Pair *pair)
 {
-  if (pair->code == code)
+  double d = 0.0;
+  if (!numfmt_parse_double(pair->value, pair->len, &d))
+    LOG_WARN("Invalid DXF number %d: %.*s", pair->code, (int)pair->len,
+             pair->value)
+  return d;
+}
+
+static long dxf_pair_long(const Dxf_Pair *pair)
+{
+  long l = 0;
+  if (!numfmt_parse_long(pair->value, pair->len, &l))
+    LOG_WARN("Invalid DXF integer %d: %.*s", pair->code, (int)pair->len,
+             pair->value)
+  return l;
+}
+
+static unsigned long dxf_pair_handle(const Dxf_Pair *pair)
+{
+  unsigned long h = 0;
+  if (!numfmt_parse_hex(pair->value, pair->len, &h))
+    LOG_WARN("Invalid DXF handle %d: %.*s", pair->code, (int)pair->len,
+             pair->value)
+  return h;
+}
+
+/* As written by out_dxf: days.ms */
+static void dxf_pair_timebll(const Dxf_Pair *restrict pair,
+                             BITCODE_TIMEBLL *restrict date)
+{
+  const char *dot = memchr(pair->value, '.', pair->len);
+  long days = 0, ms = 0;
+  if (!dot
+      || !numfmt_parse_long(pair->value, dot - pair->value, &days)
+      || !numfmt_parse_long(dot + 1, pair->len - (dot + 1 - pair->value), &ms))
     {
-      dxf_skip_comment(dat, pair);
-      DXF_CHECK_EOF;
-      dxf_free_pair(pair);
-      return 1;
+      LOG_WARN("Invalid DXF date %d: %.*s", pair->code, (int)pair->len,
+               pair->value)
+      return;
     }
-  return 0;
+  date->days = (BITCODE_BL)days;
+  date->ms = (BITCODE_BL)ms;
 }
 
 /*--------------------------------------------------------------------------------
@@ -221,32 +260,25 @@ static int dxf_check_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
 #define IS_ENCODER
 #define IS_DXF
 
-//for sscanf with BD we need to use %lf not %g
-#undef FORMAT_BD
-#define FORMAT_BD "%lf"
-
-#define FIELD(name,type,dxf) dxf_add_field(obj, #name, #type, dxf)
+#define FIELD(name,type,dxf) \
+  dxf_add_field(reg, #name, #type, dxf, &_obj->name, sizeof(_obj->name))
 #define FIELD_CAST(name,type,cast,dxf) FIELD(name,cast,dxf)
 #define FIELD_TRACE(name,type)
 #define VALUE_TV(value, dxf)  dxf_read_string(dat, (char**)&value)
-#define SUBCLASS(text) VALUE_TV(buf, 100);
+#define SUBCLASS(text) \
+  if (GROUP(100)) { dxf_read_string(dat, NULL); }
 
 #define VALUE_TU(value,dxf) \
-  { BITCODE_TU wstr; \
-    VALUE_TV(buf, dxf); \
-    wstr = bit_utf8_to_TU(buf); \
-    /* TODO get TU length, copy to &value */ \
+  { /* TODO convert with bit_utf8_to_TU, copy to &value */ \
+    dxf_read_string(dat, NULL); \
   }
 
 #define FIELD_VALUE(name) _obj->name
 #define ANYCODE -1
 #define VALUE_HANDLE(hdlptr, handle_code, dxf) \
   if (dxf && hdlptr) { \
-    if (GROUP(dxf)) { \
-      int i = sscanf((char*)&dat->chain[dat->byte], "%lX", \
-                     &hdlptr->absolute_ref); \
-      dat->byte += i; \
-    } \
+    if (GROUP(dxf) && dxf_read_value(dat, &pair, dxf)) \
+      hdlptr->absolute_ref = dxf_pair_handle(&pair); \
   }
 #define FIELD_HANDLE(name, handle_code, dxf) VALUE_HANDLE(_obj->name, handle_code, dxf)
 #define HEADER_9(name) \
@@ -263,14 +295,13 @@ static int dxf_check_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
 
 #define HEADER_VALUE(name, type, dxf, value) \
   if (dxf) {\
-    char *headername; \
     if (GROUP(9)) { \
-      dxf_read_string(dat, &headername); \
+      dxf_read_string(dat, NULL); \
       LOG_TRACE("9 %s:\n", #name); \
       VALUE (value, type, dxf); \
     } \
     else { \
-      FIELD(name,type,dxf); \
+      dxf_add_field(reg, #name, #type, dxf, NULL, 0); \
     } \
   }
 #define HEADER_VAR(name, type, dxf) \
@@ -305,21 +336,19 @@ static int dxf_check_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
   HEADER_9(name);\
   {\
     Dwg_Object_Ref *ref = dwg->header_vars.name;\
-    pair = dxf_read_pair(dat); \
-    DXF_CHECK_EOF; \
-    if (ref && ref->obj && pair->type == VT_HANDLE) { \
+    if (dxf_read_pair(dat, &pair) && ref && ref->obj \
+        && pair.type == VT_HANDLE) { \
       /* TODO: set the table handle */ \
-      ;/*ref->obj->handle.absolute_ref = pair->value.i; */ \
-      /*ref->obj->tio.object->tio.section->entry_name = strdup(pair->value.s);*/ \
+      ;/*ref->obj->handle.absolute_ref = dxf_pair_handle(&pair); */ \
+      /*ref->obj->tio.object->tio.section->entry_name = dxf_pair_strdup(&pair);*/ \
     } \
   }
 //FIXME
 #define HANDLE_NAME(id, dxf) \
   { \
     Dwg_Object_Ref *ref = id;\
-    char *tmp; \
     Dwg_Object *o = ref ? ref->obj : NULL;\
-    VALUE_TV(tmp, dxf); \
+    dxf_read_string(dat, NULL); \
 }
 
 #define FIELD_DATAHANDLE(name, code, dxf) FIELD_HANDLE(name, code, dxf)
@@ -367,7 +396,7 @@ static int dxf_check_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
 #define FIELD_MC(name,dxf)  FIELD(name, MC, dxf)
 #define FIELD_MS(name,dxf)  FIELD(name, MS, dxf)
 #define FIELD_TF(name,len,dxf)  VALUE_TV(_obj->name, dxf)
-#define FIELD_TFF(name,len,dxf) VALUE_TV(_obj->name, dxf)
+#define FIELD_TFF(name,len,dxf) dxf_read_string(dat, NULL) /* TODO fixed */
 #define FIELD_TV(name,dxf) \
   if (_obj->name != NULL && dxf != 0) { GROUP(dxf); VALUE_TV(_obj->name, dxf); }
 #define FIELD_TU(name,dxf) \
@@ -398,41 +427,28 @@ static int dxf_check_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
   VALUE_RS(_obj->color.index, dxf1)
 // TODO: rgb
 #define FIELD_TIMEBLL(name,dxf) \
-  GROUP(dxf);\
-  sscanf((char*)&dat->chain[dat->byte], "%u.%u", \
-        &_obj->name.days, &_obj->name.ms)
+  if (GROUP(dxf) && dxf_read_value(dat, &pair, dxf)) \
+    dxf_pair_timebll(&pair, &_obj->name)
 #define HEADER_CMC(name,dxf) \
     HEADER_9(name);\
     VALUE_RS(dwg->header_vars.name.index, dxf)
 
 #define POINT_3D(name, var, c1, c2, c3)\
   {\
-    pair = dxf_read_pair(dat); \
-    DXF_CHECK_EOF; \
-    if (pair && pair->code == c1) { \
-      dwg->var.x = pair->value.d; \
-      dxf_free_pair(pair); \
-      pair = dxf_read_pair(dat); \
-      if (pair && pair->code == c2) \
-        dwg->var.y = pair->value.d; \
-      dxf_free_pair(pair); \
-      pair = dxf_read_pair(dat); \
-      if (pair && pair->code == c3) \
-        dwg->var.z = pair->value.d; \
-      dxf_free_pair(pair); \
+    if (dxf_read_pair(dat, &pair) && pair.code == c1) { \
+      dwg->var.x = dxf_pair_double(&pair); \
+      if (dxf_read_pair(dat, &pair) && pair.code == c2) \
+        dwg->var.y = dxf_pair_double(&pair); \
+      if (dxf_read_pair(dat, &pair) && pair.code == c3) \
+        dwg->var.z = dxf_pair_double(&pair); \
     } \
   }
 #define POINT_2D(name, var, c1, c2) \
   {\
-    pair = dxf_read_pair(dat); \
-    DXF_CHECK_EOF; \
-    if (pair && pair->code == c1) { \
-      dwg->var.x = pair->value.d; \
-      dxf_free_pair(pair); \
-      pair = dxf_read_pair(dat); \
-      if (pair && pair->code == c2) \
-        dwg->var.y = pair->value.d; \
-      dxf_free_pair(pair); \
+    if (dxf_read_pair(dat, &pair) && pair.code == c1) { \
+      dwg->var.x = dxf_pair_double(&pair); \
+      if (dxf_read_pair(dat, &pair) && pair.code == c2) \
+        dwg->var.y = dxf_pair_double(&pair); \
     } \
   }
 
@@ -440,12 +456,12 @@ static int dxf_check_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
 // reads data of the type indicated by 'type' 'size' times and stores
 // it all in the vector called 'name'.
 #define FIELD_VECTOR_N(name, type, size, dxf)\
-  if (dxf)\
+  if (dxf && _obj->name)\
     {\
       for (vcount=0; vcount < (BITCODE_BL)size; vcount++)\
         {\
-          sscanf((char*)&dat->chain[dat->byte], #name ": " FORMAT_##type ",\n", \
-                 &_obj->name[vcount]);\
+          if (dxf_read_pair(dat, &pair) && pair.code == dxf) \
+            _obj->name[vcount] = (BITCODE_##type)dxf_pair_double(&pair); \
         }\
     }
 
@@ -501,651 +517,849 @@ static int dxf_check_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
 
 #define FIELD_XDATA(name, size)
 
-#define REACTORS(code)\
-  pair = dxf_read_pair(dat); \
-  if (dxf_check_code(dat, pair, 102)) { /* {ACAD_REACTORS */ \
-    dxf_free_pair(pair); vcount = 0; \
-    while (dxf_check_code(dat, pair, 330)) { \
-      vcount++; obj->tio.object->num_reactors++; \
-      VALUE_HANDLE(obj->tio.object->reactors[vcount], code, 330); \
-    } \
-    dxf_check_code(dat, pair, 102); \
-  }
-
-#define ENT_REACTORS(code)\
-  pair = dxf_read_code(dat); \
-  if (dxf_check_code(dat, pair, 102)) { /* {ACAD_REACTORS */ \
-    dxf_free_pair(pair); vcount = 0; \
-    while (dxf_check_code(dat, pair, 330)) { \
-      vcount++; _obj->num_reactors++; \
-      VALUE_HANDLE(obj->tio.entity->reactors[vcount], code, 330); \
-    } \
-    dxf_check_code(dat, pair, 102); \
-  }
+static uint32_t
+dxf_name_hash(const char *name)
+{
+  uint32_t h = 2166136261U; // FNV-1a
+  for (; *name; name++)
+    h = (h ^ (unsigned char)*name) * 16777619U;
+  return h;
+}
 
-#define XDICOBJHANDLE(code)
-#define ENT_XDICOBJHANDLE(code)
+/* Adds field i to the name table of reg. The first field of a name wins. */
+static void
+dxf_index_field(Dxf_Registry *restrict reg, int i)
+{
+  const unsigned int mask = reg->size_index - 1;
+  unsigned int h = dxf_name_hash(reg->fields[i].name) & mask;
+
+  while (reg->index[h]
+         && strcmp(reg->fields[reg->index[h] - 1].name, reg->fields[i].name))
+    h = (h + 1) & mask;
+  if (!reg->index[h])
+    reg->index[h] = i + 1;
+}
 
-#define COMMON_ENTITY_HANDLE_DATA \
-  SINCE(R_13) { \
-    error |= dxf_common_entity_handle_data(dat, obj); \
-  }
-#define SECTION_STRING_STREAM
-#define START_STRING_STREAM
-#define END_STRING_STREAM
-#define START_HANDLE_STREAM
-
-#define DWG_ENTITY(token) \
-static int \
-dwg_indxf_##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj) \
-{\
-  BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4; \
-  Dwg_Entity_##token *ent, *_obj;\
-  Bit_Chain *hdl_dat = dat;\
-  Dwg_Data* dwg = obj->parent;\
-  Dwg_Object_Entity *_ent;\
-  Dxf_Pair *pair; \
-  int error = 0;\
-  LOG_INFO("Entity " #token ":\n")\
-  _ent = obj->tio.entity;\
-  _obj = ent = _ent->tio.token;\
-  obj->fixedtype = DWG_TYPE_##token;\
-  LOG_TRACE("Entity handle: %d.%d.%lX\n",\
-    obj->handle.code,\
-    obj->handle.size,\
-    obj->handle.value)
-
-#define DWG_ENTITY_END return error; }
-
-#define DWG_OBJECT(token) \
-static int \
-dwg_indxf_ ##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj) \
-{ \
-  BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4;\
-  Bit_Chain *hdl_dat = dat;\
-  Dwg_Data* dwg = obj->parent;\
-  Dwg_Object_##token *_obj;\
-  Dxf_Pair *pair; \
-  int error = 0; \
-  obj->fixedtype = DWG_TYPE_##token;\
-  LOG_INFO("Object " #token ":\n")\
-  _obj = obj->tio.object->tio.token;\
-  LOG_TRACE("Object handle: %d.%d.%lX\n",\
-    obj->handle.code,\
-    obj->handle.size,\
-    obj->handle.value)
-
-#define DWG_OBJECT_END return error; }
-
-//TODO: we have only one obj per DXF context/section. simplify
-void dxf_add_field(Dwg_Object *restrict obj, const char *restrict name,
-                   const char *restrict type, int dxf)
+/* (Re)builds the name table of reg with size slots */
+static int
+dxf_index_fields(Dxf_Registry *restrict reg, unsigned int size)
 {
   int i;
-  Dxf_Objs *found = NULL;
+  int *index = calloc(size, sizeof(int));
+  if (!index)
+    return DWG_ERR_OUTOFMEM;
+  free(reg->index);
+  reg->index = index;
+  reg->size_index = size;
+  for (i = 0; i < reg->num_fields; i++)
+    dxf_index_field(reg, i);
+  return 0;
+}
+
+static void
+dxf_add_field(Dxf_Registry *restrict reg, const char *restrict name,
+              const char *restrict type, int dxf, void *restrict value,
+              size_t size)
+{
   Dxf_Field *field;
 
-  //array of [obj -> [fields], ...]
-  if (num_dxf_objs >= size_dxf_objs)
+  if (reg->num_fields >= reg->size_fields)
     {
-      size_dxf_objs += 1000;
-      dxf_objs = realloc(dxf_objs, size_dxf_objs*sizeof(Dxf_Objs));
-      memset(&dxf_objs[num_dxf_objs], 0, 1000*sizeof(Dxf_Objs));
+      Dxf_Field *fields = realloc(reg->fields, (reg->size_fields + 64)
+                                                 * sizeof(Dxf_Field));
+      if (!fields)
+        return;
+      reg->fields = fields;
+      reg->size_fields += 64;
     }
-  //search obj ptr in array
-  for (i=0; i<num_dxf_objs; i++)
+  // keep the table at most half full
+  if (2 * (unsigned int)(reg->num_fields + 1) > reg->size_index
+      && dxf_index_fields(reg, reg->size_index ? 2 * reg->size_index : 512))
+    return;
+
+  field = &reg->fields[reg->num_fields];
+  field->name = name;
+  field->type = type;
+  field->dxf = dxf;
+  field->value = value;
+  field->size = size;
+  dxf_index_field(reg, reg->num_fields);
+  reg->num_fields++;
+}
+
+static Dxf_Field *
+dxf_search_field(const Dxf_Registry *restrict reg, const char *restrict name)
+{
+  unsigned int mask, h;
+
+  if (!reg->num_fields)
+    return NULL;
+  mask = reg->size_index - 1;
+  for (h = dxf_name_hash(name) & mask; reg->index[h]; h = (h + 1) & mask)
+    if (!strcmp(reg->fields[reg->index[h] - 1].name, name))
+      return &reg->fields[reg->index[h] - 1];
+  return NULL;
+}
+
+/* Releases the registry, which is then empty */
+static void
+dxf_free_fields(Dxf_Registry *restrict reg)
+{
+  free(reg->fields);
+  free(reg->index);
+  memset(reg, 0, sizeof(Dxf_Registry));
+}
+
+/* Assigns the value of pair to the header variable of field, by the size of
+   the variable. Only reals go into doubles, and only integers into the
+   others. */
+static void
+dxf_set_field(const Dxf_Field *restrict field, const Dxf_Pair *restrict pair)
+{
+  const int is_double = !strcmp(field->type, "RD")
+                        || !strcmp(field->type, "BD");
+  long l;
+
+  if (pair->type == VT_REAL || pair->type == VT_POINT3D)
     {
-      if (dxf_objs[i].obj == obj)
+      if (is_double && field->size == sizeof(double))
         {
-          found = &dxf_objs[i];
-          break;
+          *(double *)field->value = dxf_pair_double(pair);
+          return;
         }
     }
-  if (!found) // new object (first field)
-    {
-      found = &dxf_objs[num_dxf_objs];
-      found->obj = obj;
-      found->num_fields = 1;
-      found->size_fields = 16;
-      found->fields = (Dxf_Field*)calloc(16, sizeof(Dxf_Field));
-      num_dxf_objs++;
-    }
-  /*if (!found->fields)
+  else if (!is_double
+           && (pair->type == VT_INT8 || pair->type == VT_INT16
+               || pair->type == VT_INT32 || pair->type == VT_BOOL))
     {
-      found->num_fields = 1;
-      found->size_fields = 16;
-      found->fields = calloc(found->size_fields, sizeof(Dxf_Field));
-    }
-    else */
-  if (found->num_fields > found->size_fields)
-    {
-      found->size_fields += 16;
-      found->fields = realloc(found->fields, found->size_fields*sizeof(Dxf_Field));
-      memset(&found->fields[found->num_fields], 0, 16*sizeof(Dxf_Field));
+      l = dxf_pair_long(pair);
+      switch (field->size)
+        {
+        case 1:
+          *(BITCODE_RC *)field->value = (BITCODE_RC)l;
+          return;
+        case 2:
+          *(BITCODE_RS *)field->value = (BITCODE_RS)l;
+          return;
+        case 4:
+          *(BITCODE_RL *)field->value = (BITCODE_RL)l;
+          return;
+        case 8:
+          *(BITCODE_RLL *)field->value = (BITCODE_RLL)l;
+          return;
+        default:
+          break;
+        }
     }
+  LOG_WARN("Invalid DXF header variable %s %s[%d]: %.*s", field->name,
+           field->type, pair->code, (int)pair->len, pair->value)
+}
 
-  // fill the new field
-  field = &found->fields[found->num_fields];
-  field->name = malloc(strlen(name)+1);
-  strcpy(field->name, (char*)name);
-  field->type = malloc(strlen(type)+1);
-  strcpy(field->type, (char*)type);
-  field->dxf = dxf;
-  found->num_fields++;
+/* Skips the groups up to 0 ENDSEC */
+static void
+dxf_skip_section (Bit_Chain *restrict dat)
+{
+  Dxf_Pair pair;
+  while (dxf_read_pair(dat, &pair))
+    if (pair.code == 0 && dxf_pair_is(&pair, "ENDSEC"))
+      return;
+}
+
+/* registers the header fields of the spec for version in reg. With nothing
+   to read, all the groups fail and only the fields are defined
+   (unordered). */
+static int
+dxf_header_fields(Dxf_Registry *restrict reg, Dwg_Version_Type version,
+                  Dwg_Data *restrict dwg)
+{
+  Bit_Chain empty = { 0 };
+  Bit_Chain *dat = &empty;
+  Dwg_Header_Variables* _obj = &dwg->header_vars;
+  Dwg_Object* obj = NULL;
+  const int minimal = dwg->opts & 0x10;
+  double ms;
+  char* codepage;
+  Dxf_Pair pair;
+
+  empty.version = version;
+  empty.from_version = version;
+  #include "header_variables_dxf.spec"
+
+  return 0;
 }
 
-//TODO: we have only one obj per DXF context/section. simplify
-Dxf_Field* dxf_search_field(Dwg_Object *restrict obj, const char *restrict name,
-                            const char *restrict type, int dxf)
+/* Assigns the header variables, each from the first group of its dxf code
+   after its 9 $NAME. */
+static int
+dxf_header_read(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 {
+  Dxf_Registry reg = { 0 }; // of this header only
+  Dwg_Version_Type version = dat->version;
+  Dxf_Pair pair;
+  Dxf_Field *field = NULL;
+  char name[80];
   int i;
-  Dxf_Objs *found = NULL;
 
-  // first search obj ptr in array
-  for (i=0; i<num_dxf_objs; i++)
+  // 9 $NAME and its value groups, up to 0 ENDSEC
+  while (dxf_read_pair(dat, &pair) && pair.code != 0)
     {
-      if (dxf_objs[i].obj == obj)
+      if (pair.code != 9)
         {
-          found = &dxf_objs[i];
-          break;
+          if (field && field->value && pair.code == field->dxf)
+            {
+              dxf_set_field(field, &pair);
+              field = NULL;
+            }
+          continue;
+        }
+      field = NULL;
+      if (dxf_pair_is(&pair, "$ACADVER"))
+        {
+          // the fields of this version, as it comes first
+          if (!dxf_read_pair(dat, &pair) || pair.code == 0)
+            break;
+          for (i = 0; pair.code == 1 && i < R_AFTER; i++)
+            if (dxf_pair_is(&pair, version_codes[i]))
+              version = (Dwg_Version_Type)i;
+          continue;
+        }
+      if (dxf_pair_is(&pair, "$DWGCODEPAGE"))
+        {
+          if (!dxf_read_pair(dat, &pair) || pair.code == 0)
+            break;
+          // TODO: convert all DWGCODEPAGE strings to header.codepage
+          if (pair.code == 3 && dxf_pair_is(&pair, "ANSI_1252"))
+            dwg->header.codepage = 30;
+          continue;
+        }
+      if (!reg.num_fields)
+        dxf_header_fields(&reg, version, dwg);
+      if (pair.len > 1 && pair.len <= sizeof(name) && pair.value[0] == '$')
+        {
+          memcpy(name, &pair.value[1], pair.len - 1);
+          name[pair.len - 1] = '\0';
+          field = dxf_search_field(&reg, name);
+          if (field)
+            LOG_HANDLE("%s: %s %d\n", field->name, field->type, field->dxf)
         }
     }
-  if (!found)
-    {
-      LOG_ERROR("obj not found\n");
-      return NULL;
+  dxf_free_fields(&reg);
+  return 0;
+}
+
+static int
+dxf_classes_read (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+{
+  BITCODE_BL i;
+  Dxf_Pair pair;
+  Dwg_Class *klass = NULL;
+
+  // 0 CLASS and its groups, up to 0 ENDSEC
+  while (dxf_read_pair(dat, &pair)) {
+    if (pair.code == 0) {
+      if (dxf_pair_is(&pair, "ENDSEC"))
+        return 0;
+      if (!dxf_pair_is(&pair, "CLASS")) {
+        LOG_ERROR("Unexpected DXF 0 %.*s at class[%u]", (int)pair.len,
+                  pair.value, dwg->num_classes)
+        return DWG_ERR_CLASSESNOTFOUND;
+      }
+      // add class (see decode)
+      i = dwg->num_classes;
+      klass = realloc(dwg->dwg_class, (i + 1) * sizeof(Dwg_Class));
+      if (!klass) { LOG_ERROR("Out of memory"); return DWG_ERR_OUTOFMEM; }
+      dwg->dwg_class = klass;
+      klass = &dwg->dwg_class[i];
+      memset(klass, 0, sizeof(Dwg_Class));
+      klass->number = 500 + i;
+      dwg->num_classes++;
+      continue;
     }
-  // then search field
-  for (i=0; i<found->num_fields; i++)
-    {
-      if (!strcmp(found->fields[i].name, name))
-        return &found->fields[i];
+    if (!klass) {
+      LOG_ERROR("Unexpected DXF %d before CLASS", pair.code)
+      return DWG_ERR_CLASSESNOTFOUND;
     }
-  return NULL;
+    switch (pair.code) {
+    case 1: klass->dxfname = dxf_pair_strdup(&pair); break;
+    case 2: klass->cppname = dxf_pair_strdup(&pair); break;
+    case 3: klass->appname = dxf_pair_strdup(&pair); break;
+    case 90: klass->proxyflag = (BITCODE_BS)dxf_pair_long(&pair); break;
+    case 91: klass->num_instances = (BITCODE_BL)dxf_pair_long(&pair); break;
+    case 280: klass->wasazombie = (BITCODE_B)dxf_pair_long(&pair); break;
+    case 281: klass->item_class_id = dxf_pair_long(&pair) ? 0x1f3 : 0x1f2;
+              break;
+    default: LOG_WARN("Unknown DXF code for class[%u].%d",
+                      dwg->num_classes - 1, pair.code);
+             break;
+    }
+  }
+  return 0;
 }
 
 static int
-dxf_common_entity_handle_data(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
+dxf_tables_read (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 {
-  (void)dat; (void)obj;
+  (void)dwg;
+  // TABLE VPORT ... ENDTAB
+  dxf_skip_section(dat);
   return 0;
 }
 
-#include "dwg.spec"
-
-/* returns 0 if object was handled,
-   DWG_ERR_UNHANDLEDCLASS or some other error otherwise
- */
 static int
-dwg_indxf_variable_type(Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
-                        Dwg_Object *restrict obj)
+dxf_blocks_read (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 {
-  int i;
-  Dwg_Class *klass;
-  int is_entity;
-
-  i = obj->type - 500;
-  if (i < 0 || i >= dwg->num_classes)
-    return DWG_ERR_INVALIDTYPE;
+  (void)dwg;
+  dxf_skip_section(dat);
+  return 0;
+}
 
-  klass = &dwg->dwg_class[i];
-  if (!klass || ! klass->dxfname)
-    return DWG_ERR_INTERNALERROR;
-  // almost always false
-  is_entity = dwg_class_is_entity(klass);
+/* The types of the ENTITIES and OBJECTS records with a parser below.
+   The records of all other types are still skipped. */
+typedef struct _dxf_type {
+  const char *name;
+  int (*add)(Dwg_Object *obj);
+  unsigned int type;
+} Dxf_Type;
+
+#define DXF_TYPE(token) { #token, dwg_add_##token, DWG_TYPE_##token }
+static const Dxf_Type dxf_types[] = {
+  DXF_TYPE(LINE),
+  DXF_TYPE(POINT),
+  DXF_TYPE(CIRCLE),
+  DXF_TYPE(ARC),
+  DXF_TYPE(ELLIPSE),
+  DXF_TYPE(RAY),
+  DXF_TYPE(XLINE),
+  DXF_TYPE(DICTIONARY),
+};
+#undef DXF_TYPE
+
+/* One record: the byte range of its groups after 0 TYPE, and the
+   dwg->object slot they are parsed into. */
+typedef struct _dxf_record {
+  unsigned long start;
+  unsigned long end;
+  BITCODE_BL index;
+  int has_layer; // 8 LAYER. Not imported, as the TABLES are skipped
+} Dxf_Record;
+
+/* records per parallel task */
+#define DXF_CHUNK_RECORDS 512
+
+static const Dxf_Type *
+dxf_find_type(const Dxf_Pair *pair)
+{
+  size_t i;
+  for (i = 0; i < sizeof(dxf_types) / sizeof(dxf_types[0]); i++)
+    if (dxf_pair_is(pair, dxf_types[i].name))
+      return &dxf_types[i];
+  return NULL;
+}
 
-  #include "classes.inc"
+/* Sets the absolute handle and its size in bytes */
+static void
+dxf_pair_H(const Dxf_Pair *restrict pair, Dwg_Handle *restrict handle)
+{
+  unsigned long value = dxf_pair_handle(pair);
+  handle->value = value;
+  for (handle->size = 0; value; value >>= 8)
+    handle->size++;
+}
 
-  return DWG_ERR_UNHANDLEDCLASS;
+/* A new ref of the handle, to be registered in dwg->object_ref.
+   NULL for the null handle. */
+static Dwg_Object_Ref *
+dxf_pair_ref(const Dxf_Pair *pair, const unsigned int code)
+{
+  Dwg_Handle handle;
+  Dwg_Object_Ref *ref;
+
+  dxf_pair_H(pair, &handle);
+  if (!handle.value)
+    return NULL;
+  ref = calloc(1, sizeof(Dwg_Object_Ref));
+  if (!ref)
+    {
+      LOG_ERROR("Out of memory");
+      return NULL;
+    }
+  ref->handleref = handle;
+  ref->handleref.code = code;
+  ref->absolute_ref = handle.value;
+  return ref;
 }
 
+/* Sets the x, y or z of pt from the groups dxf, dxf+10 or dxf+20 */
 static int
-dwg_indxf_object(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
+dxf_pair_3bd(const Dxf_Pair *restrict pair, const int dxf,
+             BITCODE_3BD *restrict pt)
 {
-  int error = 0;
-  if (!obj || !obj->parent)
-    return DWG_ERR_INTERNALERROR;
+  if (pair->code == dxf)
+    pt->x = dxf_pair_double(pair);
+  else if (pair->code == dxf + 10)
+    pt->y = dxf_pair_double(pair);
+  else if (pair->code == dxf + 20)
+    pt->z = dxf_pair_double(pair);
+  else
+    return 0;
+  return 1;
+}
 
+/* DXF angles are in degrees, but for ELLIPSE */
+static double
+dxf_pair_angle(const Dxf_Pair *pair)
+{
+  return dxf_pair_double(pair) * M_PI_2 / 90.0;
+}
+
+static void
+dxf_entity_defaults(Dwg_Object *restrict obj)
+{
+  Dwg_Object_Entity *ent = obj->tio.entity;
+  BITCODE_BE *extrusion = NULL;
+
+  ent->entity_mode = 2;
+  ent->color.index = 256; // BYLAYER
+  ent->linetype_scale = 1.0;
+  switch (obj->type)
+    {
+    case DWG_TYPE_LINE: extrusion = &ent->tio.LINE->extrusion; break;
+    case DWG_TYPE_POINT: extrusion = &ent->tio.POINT->extrusion; break;
+    case DWG_TYPE_CIRCLE: extrusion = &ent->tio.CIRCLE->extrusion; break;
+    case DWG_TYPE_ARC: extrusion = &ent->tio.ARC->extrusion; break;
+    case DWG_TYPE_ELLIPSE:
+      extrusion = &ent->tio.ELLIPSE->extrusion;
+      ent->tio.ELLIPSE->axis_ratio = 1.0;
+      ent->tio.ELLIPSE->end_angle = 4 * M_PI_2;
+      break;
+    default: break;
+    }
+  if (extrusion)
+    extrusion->z = 1.0;
+}
+
+static void
+dxf_entity_field(Dwg_Object *restrict obj, const Dxf_Pair *restrict pair)
+{
+  Dwg_Object_Entity *ent = obj->tio.entity;
+
+  switch (pair->code)
+    {
+    case 48: ent->linetype_scale = dxf_pair_double(pair); return;
+    case 60: ent->invisible = (BITCODE_BS)dxf_pair_long(pair); return;
+    case 62: ent->color.index = (BITCODE_BS)dxf_pair_long(pair); return;
+    case 67: ent->entity_mode = dxf_pair_long(pair) ? 1 : 2; return;
+    default: break;
+    }
   switch (obj->type)
     {
-    case DWG_TYPE_TEXT:
-      return dwg_indxf_TEXT(dat, obj);
-    case DWG_TYPE_ATTRIB:
-      return dwg_indxf_ATTRIB(dat, obj);
-    case DWG_TYPE_ATTDEF:
-      return dwg_indxf_ATTDEF(dat, obj);
-    case DWG_TYPE_BLOCK:
-      return dwg_indxf_BLOCK(dat, obj);
-    case DWG_TYPE_ENDBLK:
-      return dwg_indxf_ENDBLK(dat, obj);
-    case DWG_TYPE_SEQEND:
-      return dwg_indxf_SEQEND(dat, obj);
-    case DWG_TYPE_INSERT:
-      return dwg_indxf_INSERT(dat, obj);
-    case DWG_TYPE_MINSERT:
-      return dwg_indxf_MINSERT(dat, obj);
-    case DWG_TYPE_VERTEX_2D:
-      return dwg_indxf_VERTEX_2D(dat, obj);
-    case DWG_TYPE_VERTEX_3D:
-      return dwg_indxf_VERTEX_3D(dat, obj);
-    case DWG_TYPE_VERTEX_MESH:
-      return dwg_indxf_VERTEX_MESH(dat, obj);
-    case DWG_TYPE_VERTEX_PFACE:
-      return dwg_indxf_VERTEX_PFACE(dat, obj);
-    case DWG_TYPE_VERTEX_PFACE_FACE:
-      return dwg_indxf_VERTEX_PFACE_FACE(dat, obj);
-    case DWG_TYPE_POLYLINE_2D:
-      return dwg_indxf_POLYLINE_2D(dat, obj);
-    case DWG_TYPE_POLYLINE_3D:
-      return dwg_indxf_POLYLINE_3D(dat, obj);
-    case DWG_TYPE_ARC:
-      return dwg_indxf_ARC(dat, obj);
-    case DWG_TYPE_CIRCLE:
-      return dwg_indxf_CIRCLE(dat, obj);
     case DWG_TYPE_LINE:
-      return dwg_indxf_LINE(dat, obj);
-    case DWG_TYPE_DIMENSION_ORDINATE:
-      return dwg_indxf_DIMENSION_ORDINATE(dat, obj);
-    case DWG_TYPE_DIMENSION_LINEAR:
-      return dwg_indxf_DIMENSION_LINEAR(dat, obj);
-    case DWG_TYPE_DIMENSION_ALIGNED:
-      return dwg_indxf_DIMENSION_ALIGNED(dat, obj);
-    case DWG_TYPE_DIMENSION_ANG3PT:
-      return dwg_indxf_DIMENSION_ANG3PT(dat, obj);
-    case DWG_TYPE_DIMENSION_ANG2LN:
-      return dwg_indxf_DIMENSION_ANG2LN(dat, obj);
-    case DWG_TYPE_DIMENSION_RADIUS:
-      return dwg_indxf_DIMENSION_RADIUS(dat, obj);
-    case DWG_TYPE_DIMENSION_DIAMETER:
-      return dwg_indxf_DIMENSION_DIAMETER(dat, obj);
+      {
+        Dwg_Entity_LINE *_obj = ent->tio.LINE;
+        if (!dxf_pair_3bd(pair, 10, &_obj->start)
+            && !dxf_pair_3bd(pair, 11, &_obj->end)
+            && !dxf_pair_3bd(pair, 210, &_obj->extrusion)
+            && pair->code == 39)
+          _obj->thickness = dxf_pair_double(pair);
+      }
+      break;
     case DWG_TYPE_POINT:
-      return dwg_indxf_POINT(dat, obj);
-    case DWG_TYPE__3DFACE:
-      return dwg_indxf__3DFACE(dat, obj);
-    case DWG_TYPE_POLYLINE_PFACE:
-      return dwg_indxf_POLYLINE_PFACE(dat, obj);
-    case DWG_TYPE_POLYLINE_MESH:
-      return dwg_indxf_POLYLINE_MESH(dat, obj);
-    case DWG_TYPE_SOLID:
-      return dwg_indxf_SOLID(dat, obj);
-    case DWG_TYPE_TRACE:
-      return dwg_indxf_TRACE(dat, obj);
-    case DWG_TYPE_SHAPE:
-      return dwg_indxf_SHAPE(dat, obj);
-    case DWG_TYPE_VIEWPORT:
-      return dwg_indxf_VIEWPORT(dat, obj);
+      {
+        Dwg_Entity_POINT *_obj = ent->tio.POINT;
+        if (pair->code == 10) _obj->x = dxf_pair_double(pair);
+        else if (pair->code == 20) _obj->y = dxf_pair_double(pair);
+        else if (pair->code == 30) _obj->z = dxf_pair_double(pair);
+        else if (pair->code == 39) _obj->thickness = dxf_pair_double(pair);
+        else if (pair->code == 50) _obj->x_ang = dxf_pair_angle(pair);
+        else dxf_pair_3bd(pair, 210, &_obj->extrusion);
+      }
+      break;
+    case DWG_TYPE_CIRCLE:
+      {
+        Dwg_Entity_CIRCLE *_obj = ent->tio.CIRCLE;
+        if (pair->code == 40) _obj->radius = dxf_pair_double(pair);
+        else if (pair->code == 39) _obj->thickness = dxf_pair_double(pair);
+        else if (!dxf_pair_3bd(pair, 10, &_obj->center))
+          dxf_pair_3bd(pair, 210, &_obj->extrusion);
+      }
+      break;
+    case DWG_TYPE_ARC:
+      {
+        Dwg_Entity_ARC *_obj = ent->tio.ARC;
+        if (pair->code == 40) _obj->radius = dxf_pair_double(pair);
+        else if (pair->code == 39) _obj->thickness = dxf_pair_double(pair);
+        else if (pair->code == 50) _obj->start_angle = dxf_pair_angle(pair);
+        else if (pair->code == 51) _obj->end_angle = dxf_pair_angle(pair);
+        else if (!dxf_pair_3bd(pair, 10, &_obj->center))
+          dxf_pair_3bd(pair, 210, &_obj->extrusion);
+      }
+      break;
     case DWG_TYPE_ELLIPSE:
-      return dwg_indxf_ELLIPSE(dat, obj);
-    case DWG_TYPE_SPLINE:
-      return dwg_indxf_SPLINE(dat, obj);
-    case DWG_TYPE_REGION:
-      return dwg_indxf_REGION(dat, obj);
-    case DWG_TYPE__3DSOLID:
-      return dwg_indxf__3DSOLID(dat, obj);
-    case DWG_TYPE_BODY:
-      return dwg_indxf_BODY(dat, obj);
+      {
+        Dwg_Entity_ELLIPSE *_obj = ent->tio.ELLIPSE;
+        if (pair->code == 40) _obj->axis_ratio = dxf_pair_double(pair);
+        else if (pair->code == 41) _obj->start_angle = dxf_pair_double(pair);
+        else if (pair->code == 42) _obj->end_angle = dxf_pair_double(pair);
+        else if (!dxf_pair_3bd(pair, 10, &_obj->center)
+                 && !dxf_pair_3bd(pair, 11, &_obj->sm_axis))
+          dxf_pair_3bd(pair, 210, &_obj->extrusion);
+      }
+      break;
     case DWG_TYPE_RAY:
-      return dwg_indxf_RAY(dat, obj);
     case DWG_TYPE_XLINE:
-      return dwg_indxf_XLINE(dat, obj);
-    case DWG_TYPE_DICTIONARY:
-      return dwg_indxf_DICTIONARY(dat, obj);
-    case DWG_TYPE_MTEXT:
-      return dwg_indxf_MTEXT(dat, obj);
-    case DWG_TYPE_LEADER:
-      return dwg_indxf_LEADER(dat, obj);
-    case DWG_TYPE_TOLERANCE:
-      return dwg_indxf_TOLERANCE(dat, obj);
-    case DWG_TYPE_MLINE:
-      return dwg_indxf_MLINE(dat, obj);
-    case DWG_TYPE_BLOCK_CONTROL:
-      return dwg_indxf_BLOCK_CONTROL(dat, obj);
-    case DWG_TYPE_BLOCK_HEADER:
-      return dwg_indxf_BLOCK_HEADER(dat, obj);
-    case DWG_TYPE_LAYER_CONTROL:
-      return dwg_indxf_LAYER_CONTROL(dat, obj);
-    case DWG_TYPE_LAYER:
-      return dwg_indxf_LAYER(dat, obj);
-    case DWG_TYPE_STYLE_CONTROL:
-      return dwg_indxf_STYLE_CONTROL(dat, obj);
-    case DWG_TYPE_STYLE:
-      return dwg_indxf_STYLE(dat, obj);
-    case DWG_TYPE_LTYPE_CONTROL:
-      return dwg_indxf_LTYPE_CONTROL(dat, obj);
-    case DWG_TYPE_LTYPE:
-      return dwg_indxf_LTYPE(dat, obj);
-    case DWG_TYPE_VIEW_CONTROL:
-      return dwg_indxf_VIEW_CONTROL(dat, obj);
-    case DWG_TYPE_VIEW:
-      return dwg_indxf_VIEW(dat, obj);
-    case DWG_TYPE_UCS_CONTROL:
-      return dwg_indxf_UCS_CONTROL(dat, obj);
-    case DWG_TYPE_UCS:
-      return dwg_indxf_UCS(dat, obj);
-    case DWG_TYPE_VPORT_CONTROL:
-      return dwg_indxf_VPORT_CONTROL(dat, obj);
-    case DWG_TYPE_VPORT:
-      return dwg_indxf_VPORT(dat, obj);
-    case DWG_TYPE_APPID_CONTROL:
-      return dwg_indxf_APPID_CONTROL(dat, obj);
-    case DWG_TYPE_APPID:
-      return dwg_indxf_APPID(dat, obj);
-    case DWG_TYPE_DIMSTYLE_CONTROL:
-      return dwg_indxf_DIMSTYLE_CONTROL(dat, obj);
-    case DWG_TYPE_DIMSTYLE:
-      return dwg_indxf_DIMSTYLE(dat, obj);
-    case DWG_TYPE_VPORT_ENTITY_CONTROL:
-      return dwg_indxf_VPORT_ENTITY_CONTROL(dat, obj);
-    case DWG_TYPE_VPORT_ENTITY_HEADER:
-      return dwg_indxf_VPORT_ENTITY_HEADER(dat, obj);
-    case DWG_TYPE_GROUP:
-      return dwg_indxf_GROUP(dat, obj);
-    case DWG_TYPE_MLINESTYLE:
-      return dwg_indxf_MLINESTYLE(dat, obj);
-    case DWG_TYPE_OLE2FRAME:
-      return dwg_indxf_OLE2FRAME(dat, obj);
-    case DWG_TYPE_DUMMY:
-      return 0; //dwg_indxf_DUMMY(dat, obj);
-    case DWG_TYPE_LONG_TRANSACTION:
-      return dwg_indxf_LONG_TRANSACTION(dat, obj);
-    case DWG_TYPE_LWPOLYLINE:
-      return dwg_indxf_LWPOLYLINE(dat, obj);
-    case DWG_TYPE_HATCH:
-      return dwg_indxf_HATCH(dat, obj);
-    case DWG_TYPE_XRECORD:
-      return dwg_indxf_XRECORD(dat, obj);
-    case DWG_TYPE_PLACEHOLDER:
-      return dwg_indxf_PLACEHOLDER(dat, obj);
-    case DWG_TYPE_OLEFRAME:
-      return dwg_indxf_OLEFRAME(dat, obj);
-    case DWG_TYPE_VBA_PROJECT:
-      LOG_ERROR("Unhandled Object VBA_PROJECT. Has its own section\n");
-      //dwg_indxf_VBA_PROJECT(dat, obj);
-      return DWG_ERR_INVALIDTYPE;
-    case DWG_TYPE_LAYOUT:
-      return dwg_indxf_LAYOUT(dat, obj);
-    case DWG_TYPE_PROXY_ENTITY:
-      return dwg_indxf_PROXY_ENTITY(dat, obj);
-    case DWG_TYPE_PROXY_OBJECT:
-      return dwg_indxf_PROXY_OBJECT(dat, obj);
+      {
+        Dwg_Entity_RAY *_obj = ent->tio.RAY;
+        if (!dxf_pair_3bd(pair, 10, &_obj->point))
+          dxf_pair_3bd(pair, 11, &_obj->vector);
+      }
+      break;
     default:
-      if (obj->type == obj->parent->layout_number)
-        {
-          return dwg_indxf_LAYOUT(dat, obj);
-        }
-      /* > 500 */
-      if (DWG_ERR_UNHANDLEDCLASS &
-          (error = dwg_indxf_variable_type(obj->parent, dat, obj)))
-        {
-          Dwg_Data *dwg = obj->parent;
-          int is_entity;
-          int i = obj->type - 500;
-          Dwg_Class *klass = NULL;
-
-          if (i >= 0 && i < (int)dwg->num_classes)
-            {
-              klass = &dwg->dwg_class[i];
-              is_entity = dwg_class_is_entity(klass);
-            }
-          // properly dwg_decode_object/_entity for eed, reactors, xdic
-          if (klass && !is_entity)
-            {
-              return error; //dwg_indxf_UNKNOWN_OBJ(dat, obj);
-            }
-          else if (klass)
-            {
-              return error; //dwg_indxf_UNKNOWN_ENT(dat, obj);
-            }
-          else // not a class
-            {
-              LOG_WARN("Unknown object, skipping eed/reactors/xdic");
-              SINCE(R_2000)
-                {
-                  LOG_INFO("Object bitsize: %u\n", obj->bitsize)
-                }
-              LOG_INFO("Object handle: %d.%d.%lX\n",
-                       obj->handle.code, obj->handle.size, obj->handle.value);
-            }
-        }
+      break;
     }
-  return error;
 }
 
-#define DXF_CHECK_ENDSEC \
-  if (dat->byte >= dat->size || pair->code == 0) \
-    return 0
-#define DXF_BREAK_ENDSEC \
-  if (dat->byte >= dat->size || \
-      (pair->code == 0 && !strcmp(pair->value.s, "ENDSEC"))) \
-    break
-#define DXF_RETURN_ENDSEC(what) \
-  if (dat->byte >= dat->size || \
-      (pair->code == 0 && !strcmp(pair->value.s, "ENDSEC"))) { \
-    dxf_free_pair(pair); \
-    return what; \
-  }
-
-static int dxf_expect_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
+static int
+dxf_object_field(Dwg_Object *restrict obj, const Dxf_Pair *restrict pair)
 {
-  while (pair->code != code)
+  switch (obj->type)
     {
-      dxf_free_pair(pair);
-      pair = dxf_read_pair(dat);
-      dxf_skip_comment(dat, pair);
-      DXF_CHECK_EOF;
-      if (pair->code != code) {
-        LOG_ERROR("Expecting DXF code %d, got %d (at %lu)",
-                  code, pair->code, dat->byte);
+    case DWG_TYPE_DICTIONARY:
+      {
+        Dwg_Object_DICTIONARY *_obj = obj->tio.object->tio.DICTIONARY;
+        const BITCODE_BL n = _obj->numitems;
+        if (pair->code == 3)
+          {
+            // the name, and then its 350 or 360 item
+            BITCODE_TV *text = realloc(_obj->text, (n + 1) * sizeof(BITCODE_TV));
+            BITCODE_H *items;
+            if (!text)
+              return DWG_ERR_OUTOFMEM;
+            _obj->text = text;
+            items = realloc(_obj->itemhandles, (n + 1) * sizeof(BITCODE_H));
+            if (!items)
+              return DWG_ERR_OUTOFMEM;
+            _obj->itemhandles = items;
+            text[n] = dxf_pair_strdup(pair);
+            items[n] = NULL;
+            _obj->numitems++;
+          }
+        else if ((pair->code == 350 || pair->code == 360) && n
+                 && !_obj->itemhandles[n - 1])
+          _obj->itemhandles[n - 1] = dxf_pair_ref(pair, 2);
+        else if (pair->code == 280)
+          _obj->hard_owner = (BITCODE_RC)dxf_pair_long(pair);
+        else if (pair->code == 281)
+          _obj->cloning = (BITCODE_BS)dxf_pair_long(pair);
       }
+      break;
+    default:
+      break;
     }
   return 0;
 }
 
+/* Parses the groups of one record into its pre-allocated object. Runs in
+   the workers, so it only writes to this object and its record. The new
+   refs are registered afterwards, in dxf_records_fixup. */
 static int
-dxf_header_read(Bit_Chain *dat, Dwg_Data* dwg)
+dxf_record_read(const Bit_Chain *restrict in, Dwg_Object *restrict obj,
+                Dxf_Record *restrict rec)
 {
-  Dwg_Header_Variables* _obj = &dwg->header_vars;
-  Dwg_Object* obj = NULL;
-  const int minimal = dwg->opts & 0x10;
-  double ms;
-  char* codepage;
-  Dxf_Pair *pair = dxf_read_pair(dat);
+  Bit_Chain dat = *in;
+  Dxf_Pair pair;
+  Dwg_Object_Ref *owner = NULL;
+  const int is_entity = obj->supertype == DWG_SUPERTYPE_ENTITY;
+  int in_app = 0; // within 102 {APPNAME ... 102 }
+  int error = 0;
 
-  // define fields (unordered)
-  #include "header_variables_dxf.spec"
+  dat.byte = rec->start;
+  dat.size = rec->end;
+  if (is_entity)
+    dxf_entity_defaults(obj);
+  while (dxf_read_pair(&dat, &pair))
+    {
+      if (pair.code == 102)
+        {
+          in_app = pair.len && pair.value[0] == '{';
+          continue;
+        }
+      //TODO the reactors and the xdictionary within
+      if (in_app)
+        continue;
+      if (pair.code == 5)
+        dxf_pair_H(&pair, &obj->handle);
+      else if (pair.code == 330)
+        {
+          if (!owner)
+            owner = dxf_pair_ref(&pair, 4);
+        }
+      else if (pair.code == 8 && is_entity)
+        rec->has_layer = 1;
+      else if (is_entity)
+        dxf_entity_field(obj, &pair);
+      else
+        error |= dxf_object_field(obj, &pair);
+    }
+  if (is_entity)
+    obj->tio.entity->subentity = owner;
+  else if (obj->type == DWG_TYPE_DICTIONARY)
+    obj->tio.object->tio.DICTIONARY->parenthandle = owner;
+  else
+    free(owner);
+  return error;
+}
 
-  while (pair->code != 0) {
-    pair = dxf_read_pair(dat);
-    DXF_BREAK_ENDSEC;
+/* Splits the ENTITIES or OBJECTS section at its 0 groups, up to 0 ENDSEC.
+   The objects of the known types are added here serially, so that the
+   workers only fill in their own pre-allocated slot. */
+static int
+dxf_records_split(Bit_Chain *restrict dat, Dwg_Data *restrict dwg,
+                  Dxf_Record **restrict recordsp, long *restrict num_recordsp)
+{
+  Dxf_Pair pair;
+  Dxf_Record *records = NULL;
+  Dxf_Record *rec = NULL; // the open record
+  long num_records = 0, size_records = 0;
+  long num_skipped = 0;
+  int error = 0;
 
-    //TODO find name in header struct and set value
+  for (;;)
+    {
+      const unsigned long pos = dat->byte;
+      const Dxf_Type *type;
+      Dwg_Object *obj;
 
-    dxf_free_pair(pair);
-  }
-  dxf_free_pair(pair);
+      if (!dxf_read_pair(dat, &pair))
+        {
+          if (rec)
+            rec->end = pos;
+          break;
+        }
+      if (pair.code != 0)
+        continue;
+      if (rec)
+        {
+          rec->end = pos;
+          rec = NULL;
+        }
+      if (dxf_pair_is(&pair, "ENDSEC"))
+        break;
+      type = dxf_find_type(&pair);
+      if (!type)
+        {
+          LOG_TRACE("Skip DXF 0 %.*s\n", (int)pair.len, pair.value)
+          num_skipped++;
+          continue;
+        }
+      if (num_records == size_records)
+        {
+          Dxf_Record *grown;
+          size_records = size_records ? 2 * size_records : 256;
+          grown = realloc(records, size_records * sizeof(Dxf_Record));
+          if (!grown)
+            {
+              LOG_ERROR("Out of memory");
+              error |= DWG_ERR_OUTOFMEM;
+              break;
+            }
+          records = grown;
+        }
+      // -1: dwg->object moved, which no ref points into yet
+      if (dwg_add_object(dwg) > 0)
+        {
+          LOG_ERROR("Out of memory");
+          error |= DWG_ERR_OUTOFMEM;
+          break;
+        }
+      obj = &dwg->object[dwg->num_objects - 1];
+      obj->type = type->type;
+      error |= type->add(obj);
+      if (error >= DWG_ERR_CRITICAL)
+        break;
+      rec = &records[num_records++];
+      rec->index = obj->index;
+      rec->start = dat->byte;
+      rec->end = dat->byte;
+      rec->has_layer = 0;
+    }
+  if (num_skipped)
+    LOG_WARN("Skipped %ld DXF records of unsupported types", num_skipped)
+  *recordsp = records;
+  *num_recordsp = num_records;
+  return error;
+}
 
-  // TODO: convert DWGCODEPAGE string to header.codepage number
-  if (!strcmp(_obj->DWGCODEPAGE, "ANSI_1252"))
-      dwg->header.codepage = 30;
+/* Parses the records. With dwg->num_threads, fixed chunks of records are
+   parsed in parallel, each into its own objects. */
+static int
+dxf_records_read(const Bit_Chain *restrict dat, Dwg_Data *restrict dwg,
+                 Dxf_Record *restrict records, const long num_records)
+{
+  int error = 0;
+  long i;
 
-  return 0;
+#ifdef _OPENMP
+  const long num_chunks
+      = (num_records + DXF_CHUNK_RECORDS - 1) / DXF_CHUNK_RECORDS;
+  if (dwg->num_threads > 1 && num_chunks > 1)
+    {
+      long c;
+#pragma omp parallel for schedule(dynamic) reduction(|:error) \
+    num_threads(dwg->num_threads)
+      for (c = 0; c < num_chunks; c++)
+        {
+          long j = c * DXF_CHUNK_RECORDS;
+          long to = j + DXF_CHUNK_RECORDS;
+          if (to > num_records)
+            to = num_records;
+          for (; j < to; j++)
+            error |= dxf_record_read(dat, &dwg->object[records[j].index],
+                                     &records[j]);
+        }
+      return error;
+    }
+#endif
+  for (i = 0; i < num_records; i++)
+    error |= dxf_record_read(dat, &dwg->object[records[i].index], &records[i]);
+  return error;
 }
 
 static int
-dxf_classes_read (Bit_Chain *dat, Dwg_Data * dwg)
+dxf_add_ref(Dwg_Data *restrict dwg, Dwg_Object_Ref *restrict ref)
 {
-  BITCODE_BL i;
-  Dxf_Pair *pair = dxf_read_pair(dat);
-  Dwg_Class *klass;
-
-  while (1) { // read next class
-    // add class (see decode)
-    i = dwg->num_classes;
-    if (i == 0)
-      dwg->dwg_class = malloc(sizeof(Dwg_Class));
-    else
-      dwg->dwg_class = realloc(dwg->dwg_class, (i + 1) * sizeof(Dwg_Class));
-    if (!dwg->dwg_class) { LOG_ERROR("Out of memory"); return DWG_ERR_OUTOFMEM; }
-
-    klass = &dwg->dwg_class[i];
-    memset(klass, 0, sizeof(Dwg_Class));
-
-    while (pair->code != 0) { // read until next 0 CLASS
-      pair = dxf_read_pair(dat);
-      switch (pair->code) {
-      case 1: STRADD(klass->dxfname, pair->value.s); break;
-      case 2: STRADD(klass->cppname, pair->value.s); break;
-      case 3: STRADD(klass->appname, pair->value.s); break;
-      case 90: klass->proxyflag = pair->value.l; break;
-      case 91: klass->num_instances = pair->value.l; break;
-      case 280: klass->wasazombie = (BITCODE_B)pair->value.i; break;
-      case 281: klass->item_class_id = pair->value.i ? 0x1f3 : 0x1f2; break;
-      default: LOG_WARN("Unknown DXF code for class[%d].%d", i, pair->code);
-               break;
-      }
-      dxf_free_pair(pair);
-    }
-    DXF_RETURN_ENDSEC(0); // next class or ENDSEC
-    if (strcmp(pair->value.s, "CLASS")) { // or something else
-      LOG_ERROR("Unexpexted DXF 0 %s at class[%d]", pair->value.s, i);
-      return DWG_ERR_CLASSESNOTFOUND;
-    }
-    dwg->num_classes++;
-  }
-  return 0;
+  return ref ? dwg_decode_add_object_ref(dwg, ref) : 0;
 }
 
+/* The serial pass after the workers: maps the handles of the new objects,
+   and registers their refs. These are resolved at the end of the DXF. */
 static int
-dxf_tables_read (Bit_Chain *dat, Dwg_Data * dwg)
+dxf_records_fixup(Dwg_Data *restrict dwg, const Dxf_Record *restrict records,
+                  const long num_records)
 {
-  (void)dwg;
+  int error = 0;
+  long i, num_layers = 0;
 
-  SECTION(TABLES);
-  TABLE(VPORT);
-  //...
-  ENDTAB();
-  ENDSEC();
-  return 0;
+  if (!dwg->object_map && num_records)
+    {
+      dwg->object_map = hash_new((uint32_t)num_records);
+      if (!dwg->object_map)
+        {
+          LOG_ERROR("Out of memory");
+          return DWG_ERR_OUTOFMEM;
+        }
+    }
+  for (i = 0; i < num_records; i++)
+    {
+      Dwg_Object *obj = &dwg->object[records[i].index];
+      if (obj->handle.value)
+        {
+          LOG_HANDLE("object_map{%lX} = %lu\n", obj->handle.value,
+                     (unsigned long)obj->index);
+          if (hash_set(dwg->object_map, (uint32_t)obj->handle.value,
+                       (uint32_t)obj->index))
+            dwg->refs_generation++;
+        }
+      num_layers += records[i].has_layer;
+      if (obj->supertype == DWG_SUPERTYPE_ENTITY)
+        error |= dxf_add_ref(dwg, obj->tio.entity->subentity);
+      else if (obj->type == DWG_TYPE_DICTIONARY)
+        {
+          Dwg_Object_DICTIONARY *_obj = obj->tio.object->tio.DICTIONARY;
+          BITCODE_BL j;
+          error |= dxf_add_ref(dwg, _obj->parenthandle);
+          for (j = 0; j < _obj->numitems; j++)
+            error |= dxf_add_ref(dwg, _obj->itemhandles[j]);
+        }
+    }
+  if (num_layers)
+    LOG_WARN("Skipped the layer of %ld DXF entities, the TABLES section is "
+             "not imported yet", num_layers)
+  return error;
 }
 
+/* The ENTITIES or OBJECTS section: split serially into records, parsed
+   in parallel, and then fixed up serially. */
 static int
-dxf_blocks_read (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxf_records_section(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 {
-  (void)dwg;
-
-  SECTION(BLOCKS);
-  //...
-  ENDSEC();
-  return 0;
+  Dxf_Record *records;
+  long num_records;
+  int error = dxf_records_split(dat, dwg, &records, &num_records);
+
+  if (error < DWG_ERR_CRITICAL)
+    error |= dxf_records_read(dat, dwg, records, num_records);
+  if (error < DWG_ERR_CRITICAL)
+    error |= dxf_records_fixup(dwg, records, num_records);
+  free(records);
+  return error;
 }
 
 static int
 dxf_entities_read (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 {
-  Dxf_Pair *pair;
-  Dwg_Object *obj = NULL;
-  (void)dwg;
-
-  SECTION(ENTITIES);
-  while (dat->byte < dat->size) {
-    pair = dxf_read_pair(dat);
-    dxf_expect_code(dat, pair, 0);
-    DXF_CHECK_EOF;
-    dwg_indxf_object(dat, obj); //TODO obj must be already created here
-  }
-  ENDSEC();
-  return 0;
+  // 0 TYPE and its groups, up to 0 ENDSEC
+  return dxf_records_section(dat, dwg);
 }
 
 static int
 dxf_objects_read (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 {
-  Dxf_Pair *pair;
-  Dwg_Object *obj = NULL;
-  (void)dwg;
-
-  SECTION(OBJECTS);
-  while (dat->byte < dat->size) {
-    pair = dxf_read_pair(dat);
-    dxf_expect_code(dat, pair, 0);
-    DXF_CHECK_EOF;
-    dwg_indxf_object(dat, obj); //TODO obj must be already created here
-  }
-  ENDSEC();
-  return 0;
+  // 0 TYPE and its groups, up to 0 ENDSEC
+  return dxf_records_section(dat, dwg);
 }
 
 static int
 dxf_preview_read (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 {
   (void)dwg;
-  SECTION(THUMBNAILIMAGE);
   //VALUE_RL(pic->size, 90);
   //VALUE_BINARY(pic->chain, pic->size, 310);
-  ENDSEC();
+  dxf_skip_section(dat);
   return 0;
 }
 
 int
 dwg_read_dxf(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 {
-  const int minimal = dwg->opts & 0x10;
-  Dxf_Pair *pair;
+  Dxf_Pair pair;
   //warn if minimal != 0
   //struct Dwg_Header *obj = &dwg->header;
   loglevel = dwg->opts & 0xf;
 
-  num_dxf_objs = 0;
-  size_dxf_objs = 1000;
-  dxf_objs = malloc(1000*sizeof(Dxf_Objs));
-
-  while (dat->byte < dat->size) {
-    pair = dxf_read_pair(dat);
-    dxf_expect_code(dat, pair, 0);
-    DXF_CHECK_EOF;
-    if (!strcmp(pair->value.s, "SECTION"))
+  // 0 SECTION 2 NAME, up to 0 EOF. Skip comments and anything else.
+  while (dxf_read_pair(dat, &pair)) {
+    if (pair.code != 0)
+      continue;
+    if (dxf_pair_is(&pair, "EOF"))
+      break;
+    if (!dxf_pair_is(&pair, "SECTION"))
+      continue;
+    if (!dxf_read_pair(dat, &pair) || pair.code != 2)
       {
-        dxf_free_pair(pair);
-        pair = dxf_read_pair(dat);
-        dxf_expect_code(dat, pair, 2);
-        DXF_CHECK_EOF;
-        if (!strcmp(pair->value.s, "HEADER"))
-          {
-            dxf_free_pair(pair);
-            dxf_header_read (dat, dwg);
-          }
-        else if (!strcmp(pair->value.s, "CLASSES"))
-          {
-            dxf_free_pair(pair);
-            dxf_classes_read (dat, dwg);
-          }
-        else if (!strcmp(pair->value.s, "TABLES"))
-          {
-            dxf_free_pair(pair);
-            dxf_tables_read (dat, dwg);
-          }
-        else if (!strcmp(pair->value.s, "BLOCKS"))
-          {
-            dxf_free_pair(pair);
-            dxf_blocks_read (dat, dwg);
-          }
-        else if (!strcmp(pair->value.s, "ENTITIES"))
-          {
-            dxf_free_pair(pair);
-            dxf_entities_read (dat, dwg);
-          }
-        else if (!strcmp(pair->value.s, "OBJECTS"))
-          {
-            dxf_free_pair(pair);
-            dxf_objects_read (dat, dwg);
-          }
-        if (!strcmp(pair->value.s, "THUMBNAIL"))
-          {
-            dxf_free_pair(pair);
-            dxf_preview_read (dat, dwg);
-          }
+        LOG_ERROR("Expecting DXF code 2, got %d (at %lu)", pair.code,
+                  dat->byte);
+        continue;
       }
+    if (dxf_pair_is(&pair, "HEADER"))
+      dxf_header_read (dat, dwg);
+    else if (dxf_pair_is(&pair, "CLASSES"))
+      dxf_classes_read (dat, dwg);
+    else if (dxf_pair_is(&pair, "TABLES"))
+      dxf_tables_read (dat, dwg);
+    else if (dxf_pair_is(&pair, "BLOCKS"))
+      dxf_blocks_read (dat, dwg);
+    else if (dxf_pair_is(&pair, "ENTITIES"))
+      dxf_entities_read (dat, dwg);
+    else if (dxf_pair_is(&pair, "OBJECTS"))
+      dxf_objects_read (dat, dwg);
+    else if (dxf_pair_is(&pair, "THUMBNAILIMAGE"))
+      dxf_preview_read (dat, dwg);
+    else
+      dxf_skip_section(dat);
   }
+  // the refs of all records, now that all handles are known
+  if (dwg->object_map && dwg->num_object_refs)
+    dwg_resolve_objectrefs_silent(dwg);
   return dwg->num_objects ? 1 : 0;
 }
 
@@ -52,10 +52,6 @@ typedef struct _dxf_pair {
   } value;
 } Dxf_Pair;
 
-static long num_dxf_objs;  // how many elements are added
-static long size_dxf_objs; // how many elements are allocated
-static Dxf_Objs* dxf_objs;
-
 //static inline void dxf_skip_ws(Bit_Chain *dat)
 //{
 //  for (; !dat->chain[dat->byte] || isspace(dat->chain[dat->byte]); dat->byte++) ;
@@ -202,8 +198,8 @@ static int dxf_check_code(Bit_Chain *dat, Dxf_Pair *pair, int code)
 #undef FORMAT_BD
 #define FORMAT_BD "%lf"
 
-// add the name/type/dxf combo to some structure for this element.
-#define FIELD(name,type,dxf) dxf_add_field(obj, #name, #type, dxf)
+// TODO: the binary header is not assigned yet, see dxf_header_read
+#define FIELD(name,type,dxf) {}
 #define FIELD_CAST(name,type,cast,dxf) FIELD(name,cast,dxf)
 #define FIELD_TRACE(name,type)
 #define VALUE_TV(value, dxf)  dxfb_read_string(dat, (char**)&value, 0)
@@ -989,10 +985,6 @@ dwg_read_dxfb(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   //struct Dwg_Header *obj = &dwg->header;
   loglevel = dwg->opts & 0xf;
 
-  num_dxf_objs = 0;
-  size_dxf_objs = 1000;
-  dxf_objs = malloc(1000*sizeof(Dxf_Objs));
-
   while (dat->byte < dat->size) {
     pair = dxf_read_pair(dat);
     dxf_expect_code(dat, pair, 0);
@@ -0,0 +1,417 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * numfmt.c: number formatting for the text writers, without stdio,
+ *           and parsing for the DXF reader, without sscanf.
+ *
+ * numfmt_fixed computes value * 10^prec exactly as m * 5^prec * 2^(e+prec)
+ * in 128-bit integers and rounds half to even, as glibc does in the
+ * default rounding mode. Values out of that range, inf and nan, and
+ * compilers without __int128 use snprintf.
+ *
+ * numfmt_parse_double converts a mantissa up to 2^53 with a power of ten
+ * up to 22 exactly with one multiplication or division, as both are exact
+ * doubles. Longer mantissas and larger exponents use strtod, with the '.'
+ * moved into the exponent, so that the locale does not matter.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+
+#include "numfmt.h"
+
+static const char digits2[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536"
+  "37383940414243444546474849505152535455565758596061626364656667686970717273"
+  "7475767778798081828384858687888990919293949596979899";
+
+/* Writes the decimal digits of u backwards, ending before end. Returns the
+   start. */
+static char *
+numfmt_u64_rev(char *end, uint64_t u)
+{
+  while (u >= 100)
+    {
+      const unsigned d = (unsigned)(u % 100) * 2;
+      u /= 100;
+      *--end = digits2[d + 1];
+      *--end = digits2[d];
+    }
+  if (u >= 10)
+    {
+      const unsigned d = (unsigned)u * 2;
+      *--end = digits2[d + 1];
+      *--end = digits2[d];
+    }
+  else
+    *--end = (char)('0' + u);
+  return end;
+}
+
+int
+numfmt_int(char *restrict buf, const long value, const int width)
+{
+  char tmp[24];
+  char *end = &tmp[sizeof(tmp)];
+  char *s;
+  int len, pad;
+
+  if (value < 0)
+    {
+      s = numfmt_u64_rev(end, (uint64_t)0 - (uint64_t)value);
+      *--s = '-';
+    }
+  else
+    s = numfmt_u64_rev(end, (uint64_t)value);
+  len = (int)(end - s);
+  pad = width > len ? width - len : 0;
+  memset(buf, ' ', pad);
+  memcpy(&buf[pad], s, len);
+  buf[pad + len] = '\0';
+  return pad + len;
+}
+
+int
+numfmt_hex(char *restrict buf, const unsigned long value)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  char tmp[20];
+  char *end = &tmp[sizeof(tmp)];
+  char *s = end;
+  unsigned long u = value;
+  int len;
+
+  do
+    {
+      *--s = hex[u & 0xf];
+      u >>= 4;
+    }
+  while (u);
+  len = (int)(end - s);
+  memcpy(buf, s, len);
+  buf[len] = '\0';
+  return len;
+}
+
+#ifdef __SIZEOF_INT128__
+
+typedef unsigned __int128 uint128_t;
+
+static const uint64_t powers5[] = {
+  1ULL, 5ULL, 25ULL, 125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL,
+  390625ULL, 1953125ULL, 9765625ULL, 48828125ULL, 244140625ULL,
+  1220703125ULL, 6103515625ULL, 30517578125ULL, 152587890625ULL,
+  762939453125ULL
+};
+static const uint64_t powers10[] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL
+};
+#  define NUMFMT_MAXPREC 17
+
+int
+numfmt_fixed(char *restrict buf, const double value, const int prec)
+{
+  union { double d; uint64_t u; } bits;
+  uint64_t m, ip, frac;
+  uint128_t n, q;
+  int e, shift;
+  char *p = buf;
+
+  bits.d = value;
+  e = (int)((bits.u >> 52) & 0x7ff);
+  m = bits.u & 0xfffffffffffffULL;
+  if (e == 0x7ff || prec < 0 || prec > NUMFMT_MAXPREC)
+    return snprintf(buf, NUMFMT_BUFSIZE, "%.*f", prec, value);
+  if (e)
+    m |= 1ULL << 52;
+  else
+    e = 1; // subnormal
+  e -= 1075; // value = m * 2^e
+
+  /* value * 10^prec = m * 5^prec * 2^(e + prec) */
+  n = (uint128_t)m * powers5[prec];
+  shift = e + prec;
+  if (shift >= 0)
+    {
+      if (shift >= 128 - 93) // 53 + 40 bits of n
+        return snprintf(buf, NUMFMT_BUFSIZE, "%.*f", prec, value);
+      q = n << shift;
+    }
+  else if (shift <= -128)
+    q = 0; // less than 1/2
+  else
+    {
+      const uint128_t half = (uint128_t)1 << (-shift - 1);
+      const uint128_t rem = n & ((half << 1) - 1);
+      q = n >> -shift;
+      if (rem > half || (rem == half && (q & 1)))
+        q++;
+    }
+  if (q >> 64)
+    {
+      const uint128_t ip128 = q / powers10[prec];
+      if (ip128 >> 64)
+        return snprintf(buf, NUMFMT_BUFSIZE, "%.*f", prec, value);
+      ip = (uint64_t)ip128;
+      frac = (uint64_t)(q - ip128 * powers10[prec]);
+    }
+  else
+    {
+      ip = (uint64_t)q / powers10[prec];
+      frac = (uint64_t)q - ip * powers10[prec];
+    }
+
+  if (bits.u >> 63)
+    *p++ = '-';
+  {
+    char tmp[24];
+    char *end = &tmp[sizeof(tmp)];
+    char *s = numfmt_u64_rev(end, ip);
+    memcpy(p, s, end - s);
+    p += end - s;
+  }
+  if (prec)
+    {
+      char *s;
+      *p++ = '.';
+      s = numfmt_u64_rev(p + prec, frac);
+      while (s > p) // leading zeros
+        *--s = '0';
+      p += prec;
+    }
+  *p = '\0';
+  return (int)(p - buf);
+}
+
+#else
+
+int
+numfmt_fixed(char *restrict buf, const double value, const int prec)
+{
+  return snprintf(buf, NUMFMT_BUFSIZE, "%.*f", prec, value);
+}
+
+#endif
+
+/* Parsing the DXF text values. Blanks around the number are skipped, the
+   rest of the field must be part of it. */
+
+static const char *
+numfmt_trim(const char *s, size_t *len)
+{
+  size_t n = *len;
+  while (n && (*s == ' ' || *s == '\t'))
+    {
+      s++;
+      n--;
+    }
+  while (n && (s[n - 1] == ' ' || s[n - 1] == '\t' || s[n - 1] == '\r'))
+    n--;
+  *len = n;
+  return s;
+}
+
+int
+numfmt_parse_long(const char *restrict s, size_t len, long *restrict value)
+{
+  unsigned long u = 0;
+  const unsigned long max = (unsigned long)LONG_MAX;
+  int neg = 0;
+  size_t i = 0;
+
+  s = numfmt_trim(s, &len);
+  if (len && (*s == '-' || *s == '+'))
+    {
+      neg = *s == '-';
+      i++;
+    }
+  if (i == len)
+    return 0;
+  for (; i < len; i++)
+    {
+      const unsigned d = (unsigned)(s[i] - '0');
+      if (d > 9 || u > (max - d) / 10)
+        return 0;
+      u = u * 10 + d;
+    }
+  *value = neg ? -(long)u : (long)u;
+  return 1;
+}
+
+int
+numfmt_parse_hex(const char *restrict s, size_t len,
+                 unsigned long *restrict value)
+{
+  unsigned long u = 0;
+  size_t i;
+
+  s = numfmt_trim(s, &len);
+  if (!len || len > 2 * sizeof(unsigned long))
+    return 0;
+  for (i = 0; i < len; i++)
+    {
+      const char c = s[i];
+      unsigned d;
+      if (c >= '0' && c <= '9')
+        d = (unsigned)(c - '0');
+      else if (c >= 'A' && c <= 'F')
+        d = (unsigned)(c - 'A' + 10);
+      else if (c >= 'a' && c <= 'f')
+        d = (unsigned)(c - 'a' + 10);
+      else
+        return 0;
+      u = (u << 4) | d;
+    }
+  *value = u;
+  return 1;
+}
+
+/* strtod on a NUL-terminated copy, for what the fast path does not take.
+   The '.' is removed and moved into the exponent, as strtod expects the
+   radix character of the locale, which is not '.' in every one. Any other
+   punctuation is rejected, so that the radix of the locale is not taken. */
+static int
+numfmt_parse_double_slow(const char *s, size_t len, double *value)
+{
+  char buf[160];
+  char *end;
+  const char *dot = memchr(s, '.', len);
+  size_t i;
+
+  if (!len || len >= 128)
+    return 0;
+  for (i = 0; i < len; i++)
+    if (!((s[i] >= '0' && s[i] <= '9') || (s[i] >= 'a' && s[i] <= 'z')
+          || (s[i] >= 'A' && s[i] <= 'Z') || s[i] == '.' || s[i] == '+'
+          || s[i] == '-'))
+      return 0;
+  if (dot)
+    {
+      const size_t pos = (size_t)(dot - s);
+      size_t expos;
+      long e = 0;
+
+      if (memchr(dot + 1, '.', len - pos - 1))
+        return 0;
+      for (expos = pos + 1; expos < len; expos++)
+        if (s[expos] == 'e' || s[expos] == 'E')
+          break;
+      if (expos < len)
+        {
+          e = strtol(&s[expos + 1], &end, 10);
+          if (end == &s[expos + 1] || end != &s[len])
+            return 0;
+          if (e > 100000)
+            e = 100000;
+          else if (e < -100000)
+            e = -100000;
+        }
+      // the digits after the '.'
+      e -= (long)(expos - pos - 1);
+      memcpy(buf, s, pos);
+      memcpy(&buf[pos], dot + 1, expos - pos - 1);
+      len = expos - 1;
+      len += (size_t)snprintf(&buf[len], sizeof(buf) - len, "e%ld", e);
+    }
+  else
+    {
+      memcpy(buf, s, len);
+      buf[len] = '\0';
+    }
+  *value = strtod(buf, &end);
+  return end == &buf[len];
+}
+
+int
+numfmt_parse_double(const char *restrict s, size_t len,
+                    double *restrict value)
+{
+  static const double exact10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  uint64_t m = 0;
+  int exp10 = 0, ndigits = 0, any = 0, neg = 0;
+  size_t i = 0;
+  double d;
+
+  s = numfmt_trim(s, &len);
+  if (len && (*s == '-' || *s == '+'))
+    {
+      neg = *s == '-';
+      i++;
+    }
+  // mantissa, without the leading zeros
+  for (; i < len && s[i] >= '0' && s[i] <= '9'; i++)
+    {
+      any = 1;
+      if (!ndigits && s[i] == '0')
+        continue;
+      if (++ndigits > 19)
+        return numfmt_parse_double_slow(s, len, value);
+      m = m * 10 + (uint64_t)(s[i] - '0');
+    }
+  if (i < len && s[i] == '.')
+    for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++)
+      {
+        any = 1;
+        if (!ndigits && s[i] == '0')
+          {
+            exp10--;
+            continue;
+          }
+        if (++ndigits > 19)
+          return numfmt_parse_double_slow(s, len, value);
+        m = m * 10 + (uint64_t)(s[i] - '0');
+        exp10--;
+      }
+  if (!any) // inf, nan or no number at all
+    return numfmt_parse_double_slow(s, len, value);
+  if (i < len && (s[i] == 'e' || s[i] == 'E'))
+    {
+      int e = 0, eneg = 0;
+      i++;
+      if (i < len && (s[i] == '-' || s[i] == '+'))
+        eneg = s[i++] == '-';
+      if (i == len)
+        return 0;
+      for (; i < len && s[i] >= '0' && s[i] <= '9'; i++)
+        if (e < 10000)
+          e = e * 10 + (s[i] - '0');
+      exp10 += eneg ? -e : e;
+    }
+  if (i != len)
+    return 0;
+
+  // exact when both m and 10^|exp10| are exact doubles (Clinger)
+  if (m == 0)
+    d = 0.0;
+  else if (m <= (UINT64_C(1) << 53) && exp10 >= -22 && exp10 <= 22)
+    {
+      d = (double)m;
+      d = exp10 < 0 ? d / exact10[-exp10] : d * exact10[exp10];
+    }
+  else
+    return numfmt_parse_double_slow(s, len, value);
+  *value = neg ? -d : d;
+  return 1;
+}
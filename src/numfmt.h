@@ -0,0 +1,50 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * numfmt.h: number formatting for the text writers, without stdio.
+ *           The output is the same as with printf.
+ *           And the parsing of the DXF values, as with strtod and strtol.
+ */
+
+#include <stddef.h>
+
+#ifndef NUMFMT_H
+#define NUMFMT_H
+
+#include "config.h"
+
+/* Large enough for "%.17f" of DBL_MAX */
+#define NUMFMT_BUFSIZE 330
+
+/* As sprintf(buf, "%.*f", prec, value). Returns the length. */
+int
+numfmt_fixed(char *restrict buf, const double value, const int prec);
+/* As sprintf(buf, "%*ld", width, value). Returns the length. */
+int
+numfmt_int(char *restrict buf, const long value, const int width);
+/* As sprintf(buf, "%lX", value). Returns the length. */
+int
+numfmt_hex(char *restrict buf, const unsigned long value);
+
+/* The numbers in s[0 .. len), not NUL-terminated, with optional blanks
+   around. Return 1 on success, 0 if the field is no number or overflows. */
+int
+numfmt_parse_double(const char *restrict s, size_t len,
+                    double *restrict value);
+int
+numfmt_parse_long(const char *restrict s, size_t len, long *restrict value);
+int
+numfmt_parse_hex(const char *restrict s, size_t len,
+                 unsigned long *restrict value);
+
+#endif
@@ -35,13 +35,106 @@ Add CLASSES for those
 #include "dwg.h"
 #include "decode.h"
 #include "out_dxf.h"
+#include "numfmt.h"
 
 #define DWG_LOGLEVEL DWG_LOGLEVEL_NONE
 #include "logging.h"
 
 /* the current version per spec block */
-static unsigned int cur_ver = 0;
-static char buf[255];
+static THREAD_LOCAL unsigned int cur_ver = 0;
+
+/* The output goes through the sink of bits.h, see bit_sink_room.
+   The numbers are formatted by numfmt, not stdio. */
+#define DXF_BUFSIZE (256 * 1024)
+
+/* Returns room for len more bytes, len < DXF_BUFSIZE, or NULL */
+static ALWAYS_INLINE char *
+dxf_reserve(Bit_Chain *restrict dat, const size_t len)
+{
+  if (!bit_sink_room(dat, len))
+    return NULL;
+  return (char*)&dat->chain[dat->byte];
+}
+
+#define DXF_PUTS(lit) bit_sink_write(dat, lit, sizeof(lit) - 1)
+
+/* "%3i\r\n" */
+static void
+dxf_group(Bit_Chain *restrict dat, const int dxf)
+{
+  char *s = dxf_reserve(dat, 24);
+  int len;
+  if (!s)
+    return;
+  len = numfmt_int(s, dxf, 3);
+  s[len++] = '\r';
+  s[len++] = '\n';
+  dat->byte += len;
+}
+
+/* "%s\r\n" */
+static void
+dxf_string(Bit_Chain *restrict dat, const char *restrict value)
+{
+  if (!value)
+    value = "(null)"; // as glibc
+  bit_sink_write(dat, value, strlen(value));
+  DXF_PUTS("\r\n");
+}
+
+/* "%3i\r\n%lX\r\n" */
+static void
+dxf_handle(Bit_Chain *restrict dat, const int dxf, const unsigned long value)
+{
+  char *s = dxf_reserve(dat, 48);
+  int len;
+  if (!s)
+    return;
+  len = numfmt_int(s, dxf, 3);
+  s[len++] = '\r';
+  s[len++] = '\n';
+  len += numfmt_hex(&s[len], value);
+  s[len++] = '\r';
+  s[len++] = '\n';
+  dat->byte += len;
+}
+
+/* "%02X", of a promoted char */
+static void
+dxf_hexbyte(Bit_Chain *restrict dat, const int value)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  char *s = dxf_reserve(dat, 20);
+  if (!s)
+    return;
+  if (value >= 0 && value <= 0xff)
+    {
+      s[0] = hex[value >> 4];
+      s[1] = hex[value & 0xf];
+      dat->byte += 2;
+    }
+  else // negative signed char
+    dat->byte += numfmt_hex(s, (unsigned int)value);
+}
+
+/* "%-16.14f\r\n" */
+static void
+dxf_double(Bit_Chain *restrict dat, const double value)
+{
+  char *s = dxf_reserve(dat, NUMFMT_BUFSIZE + 20);
+  int len;
+  if (!s)
+    return;
+  len = numfmt_fixed(s, value, 14);
+  if (len < 16)
+    {
+      memset(&s[len], ' ', 16 - len);
+      len = 16;
+    }
+  s[len++] = '\r';
+  s[len++] = '\n';
+  dat->byte += len;
+}
 
 // private
 static int
@@ -66,22 +159,19 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
 
 #define VALUE_TV(value,dxf) \
   { GROUP(dxf); \
-    fprintf(dat->fh, "%s\r\n", value); }
+    dxf_string(dat, value); }
 #ifdef HAVE_NATIVE_WCHAR2
 # define VALUE_TU(value,dxf)\
   { GROUP(dxf); \
-    fprintf(dat->fh, "%ls\r\n", value ? (wchar_t*)value : L""); }
+    bit_sink_printf(dat, "%ls\r\n", value ? (wchar_t*)value : L""); }
 #else
 # define VALUE_TU(wstr,dxf) \
   { \
-    BITCODE_TU ws = (BITCODE_TU)wstr; \
-    uint16_t _c; \
+    char _u8[256]; \
+    char *_s = bit_convert_TU_buf((BITCODE_TU)wstr, _u8, sizeof(_u8)); \
     GROUP(dxf);\
-    if (wstr) \
-      while ((_c = *ws++)) { \
-        fprintf(dat->fh, "%c", (char)(_c & 0xff)); \
-      } \
-    fprintf(dat->fh, "\r\n"); \
+    dxf_string(dat, _s); \
+    if (_s != _u8) free(_s); \
   }
 #endif
 #define VALUE_TFF(str,dxf)    VALUE_TV(str, dxf)
@@ -94,9 +184,9 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
     GROUP(dxf); \
     if (value) \
       for (j=0; j < l; j++) { \
-        fprintf(dat->fh, "%02X", value[j]); \
+        dxf_hexbyte(dat, value[j]); \
       } \
-    fprintf(dat->fh, "\r\n"); \
+    DXF_PUTS("\r\n"); \
     len -= 127; \
   } while (len > 127); \
 }
@@ -106,7 +196,7 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
 // the hex code
 #define VALUE_HANDLE(value, handle_code, dxf) \
   if (dxf) { \
-    fprintf(dat->fh, "%3i\r\n%lX\r\n", dxf, value ? value->absolute_ref : 0); \
+    dxf_handle(dat, dxf, value ? value->absolute_ref : 0); \
   }
 // the name in the table, referenced by the handle
 // names on: 6 7 8. which else? there are more styles: plot, ...
@@ -120,14 +210,14 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
     else if (dxf == 8) \
       FIELD_HANDLE_NAME(name, dxf, LAYER) \
     else if (dat->version >= R_13) \
-      fprintf(dat->fh, "%3i\r\n%lX\r\n", dxf, _obj->name->absolute_ref); \
+      dxf_handle(dat, dxf, _obj->name->absolute_ref); \
   }
 #define HEADER_9(name) \
     GROUP(9);\
-    fprintf (dat->fh, "$%s\r\n", #name)
+    DXF_PUTS("$" #name "\r\n")
 #define VALUE_H(value, dxf) \
     if (dxf) \
-      fprintf(dat->fh, "%3i\r\n%lX\r\n", dxf, value ? value->absolute_ref : 0)
+      dxf_handle(dat, dxf, value ? value->absolute_ref : 0)
 #define HEADER_H(name,dxf) \
     HEADER_9(name);\
     VALUE_H(dwg->header_vars.name, dxf)
@@ -135,7 +225,7 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
 #define HEADER_VALUE(name, type, dxf, value) \
   if (dxf) {\
     GROUP(9);\
-    fprintf (dat->fh, "$" #name "\r\n");\
+    DXF_PUTS("$" #name "\r\n");\
     VALUE (value, type, dxf);\
   }
 #define HEADER_VAR(name, type, dxf) \
@@ -151,62 +241,63 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
   HEADER_9(name);\
   VALUE_BLL(dwg->header_vars.name, dxf)
 
-#define SECTION(section) fprintf(dat->fh, "  0\r\nSECTION\r\n  2\r\n" #section "\r\n")
-#define ENDSEC()         fprintf(dat->fh, "  0\r\nENDSEC\r\n")
-#define TABLE(table)     fprintf(dat->fh, "  0\r\nTABLE\r\n  2\r\n" #table "\r\n")
-#define ENDTAB()         fprintf(dat->fh, "  0\r\nENDTAB\r\n")
-#define RECORD(record)   fprintf(dat->fh, "  0\r\n" #record "\r\n")
+#define SECTION(section) DXF_PUTS("  0\r\nSECTION\r\n  2\r\n" #section "\r\n")
+#define ENDSEC()         DXF_PUTS("  0\r\nENDSEC\r\n")
+#define TABLE(table)     DXF_PUTS("  0\r\nTABLE\r\n  2\r\n" #table "\r\n")
+#define ENDTAB()         DXF_PUTS("  0\r\nENDTAB\r\n")
+#define RECORD(record)   DXF_PUTS("  0\r\n" #record "\r\n")
 #define SUBCLASS(text)   if (dat->from_version >= R_2000) { VALUE_TV(#text, 100); }
 
 #define GROUP(dxf) \
-    fprintf (dat->fh, "%3i\r\n", dxf)
+    dxf_group(dat, dxf)
 /* avoid empty numbers, and fixup some bad %f libc formatting */
 #define VALUE(value, type, dxf) \
   if (dxf) { \
     char *_s; \
+    char _vbuf[255]; \
     const char *_fmt = dxf_format (dxf); \
     GROUP(dxf); \
     GCC_DIAG_IGNORE(-Wformat-nonliteral) \
-    snprintf(buf, 255, _fmt, value); \
+    snprintf(_vbuf, 255, _fmt, value); \
     GCC_DIAG_RESTORE \
     /* not a string, empty num. must be zero */ \
-    if (strcmp(_fmt, "%s") && !*buf) \
-      strcpy(buf, "0"); \
+    if (strcmp(_fmt, "%s") && !*_vbuf) \
+      strcpy(_vbuf, "0"); \
     else if (90 <= dxf && dxf < 100) { \
       /* -Wpointer-to-int-cast */ \
       const int32_t _si = (int32_t)(intptr_t)(value); \
-      snprintf(buf, 255, "%6i", _si); \
+      snprintf(_vbuf, 255, "%6i", _si); \
     } else if (!strcmp(_fmt, "%-16.14f")) {      \
-      if (!strcmp(buf, "0.00000000000000")) \
-        strcpy(buf, "0.0"); \
-      else if ((_s = strstr(buf, ".00000000000000"))) \
+      if (!strcmp(_vbuf, "0.00000000000000")) \
+        strcpy(_vbuf, "0.0"); \
+      else if ((_s = strstr(_vbuf, ".00000000000000"))) \
         strcpy(_s, ".0"); \
-      else if ((_s = strstr(buf, ".50000000000000"))) \
+      else if ((_s = strstr(_vbuf, ".50000000000000"))) \
         strcpy(_s, ".5"); \
-      else if ((_s = strstr(buf, ".12500000000000"))) \
+      else if ((_s = strstr(_vbuf, ".12500000000000"))) \
         strcpy(_s, ".125"); \
     } \
-    fprintf(dat->fh, "%s\r\n", buf); \
+    dxf_string(dat, _vbuf); \
   }
 #define VALUE_RD(value, dxf) \
   if (dxf && !bit_isnan(value)) { \
     GROUP(dxf); \
     if (value == 0.0 || value == 0) \
-      fprintf(dat->fh, "0.0\r\n"); \
+      DXF_PUTS("0.0\r\n"); \
     else if (value == 0.5) \
-      fprintf(dat->fh, "0.5\r\n"); \
+      DXF_PUTS("0.5\r\n"); \
     else if (value == 0.125) \
-      fprintf(dat->fh, "0.125\r\n"); \
+      DXF_PUTS("0.125\r\n"); \
     else \
-      fprintf(dat->fh, "%-16.14f\r\n", value); \
+      dxf_double(dat, value); \
   }
 #define VALUE_B(value, dxf) \
   if (dxf) { \
     GROUP(dxf); \
-    if (value == 0) \
-      fprintf(dat->fh, "     0\r\n"); \
+    if ((value) == 0) \
+      DXF_PUTS("     0\r\n"); \
     else \
-      fprintf(dat->fh, "     1\r\n"); \
+      DXF_PUTS("     1\r\n"); \
   }
 
 #define FIELD_HANDLE_NAME(name, dxf, table) \
@@ -240,8 +331,12 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
 #define VALUE_BL(value,dxf)  VALUE(value, BL, dxf)
 #define VALUE_BLL(value,dxf) VALUE(value, RLL, dxf)
 #define VALUE_BD(value,dxf) \
-  { if (dxf >= 50 && dxf < 55) value = rad2deg(value); \
-    VALUE_RD(value, dxf); }
+  { if (dxf >= 50 && dxf < 55) { \
+      const BITCODE_BD _deg = rad2deg(value); \
+      VALUE_RD(_deg, dxf); \
+    } else { \
+      VALUE_RD(value, dxf); \
+    } }
 #define VALUE_RC(value,dxf)  VALUE(value, RC, dxf)
 #define VALUE_RS(value,dxf)  VALUE(value, RS, dxf)
 #define VALUE_RL(value,dxf)  VALUE(value, RL, dxf)
@@ -257,9 +352,7 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
 #define FIELD_BS(name,dxf)  FIELD(name, BS, dxf)
 #define FIELD_BL(name,dxf)  FIELD(name, BL, dxf)
 #define FIELD_BLL(name,dxf) FIELD(name, BLL, dxf)
-#define FIELD_BD(name,dxf)  \
-  { if (dxf >= 50 && dxf < 55) _obj->name = rad2deg(_obj->name); \
-    FIELD_RD(name, dxf); }
+#define FIELD_BD(name,dxf)  VALUE_BD(_obj->name, dxf)
 #define FIELD_RC(name,dxf)  FIELD(name, RC, dxf)
 #define FIELD_RS(name,dxf)  FIELD(name, RS, dxf)
 #define FIELD_RL(name,dxf)  FIELD(name, RL, dxf)
@@ -303,7 +396,7 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
 #define HEADER_TIMEBLL(name, dxf) \
   HEADER_9(name); FIELD_TIMEBLL(name, dxf)
 #define FIELD_TIMEBLL(name,dxf) \
-  GROUP(dxf); fprintf(dat->fh, FORMAT_RL "." FORMAT_RL "\r\n", \
+  GROUP(dxf); bit_sink_printf(dat, FORMAT_RL "." FORMAT_RL "\r\n", \
                       _obj->name.days, _obj->name.ms)
 #define HEADER_CMC(name,dxf) \
     HEADER_9(name);\
@@ -401,30 +494,30 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
       obj->tio.object->xdicobjhandle && \
       obj->tio.object->xdicobjhandle->absolute_ref) \
   { \
-    fprintf(dat->fh, "102\r\n{ACAD_XDICTIONARY\r\n");\
+    DXF_PUTS("102\r\n{ACAD_XDICTIONARY\r\n");\
     VALUE_HANDLE(obj->tio.object->xdicobjhandle, code, 360); \
-    fprintf(dat->fh, "102\r\n}\r\n");\
+    DXF_PUTS("102\r\n}\r\n");\
   }
 #define _REACTORS(code)\
   if (dat->version >= R_13 && \
       obj->tio.object->num_reactors && \
       obj->tio.object->reactors) \
   { \
-    fprintf(dat->fh, "102\r\n{ACAD_REACTORS\r\n");\
+    DXF_PUTS("102\r\n{ACAD_REACTORS\r\n");\
     for (vcount=0; vcount < obj->tio.object->num_reactors; vcount++)\
       { /* soft ptr */ \
         VALUE_HANDLE(obj->tio.object->reactors[vcount], code, 330); \
       }\
-    fprintf(dat->fh, "102\r\n}\r\n");\
+    DXF_PUTS("102\r\n}\r\n");\
   }
 #define ENT_REACTORS(code)\
   if (dat->version >= R_13 && _obj->num_reactors && _obj->reactors) {\
-    fprintf(dat->fh, "102\r\n{ACAD_REACTORS\r\n");\
+    DXF_PUTS("102\r\n{ACAD_REACTORS\r\n");\
     for (vcount=0; vcount < _obj->num_reactors; vcount++)\
       {\
         VALUE_HANDLE(_obj->reactors[vcount], code, 330); \
       }\
-    fprintf(dat->fh, "102\r\n}\r\n");\
+    DXF_PUTS("102\r\n}\r\n");\
   }
 #define REACTORS(code)
 #define XDICOBJHANDLE(code)
@@ -433,9 +526,9 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
       obj->tio.entity->xdicobjhandle && \
       obj->tio.entity->xdicobjhandle->absolute_ref) \
   { \
-    fprintf(dat->fh, "102\r\n{ACAD_XDICTIONARY\r\n");\
+    DXF_PUTS("102\r\n{ACAD_XDICTIONARY\r\n");\
     VALUE_HANDLE(obj->tio.entity->xdicobjhandle, code, 360); \
-    fprintf(dat->fh, "102\r\n}\r\n");\
+    DXF_PUTS("102\r\n}\r\n");\
   }
 
 #define COMMON_ENTITY_HANDLE_DATA
@@ -463,7 +556,7 @@ dwg_dxf_##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
 {\
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4; \
   int error = 0; \
-  Dwg_Data* dwg = obj->parent; \
+  const Dwg_Data *dwg = obj->parent; \
   Dwg_Entity_##token *ent, *_obj;\
   Dwg_Object_Entity *_ent;\
   if (!strcmp(#token, "GEOPOSITIONMARKER"))\
@@ -481,7 +574,7 @@ dwg_dxf_##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
     return dwg_dxf_TABLECONTENT(dat, obj); \
   } \
   else if (obj->type >= 500 && obj->dxfname) \
-    fprintf(dat->fh, "  0\r\n%s\r\n", obj->dxfname); \
+    { DXF_PUTS("  0\r\n"); dxf_string(dat, obj->dxfname); } \
   else\
     RECORD(token);\
   _ent = obj->tio.entity;\
@@ -492,7 +585,7 @@ dwg_dxf_##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
               obj->handle.code,\
               obj->handle.size,\
               obj->handle.value); \
-    fprintf(dat->fh, "%3i\r\n%lX\r\n", 5, obj->handle.value); \
+    dxf_handle(dat, 5, obj->handle.value); \
   } \
   SINCE(R_13) { \
     VALUE_HANDLE (obj->parent->header_vars.BLOCK_RECORD_MSPACE, 5, 330); \
@@ -509,7 +602,7 @@ dwg_dxf_ ##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4;\
   int error = 0; \
   Bit_Chain *hdl_dat = dat;\
-  Dwg_Data* dwg = obj->parent; \
+  const Dwg_Data *dwg = obj->parent; \
   Dwg_Object_##token *_obj;\
   LOG_INFO("Object " #token ":\n")\
   _obj = obj->tio.object->tio.token;\
@@ -517,7 +610,7 @@ dwg_dxf_ ##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
     if (obj->fixedtype == DWG_TYPE_TABLE) \
       ; \
     else if (obj->type >= 500 && obj->dxfname)        \
-      fprintf(dat->fh, "  0\r\n%s\r\n", obj->dxfname); \
+      { DXF_PUTS("  0\r\n"); dxf_string(dat, obj->dxfname); } \
     else if (obj->type == DWG_TYPE_PLACEHOLDER) \
       RECORD(ACDBPLACEHOLDER); \
     else if (obj->type != DWG_TYPE_BLOCK_HEADER) \
@@ -525,7 +618,7 @@ dwg_dxf_ ##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
     SINCE(R_13) { \
       int dxf = 5; \
       if (obj->type == DWG_TYPE_DIMSTYLE) dxf = 105; \
-      fprintf(dat->fh, "%3i\r\n%lX\r\n", dxf, obj->handle.value); \
+      dxf_handle(dat, dxf, obj->handle.value); \
       _XDICOBJHANDLE(3); \
       _REACTORS(4); \
     } \
@@ -593,13 +686,13 @@ dxf_write_xdata(Bit_Chain *restrict dat, Dwg_Resbuf *restrict rbuf, BITCODE_BL s
           break;
         case VT_HANDLE:
         case VT_OBJECTID:
-          fprintf(dat->fh, "%3i\r\n%lX\r\n", dxftype,
-                  (unsigned long)*(uint64_t*)rbuf->value.hdl);
+          dxf_handle(dat, dxftype,
+                     (unsigned long)*(uint64_t*)rbuf->value.hdl);
           break;
         case VT_INVALID:
           break; //skip
         default:
-          fprintf(dat->fh, "%3i\r\n\r\n", dxftype);
+          bit_sink_printf(dat, "%3i\r\n\r\n", dxftype);
           break;
         }
       rbuf = tmp;
@@ -617,39 +710,41 @@ dxf_cvt_tablerecord(Bit_Chain *restrict dat, const Dwg_Object *restrict obj,
 {
   if (obj && obj->supertype == DWG_SUPERTYPE_OBJECT && entry_name)
     {
-      if (dat->version >= R_2007) // r2007+ unicode names
+      if (dat->version >= R_2007) // r2007+ unicode names, cached as UTF-8
         {
-          entry_name = bit_convert_TU((BITCODE_TU)entry_name);
+          entry_name = (char*)dwg_obj_table_utf8name(obj);
+          if (!entry_name)
+            entry_name = (char*)"";
         }
       if (dat->from_version >= R_13 && dat->version < R_13)
         { // convert the other way round, from newer to older
           if (!strcmp(entry_name, "Standard"))
-            fprintf(dat->fh, "%3i\r\nSTANDARD\r\n", dxf);
+            { GROUP(dxf); DXF_PUTS("STANDARD\r\n"); }
           else if (!strcmp(entry_name, "ByLayer"))
-            fprintf(dat->fh, "%3i\r\nBYLAYER\r\n", dxf);
+            { GROUP(dxf); DXF_PUTS("BYLAYER\r\n"); }
           else if (!strcmp(entry_name, "ByBlock"))
-            fprintf(dat->fh, "%3i\r\nBYBLOCK\r\n", dxf);
+            { GROUP(dxf); DXF_PUTS("BYBLOCK\r\n"); }
           else if (!strcmp(entry_name, "*Active"))
-            fprintf(dat->fh, "%3i\r\n*ACTIVE\r\n", dxf);
+            { GROUP(dxf); DXF_PUTS("*ACTIVE\r\n"); }
           else
-            fprintf(dat->fh, "%3i\r\n%s\r\n", dxf, entry_name);
+            { GROUP(dxf); dxf_string(dat, entry_name); }
         }
       else
         { // convert some standard names
           if (dat->version >= R_13 && !strcmp(entry_name, "STANDARD"))
-            fprintf(dat->fh, "%3i\r\nStandard\r\n", dxf);
+            { GROUP(dxf); DXF_PUTS("Standard\r\n"); }
           else if (dat->version >= R_13 && !strcmp(entry_name, "BYLAYER"))
-            fprintf(dat->fh, "%3i\r\nByLayer\r\n", dxf);
+            { GROUP(dxf); DXF_PUTS("ByLayer\r\n"); }
           else if (dat->version >= R_13 && !strcmp(entry_name, "BYBLOCK"))
-            fprintf(dat->fh, "%3i\r\nByBlock\r\n", dxf);
+            { GROUP(dxf); DXF_PUTS("ByBlock\r\n"); }
           else if (dat->version >= R_13 && !strcmp(entry_name, "*ACTIVE"))
-            fprintf(dat->fh, "%3i\r\n*Active\r\n", dxf);
+            { GROUP(dxf); DXF_PUTS("*Active\r\n"); }
           else
-            fprintf(dat->fh, "%3i\r\n%s\r\n", dxf, entry_name);
+            { GROUP(dxf); dxf_string(dat, entry_name); }
         }
     }
   else {
-    fprintf(dat->fh, "%3i\r\n\r\n", dxf);
+    bit_sink_printf(dat, "%3i\r\n\r\n", dxf);
   }
 }
 
@@ -657,7 +752,7 @@ dxf_cvt_tablerecord(Bit_Chain *restrict dat, const Dwg_Object *restrict obj,
 #define COMMON_TABLE_CONTROL_FLAGS \
   if (ctrl) { \
     SINCE(R_13) { \
-      fprintf(dat->fh, "%3i\r\n%lX\r\n", 5, ctrl->handle.value);\
+      dxf_handle(dat, 5, ctrl->handle.value);\
     } \
     SINCE(R_14) { \
       VALUE_H (_ctrl->null_handle, 330); \
@@ -696,7 +791,7 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
                        const Dwg_Object *restrict obj,
                        Dwg_Entity_3DSOLID *restrict _obj)
 {
-  Dwg_Data* dwg = obj->parent;
+  const Dwg_Data *dwg = obj->parent;
   unsigned long j;
   BITCODE_BL vcount, rcount1, rcount2;
   BITCODE_BL i;
@@ -717,7 +812,8 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
           for (i=0; i<FIELD_VALUE(num_blocks); i++)
             {
               char *s = FIELD_VALUE(encr_sat_data[i]);
-              int len = strlen(s);
+              char *z = memchr(s, 0, FIELD_VALUE(block_size[i]));
+              int len = z ? (int)(z - s) : (int)FIELD_VALUE(block_size[i]);
               // FIELD_BL (block_size[i], 0);
               // DXF 1 + 3 if >255
               while (len > 0) {
@@ -731,9 +827,9 @@ static int dxf_3dsolid(Bit_Chain *restrict dat,
                   else
                     GROUP(3);
                   if (s[l-1] == '\r')
-                    fprintf(dat->fh, "%.*s\n", l, s);
+                    bit_sink_printf(dat, "%.*s\n", l, s);
                   else
-                    fprintf(dat->fh, "%.*s\r\n", l, s);
+                    bit_sink_printf(dat, "%.*s\r\n", l, s);
                   l++;
                   len -= l;
                   s += l;
@@ -825,7 +921,7 @@ dwg_dxf_variable_type(const Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
   is_entity = dwg_class_is_entity(klass);
 
   //if (!is_entity)
-  //  fprintf(dat->fh, "  0\r\n%s\r\n", dxfname);
+  //  bit_sink_printf(dat, "  0\r\n%s\r\n", dxfname);
 
   #include "classes.inc"
 
@@ -1005,7 +1101,7 @@ dwg_dxf_object(Bit_Chain *restrict dat, const Dwg_Object *restrict obj)
       else if ((error = dwg_dxf_variable_type(obj->parent, dat, (Dwg_Object*)obj))
                & DWG_ERR_UNHANDLEDCLASS)
         {
-          Dwg_Data *dwg = obj->parent;
+          const Dwg_Data *dwg = obj->parent;
           int is_entity;
           int i = obj->type - 500;
           Dwg_Class *klass = NULL;
@@ -1030,7 +1126,7 @@ static int
 dxf_common_entity_handle_data(Bit_Chain *restrict dat, const Dwg_Object *restrict obj)
 {
   Dwg_Object_Entity *ent;
-  //Dwg_Data *dwg = obj->parent;
+  //const Dwg_Data *dwg = obj->parent;
   Dwg_Object_Entity *_obj;
   int error = 0;
   BITCODE_BL vcount = 0;
@@ -1160,7 +1256,7 @@ dxf_format (int code)
   return "(unknown code)";
 }
 
-const char* dxf_codepage (int code, Dwg_Data* dwg)
+const char* dxf_codepage (int code, const Dwg_Data* dwg)
 {
   if (code == 30 || code == 0)
     return "ANSI_1252";
@@ -1174,10 +1270,10 @@ const char* dxf_codepage (int code, Dwg_Data* dwg)
 
 // see https://www.autodesk.com/techpubs/autocad/acad2000/dxf/header_section_group_codes_dxf_02.htm
 static int
-dxf_header_write(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxf_header_write(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
-  Dwg_Header_Variables* _obj = &dwg->header_vars;
-  Dwg_Object* obj = NULL;
+  const Dwg_Header_Variables *_obj = &dwg->header_vars;
+  const Dwg_Object *obj = NULL;
   double ms;
   const int minimal = dwg->opts & 0x10;
   const char* codepage = dxf_codepage(dwg->header.codepage, dwg);
@@ -1198,7 +1294,7 @@ dxf_header_write(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 
 // only called since r2000. but not really needed, unless referenced
 static int
-dxf_classes_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxf_classes_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   unsigned int i;
 
@@ -1223,15 +1319,15 @@ dxf_classes_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 static int
-dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxf_tables_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   int error = 0;
   unsigned int i;
 
   SECTION(TABLES);
   {
-    Dwg_Object_VPORT_CONTROL *_ctrl = &dwg->vport_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_VPORT_CONTROL *_ctrl = &dwg->vport_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     if (ctrl)
       {
         TABLE(VPORT);
@@ -1248,7 +1344,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
           }
         for (i=0; i<dwg->vport_control.num_entries; i++)
           {
-            Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->vports[i]);
+            Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->vports[i]);
             if (obj && obj->type == DWG_TYPE_VPORT) {
               //reordered in the DXF: 2,70,10,11,12,13,14,15,16,...
               //special-cased in the spec
@@ -1259,25 +1355,25 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       }
   }
   {
-    Dwg_Object_LTYPE_CONTROL *_ctrl = &dwg->ltype_control;
+    const Dwg_Object_LTYPE_CONTROL *_ctrl = &dwg->ltype_control;
     Dwg_Object *obj;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     if (ctrl)
       {
         TABLE(LTYPE);
         COMMON_TABLE_CONTROL_FLAGS;
         error |= dwg_dxf_LTYPE_CONTROL(dat, ctrl);
         // first the 2 builtin ltypes: ByBlock, ByLayer
-        if ((obj  = dwg_ref_object(dwg, dwg->header_vars.LTYPE_BYBLOCK))) {
+        if ((obj  = dwg_ref_object_const(dwg, dwg->header_vars.LTYPE_BYBLOCK))) {
           dwg_dxf_LTYPE(dat, obj);
         }
-        if ((obj  = dwg_ref_object(dwg, dwg->header_vars.LTYPE_BYLAYER))) {
+        if ((obj  = dwg_ref_object_const(dwg, dwg->header_vars.LTYPE_BYLAYER))) {
           error |= dwg_dxf_LTYPE(dat, obj);
         }
         // here LTYPE_CONTINUOUS is already included
         for (i=0; i<dwg->ltype_control.num_entries; i++)
           {
-            obj = dwg_ref_object(dwg, _ctrl->linetypes[i]);
+            obj = dwg_ref_object_const(dwg, _ctrl->linetypes[i]);
             if (obj && obj->type == DWG_TYPE_LTYPE) {
               error |= dwg_dxf_LTYPE(dat, obj);
             }
@@ -1286,8 +1382,8 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       }
   }
   {
-    Dwg_Object_LAYER_CONTROL *_ctrl = &dwg->layer_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_LAYER_CONTROL *_ctrl = &dwg->layer_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     if (ctrl)
       {
         TABLE(LAYER);
@@ -1295,7 +1391,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
         error |= dwg_dxf_LAYER_CONTROL(dat, ctrl);
         for (i=0; i<dwg->layer_control.num_entries; i++)
           {
-            Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->layers[i]);
+            Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->layers[i]);
             if (obj && obj->type == DWG_TYPE_LAYER)
               error |= dwg_dxf_LAYER(dat, obj);
             //else if (obj && obj->type == DWG_TYPE_DICTIONARY)
@@ -1305,8 +1401,8 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       }
   }
   {
-    Dwg_Object_STYLE_CONTROL *_ctrl = &dwg->style_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_STYLE_CONTROL *_ctrl = &dwg->style_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     if (ctrl)
       {
         TABLE(STYLE);
@@ -1314,7 +1410,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
         error |= dwg_dxf_STYLE_CONTROL(dat, ctrl);
         for (i=0; i<dwg->style_control.num_entries; i++)
           {
-            Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->styles[i]);
+            Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->styles[i]);
             if (obj && obj->type == DWG_TYPE_STYLE) {
               error |= dwg_dxf_STYLE(dat, obj);
             }
@@ -1323,8 +1419,8 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       }
   }
   {
-    Dwg_Object_VIEW_CONTROL *_ctrl = &dwg->view_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_VIEW_CONTROL *_ctrl = &dwg->view_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     if (ctrl)
       {
         TABLE(VIEW);
@@ -1332,7 +1428,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
         error |= dwg_dxf_VIEW_CONTROL(dat, ctrl);
         for (i=0; i<dwg->view_control.num_entries; i++)
           {
-            Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->views[i]);
+            Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->views[i]);
             //FIXME implement the other two
             if (obj && obj->type == DWG_TYPE_VIEW)
               error |= dwg_dxf_VIEW(dat, obj);
@@ -1347,8 +1443,8 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       }
   }
   {
-    Dwg_Object_UCS_CONTROL *_ctrl = &dwg->ucs_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_UCS_CONTROL *_ctrl = &dwg->ucs_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     if (ctrl)
       {
         TABLE(UCS);
@@ -1356,7 +1452,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
         error |= dwg_dxf_UCS_CONTROL(dat, ctrl);
         for (i=0; i<dwg->ucs_control.num_entries; i++)
           {
-            Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->ucs[i]);
+            Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->ucs[i]);
             if (obj && obj->type == DWG_TYPE_UCS) {
               error |= dwg_dxf_UCS(dat, obj);
             }
@@ -1366,8 +1462,8 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   }
   SINCE (R_13)
   {
-    Dwg_Object_APPID_CONTROL *_ctrl = &dwg->appid_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_APPID_CONTROL *_ctrl = &dwg->appid_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     if (ctrl)
       {
         TABLE(APPID);
@@ -1375,7 +1471,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
         error |= dwg_dxf_APPID_CONTROL(dat, ctrl);
         for (i=0; i<dwg->appid_control.num_entries; i++)
           {
-            Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->apps[i]);
+            Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->apps[i]);
             if (obj && obj->type == DWG_TYPE_APPID) {
               error |= dwg_dxf_APPID(dat, obj);
             }
@@ -1384,8 +1480,8 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       }
   }
   {
-    Dwg_Object_DIMSTYLE_CONTROL *_ctrl = &dwg->dimstyle_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_DIMSTYLE_CONTROL *_ctrl = &dwg->dimstyle_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     if (ctrl)
       {
         TABLE(DIMSTYLE);
@@ -1394,7 +1490,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
         //ignoring morehandles
         for (i=0; i<dwg->dimstyle_control.num_entries; i++)
           {
-            Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->dimstyles[i]);
+            Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->dimstyles[i]);
             if (obj && obj->type == DWG_TYPE_DIMSTYLE) {
               error |= dwg_dxf_DIMSTYLE(dat, obj);
             }
@@ -1405,8 +1501,8 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   // fool the warnings. this table is nowhere to be found in the wild. maybe pre-R_11
   if (0 && dwg->vport_entity_control.num_entries)
     {
-      Dwg_Object_VPORT_ENTITY_CONTROL *_ctrl = &dwg->vport_entity_control;
-      Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+      const Dwg_Object_VPORT_ENTITY_CONTROL *_ctrl = &dwg->vport_entity_control;
+      const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
       if (ctrl)
         {
           TABLE(VPORT_ENTITY);
@@ -1414,7 +1510,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
           error |= dwg_dxf_VPORT_ENTITY_CONTROL(dat, ctrl);
           for (i=0; i<dwg->vport_entity_control.num_entries; i++)
             {
-              Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->vport_entity_headers[i]);
+              Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->vport_entity_headers[i]);
               if (obj && obj->type == DWG_TYPE_VPORT_ENTITY_HEADER) {
                 error |= dwg_dxf_VPORT_ENTITY_HEADER(dat, obj);
               }
@@ -1426,9 +1522,9 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     }
   SINCE (R_13)
   {
-    Dwg_Object_BLOCK_CONTROL *_ctrl = &dwg->block_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
-    Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->model_space);
+    const Dwg_Object_BLOCK_CONTROL *_ctrl = &dwg->block_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->model_space);
     Dwg_Object *mspace = NULL, *pspace = NULL;
 
     TABLE(BLOCK_RECORD);
@@ -1440,7 +1536,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       error |= dwg_dxf_BLOCK_HEADER(dat, obj);
     }
     if (_ctrl->paper_space) {
-      obj = dwg_ref_object(dwg, _ctrl->paper_space);
+      obj = dwg_ref_object_const(dwg, _ctrl->paper_space);
       if (obj && obj->type == DWG_TYPE_BLOCK_HEADER) {
         pspace = obj;
         RECORD(BLOCK_RECORD);
@@ -1449,7 +1545,7 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     }
     for (i=0; i<dwg->block_control.num_entries; i++)
       {
-        obj = dwg_ref_object(dwg, dwg->block_control.block_headers[i]);
+        obj = dwg_ref_object_const(dwg, dwg->block_control.block_headers[i]);
         if (obj && obj->type == DWG_TYPE_BLOCK_HEADER &&
             obj != mspace && obj != pspace)
           {
@@ -1464,12 +1560,12 @@ dxf_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 static int
-dxf_blocks_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxf_blocks_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   int error = 0;
   //unsigned int i;
-  Dwg_Object_BLOCK_CONTROL *_ctrl = &dwg->block_control;
-  Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+  const Dwg_Object_BLOCK_CONTROL *_ctrl = &dwg->block_control;
+  const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
   /* let's see if this control block is correct... */
   Dwg_Object_Ref *msref = dwg->header_vars.BLOCK_RECORD_MSPACE;
   Dwg_Object_Ref *psref = dwg->header_vars.BLOCK_RECORD_PSPACE;
@@ -1528,36 +1624,90 @@ dxf_blocks_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   return error;
 }
 
+/* Objects per chunk of the parallel output */
+#define DXF_CHUNK_OBJECTS 512
+
+static int
+dxf_section_object(Bit_Chain *restrict dat, const Dwg_Object *restrict obj,
+                   const int entities)
+{
+  if (entities
+      ? (obj->supertype == DWG_SUPERTYPE_ENTITY
+         && obj->type != DWG_TYPE_BLOCK && obj->type != DWG_TYPE_ENDBLK)
+      : obj->supertype == DWG_SUPERTYPE_OBJECT)
+    return dwg_dxf_object(dat, obj);
+  return 0;
+}
+
+/* The entities or the objects of the ENTITIES or OBJECTS section.
+   With dwg->num_threads, fixed chunks of objects are written in parallel
+   into memory, and then appended in order, so the output is the same. */
 static int
-dxf_entities_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxf_section_objects(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg,
+                    const int entities)
 {
   int error = 0;
   BITCODE_BL i;
 
-  SECTION(ENTITIES);
-  for (i=0; i<dwg->num_objects; i++)
+#ifdef _OPENMP
+  const long num_chunks
+      = (long)((dwg->num_objects + DXF_CHUNK_OBJECTS - 1) / DXF_CHUNK_OBJECTS);
+  Bit_Chain *chunks = dwg->num_threads > 1 && num_chunks > 1
+                      ? calloc(num_chunks, sizeof(Bit_Chain)) : NULL;
+  if (chunks)
     {
-      if (dwg->object[i].supertype == DWG_SUPERTYPE_ENTITY &&
-          dwg->object[i].type != DWG_TYPE_BLOCK &&
-          dwg->object[i].type != DWG_TYPE_ENDBLK)
-        error |= dwg_dxf_object(dat, &dwg->object[i]);
+      long c;
+#pragma omp parallel for schedule(dynamic) reduction(|:error) \
+    num_threads(dwg->num_threads)
+      for (c = 0; c < num_chunks; c++)
+        {
+          Bit_Chain *chunk = &chunks[c];
+          BITCODE_BL j = (BITCODE_BL)c * DXF_CHUNK_OBJECTS;
+          BITCODE_BL to = j + DXF_CHUNK_OBJECTS;
+          if (to > dwg->num_objects)
+            to = dwg->num_objects;
+          *chunk = *dat;
+          chunk->fh = NULL;
+          chunk->sink = NULL;
+          bit_sink_begin(chunk, DXF_BUFSIZE);
+          for (; j < to && chunk->chain; j++)
+            error |= dxf_section_object(chunk, &dwg->object[j], entities);
+        }
+      for (c = 0; c < num_chunks; c++)
+        {
+          if (!chunks[c].chain)
+            error |= DWG_ERR_OUTOFMEM;
+          else
+            bit_sink_write(dat, (char*)chunks[c].chain, chunks[c].byte);
+          free(chunks[c].chain);
+        }
+      free(chunks);
+      return error;
     }
+#endif
+  for (i = 0; i < dwg->num_objects; i++)
+    error |= dxf_section_object(dat, &dwg->object[i], entities);
+  return error;
+}
+
+static int
+dxf_entities_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
+{
+  int error;
+
+  SECTION(ENTITIES);
+  error = dxf_section_objects(dat, dwg, 1);
   ENDSEC();
   return error;
 }
 
 static int
-dxf_objects_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxf_objects_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
-  int error = 0;
-  BITCODE_BL i;
+  int error;
 
   SECTION(OBJECTS);
-  for (i=0; i<dwg->num_objects; i++)
-    {
-      if (dwg->object[i].supertype == DWG_SUPERTYPE_OBJECT)
-        error |= dwg_dxf_object(dat, &dwg->object[i]);
-    }
+  error = dxf_section_objects(dat, dwg, 0);
   ENDSEC();
   return error;
 }
@@ -1565,7 +1715,7 @@ dxf_objects_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 //TODO: Beware, there's also a new ACDSDATA section, with ACDSSCHEMA elements
 // and the Thumbnail_Data (per block?)
 static int
-dxf_preview_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxf_preview_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   Bit_Chain *pic = (Bit_Chain*) &dwg->picture;
   if (pic->chain && pic->size && pic->size > 10)
@@ -1579,13 +1729,20 @@ dxf_preview_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 int
-dwg_write_dxf(Bit_Chain *dat, Dwg_Data * dwg)
+dwg_write_dxf(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   const int minimal = dwg->opts & 0x10;
-  struct Dwg_Header *obj = &dwg->header;
+  const struct Dwg_Header *obj = &dwg->header;
+  const Bit_Chain orig = *dat;
+  int error = 0;
 
   if (dat->from_version == R_INVALID)
     dat->from_version = dat->version;
+  if (bit_sink_begin(dat, DXF_BUFSIZE))
+    {
+      *dat = orig;
+      return DWG_ERR_OUTOFMEM;
+    }
 
   VALUE_TV(PACKAGE_STRING, 999);
 
@@ -1622,10 +1779,12 @@ dwg_write_dxf(Bit_Chain *dat, Dwg_Data * dwg)
     }
   }
   RECORD(EOF);
+  goto done;
 
-  return 0;
  fail:
-  return 1;
+  error = 1;
+ done:
+  return bit_sink_end(dat, &orig, error);
 }
 
 #undef IS_PRINT
@@ -22,9 +22,9 @@
 #include "bits.h"
 
 const char *dxf_format (int code);
-const char* dxf_codepage (int code, Dwg_Data* dwg);
+const char* dxf_codepage (int code, const Dwg_Data* dwg);
 
-EXPORT int dwg_write_dxf(Bit_Chain *dat, Dwg_Data* dwg);
-EXPORT int dwg_write_dxfb(Bit_Chain *dat, Dwg_Data* dwg);
+EXPORT int dwg_write_dxf(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg);
+EXPORT int dwg_write_dxfb(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg);
 
 #endif
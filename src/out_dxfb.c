@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
 
 #include "common.h"
@@ -31,8 +32,55 @@
 #include "logging.h"
 
 /* the current version per spec block */
-static unsigned int cur_ver = 0;
-static char buf[4096];
+static THREAD_LOCAL unsigned int cur_ver = 0;
+
+/* The output goes through the sink of bits.h, see bit_sink_room.
+   The group codes and numbers are stored little-endian into the buffer,
+   and the strings copied. */
+#define DXFB_BUFSIZE (256 * 1024)
+
+/* with the NUL */
+#define DXFB_PUTS(lit) bit_sink_write(dat, lit, sizeof(lit))
+
+/* The group code, 1 byte before r14, and the value of size bytes */
+static ALWAYS_INLINE void
+dxfb_value(Bit_Chain *restrict dat, const int dxf, const uint64_t value,
+           const unsigned int size)
+{
+  unsigned char *p;
+  unsigned int i;
+
+  if (!bit_sink_room(dat, 2 + size))
+    return;
+  p = &dat->chain[dat->byte];
+  *p++ = (unsigned char)dxf;
+  if (dat->version >= R_14)
+    *p++ = (unsigned char)(dxf >> 8);
+  for (i = 0; i < size; i++)
+    p[i] = (unsigned char)(value >> (8 * i));
+  dat->byte = p + size - dat->chain;
+}
+
+static ALWAYS_INLINE void
+dxfb_double(Bit_Chain *restrict dat, const int dxf, const double value)
+{
+  uint64_t u;
+  memcpy(&u, &value, sizeof(u));
+  dxfb_value(dat, dxf, u, 8);
+}
+
+/* The group code and the string with nul NULs */
+static void
+dxfb_string(Bit_Chain *restrict dat, const int dxf, const char *restrict value,
+            const int nul)
+{
+  static const char zeros[2] = { 0, 0 };
+  if (!value)
+    value = "(null)"; // as glibc
+  dxfb_value(dat, dxf, 0, 0);
+  bit_sink_write(dat, value, strlen(value));
+  bit_sink_write(dat, zeros, nul);
+}
 
 //private
 static int
@@ -51,8 +99,7 @@ dxfb_common_entity_handle_data(Bit_Chain *restrict dat,
     if (dxf) { FIELD_##type(name, dxf); }
 
 #define HEADER_VALUE(name, type, dxf, value) \
-    GROUP(9);\
-    fprintf (dat->fh, "$%s%c", #name, 0);\
+    HEADER_9(name);\
     VALUE_##type(value, dxf)
 
 #define HEADER_VAR(name, type, dxf) \
@@ -61,38 +108,24 @@ dxfb_common_entity_handle_data(Bit_Chain *restrict dat,
 #define FIELD_CAST(name,type,cast,dxf) FIELD(name,cast,dxf)
 #define FIELD_TRACE(name,type)
 //TODO length?
-#define VALUE_TV(value,dxf) \
-  { GROUP(dxf); \
-    fprintf(dat->fh, "%s%c", value, 0); }
-#ifdef HAVE_NATIVE_WCHAR2
-# define VALUE_TU(value,dxf)\
-  { GROUP(dxf); \
-    fprintf(dat->fh, "%ls%c%c", (wchar_t*)value, 0, 0); }
-#else
-# define VALUE_TU(wstr,dxf) \
+#define VALUE_TV(value,dxf) { dxfb_string(dat, dxf, value, 1); }
+#define VALUE_TU(wstr,dxf) \
   { \
-    BITCODE_TU ws = (BITCODE_TU)wstr; \
-    uint16_t _c; \
-    GROUP(dxf);\
-    while ((_c = *ws++)) { \
-      fprintf(dat->fh, "%c", (char)(_c & 0xff)); \
-    } \
-    fprintf(dat->fh, "%c%c", 0, 0); \
+    char _u8[256]; \
+    char *_s = bit_convert_TU_buf((BITCODE_TU)wstr, _u8, sizeof(_u8)); \
+    dxfb_string(dat, dxf, _s, 2); \
+    if (_s != _u8) free(_s); \
   }
-#endif
 #define VALUE_TFF(str,dxf)  VALUE_TV(str, dxf)
 #define VALUE_BINARY(value,size,dxf) \
 { \
   long len = size; \
   do { \
-    short j; \
     long l = len > 127 ? 127 : len; \
     GROUP(dxf); \
     if (value) \
-      for (j=0; j < l; j++) { \
-        fprintf(dat->fh, "%c", value[j]); \
-      } \
-    fprintf(dat->fh, "%c", '\0'); \
+      bit_sink_write(dat, value, l); \
+    bit_sink_write(dat, "", 1); \
     len -= 127; \
   } while (len > 127); \
 }
@@ -101,23 +134,12 @@ dxfb_common_entity_handle_data(Bit_Chain *restrict dat,
 #define ANYCODE -1
 //TODO
 #define VALUE_HANDLE(hdlptr, handle_code, dxf) \
-  { \
-     uint32_t _j = (uint32_t)hdlptr->absolute_ref; \
-     GROUP(dxf); \
-     fwrite(&_j, sizeof(uint32_t), 1, dat->fh); \
+  if (dxf) { \
+     dxfb_value(dat, dxf, hdlptr ? (uint32_t)hdlptr->absolute_ref : 0, 4); \
   }
 #define FIELD_HANDLE(name, handle_code, dxf) VALUE_HANDLE(_obj->name, handle_code, dxf)
 
-#define GROUP(code)                  \
-    {                                \
-    if (dat->version < R_14) {       \
-      unsigned char icode = (unsigned char)code; \
-      fwrite(&icode, sizeof(unsigned char), 1, dat->fh); \
-    } else {                         \
-      short icode = code;            \
-      fwrite(&icode, sizeof(short), 1, dat->fh); \
-    }                                \
-  }
+#define GROUP(code) { dxfb_value(dat, code, 0, 0); }
 #define FIELD_TV(name,dxf) \
   if (_obj->name != NULL && dxf != 0) { VALUE_TV(_obj->name,dxf) }
 #define FIELD_TU(name,dxf) \
@@ -187,7 +209,7 @@ dxfb_common_entity_handle_data(Bit_Chain *restrict dat,
 
 #define HEADER_9(name) \
     GROUP(9);\
-    fprintf (dat->fh, "$%s%c", #name, 0)
+    DXFB_PUTS("$" #name)
 #define VALUE(value,type,dxf) VALUE_##type(value,dxf)
 #define VALUE_B(value,dxf) VALUE_RC(value,dxf)
 #define VALUE_BB(value,dxf) VALUE_RC(value,dxf)
@@ -195,46 +217,26 @@ dxfb_common_entity_handle_data(Bit_Chain *restrict dat,
 #define VALUE_BS(value,dxf) VALUE_RS(value,dxf)
 #define VALUE_BL(value,dxf) VALUE_RL(value,dxf)
 #define VALUE_BD(value,dxf) VALUE_RD(value,dxf)
-#define VALUE_RC(value,dxf) \
-  {\
-    BITCODE_RC c = (value); \
-    GROUP(dxf);\
-    fwrite(&c, sizeof(BITCODE_RC), 1, dat->fh); \
-  }
+#define VALUE_RC(value,dxf) { dxfb_value(dat, dxf, (BITCODE_RC)(value), 1); }
 #define FIELD_RC(name,dxf) VALUE_RC(_obj->name, dxf)
 #define HEADER_RC(name,dxf) \
     HEADER_9(name);\
     VALUE_RC(dwg->header_vars.name, dxf)
 #define HEADER_B(name,dxf) HEADER_RC(name,dxf)
 
-#define VALUE_RS(value,dxf) \
-  {\
-    BITCODE_RS s = (value); \
-    GROUP(dxf);\
-    fwrite(&s, sizeof(BITCODE_RS), 1, dat->fh);\
-  }
+#define VALUE_RS(value,dxf) { dxfb_value(dat, dxf, (BITCODE_RS)(value), 2); }
 #define FIELD_RS(name,dxf) VALUE_RS(_obj->name, dxf)
 #define HEADER_RS(name,dxf) \
     HEADER_9(name);\
     VALUE_RS(dwg->header_vars.name, dxf)
 
-#define VALUE_RD(value,dxf)\
-  {\
-    double d = (value);\
-    GROUP(dxf);\
-    fwrite(&d, sizeof(double), 1, dat->fh); \
-  }
+#define VALUE_RD(value,dxf) { dxfb_double(dat, dxf, value); }
 #define FIELD_RD(name,dxf) VALUE_RD(_obj->name,dxf)
 #define HEADER_RD(name,dxf) \
     HEADER_9(name);\
     VALUE_RD(dwg->header_vars.name, dxf)
 
-#define VALUE_RL(value,dxf)\
-  {\
-    BITCODE_RL _s = value;\
-    GROUP(dxf);\
-    fwrite(&_s, sizeof(BITCODE_RL), 1, dat->fh);\
-  }
+#define VALUE_RL(value,dxf) { dxfb_value(dat, dxf, (BITCODE_RL)(value), 4); }
 #define FIELD_RL(name,dxf) VALUE_RL(_obj->name,dxf)
 #define HEADER_RL(name,dxf) \
     HEADER_9(name);\
@@ -272,11 +274,8 @@ dxfb_common_entity_handle_data(Bit_Chain *restrict dat,
 
 #define HEADER_RLL(name,dxf) \
   {\
-    BITCODE_RLL s = _obj->name;\
-    GROUP(9);\
-    fprintf (dat->fh, "$%s%c", #name, 0);\
-    GROUP(dxf);\
-    fwrite(&s, sizeof(BITCODE_RLL), 1, dat->fh);\
+    HEADER_9(name);\
+    dxfb_value(dat, dxf, (BITCODE_RLL)_obj->name, 8);\
   }
 
 #define FIELD_MC(name,dxf) FIELD_RC(name,dxf)
@@ -439,7 +438,7 @@ static int \
 dwg_dxfb_##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
 {\
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4; \
-  Dwg_Data* dwg = obj->parent; \
+  const Dwg_Data *dwg = obj->parent; \
   Dwg_Entity_##token *ent, *_obj;\
   Dwg_Object_Entity *_ent;\
   int error = 0; \
@@ -463,13 +462,11 @@ dwg_dxfb_##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
   _ent = obj->tio.entity;\
   _obj = ent = _ent->tio.token;\
   SINCE(R_11) { \
-    uint32_t i = (uint32_t)obj->handle.value;\
     LOG_TRACE("Entity handle: %d.%d.%lX\n",\
       obj->handle.code,\
       obj->handle.size,\
       obj->handle.value) \
-    GROUP(330); \
-    fwrite(&i, sizeof(uint32_t), 1, dat->fh); \
+    VALUE_RL((uint32_t)obj->handle.value, 330); \
   } \
   SINCE(R_13) { \
     VALUE_HANDLE_NAME (obj->parent->header_vars.BLOCK_RECORD_MSPACE, 330, BLOCK_HEADER); \
@@ -484,7 +481,7 @@ dwg_dxfb_ ##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
 { \
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4;\
   Bit_Chain *hdl_dat = dat;\
-  Dwg_Data* dwg = obj->parent;\
+  const Dwg_Data *dwg = obj->parent;\
   Dwg_Object_##token *_obj;\
   int error = 0; \
   LOG_INFO("Object " #token ":\n")\
@@ -499,11 +496,8 @@ dwg_dxfb_ ##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
     else if (obj->type != DWG_TYPE_BLOCK_HEADER) \
       RECORD(token)                              \
     SINCE(R_13) { \
-      uint32_t _i = (uint32_t)obj->handle.value; \
-      int dxf = 5; \
-      if (obj->type == DWG_TYPE_DIMSTYLE) dxf = 105; \
-      GROUP(dxf);\
-      fwrite(&_i, sizeof(uint32_t), 1, dat->fh); \
+      const int dxf = obj->type == DWG_TYPE_DIMSTYLE ? 105 : 5; \
+      VALUE_RL((uint32_t)obj->handle.value, dxf); \
       _XDICOBJHANDLE(3); \
       _REACTORS(4); \
     } \
@@ -555,11 +549,16 @@ dxfb_write_xdata(Bit_Chain *restrict dat, Dwg_Resbuf *restrict rbuf, BITCODE_BL
           break;
         case VT_HANDLE:
         case VT_OBJECTID:
-          fprintf(dat->fh, "%lX\r\n", (unsigned long)*(uint64_t*)rbuf->value.hdl);
+          {
+            char hex[24];
+            const int len = snprintf(hex, sizeof(hex), "%lX\r\n",
+                                     (unsigned long)*(uint64_t*)rbuf->value.hdl);
+            bit_sink_write(dat, hex, len);
+          }
           break;
         case VT_INVALID:
         default:
-          fprintf(dat->fh, "\r\n");
+          bit_sink_write(dat, "\r\n", 2);
           break;
         }
       rbuf = tmp;
@@ -574,9 +573,11 @@ dxfb_cvt_tablerecord(Bit_Chain *restrict dat, const Dwg_Object *restrict obj,
 {
   if (obj && obj->supertype == DWG_SUPERTYPE_OBJECT && entry_name)
     {
-      if (dat->version >= R_2007) // r2007+ unicode names
+      if (dat->version >= R_2007) // r2007+ unicode names, cached as UTF-8
         {
-          entry_name = bit_convert_TU((BITCODE_TU)entry_name);
+          entry_name = (char*)dwg_obj_table_utf8name(obj);
+          if (!entry_name)
+            entry_name = (char*)"";
         }
       if (dat->from_version >= R_2000 && dat->version < R_2000)
         { // convert the other way round, from newer to older
@@ -606,16 +607,16 @@ dxfb_cvt_tablerecord(Bit_Chain *restrict dat, const Dwg_Object *restrict obj,
         }
     }
   else {
-    fprintf(dat->fh, "%3i\r\n\r\n", dxf);
+    char buf[24];
+    const int len = snprintf(buf, sizeof(buf), "%3i\r\n\r\n", dxf);
+    bit_sink_write(dat, buf, len);
   }
 }
 
 // 5 written here first
 #define COMMON_TABLE_CONTROL_FLAGS \
   SINCE(R_13) { \
-    uint32_t _i = (uint32_t)ctrl->handle.value; \
-    GROUP(5); \
-    fwrite(&_i, sizeof(uint32_t), 1, dat->fh); \
+    VALUE_RL((uint32_t)ctrl->handle.value, 5); \
   } \
   SINCE(R_14) \
     VALUE_H (_ctrl->null_handle, 330); \
@@ -840,7 +841,7 @@ dwg_dxfb_object(Bit_Chain *restrict dat, const Dwg_Object *restrict obj)
       else if (DWG_ERR_UNHANDLEDCLASS &
                (error = dwg_dxfb_variable_type(obj->parent, dat, (Dwg_Object*)obj)))
         {
-          Dwg_Data *dwg = obj->parent;
+          const Dwg_Data *dwg = obj->parent;
           int is_entity;
           int i = obj->type - 500;
           Dwg_Class *klass = NULL;
@@ -862,7 +863,7 @@ static int
 dxfb_common_entity_handle_data(Bit_Chain *restrict dat, const Dwg_Object *restrict obj)
 {
   Dwg_Object_Entity *ent;
-  //Dwg_Data *dwg = obj->parent;
+  //const Dwg_Data *dwg = obj->parent;
   Dwg_Object_Entity *_obj;
   BITCODE_BL vcount = 0;
   int error = 0;
@@ -876,10 +877,10 @@ dxfb_common_entity_handle_data(Bit_Chain *restrict dat, const Dwg_Object *restri
 
 // see https://www.autodesk.com/techpubs/autocad/acad2000/dxf/header_section_group_codes_dxf_02.htm
 static int
-dxfb_header_write(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxfb_header_write(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
-  Dwg_Header_Variables* _obj = &dwg->header_vars;
-  Dwg_Object* obj = NULL;
+  const Dwg_Header_Variables *_obj = &dwg->header_vars;
+  const Dwg_Object *obj = NULL;
   double ms;
   const int minimal = dwg->opts & 0x10;
   const char* codepage = dxf_codepage(dwg->header.codepage, dwg);
@@ -899,7 +900,7 @@ dxfb_header_write(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 static int
-dxfb_classes_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxfb_classes_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   unsigned int i;
 
@@ -924,15 +925,15 @@ dxfb_classes_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 static int
-dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxfb_tables_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   int error = 0;
   unsigned int i;
 
   SECTION(TABLES);
   {
-    Dwg_Object_VPORT_CONTROL *_ctrl = &dwg->vport_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_VPORT_CONTROL *_ctrl = &dwg->vport_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     TABLE(VPORT);
     // add handle 5 here at first
     COMMON_TABLE_CONTROL_FLAGS;
@@ -947,7 +948,7 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       }
     for (i=0; i<dwg->vport_control.num_entries; i++)
       {
-        Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->vports[i]);
+        Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->vports[i]);
         if (obj && obj->type == DWG_TYPE_VPORT) {
           //reordered in the DXF: 2,70,10,11,12,13,14,15,16,...
           //special-cased in the spec
@@ -957,24 +958,24 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     ENDTAB();
   }
   {
-    Dwg_Object_LTYPE_CONTROL *_ctrl = &dwg->ltype_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_LTYPE_CONTROL *_ctrl = &dwg->ltype_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     Dwg_Object *obj;
 
     TABLE(LTYPE);
     COMMON_TABLE_CONTROL_FLAGS;
     error |= dwg_dxfb_LTYPE_CONTROL(dat, ctrl);
     // first the 2 builtin ltypes: ByBlock, ByLayer
-    if ((obj  = dwg_ref_object(dwg, dwg->header_vars.LTYPE_BYBLOCK))) {
+    if ((obj  = dwg_ref_object_const(dwg, dwg->header_vars.LTYPE_BYBLOCK))) {
       dwg_dxfb_LTYPE(dat, obj);
     }
-    if ((obj  = dwg_ref_object(dwg, dwg->header_vars.LTYPE_BYLAYER))) {
+    if ((obj  = dwg_ref_object_const(dwg, dwg->header_vars.LTYPE_BYLAYER))) {
       error |= dwg_dxfb_LTYPE(dat, obj);
     }
     // here LTYPE_CONTINUOUS is already included
     for (i=0; i<dwg->ltype_control.num_entries; i++)
       {
-        obj = dwg_ref_object(dwg, _ctrl->linetypes[i]);
+        obj = dwg_ref_object_const(dwg, _ctrl->linetypes[i]);
         if (obj && obj->type == DWG_TYPE_LTYPE) {
           error |= dwg_dxfb_LTYPE(dat, obj);
         }
@@ -982,14 +983,14 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     ENDTAB();
   }
   {
-    Dwg_Object_LAYER_CONTROL *_ctrl = &dwg->layer_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_LAYER_CONTROL *_ctrl = &dwg->layer_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     TABLE(LAYER);
     COMMON_TABLE_CONTROL_FLAGS;
     error |= dwg_dxfb_LAYER_CONTROL(dat, ctrl);
     for (i=0; i<dwg->layer_control.num_entries; i++)
       {
-        Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->layers[i]);
+        Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->layers[i]);
         if (obj && obj->type == DWG_TYPE_LAYER) {
           error |= dwg_dxfb_LAYER(dat, obj);
         }
@@ -997,14 +998,14 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     ENDTAB();
   }
   {
-    Dwg_Object_STYLE_CONTROL *_ctrl = &dwg->style_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_STYLE_CONTROL *_ctrl = &dwg->style_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     TABLE(STYLE);
     COMMON_TABLE_CONTROL_FLAGS;
     error |= dwg_dxfb_STYLE_CONTROL(dat, ctrl);
     for (i=0; i<dwg->style_control.num_entries; i++)
       {
-        Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->styles[i]);
+        Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->styles[i]);
         if (obj && obj->type == DWG_TYPE_STYLE) {
           error |= dwg_dxfb_STYLE(dat, obj);
         }
@@ -1012,14 +1013,14 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     ENDTAB();
   }
   {
-    Dwg_Object_VIEW_CONTROL *_ctrl = &dwg->view_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_VIEW_CONTROL *_ctrl = &dwg->view_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     TABLE(VIEW);
     COMMON_TABLE_CONTROL_FLAGS;
     error |= dwg_dxfb_VIEW_CONTROL(dat, ctrl);
     for (i=0; i<dwg->view_control.num_entries; i++)
       {
-        Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->views[i]);
+        Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->views[i]);
         //FIXME implement the other two
         if (obj && obj->type == DWG_TYPE_VIEW)
           error |= dwg_dxfb_VIEW(dat, obj);
@@ -1033,14 +1034,14 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     ENDTAB();
   }
   {
-    Dwg_Object_UCS_CONTROL *_ctrl = &dwg->ucs_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_UCS_CONTROL *_ctrl = &dwg->ucs_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     TABLE(UCS);
     COMMON_TABLE_CONTROL_FLAGS;
     error |= dwg_dxfb_UCS_CONTROL(dat, ctrl);
     for (i=0; i<dwg->ucs_control.num_entries; i++)
       {
-        Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->ucs[i]);
+        Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->ucs[i]);
         if (obj && obj->type == DWG_TYPE_UCS) {
           error |= dwg_dxfb_UCS(dat, obj);
         }
@@ -1049,14 +1050,14 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   }
   SINCE (R_13)
   {
-    Dwg_Object_APPID_CONTROL *_ctrl = &dwg->appid_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_APPID_CONTROL *_ctrl = &dwg->appid_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     TABLE(APPID);
     COMMON_TABLE_CONTROL_FLAGS;
     error |= dwg_dxfb_APPID_CONTROL(dat, ctrl);
     for (i=0; i<dwg->appid_control.num_entries; i++)
       {
-        Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->apps[i]);
+        Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->apps[i]);
         if (obj && obj->type == DWG_TYPE_APPID) {
           error |= dwg_dxfb_APPID(dat, obj);
         }
@@ -1064,15 +1065,15 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     ENDTAB();
   }
   {
-    Dwg_Object_DIMSTYLE_CONTROL *_ctrl = &dwg->dimstyle_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    const Dwg_Object_DIMSTYLE_CONTROL *_ctrl = &dwg->dimstyle_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
     TABLE(DIMSTYLE);
     COMMON_TABLE_CONTROL_FLAGS;
     dwg_dxfb_DIMSTYLE_CONTROL(dat, ctrl);
     //ignoring morehandles
     for (i=0; i<dwg->dimstyle_control.num_entries; i++)
       {
-        Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->dimstyles[i]);
+        Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->dimstyles[i]);
         if (obj && obj->type == DWG_TYPE_DIMSTYLE) {
           error |= dwg_dxfb_DIMSTYLE(dat, obj);
         }
@@ -1082,14 +1083,14 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   // fool the warnings. this table is nowhere to be found in the wild. maybe pre-R_11
   if (0 && dwg->vport_entity_control.num_entries)
     {
-      Dwg_Object_VPORT_ENTITY_CONTROL *_ctrl = &dwg->vport_entity_control;
-      Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+      const Dwg_Object_VPORT_ENTITY_CONTROL *_ctrl = &dwg->vport_entity_control;
+      const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
       TABLE(VPORT_ENTITY);
       COMMON_TABLE_CONTROL_FLAGS;
       error |= dwg_dxfb_VPORT_ENTITY_CONTROL(dat, ctrl);
       for (i=0; i<dwg->vport_entity_control.num_entries; i++)
         {
-          Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->vport_entity_headers[i]);
+          Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->vport_entity_headers[i]);
           if (obj && obj->type == DWG_TYPE_VPORT_ENTITY_HEADER) {
             error |= dwg_dxfb_VPORT_ENTITY_HEADER(dat, obj);
           }
@@ -1100,9 +1101,9 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     }
   SINCE (R_13)
   {
-    Dwg_Object_BLOCK_CONTROL *_ctrl = &dwg->block_control;
-    Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
-    Dwg_Object *obj = dwg_ref_object(dwg, _ctrl->model_space);
+    const Dwg_Object_BLOCK_CONTROL *_ctrl = &dwg->block_control;
+    const Dwg_Object *ctrl = &dwg->object[_ctrl->objid];
+    Dwg_Object *obj = dwg_ref_object_const(dwg, _ctrl->model_space);
     Dwg_Object *mspace = NULL, *pspace = NULL;
 
     TABLE(BLOCK_RECORD);
@@ -1114,7 +1115,7 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       error |= dwg_dxfb_BLOCK_HEADER(dat, obj);
     }
     if (_ctrl->paper_space) {
-      obj = dwg_ref_object(dwg, _ctrl->paper_space);
+      obj = dwg_ref_object_const(dwg, _ctrl->paper_space);
       if (obj && obj->type == DWG_TYPE_BLOCK_HEADER) {
         pspace = obj;
         RECORD(BLOCK_RECORD);
@@ -1123,7 +1124,7 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
     }
     for (i=0; i<dwg->block_control.num_entries; i++)
       {
-        Dwg_Object *_o = dwg_ref_object(dwg, dwg->block_control.block_headers[i]);
+        Dwg_Object *_o = dwg_ref_object_const(dwg, dwg->block_control.block_headers[i]);
         if (_o && _o->type == DWG_TYPE_BLOCK_HEADER &&
             _o != mspace && _o != pspace)
           {
@@ -1139,10 +1140,10 @@ dxfb_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 static int
-dxfb_blocks_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxfb_blocks_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   int error = 0;
-  Dwg_Object_BLOCK_CONTROL *_ctrl = &dwg->block_control;
+  const Dwg_Object_BLOCK_CONTROL *_ctrl = &dwg->block_control;
   /* let's see if this control block is correct... */
   Dwg_Object_Ref *msref = dwg->header_vars.BLOCK_RECORD_MSPACE;
   Dwg_Object_Ref *psref = dwg->header_vars.BLOCK_RECORD_PSPACE;
@@ -1202,7 +1203,7 @@ dxfb_blocks_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 static int
-dxfb_entities_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxfb_entities_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   int error = 0;
   BITCODE_BL i;
@@ -1220,7 +1221,7 @@ dxfb_entities_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 static int
-dxfb_objects_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dxfb_objects_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   int error = 0;
   BITCODE_BL i;
@@ -1236,7 +1237,7 @@ dxfb_objects_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 static int
-dxfb_preview_write (Bit_Chain *dat, Dwg_Data * dwg)
+dxfb_preview_write (Bit_Chain *dat, const Dwg_Data *restrict dwg)
 {
   Bit_Chain *pic = (Bit_Chain*) &dwg->picture;
   if (pic->chain && pic->size && pic->size > 10)
@@ -1250,13 +1251,21 @@ dxfb_preview_write (Bit_Chain *dat, Dwg_Data * dwg)
 }
 
 int
-dwg_write_dxfb(Bit_Chain *dat, Dwg_Data * dwg)
+dwg_write_dxfb(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   const int minimal = dwg->opts & 0x10;
+  const Bit_Chain orig = *dat;
+  int error = 0;
 
   if (dat->from_version == R_INVALID)
     dat->from_version = dat->version;
-  fprintf(dat->fh, "AutoCAD Binary DXF\r\n%c%c", 0x1a, 0);
+  if (bit_sink_begin(dat, DXFB_BUFSIZE))
+    {
+      *dat = orig;
+      return DWG_ERR_OUTOFMEM;
+    }
+
+  DXFB_PUTS("AutoCAD Binary DXF\r\n\x1a");
   //VALUE_TV(PACKAGE_STRING, 999);
 
   // a minimal header requires only $ACADVER, $HANDSEED, and then ENTITIES
@@ -1292,10 +1301,12 @@ dwg_write_dxfb(Bit_Chain *dat, Dwg_Data * dwg)
     }
   }
   RECORD(EOF);
+  goto done;
 
-  return 0;
  fail:
-  return 1;
+  error = 1;
+ done:
+  return bit_sink_end(dat, &orig, error);
 }
 
 #undef IS_PRINT
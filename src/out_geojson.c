@@ -14,12 +14,8 @@
  * out_geojson.c: write as GeoJSON
  * written by Reini Urban
  */
-/* TODO: Arc, Circle, Ellipsis, Bulge (Curve) tessellation.
- *       ocs/ucs transforms, explode of inserts?
- *       NOCOMMA and \n not with stdout. stdout is line-buffered,
- *       so NOCOMMA cannot backup past the previous \n to delete the comma.
- *       We really have to add the comma before, not after, and special case the first
- *       field, not the last to omit the comma.
+/* TODO: Ellipsis, Bulge (Curve) tessellation.
+ *       ocs/ucs transforms of the other entities, explode of inserts.
  */
 
 #include "config.h"
@@ -35,15 +31,12 @@
 #include "dwg.h"
 #include "decode.h"
 #include "out_json.h"
+#include "numfmt.h"
 
 #define DWG_LOGLEVEL DWG_LOGLEVEL_NONE
 #include "logging.h"
 #include "dwg_api.h"
 
-/* the current version per spec block */
-static unsigned int cur_ver = 0;
-
-
 /*--------------------------------------------------------------------------------
  * See http://geojson.org/geojson-spec.html
  * Arc, AttributeDefinition, BlockReference, Ellipse, Hatch, Line,
@@ -67,163 +60,144 @@ static unsigned int cur_ver = 0;
        },
      ], ...
    }
- *
+ * Each feature is written on one line. As GeoJSON Text Sequence (RFC 8142)
+ * there is no FeatureCollection, and every feature is preceded by RS.
+ */
+
+/* The output goes through the sink of bits.h, see bit_sink_room.
+   dat->bit has GEOJSON_FIRST set until the first element of the current
+   array or hash is written, which decides about the separating comma, and
+   GEOJSON_SEQ for the text sequence. */
+#define GEOJSON_BUFSIZE (256 * 1024)
+#define GEOJSON_FIRST 0x80
+#define GEOJSON_SEQ 0x40
+/* Default decimals of the coordinates, as "%f" */
+#define GEOJSON_PRECISION 6
+/* Segments of a full circle, fewer for arcs */
+#define GEOJSON_CIRCLE_SEGMENTS 64
+#ifndef M_PI
+# define M_PI 3.14159265358979323846264338327950288
+#endif
+
+#define GEOJSON_PUTS(lit) bit_sink_write(dat, lit, sizeof(lit) - 1)
+
+/* Starts the next element, with the comma if not the first */
+static void
+geojson_sep(Bit_Chain *restrict dat)
+{
+  if (dat->bit & GEOJSON_FIRST)
+    dat->bit &= ~GEOJSON_FIRST;
+  else
+    GEOJSON_PUTS(",");
+}
+
+static void
+geojson_open(Bit_Chain *restrict dat, const char c)
+{
+  bit_sink_write(dat, &c, 1);
+  dat->bit |= GEOJSON_FIRST;
+}
+
+static void
+geojson_close(Bit_Chain *restrict dat, const char c)
+{
+  bit_sink_write(dat, &c, 1);
+  dat->bit &= ~GEOJSON_FIRST;
+}
+
+/* A quoted string, with " \ and the control characters escaped */
+static void
+geojson_string(Bit_Chain *restrict dat, const char *restrict s)
+{
+  const char *run;
+
+  GEOJSON_PUTS("\"");
+  if (s)
+    for (run = s;; s++)
+      {
+        const unsigned char c = (unsigned char)*s;
+        char esc[8];
+        if (c >= 0x20 && c != '"' && c != '\\')
+          continue;
+        bit_sink_write(dat, run, s - run);
+        if (!c)
+          break;
+        run = s + 1;
+        esc[0] = '\\';
+        esc[1] = c == '\n' ? 'n' : c == '\r' ? 'r' : c == '\t' ? 't' : (char)c;
+        if (c < 0x20 && esc[1] == (char)c)
+          {
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            bit_sink_write(dat, esc, 6);
+          }
+        else
+          bit_sink_write(dat, esc, 2);
+      }
+  GEOJSON_PUTS("\"");
+}
+
+/* As "%.*f" without the trailing zeros. JSON has no nan nor inf. */
+static void
+geojson_double(Bit_Chain *restrict dat, const double value, const int prec)
+{
+  char *s;
+  int len;
+
+  if (value != value || value - value != 0.0)
+    {
+      GEOJSON_PUTS("null");
+      return;
+    }
+  if (!bit_sink_room(dat, NUMFMT_BUFSIZE))
+    return;
+  s = (char*)&dat->chain[dat->byte];
+  len = numfmt_fixed(s, value, prec);
+  if (memchr(s, '.', len))
+    {
+      while (s[len - 1] == '0')
+        len--;
+      if (s[len - 1] == '.')
+        len--;
+    }
+  dat->byte += len;
+}
+
+/*--------------------------------------------------------------------------------
  * MACROS
  */
 
 #define ACTION geojson
 #define IS_PRINT
 
-#define PREFIX   for (int _i=0; _i<dat->bit; _i++) { fprintf (dat->fh, "  "); }
-#define ARRAY     { PREFIX fprintf (dat->fh, "[\n"); dat->bit++; }
-#define SAMEARRAY { PREFIX fprintf (dat->fh, "["); dat->bit++; }
-#define ENDARRAY  { dat->bit--; PREFIX fprintf (dat->fh, "],\n"); }
-#define LASTENDARRAY { dat->bit--; PREFIX fprintf (dat->fh, "]\n"); }
-#define HASH      { PREFIX fprintf (dat->fh, "{\n"); dat->bit++; }
-#define SAMEHASH  { fprintf (dat->fh, "{\n"); dat->bit++; }
-#define ENDHASH   { dat->bit--; PREFIX fprintf (dat->fh, "},\n"); }
-#define LASTENDHASH { dat->bit--; PREFIX fprintf (dat->fh, "}\n"); }
-#define SECTION(name) { PREFIX fprintf (dat->fh, "\"%s\": [\n", #name); dat->bit++; }
-#define ENDSEC()  ENDARRAY
-#define NOCOMMA   fseek(dat->fh, -2, SEEK_CUR)
-#define PAIR_S(name, value) \
-    { PREFIX fprintf(dat->fh, "\"" #name "\": \"%s\",\n", value); }
-#define LASTPAIR_S(name, value) \
-    { PREFIX fprintf(dat->fh, "\"" #name "\": \"%s\"\n", value); }
-#define PAIR_NULL(name) \
-    { PREFIX fprintf(dat->fh, "\"" #name "\": null,\n"); }
-#define KEY(name) \
-    { PREFIX fprintf(dat->fh, "\"" #name "\": "); }
+#define KEY(name)  { geojson_sep(dat); GEOJSON_PUTS("\"" #name "\":"); }
+#define ARRAY      geojson_open(dat, '[')
+#define ENDARRAY   geojson_close(dat, ']')
+#define HASH       geojson_open(dat, '{')
+#define ENDHASH    geojson_close(dat, '}')
+#define PAIR_S(name, value) { KEY(name); geojson_string(dat, value); }
+#define PAIR_NULL(name) { KEY(name); GEOJSON_PUTS("null"); }
 #define GEOMETRY(name) \
-    { KEY(geometry); SAMEHASH; \
+    { KEY(geometry); HASH; \
     PAIR_S(type, #name) }
-#define ENDGEOMETRY LASTENDHASH
-
-//#define VALUE(value,type,dxf)
-//    fprintf(dat->fh, FORMAT_##type, value)
-//#define VALUE_RC(value,dxf) VALUE(value, RC, dxf)
-
-#define FIELD(name,type,dxf)
-//    PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_##type ",\n", _obj->name)
-#define _FIELD(name,type,value)
-//    PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_##type ",\n", obj->name)
-#define ENT_FIELD(name,type,value)
-//    PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_##type ",\n", _ent->name)
-#define FIELD_CAST(name,type,cast,dxf) FIELD(name,cast,dxf)
-#define FIELD_TRACE(name,type)
-#define FIELD_TEXT(name,str)
-#define FIELD_TEXT_TU(name,wstr)
-
-#define FIELD_VALUE(name) _obj->name
-#define ANYCODE -1
-// todo: only the name, not the ref
-#define FIELD_HANDLE(name, handle_code, dxf)
-#define FIELD_DATAHANDLE(name, code, dxf)
-#define FIELD_HANDLE_N(name, vcount, handle_code, dxf)
-#define FIELD_B(name,dxf)   FIELD(name, B, dxf)
-#define FIELD_BB(name,dxf)  FIELD(name, BB, dxf)
-#define FIELD_3B(name,dxf)  FIELD(name, 3B, dxf)
-#define FIELD_BS(name,dxf)  FIELD(name, BS, dxf)
-#define FIELD_BL(name,dxf)  FIELD(name, BL, dxf)
-#define FIELD_BLL(name,dxf) FIELD(name, BLL, dxf)
-#define FIELD_BD(name,dxf)  FIELD(name, BD, dxf)
-#define FIELD_RC(name,dxf)  FIELD(name, RC, dxf)
-#define FIELD_RS(name,dxf)  FIELD(name, RS, dxf)
-#define FIELD_RD(name,dxf)  FIELD(name, RD, dxf)
-#define FIELD_RL(name,dxf)  FIELD(name, RL, dxf)
-#define FIELD_RLL(name,dxf) FIELD(name, RLL, dxf)
-#define FIELD_MC(name,dxf)  FIELD(name, MC, dxf)
-#define FIELD_MS(name,dxf)  FIELD(name, MS, dxf)
-#define FIELD_TF(name,len,dxf)  FIELD_TEXT(name, _obj->name)
-#define FIELD_TFF(name,len,dxf) FIELD_TEXT(name, _obj->name)
-#define FIELD_TV(name,dxf)      FIELD_TEXT(name, _obj->name)
-#define FIELD_TU(name,dxf)      FIELD_TEXT_TU(name, (BITCODE_TU)_obj->name)
-#define FIELD_T(name,dxf)
-//  { if (dat->version >= R_2007) { FIELD_TU(name, dxf); }
-//    else                        { FIELD_TV(name, dxf); } }
-#define FIELD_BT(name,dxf)    FIELD(name, BT, dxf);
-#define FIELD_4BITS(name,dxf) FIELD(name,4BITS,dxf)
-#define FIELD_BE(name,dxf)    FIELD_3RD(name,dxf)
-#define FIELD_DD(name, _default, dxf) \
-    PREFIX fprintf(dat->fh, FORMAT_DD ", ", _obj->name)
-#define FIELD_2DD(name, d1, d2, dxf)
-#define FIELD_3DD(name, def, dxf)
-#define FIELD_2RD(name,dxf)
-#define FIELD_2BD(name,dxf)
-#define FIELD_2BD_1(name,dxf)
-#define FIELD_3RD(name,dxf) ;
-#define FIELD_3BD(name,dxf)
-#define FIELD_3BD_1(name,dxf)
-#define VALUE_2DPOINT(px, py) \
-  PREFIX fprintf(dat->fh, "[ " FORMAT_DD ", " FORMAT_DD " ],\n", px, py)
-#define LASTVALUE_2DPOINT(px, py) \
-  PREFIX fprintf(dat->fh, "[ " FORMAT_DD ", " FORMAT_DD " ]\n", px, py)
-#define FIELD_2DPOINT(name)     VALUE_2DPOINT(_obj->name.x, _obj->name.y)
-#define LASTFIELD_2DPOINT(name) LASTVALUE_2DPOINT(_obj->name.x, _obj->name.y)
-#define VALUE_3DPOINT(px, py, pz) \
-    PREFIX fprintf(dat->fh, "[ " FORMAT_DD ", " FORMAT_DD ", " FORMAT_DD " ],\n", \
-            px, py, pz)
-#define LASTVALUE_3DPOINT(px, py, pz) \
-    PREFIX fprintf(dat->fh, "[ " FORMAT_DD ", " FORMAT_DD ", " FORMAT_DD " ]\n", \
-            px, py, pz)
-#define FIELD_3DPOINT(name)     VALUE_3DPOINT(_obj->name.x, _obj->name.y, _obj->name.z)
-#define LASTFIELD_3DPOINT(name) LASTVALUE_3DPOINT(_obj->name.x, _obj->name.y, _obj->name.z)
-#define FIELD_CMC(name,dxf1,dxf2)
-#define FIELD_TIMEBLL(name,dxf)
-
-//FIELD_VECTOR_N(name, type, size):
-// reads data of the type indicated by 'type' 'size' times and stores
-// it all in the vector called 'name'.
-#define FIELD_VECTOR_N(name, type, size, dxf)\
-    ARRAY; \
-    for (vcount=0; vcount < (BITCODE_BL)size; vcount++)\
-      {\
-        PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_##type ",\n", _obj->name[vcount]); \
-      }\
-    if (size) NOCOMMA;\
-    ENDARRAY;
-#define FIELD_VECTOR_T(name, size, dxf)\
-    ARRAY; \
-    PRE (R_2007) { \
-      for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++) { \
-        PREFIX fprintf(dat->fh, "\"" #name "\": \"%s\",\n", _obj->name[vcount]); \
-      }\
-    } else { \
-      for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++)\
-        FIELD_TEXT_TU(name, _obj->name[vcount]); \
-    } \
-    if (_obj->size) NOCOMMA;\
-    ENDARRAY;
-
-#define FIELD_VECTOR(name, type, size, dxf) FIELD_VECTOR_N(name, type, _obj->size, dxf)
-
-#define FIELD_2RD_VECTOR(name, size, dxf)\
-  ARRAY;\
-  for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++)\
-    {\
-      FIELD_2RD(name[vcount], dxf);\
-    }\
-  if (_obj->size) NOCOMMA;\
-  ENDARRAY;
-
-#define FIELD_2DD_VECTOR(name, size, dxf)\
-  ARRAY;\
-  FIELD_2RD(name[0], 0);\
-  for (vcount = 1; vcount < (BITCODE_BL)_obj->size; vcount++)\
-    {\
-      FIELD_2DD(name[vcount], FIELD_VALUE(name[vcount - 1].x), FIELD_VALUE(name[vcount - 1].y), dxf);\
-    }\
-  if (_obj->size) NOCOMMA;\
-  ENDARRAY;
-
-#define FIELD_3DPOINT_VECTOR(name, size, dxf)\
-  ARRAY;\
-  for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++)\
-    {\
-      FIELD_3DPOINT(name[vcount], dxf);\
-    }\
-  if (_obj->size) NOCOMMA;\
-  ENDARRAY;
+#define ENDGEOMETRY ENDHASH
+
+/* the coordinates with prec decimals, in scope */
+#define VALUE_2DPOINT(px, py) { \
+    geojson_sep(dat); GEOJSON_PUTS("["); \
+    geojson_double(dat, px, prec); GEOJSON_PUTS(","); \
+    geojson_double(dat, py, prec); GEOJSON_PUTS("]"); }
+#define VALUE_3DPOINT(px, py, pz) { \
+    geojson_sep(dat); GEOJSON_PUTS("["); \
+    geojson_double(dat, px, prec); GEOJSON_PUTS(","); \
+    geojson_double(dat, py, prec); GEOJSON_PUTS(","); \
+    geojson_double(dat, pz, prec); GEOJSON_PUTS("]"); }
+/* 2D if z is 0 */
+#define VALUE_POINT(px, py, pz) \
+  if (fabs(pz) > 0.000001) VALUE_3DPOINT(px, py, pz) \
+  else VALUE_2DPOINT(px, py)
+#define FIELD_2DPOINT(name) VALUE_2DPOINT(_obj->name.x, _obj->name.y)
+#define FIELD_3DPOINT(name) \
+  VALUE_3DPOINT(_obj->name.x, _obj->name.y, _obj->name.z)
 
 #define WARN_UNSTABLE_CLASS \
       LOG_WARN("Unstable Class %s %d %s (0x%x%s) -@%ld", is_entity ? "entity" : "object",\
@@ -231,21 +205,65 @@ static unsigned int cur_ver = 0;
                klass->wasazombie ? " was proxy" : "",\
                obj->address + obj->size)
 
+/* The name of the table record ref, or NULL */
+static const char *
+geojson_table_name(const Dwg_Object_Ref *restrict ref)
+{
+  return ref && ref->obj ? dwg_obj_table_utf8name(ref->obj) : NULL;
+}
+
+/* The block of an INSERT or MINSERT, as the OGR DXF driver writes it
+   without inlined blocks: its name, rotation in degrees and scale */
+static void
+geojson_block_properties(Bit_Chain *restrict dat,
+                         const Dwg_Object_Ref *restrict block_header,
+                         const BITCODE_3DPOINT *restrict scale,
+                         const double rotation, const int prec)
+{
+  const char *name = geojson_table_name(block_header);
+  if (name)
+    PAIR_S(BlockName, name)
+  else
+    PAIR_NULL(BlockName);
+  KEY(BlockAngle);
+  geojson_double(dat, rotation * 180.0 / M_PI, prec);
+  KEY(BlockScale);
+  dat->bit |= GEOJSON_FIRST;
+  VALUE_3DPOINT(scale->x, scale->y, scale->z);
+}
+
 // common properties
 static void
-dwg_geojson_feature(Bit_Chain *restrict dat, Dwg_Object *restrict obj,
-                    const char *restrict subclass)
+dwg_geojson_feature(Bit_Chain *restrict dat, const Dwg_Object *restrict obj,
+                    const char *restrict subclass, const int prec)
 {
   char tmp[64];
+  const char *name;
+
+  if (dat->bit & GEOJSON_SEQ)
+    GEOJSON_PUTS("\x1e"); // RS
+  else
+    {
+      geojson_sep(dat);
+      GEOJSON_PUTS("\n    ");
+    }
+  HASH;
   PAIR_S(type, "Feature");
   KEY(properties);
-  SAMEHASH;
-  PAIR_S(Layer, "0"); //TODO layer name
+  HASH;
+    name = obj->supertype == DWG_SUPERTYPE_ENTITY
+      ? geojson_table_name(obj->tio.entity->layer) : NULL;
+    PAIR_S(Layer, name ? name : "0");
     PAIR_S(SubClasses, subclass);
     PAIR_NULL(ExtendedEntity);
-    PAIR_NULL(Linetype);
+    name = obj->supertype == DWG_SUPERTYPE_ENTITY
+      ? geojson_table_name(obj->tio.entity->ltype) : NULL;
+    if (name)
+      PAIR_S(Linetype, name)
+    else
+      PAIR_NULL(Linetype);
 
-    sprintf(tmp, "%lX", obj->handle.value);
+    snprintf(tmp, sizeof(tmp), "%lX", obj->handle.value);
     PAIR_S(EntityHandle, tmp);
     //TODO if has name or text
     if (obj->type == DWG_TYPE_GEOPOSITIONMARKER) {
@@ -254,17 +272,294 @@ dwg_geojson_feature(Bit_Chain *restrict dat, Dwg_Object *restrict obj,
     }
     else
       PAIR_NULL(Text);
+    if (obj->type == DWG_TYPE_INSERT)
+      {
+        Dwg_Entity_INSERT *_obj = obj->tio.entity->tio.INSERT;
+        geojson_block_properties(dat, _obj->block_header, &_obj->scale,
+                                 _obj->rotation, prec);
+      }
+    else if (obj->type == DWG_TYPE_MINSERT)
+      {
+        Dwg_Entity_MINSERT *_obj = obj->tio.entity->tio.MINSERT;
+        geojson_block_properties(dat, _obj->block_header, &_obj->scale,
+                                 _obj->rotation, prec);
+      }
   ENDHASH;
 }
 
-#define FEATURE(subclass, obj) HASH; dwg_geojson_feature(dat, obj, #subclass)
-#define ENDFEATURE ENDHASH
+#define FEATURE(subclass, obj) dwg_geojson_feature(dat, obj, #subclass, prec)
+#define ENDFEATURE \
+  { ENDHASH; \
+    if (dat->bit & GEOJSON_SEQ) GEOJSON_PUTS("\n"); }
+
+/* The OCS of extrusion, by the arbitrary axis algorithm of the DXF
+   reference: its x, y and z axis in the WCS. Returns 0 if it is the WCS,
+   or the extrusion is invalid. */
+static int
+geojson_ocs(const BITCODE_BE *restrict extrusion, double ocs[3][3])
+{
+  const double len = sqrt(extrusion->x * extrusion->x
+                          + extrusion->y * extrusion->y
+                          + extrusion->z * extrusion->z);
+  double *ax = ocs[0], *ay = ocs[1], *az = ocs[2];
+  double n;
+
+  if (len < 1e-12
+      || (fabs(extrusion->x) < 1e-12 && fabs(extrusion->y) < 1e-12
+          && extrusion->z > 0.0))
+    return 0;
+  az[0] = extrusion->x / len;
+  az[1] = extrusion->y / len;
+  az[2] = extrusion->z / len;
+  // Ax = Wy x N, or Wz x N near the poles
+  if (fabs(az[0]) < 1.0 / 64 && fabs(az[1]) < 1.0 / 64)
+    {
+      ax[0] = az[2];
+      ax[1] = 0.0;
+      ax[2] = -az[0];
+    }
+  else
+    {
+      ax[0] = -az[1];
+      ax[1] = az[0];
+      ax[2] = 0.0;
+    }
+  n = sqrt(ax[0] * ax[0] + ax[1] * ax[1] + ax[2] * ax[2]);
+  ax[0] /= n;
+  ax[1] /= n;
+  ax[2] /= n;
+  // Ay = N x Ax
+  ay[0] = az[1] * ax[2] - az[2] * ax[1];
+  ay[1] = az[2] * ax[0] - az[0] * ax[2];
+  ay[2] = az[0] * ax[1] - az[1] * ax[0];
+  return 1;
+}
+
+/* The OCS point x,y,z as WCS point w */
+static void
+geojson_ocs_wcs(const double ocs[3][3], const double x, const double y,
+                const double z, double w[3])
+{
+  int i;
+  for (i = 0; i < 3; i++)
+    w[i] = x * ocs[0][i] + y * ocs[1][i] + z * ocs[2][i];
+}
+
+/* A closed ring as Polygon, else a LineString. pts are x,y pairs in the
+   OCS of extrusion, at elevation. The points are written in the WCS. */
+static void
+geojson_2dpolyline(Bit_Chain *restrict dat, const double *restrict pts,
+                   const BITCODE_BL num_pts, const int closed,
+                   const double elevation,
+                   const BITCODE_BE *restrict extrusion, const int prec)
+{
+  BITCODE_BL j;
+  double ocs[3][3];
+  const int is_ocs = geojson_ocs(extrusion, ocs);
+  const int is_ring = closed && num_pts >= 3;
+
+  if (is_ring)
+    {
+      GEOMETRY(Polygon);
+      KEY(coordinates);
+      ARRAY;
+      geojson_sep(dat);
+    }
+  else
+    {
+      GEOMETRY(LineString);
+      KEY(coordinates);
+    }
+  ARRAY;
+  // the ring ends with its first point
+  for (j = 0; j < num_pts + (is_ring ? 1 : 0); j++)
+    {
+      const double *pt = &pts[2 * (j < num_pts ? j : 0)];
+      if (is_ocs)
+        {
+          double w[3];
+          geojson_ocs_wcs(ocs, pt[0], pt[1], elevation, w);
+          VALUE_POINT(w[0], w[1], w[2]);
+        }
+      else
+        VALUE_POINT(pt[0], pt[1], elevation);
+    }
+  ENDARRAY;
+  if (is_ring)
+    ENDARRAY;
+  ENDGEOMETRY;
+}
+
+/* Appends the point of vobj to pts, with dim coordinates, if it is a
+   vertex of vtype. Returns 0 if out of memory. */
+static int
+geojson_add_vertex(const Dwg_Object *restrict vobj,
+                   const Dwg_Object_Type vtype, const int dim,
+                   double **restrict pts, BITCODE_BL *restrict n,
+                   BITCODE_BL *restrict size)
+{
+  const BITCODE_3BD *pt;
+
+  if (!vobj || vobj->fixedtype != vtype || !vobj->tio.entity)
+    return 1;
+  pt = vtype == DWG_TYPE_VERTEX_2D ? &vobj->tio.entity->tio.VERTEX_2D->point
+                                   : &vobj->tio.entity->tio.VERTEX_3D->point;
+  if (*n == *size)
+    {
+      double *tmp;
+      *size = *size ? 2 * *size : 16;
+      tmp = (double *)realloc(*pts, *size * dim * sizeof(double));
+      if (!tmp)
+        return 0;
+      *pts = tmp;
+    }
+  (*pts)[dim * *n] = pt->x;
+  (*pts)[dim * *n + 1] = pt->y;
+  if (dim == 3)
+    (*pts)[dim * *n + 2] = pt->z;
+  (*n)++;
+  return 1;
+}
+
+/* The points of the vertices of a POLYLINE_2D or POLYLINE_3D, with dim
+   coordinates each, in a new array. Refs which don't resolve to a vertex
+   of vtype are skipped. Returns the number of points. */
+static BITCODE_BL
+geojson_polyline_points(const Dwg_Object *restrict obj,
+                        const BITCODE_BL num_owned,
+                        const Dwg_Object_Ref *const *restrict vertex,
+                        const Dwg_Object_Ref *restrict first_vertex,
+                        const Dwg_Object_Ref *restrict last_vertex,
+                        const Dwg_Object_Type vtype, const int dim,
+                        double **restrict pts)
+{
+  const Dwg_Data *dwg = obj->parent;
+  BITCODE_BL i, n = 0, size = 0;
+
+  *pts = NULL;
+  if (dwg->header.version >= R_2004)
+    {
+      for (i = 0; vertex && i < num_owned; i++)
+        if (!geojson_add_vertex(dwg_ref_object_const(dwg, vertex[i]), vtype,
+                                dim, pts, &n, &size))
+          break;
+    }
+  else
+    {
+      // the vertices follow the polyline, until the last or the SEQEND
+      const Dwg_Object *vobj = dwg->header.version >= R_13
+        ? dwg_ref_object_const(dwg, first_vertex) : dwg_next_object(obj);
+      const Dwg_Object *vlast = dwg->header.version >= R_13
+        ? dwg_ref_object_const(dwg, last_vertex) : NULL;
+      for (; vobj && vobj->fixedtype != DWG_TYPE_SEQEND;
+           vobj = dwg_next_object(vobj))
+        {
+          if (!geojson_add_vertex(vobj, vtype, dim, pts, &n, &size)
+              || vobj == vlast)
+            break;
+        }
+    }
+  return n;
+}
+
+/* A circle as Polygon, or an arc from start to end counter-clockwise as
+   LineString, in the plane of the center. center and the angles are in
+   the OCS of extrusion, the points are written in the WCS. */
+static void
+geojson_arc(Bit_Chain *restrict dat, const BITCODE_3BD *restrict center,
+            const BITCODE_BE *restrict extrusion, const double radius,
+            const double start, double end, const int circle, const int prec)
+{
+  BITCODE_BL j, num_segs;
+  double ocs[3][3];
+  const int is_ocs = geojson_ocs(extrusion, ocs);
+
+  if (circle)
+    {
+      end = start + 2 * M_PI;
+      num_segs = GEOJSON_CIRCLE_SEGMENTS;
+      GEOMETRY(Polygon);
+      KEY(coordinates);
+      ARRAY;
+      geojson_sep(dat);
+    }
+  else
+    {
+      while (end <= start)
+        end += 2 * M_PI;
+      num_segs = (BITCODE_BL)ceil(GEOJSON_CIRCLE_SEGMENTS * (end - start)
+                                  / (2 * M_PI));
+      if (num_segs < 2)
+        num_segs = 2;
+      GEOMETRY(LineString);
+      KEY(coordinates);
+    }
+  ARRAY;
+  for (j = 0; j <= num_segs; j++)
+    {
+      // the last point of the ring exactly as the first
+      const double a = circle && j == num_segs
+        ? start : start + (end - start) * j / num_segs;
+      const double x = center->x + radius * cos(a);
+      const double y = center->y + radius * sin(a);
+      if (is_ocs)
+        {
+          double w[3];
+          geojson_ocs_wcs(ocs, x, y, center->z, w);
+          VALUE_POINT(w[0], w[1], w[2]);
+        }
+      else
+        VALUE_POINT(x, y, center->z);
+    }
+  ENDARRAY;
+  if (circle)
+    ENDARRAY;
+  ENDGEOMETRY;
+}
+
+/* The insertion point in the WCS. The block itself is not exploded, only
+   named in the properties. */
+static void
+geojson_insert_point(Bit_Chain *restrict dat,
+                     const BITCODE_3DPOINT *restrict ins_pt,
+                     const BITCODE_BE *restrict extrusion, const int prec)
+{
+  double ocs[3][3];
+  double w[3];
+
+  if (geojson_ocs(extrusion, ocs))
+    geojson_ocs_wcs(ocs, ins_pt->x, ins_pt->y, ins_pt->z, w);
+  else
+    {
+      w[0] = ins_pt->x;
+      w[1] = ins_pt->y;
+      w[2] = ins_pt->z;
+    }
+  GEOMETRY(Point);
+  KEY(coordinates);
+  dat->bit |= GEOJSON_FIRST;
+  VALUE_3DPOINT(w[0], w[1], w[2]);
+  ENDGEOMETRY;
+}
+
+static void
+geojson_lwpolyline(Bit_Chain *restrict dat, const Dwg_Object *restrict obj,
+                   const int prec)
+{
+  Dwg_Entity_LWPOLYLINE *_obj = obj->tio.entity->tio.LWPOLYLINE;
+  FEATURE(AcDbEntity:AcDbLwPolyline, obj);
+  geojson_2dpolyline(dat, _obj->points ? &_obj->points[0].x : NULL,
+                     _obj->points ? _obj->num_points : 0,
+                     _obj->flag & 512, _obj->elevation, &_obj->extrusion,
+                     prec);
+  ENDFEATURE;
+}
 
 /* returns 0 if object could be printed
  */
 static int
-dwg_geojson_variable_type(Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
-                          Dwg_Object *restrict obj)
+dwg_geojson_variable_type(const Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
+                          const Dwg_Object *restrict obj, const int prec)
 {
   int i;
   char *dxfname;
@@ -284,26 +579,11 @@ dwg_geojson_variable_type(Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
 
   if (!strcmp(dxfname, "LWPOLYLINE"))
     {
-      BITCODE_BL j;
-      Dwg_Entity_LWPOLYLINE *_obj = obj->tio.entity->tio.LWPOLYLINE;
-      //TODO: if closed and num_points > 3 use a Polygon
-      FEATURE(AcDbEntity:AcDbLwPolyline, obj);
-      GEOMETRY(LineString);
-      KEY(coordinates);
-        ARRAY;
-        for (j = 0; j < _obj->num_points-1 ; j++)
-        {
-          FIELD_2DPOINT(points[j]);
-        }
-        LASTFIELD_2DPOINT(points[j+1]);
-        LASTENDARRAY;
-      ENDGEOMETRY;
-      ENDFEATURE;
+      geojson_lwpolyline(dat, obj, prec);
       return 0;
     }
   if (!strcmp(dxfname, "GEODATA"))
     {
-      Dwg_Object_GEODATA *_obj = obj->tio.object->tio.GEODATA;
       WARN_UNSTABLE_CLASS;
       FEATURE(AcDbObject:AcDbGeoData, obj);
       //which fields?
@@ -318,14 +598,8 @@ dwg_geojson_variable_type(Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
       FEATURE(AcDbEntity:AcDbGeoPositionMarker, obj);
       GEOMETRY(Point);
       KEY(coordinates);
-      if (fabs(_obj->position.z) > 0.000001)
-        {
-          VALUE_3DPOINT(_obj->position.x, _obj->position.y, _obj->position.z);
-        }
-      else
-        {
-          VALUE_2DPOINT(_obj->position.x, _obj->position.y);
-        }
+      dat->bit |= GEOJSON_FIRST;
+      VALUE_POINT(_obj->position.x, _obj->position.y, _obj->position.z);
       ENDGEOMETRY;
       ENDFEATURE;
       return 0;
@@ -335,24 +609,28 @@ dwg_geojson_variable_type(Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
 }
 
 static void
-dwg_geojson_object(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
+dwg_geojson_object(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg,
+                   const Dwg_Object *restrict obj, const int prec)
 {
+  if (!obj->tio.entity) // not decoded
+    return;
   switch (obj->type)
     {
     case DWG_TYPE_INSERT:
       {
         Dwg_Entity_INSERT *_obj = obj->tio.entity->tio.INSERT;
         FEATURE(AcDbEntity:AcDbBlockReference, obj);
-        //TODO: explode insert into a GeometryCollection
-        GEOMETRY(Point);
-        KEY(coordinates);
-        ARRAY; LASTFIELD_3DPOINT(ins_pt); LASTENDARRAY;
-        ENDGEOMETRY;
+        geojson_insert_point(dat, &_obj->ins_pt, &_obj->extrusion, prec);
         ENDFEATURE;
       }
       break;
     case DWG_TYPE_MINSERT:
-      //dwg_geojson_MINSERT(dat, obj);
+      {
+        Dwg_Entity_MINSERT *_obj = obj->tio.entity->tio.MINSERT;
+        FEATURE(AcDbEntity:AcDbMInsertBlock, obj);
+        geojson_insert_point(dat, &_obj->ins_pt, &_obj->extrusion, prec);
+        ENDFEATURE;
+      }
       break;
     case DWG_TYPE_VERTEX_2D:
       //dwg_geojson_VERTEX_2D(dat, obj);
@@ -371,63 +649,72 @@ dwg_geojson_object(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
       break;
     case DWG_TYPE_POLYLINE_2D:
       {
-        int error;
-        BITCODE_BL j, numpts;
-        dwg_point_2d *pts;
-        FEATURE(AcDbEntity:AcDbPolyline, obj);
-        GEOMETRY(MultiLineString);
-        KEY(coordinates);
-          ARRAY;
-          numpts = dwg_object_polyline_2d_get_numpoints(obj, &error);
-          pts = dwg_object_polyline_2d_get_points(obj, &error);
-          for (j=0; j<numpts; j++)
-            {
-              if (j == numpts-1)
-                {
-                  LASTVALUE_2DPOINT(pts[j].x, pts[j].y);
-                }
-              else
-                {
-                  VALUE_2DPOINT(pts[j].x, pts[j].y);
-                }
-            }
-          LASTENDARRAY;
-        ENDGEOMETRY;
+        Dwg_Entity_POLYLINE_2D *_obj = obj->tio.entity->tio.POLYLINE_2D;
+        double *pts;
+        const BITCODE_BL numpts = geojson_polyline_points(
+            obj, _obj->num_owned, (const Dwg_Object_Ref *const *)_obj->vertex,
+            _obj->first_vertex, _obj->last_vertex, DWG_TYPE_VERTEX_2D, 2,
+            &pts);
+        FEATURE(AcDbEntity:AcDb2dPolyline, obj);
+        geojson_2dpolyline(dat, pts, numpts, _obj->flag & 1, _obj->elevation,
+                           &_obj->extrusion, prec);
         ENDFEATURE;
+        free(pts);
       }
       break;
     case DWG_TYPE_POLYLINE_3D:
       {
-        int error;
-        BITCODE_BL j, numpts;
-        dwg_point_3d *pts;
-        FEATURE(AcDbEntity:AcDbPolyline, obj);
-        GEOMETRY(MultiLineString);
-        KEY(coordinates);
-          ARRAY;
-          numpts = dwg_object_polyline_3d_get_numpoints(obj, &error);
-          pts = dwg_object_polyline_3d_get_points(obj, &error);
-          for (j=0; j<numpts; j++)
-            {
-              if (j == numpts-1)
-                {
-                  LASTVALUE_3DPOINT(pts[j].x, pts[j].y, pts[j].z);
-                }
-              else
-                {
-                  VALUE_3DPOINT(pts[j].x, pts[j].y, pts[j].z);
-                }
-            }
-          LASTENDARRAY;
+        BITCODE_BL j;
+        Dwg_Entity_POLYLINE_3D *_obj = obj->tio.entity->tio.POLYLINE_3D;
+        double *pts;
+        const BITCODE_BL numpts = geojson_polyline_points(
+            obj, _obj->num_owned, (const Dwg_Object_Ref *const *)_obj->vertex,
+            _obj->first_vertex, _obj->last_vertex, DWG_TYPE_VERTEX_3D, 3,
+            &pts);
+        const int closed = (_obj->flag & 1) && numpts >= 3;
+        FEATURE(AcDbEntity:AcDb3dPolyline, obj);
+        if (closed)
+          {
+            GEOMETRY(Polygon);
+            KEY(coordinates);
+            ARRAY;
+            geojson_sep(dat);
+          }
+        else
+          {
+            GEOMETRY(LineString);
+            KEY(coordinates);
+          }
+        ARRAY;
+        for (j = 0; j < numpts; j++)
+          VALUE_3DPOINT(pts[3 * j], pts[3 * j + 1], pts[3 * j + 2]);
+        if (closed)
+          VALUE_3DPOINT(pts[0], pts[1], pts[2]);
+        ENDARRAY;
+        if (closed)
+          ENDARRAY;
         ENDGEOMETRY;
         ENDFEATURE;
+        free(pts);
       }
       break;
     case DWG_TYPE_ARC:
-      //dwg_geojson_ARC(dat, obj);
+      {
+        Dwg_Entity_ARC *_obj = obj->tio.entity->tio.ARC;
+        FEATURE(AcDbEntity:AcDbCircle:AcDbArc, obj);
+        geojson_arc(dat, &_obj->center, &_obj->extrusion, _obj->radius,
+                    _obj->start_angle, _obj->end_angle, 0, prec);
+        ENDFEATURE;
+      }
       break;
     case DWG_TYPE_CIRCLE:
-      //dwg_geojson_CIRCLE(dat, obj);
+      {
+        Dwg_Entity_CIRCLE *_obj = obj->tio.entity->tio.CIRCLE;
+        FEATURE(AcDbEntity:AcDbCircle, obj);
+        geojson_arc(dat, &_obj->center, &_obj->extrusion, _obj->radius, 0.0,
+                    0.0, 1, prec);
+        ENDFEATURE;
+      }
       break;
     case DWG_TYPE_LINE:
       {
@@ -436,8 +723,9 @@ dwg_geojson_object(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
         GEOMETRY(LineString);
         KEY(coordinates);
           ARRAY;
-          FIELD_3DPOINT(start); LASTFIELD_3DPOINT(end);
-          LASTENDARRAY;
+          FIELD_3DPOINT(start);
+          FIELD_3DPOINT(end);
+          ENDARRAY;
         ENDGEOMETRY;
         ENDFEATURE;
       }
@@ -448,14 +736,8 @@ dwg_geojson_object(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
         FEATURE(AcDbEntity:AcDbPoint, obj);
         GEOMETRY(Point);
         KEY(coordinates);
-        if (fabs(_obj->z) > 0.000001)
-          {
-            VALUE_3DPOINT(_obj->x, _obj->y, _obj->z);
-          }
-        else
-          {
-            VALUE_2DPOINT(_obj->x, _obj->y);
-          }
+        dat->bit |= GEOJSON_FIRST;
+        VALUE_POINT(_obj->x, _obj->y, _obj->z);
         ENDGEOMETRY;
         ENDFEATURE;
       }
@@ -507,62 +789,106 @@ dwg_geojson_object(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
       //dwg_geojson_MLINE(dat, obj);
       break;
     case DWG_TYPE_LWPOLYLINE:
-      //dwg_geojson_LWPOLYLINE(dat, obj);
+      geojson_lwpolyline(dat, obj, prec);
       break;
     default:
-      if (obj->type != obj->parent->layout_number)
-        dwg_geojson_variable_type(obj->parent, dat, obj);
+      if (obj->type != dwg->layout_number)
+        dwg_geojson_variable_type(dwg, dat, obj, prec);
     }
 }
 
 static int
-geojson_entities_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+geojson_entities_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   BITCODE_BL i;
+  const int prec = dwg->geojson_precision > 0 && dwg->geojson_precision <= 17
+    ? (int)dwg->geojson_precision : GEOJSON_PRECISION;
 
-  SECTION(features);
   for (i=0; i < dwg->num_objects; i++)
-    {
-      Dwg_Object *obj = &dwg->object[i];
-      dwg_geojson_object(dat, obj);
-    }
-  NOCOMMA;
-  ENDSEC();
+    dwg_geojson_object(dat, dwg, &dwg->object[i], prec);
   return 0;
 }
 
+/* Starts the sink, with the mode flags */
+static int
+geojson_begin(Bit_Chain *restrict dat, const int mode)
+{
+  if (bit_sink_begin(dat, GEOJSON_BUFSIZE))
+    return DWG_ERR_OUTOFMEM;
+  dat->bit = mode;
+  return 0;
+}
+
+static int
+geojson_end(Bit_Chain *restrict dat, const Bit_Chain *restrict orig,
+            const int error)
+{
+  dat->bit = orig->bit;
+  return bit_sink_end(dat, orig, error);
+}
+
 EXPORT int
-dwg_write_geojson(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dwg_write_geojson(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   //const int minimal = dwg->opts & 0x10;
+  const Bit_Chain orig = *dat;
   char date[12] = "YYYY-MM-DD";
   time_t rawtime;
+#ifdef HAVE_LOCALTIME_R
+  struct tm tm;
+#endif
+  int error = 0;
 
-  HASH;
-  PAIR_S(type, "FeatureCollection");
+  if (geojson_begin(dat, GEOJSON_FIRST))
+    {
+      *dat = orig;
+      return DWG_ERR_OUTOFMEM;
+    }
+  GEOJSON_PUTS("{\n  \"type\": \"FeatureCollection\",\n  \"features\": [");
 
   //array of features
+  dat->bit |= GEOJSON_FIRST;
   if (geojson_entities_write (dat, dwg))
-    goto fail;
+    error = 1;
+  GEOJSON_PUTS("\n  ],\n  \"geocoding\": ");
 
-  KEY(geocoding);
+  dat->bit = 0;
   HASH;
     time(&rawtime);
+#ifdef HAVE_LOCALTIME_R
+    strftime(date, 12, "%Y-%m-%d", localtime_r(&rawtime, &tm));
+#else
     strftime(date, 12, "%Y-%m-%d", localtime(&rawtime));
+#endif
     PAIR_S(creation_date, date);
     KEY(generator);
     HASH;
       KEY(author); HASH; PAIR_S(name, "dwgread"); ENDHASH;
       PAIR_S(package, PACKAGE_NAME);
-      LASTPAIR_S(version, PACKAGE_VERSION);
-    LASTENDHASH;
+      PAIR_S(version, PACKAGE_VERSION);
+    ENDHASH;
     //PAIR_S(license, "?");
-  LASTENDHASH;
+  ENDHASH;
+  GEOJSON_PUTS("\n}\n");
 
-  LASTENDHASH;
-  return 0;
- fail:
-  return 1;
+  return geojson_end(dat, &orig, error);
+}
+
+/* GeoJSON Text Sequence, RFC 8142 */
+EXPORT int
+dwg_write_geojsonseq(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
+{
+  const Bit_Chain orig = *dat;
+  int error = 0;
+
+  if (geojson_begin(dat, GEOJSON_SEQ))
+    {
+      *dat = orig;
+      return DWG_ERR_OUTOFMEM;
+    }
+  if (geojson_entities_write (dat, dwg))
+    error = 1;
+  return geojson_end(dat, &orig, error);
 }
 
 #undef IS_PRINT
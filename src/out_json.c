@@ -26,12 +26,165 @@
 #include "dwg.h"
 #include "decode.h"
 #include "out_json.h"
+#include "numfmt.h"
 
 #define DWG_LOGLEVEL DWG_LOGLEVEL_NONE
 #include "logging.h"
 
 /* the current version per spec block */
-static unsigned int cur_ver = 0;
+static THREAD_LOCAL unsigned int cur_ver = 0;
+
+/* The output goes through the sink of bits.h, see bit_sink_room.
+   dat->bit is the nesting depth, with JSON_FIRST set until the first
+   element of the current array or hash is written, which decides about
+   the separating comma. */
+#define JSON_BUFSIZE (256 * 1024)
+#define JSON_FIRST 0x80
+#define JSON_DEPTH(dat) ((dat)->bit & ~JSON_FIRST)
+
+#define JSON_PUTS(lit) bit_sink_write(dat, lit, sizeof(lit) - 1)
+
+/* Starts the next element: the comma if not the first, the newline and
+   the indentation */
+static void
+json_sep(Bit_Chain *restrict dat)
+{
+  const unsigned depth = JSON_DEPTH(dat);
+  if (dat->bit & JSON_FIRST)
+    {
+      dat->bit = depth;
+      JSON_PUTS("\n");
+    }
+  else
+    JSON_PUTS(",\n");
+  if (!bit_sink_room(dat, 2 * depth))
+    return;
+  memset(&dat->chain[dat->byte], ' ', 2 * depth);
+  dat->byte += 2 * depth;
+}
+
+/* "key": */
+static void
+json_key(Bit_Chain *restrict dat, const char *restrict key)
+{
+  json_sep(dat);
+  JSON_PUTS("\"");
+  bit_sink_write(dat, key, strlen(key));
+  JSON_PUTS("\": ");
+}
+
+static void
+json_open(Bit_Chain *restrict dat, const char c)
+{
+  bit_sink_write(dat, &c, 1);
+  dat->bit = (JSON_DEPTH(dat) + 1) | JSON_FIRST;
+}
+
+static void
+json_close(Bit_Chain *restrict dat, const char c)
+{
+  const int empty = dat->bit & JSON_FIRST;
+  dat->bit = JSON_DEPTH(dat) - 1;
+  if (!empty)
+    {
+      /* a first element, for the indentation only */
+      dat->bit |= JSON_FIRST;
+      json_sep(dat);
+    }
+  bit_sink_write(dat, &c, 1);
+}
+
+/* The length of the valid UTF-8 sequence at s, or 0 */
+static int
+json_utf8_len(const unsigned char *restrict s)
+{
+  if (s[0] >= 0xC2 && s[0] <= 0xDF)
+    return (s[1] & 0xC0) == 0x80 ? 2 : 0;
+  if (s[0] >= 0xE0 && s[0] <= 0xEF)
+    {
+      // no overlongs, no surrogates
+      if ((s[0] == 0xE0 && s[1] < 0xA0) || (s[0] == 0xED && s[1] > 0x9F))
+        return 0;
+      return (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80 ? 3 : 0;
+    }
+  if (s[0] >= 0xF0 && s[0] <= 0xF4)
+    {
+      if ((s[0] == 0xF0 && s[1] < 0x90) || (s[0] == 0xF4 && s[1] > 0x8F))
+        return 0;
+      return (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80
+                 && (s[3] & 0xC0) == 0x80
+             ? 4 : 0;
+    }
+  return 0;
+}
+
+/* A quoted string, with " \ and the control characters escaped.
+   NULL as "". Before r2007 the strings are in the codepage of the DWG,
+   since r2007 they are converted to UTF-8. Each byte >= 0x80 which is not
+   part of valid UTF-8, all of them before r2007, is written as \u00XX, so
+   the output is always valid JSON and the bytes can be recovered. */
+static void
+json_string(Bit_Chain *restrict dat, const char *restrict s)
+{
+  const char *run;
+  const int is_utf8 = dat->version >= R_2007;
+
+  JSON_PUTS("\"");
+  if (s)
+    for (run = s;; s++)
+      {
+        const unsigned char c = (unsigned char)*s;
+        int len;
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\')
+          continue;
+        if (c >= 0x80 && is_utf8
+            && (len = json_utf8_len((const unsigned char *)s)))
+          {
+            s += len - 1;
+            continue;
+          }
+        bit_sink_write(dat, run, s - run);
+        if (!c)
+          break;
+        run = s + 1;
+        switch (c)
+          {
+          case '"':  JSON_PUTS("\\\""); break;
+          case '\\': JSON_PUTS("\\\\"); break;
+          case '\n': JSON_PUTS("\\n"); break;
+          case '\r': JSON_PUTS("\\r"); break;
+          case '\t': JSON_PUTS("\\t"); break;
+          case '\b': JSON_PUTS("\\b"); break;
+          case '\f': JSON_PUTS("\\f"); break;
+          default:   bit_sink_printf(dat, "\\u%04x", c); break;
+          }
+      }
+  JSON_PUTS("\"");
+}
+
+/* As "%f", but JSON has no nan nor inf */
+static void
+json_double(Bit_Chain *restrict dat, const double value)
+{
+  char *s;
+  if (value != value || value - value != 0.0)
+    {
+      JSON_PUTS("null");
+      return;
+    }
+  if (!bit_sink_room(dat, NUMFMT_BUFSIZE))
+    return;
+  s = (char*)&dat->chain[dat->byte];
+  dat->byte += numfmt_fixed(s, value, 6);
+}
+
+static void
+json_handle(Bit_Chain *restrict dat, const Dwg_Object_Ref *restrict ref)
+{
+  bit_sink_printf(dat, "\"HANDLE(%d.%d.%lu) absolute:%lu\"",
+              ref->handleref.code, ref->handleref.size,
+              ref->handleref.value, ref->absolute_ref);
+}
 
 /*--------------------------------------------------------------------------------
  * MACROS
@@ -40,74 +193,73 @@ static unsigned int cur_ver = 0;
 #define ACTION json
 #define IS_PRINT
 
-#define PREFIX   for (int _i=0; _i<dat->bit; _i++) { fprintf (dat->fh, "  "); }
-#define ARRAY    PREFIX fprintf (dat->fh, "[\n"); dat->bit++
-#define ENDARRAY dat->bit--; PREFIX fprintf (dat->fh, "],\n")
-#define HASH     PREFIX fprintf (dat->fh, "{\n"); dat->bit++
-#define ENDHASH  dat->bit--; PREFIX fprintf (dat->fh, "},\n")
-#define SECTION(name) PREFIX fprintf (dat->fh, "\"%s\": [\n", #name); dat->bit++;
-#define ENDSEC()  ENDARRAY
-#define NOCOMMA   fseek(dat->fh, -2, SEEK_CUR)
-
-#define VALUE(value,type,dxf) \
-    fprintf(dat->fh, FORMAT_##type, value)
+#define KEY(name)  json_key(dat, #name)
+#define ELEM       json_sep(dat)
+#define ARRAY      json_open(dat, '[')
+#define ENDARRAY   json_close(dat, ']')
+#define HASH       json_open(dat, '{')
+#define ENDHASH    json_close(dat, '}')
+#define SECTION(name) { KEY(name); ARRAY; }
+#define ENDSEC()   ENDARRAY
+
+/* the values as JSON numbers, per type */
+#define JSON_B(v)     bit_sink_printf(dat, FORMAT_B, (int)(v))
+#define JSON_BB(v)    bit_sink_printf(dat, "%u", (unsigned)(v))
+#define JSON_3B(v)    JSON_BB(v)
+#define JSON_RC(v)    JSON_BB(v)
+#define JSON_4BITS(v) JSON_BB(v)
+#define JSON_BS(v)    bit_sink_printf(dat, FORMAT_BS, v)
+#define JSON_RS(v)    bit_sink_printf(dat, FORMAT_RS, v)
+#define JSON_BL(v)    bit_sink_printf(dat, FORMAT_BL, v)
+#define JSON_RL(v)    bit_sink_printf(dat, FORMAT_RL, v)
+#define JSON_MS(v)    bit_sink_printf(dat, FORMAT_MS, v)
+#define JSON_MC(v)    bit_sink_printf(dat, FORMAT_MC, v)
+#define JSON_BLL(v)   bit_sink_printf(dat, FORMAT_BLL, v)
+#define JSON_RLL(v)   bit_sink_printf(dat, FORMAT_RLL, v)
+#define JSON_BD(v)    json_double(dat, v)
+#define JSON_RD(v)    JSON_BD(v)
+#define JSON_DD(v)    JSON_BD(v)
+#define JSON_BT(v)    JSON_BD(v)
+
+/* VALUE_* are array elements, FIELD_* the keys and values of a hash */
+#define VALUE(value,type,dxf) { ELEM; JSON_##type(value); }
 #define VALUE_RC(value,dxf) VALUE(value, RC, dxf)
 #define VALUE_RS(value,dxf) VALUE(value, RS, dxf)
 #define VALUE_RL(value,dxf) VALUE(value, RL, dxf)
 #define VALUE_RD(value,dxf) VALUE(value, RD, dxf)
-
-#define FIELD(name,type,dxf) \
-    PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_##type ",\n", _obj->name)
-#define _FIELD(name,type,value) \
-    PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_##type ",\n", obj->name)
-#define ENT_FIELD(name,type,value) \
-    PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_##type ",\n", _ent->name)
+#define VALUE_2RD(pt) { ELEM; JSON_PUTS("[ "); JSON_RD((pt).x); \
+    JSON_PUTS(", "); JSON_RD((pt).y); JSON_PUTS(" ]"); }
+#define VALUE_3RD(pt) { ELEM; JSON_PUTS("[ "); JSON_RD((pt).x); \
+    JSON_PUTS(", "); JSON_RD((pt).y); JSON_PUTS(", "); JSON_RD((pt).z); \
+    JSON_PUTS(" ]"); }
+
+#define FIELD(name,type,dxf) { KEY(name); JSON_##type(_obj->name); }
+#define _FIELD(name,type,value) { KEY(name); JSON_##type(obj->name); }
+#define ENT_FIELD(name,type,value) { KEY(name); JSON_##type(_ent->name); }
 #define FIELD_CAST(name,type,cast,dxf) FIELD(name,cast,dxf)
 #define FIELD_TRACE(name,type)
 #define FIELD_G_TRACE(name,type,dxf)
-#define FIELD_TEXT(name,str) \
-    PREFIX fprintf(dat->fh, "\"" #name "\": \"%s\",\n", str ? str : "")
-#ifdef HAVE_NATIVE_WCHAR2
-# define FIELD_TEXT_TU(name,wstr) \
-    PREFIX fprintf(dat->fh, "\"" #name "\": \"%ls\",\n", wstr ? (wchar_t*)wstr : L"")
-#else
-# define FIELD_TEXT_TU(name,wstr) \
+#define FIELD_TEXT(name,str) { KEY(name); json_string(dat, str); }
+#define VALUE_TEXT_TU(wstr) \
   { \
-    BITCODE_TU ws = (BITCODE_TU)wstr;\
-    uint16_t _c; PREFIX \
-    fprintf(dat->fh, "\"" #name "\": \""); \
-    if (ws) { \
-      while ((_c = *ws++)) { \
-        fprintf(dat->fh, "%c", (char)(_c & 0xff)); \
-      } \
-    }\
-    fprintf(dat->fh, "\",\n"); \
+    char _u8[256]; \
+    char *_s = bit_convert_TU_buf((BITCODE_TU)wstr, _u8, sizeof(_u8)); \
+    json_string(dat, _s); \
+    if (_s != _u8) free(_s); \
   }
-#endif
+#define FIELD_TEXT_TU(name,wstr) { KEY(name); VALUE_TEXT_TU(wstr); }
 
 #define FIELD_VALUE(name) _obj->name
 #define ANYCODE -1
 // todo: only the name, not the ref
-#define VALUE_HANDLE(hdlptr, name, handle_code, dxf)     \
-  PREFIX if (hdlptr) { \
-    fprintf(dat->fh, "\"%s\": \"HANDLE(%d.%d.%lu) absolute:%lu\",\n", #name, \
-           hdlptr->handleref.code,                     \
-           hdlptr->handleref.size,                     \
-           hdlptr->handleref.value,                    \
-           hdlptr->absolute_ref);                      \
-  }
+#define VALUE_HANDLE(hdlptr, name, handle_code, dxf) \
+  if (hdlptr) { KEY(name); json_handle(dat, hdlptr); }
 #define FIELD_HANDLE(name, handle_code, dxf) VALUE_HANDLE(_obj->name, name, handle_code, dxf)
 #define FIELD_DATAHANDLE(name, code, dxf) FIELD_HANDLE(name, code, dxf)
 #define FIELD_HANDLE_N(name, vcount, handle_code, dxf) \
-  PREFIX if (_obj->name) { \
-    fprintf(dat->fh, "\"HANDLE(%d.%d.%lu) absolute:%lu\",\n",\
-           _obj->name->handleref.code,                     \
-           _obj->name->handleref.size,                     \
-           _obj->name->handleref.value,                    \
-           _obj->name->absolute_ref);                      \
-  } else {\
-    fprintf(dat->fh, "\"\",\n"); \
-  }
+  { ELEM; \
+    if (_obj->name) json_handle(dat, _obj->name); \
+    else            JSON_PUTS("\"\""); }
 
 #define FIELD_B(name,dxf)   FIELD(name, B, dxf)
 #define FIELD_BB(name,dxf)  FIELD(name, BB, dxf)
@@ -130,11 +282,10 @@ static unsigned int cur_ver = 0;
 #define FIELD_T(name,dxf) \
   { if (dat->version >= R_2007) { FIELD_TU(name, dxf); } \
     else                        { FIELD_TV(name, dxf); } }
-#define FIELD_BT(name,dxf)    FIELD(name, BT, dxf);
+#define FIELD_BT(name,dxf)    FIELD(name, BT, dxf)
 #define FIELD_4BITS(name,dxf) FIELD(name,4BITS,dxf)
 #define FIELD_BE(name,dxf)    FIELD_3RD(name,dxf)
-#define FIELD_DD(name, _default, dxf) \
-    PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_DD ",\n", _obj->name)
+#define FIELD_DD(name, _default, dxf) FIELD(name, DD, dxf)
 #define FIELD_2DD(name, d1, d2, dxf) { \
     FIELD_DD(name.x, d1, dxf); \
     FIELD_DD(name.y, d2, dxf+10); }
@@ -153,81 +304,74 @@ static unsigned int cur_ver = 0;
     FIELD(name.z, BD, dxf+2);}
 #define FIELD_3DPOINT(name,dxf) FIELD_3BD(name,dxf)
 #define FIELD_CMC(color,dxf1,dxf2) { \
-  PREFIX fprintf(dat->fh, "\"" #color "\": %d,\n", _obj->color.index); \
+  KEY(color); bit_sink_printf(dat, "%d", _obj->color.index); \
   if (dat->version >= R_2004) { \
-      PREFIX fprintf(dat->fh, "\"" #color "\".rgb: %06x,\n", (unsigned)_obj->color.rgb); \
+    KEY(color.rgb); bit_sink_printf(dat, "\"%06x\"", (unsigned)_obj->color.rgb); \
     if (_obj->color.flag & 1) \
-      PREFIX fprintf(dat->fh, "\"" #color ".name\": \"%s\",\n", _obj->color.name); \
+      FIELD_TEXT(color.name, _obj->color.name); \
     if (_obj->color.flag & 2) \
-      PREFIX fprintf(dat->fh, "\"" #color ".bookname\": \"%s\",\n", _obj->color.book_name); \
+      FIELD_TEXT(color.bookname, _obj->color.book_name); \
   }\
 }
-#define FIELD_TIMEBLL(name,dxf) \
-    PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_BL "." FORMAT_BL ",\n", \
-            _obj->name.days, _obj->name.ms)
+#define FIELD_TIMEBLL(name,dxf) { KEY(name); \
+    bit_sink_printf(dat, FORMAT_BL "." FORMAT_BL, _obj->name.days, _obj->name.ms); }
 
 //FIELD_VECTOR_N(name, type, size):
 // reads data of the type indicated by 'type' 'size' times and stores
 // it all in the vector called 'name'.
-#define FIELD_VECTOR_N(name, type, size, dxf)\
-    ARRAY; \
+#define FIELD_VECTOR_N(name, type, size, dxf) { \
+    KEY(name); ARRAY; \
+    if (_obj->name)\
     for (vcount=0; vcount < (BITCODE_BL)size; vcount++)\
       {\
-        PREFIX fprintf(dat->fh, "\"" #name "\": " FORMAT_##type ",\n", _obj->name[vcount]); \
+        VALUE(_obj->name[vcount], type, dxf); \
       }\
-    if (size) NOCOMMA;\
-    ENDARRAY;
-#define FIELD_VECTOR_T(name, size, dxf)\
-    ARRAY; \
-    PRE (R_2007) { \
-      for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++) { \
-        PREFIX fprintf(dat->fh, "\"" #name "\": \"%s\",\n", _obj->name[vcount]); \
-      }\
-    } else { \
-      for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++)\
-        FIELD_TEXT_TU(name, _obj->name[vcount]); \
+    ENDARRAY; }
+#define FIELD_VECTOR_T(name, size, dxf) { \
+    KEY(name); ARRAY; \
+    if (_obj->name) { \
+      PRE (R_2007) { \
+        for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++) { \
+          ELEM; json_string(dat, _obj->name[vcount]); \
+        }\
+      } else { \
+        for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++) { \
+          ELEM; VALUE_TEXT_TU(_obj->name[vcount]); \
+        }\
+      } \
     } \
-    if (_obj->size) NOCOMMA;\
-    ENDARRAY;
+    ENDARRAY; }
 
 #define FIELD_VECTOR(name, type, size, dxf) FIELD_VECTOR_N(name, type, _obj->size, dxf)
 
-#define FIELD_2RD_VECTOR(name, size, dxf)\
-  ARRAY;\
+#define FIELD_2RD_VECTOR(name, size, dxf) { \
+  KEY(name); ARRAY;\
+  if (_obj->name)\
   for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++)\
     {\
-      FIELD_2RD(name[vcount], dxf);\
+      VALUE_2RD(_obj->name[vcount]);\
     }\
-  if (_obj->size) NOCOMMA;\
-  ENDARRAY;
+  ENDARRAY; }
 
-#define FIELD_2DD_VECTOR(name, size, dxf)\
-  ARRAY;\
-  FIELD_2RD(name[0], 0);\
-  for (vcount = 1; vcount < (BITCODE_BL)_obj->size; vcount++)\
-    {\
-      FIELD_2DD(name[vcount], FIELD_VALUE(name[vcount - 1].x), FIELD_VALUE(name[vcount - 1].y), dxf);\
-    }\
-  if (_obj->size) NOCOMMA;\
-  ENDARRAY;
+#define FIELD_2DD_VECTOR(name, size, dxf) FIELD_2RD_VECTOR(name, size, dxf)
 
-#define FIELD_3DPOINT_VECTOR(name, size, dxf)\
-  ARRAY;\
+#define FIELD_3DPOINT_VECTOR(name, size, dxf) { \
+  KEY(name); ARRAY;\
+  if (_obj->name)\
   for (vcount=0; vcount < (BITCODE_BL)_obj->size; vcount++)\
     {\
-      FIELD_3DPOINT(name[vcount], dxf);\
+      VALUE_3RD(_obj->name[vcount]);\
     }\
-  if (_obj->size) NOCOMMA;\
-  ENDARRAY;
+  ENDARRAY; }
 
-#define HANDLE_VECTOR_N(name, size, code, dxf) \
-  ARRAY;\
+#define HANDLE_VECTOR_N(name, size, code, dxf) { \
+  KEY(name); ARRAY;\
+  if (_obj->name)\
   for (vcount=0; vcount < (BITCODE_BL)size; vcount++)\
     {\
       FIELD_HANDLE_N(name[vcount], vcount, code, dxf);\
     }\
-  if (size) NOCOMMA;                            \
-  ENDARRAY;
+  ENDARRAY; }
 
 #define HANDLE_VECTOR(name, sizefield, code, dxf) \
   HANDLE_VECTOR_N(name, FIELD_VALUE(sizefield), code, dxf)
@@ -237,15 +381,17 @@ static unsigned int cur_ver = 0;
 
 #define FIELD_XDATA(name, size)
 
-#define REACTORS(code)\
-  PREFIX; \
-  fprintf(dat->fh, "\"reactors\":"); ARRAY; \
+#define REACTORS(code) { \
+  KEY(reactors); ARRAY; \
+  if (obj->tio.object->reactors)\
   for (vcount=0; vcount < obj->tio.object->num_reactors; vcount++)\
     {\
-      VALUE_HANDLE(obj->tio.object->reactors[vcount], reactors, code, 330); \
+      Dwg_Object_Ref *_ref = obj->tio.object->reactors[vcount]; \
+      ELEM; \
+      if (_ref) json_handle(dat, _ref); \
+      else      JSON_PUTS("\"\""); \
     }\
-  if (obj->tio.object->num_reactors) NOCOMMA;\
-  ENDARRAY;
+  ENDARRAY; }
 
 #define XDICOBJHANDLE(code)\
   SINCE(R_2004)\
@@ -266,12 +412,12 @@ static unsigned int cur_ver = 0;
 
 #define DWG_ENTITY(token) \
 static int \
-dwg_json_##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj) \
+dwg_json_##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
 {\
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4; \
   int error = 0; \
   Bit_Chain *hdl_dat = dat;\
-  Dwg_Data* dwg = obj->parent; \
+  const Dwg_Data *dwg = obj->parent; \
   Dwg_Entity_##token *ent, *_obj;\
   Dwg_Object_Entity *_ent;\
   LOG_INFO("Entity " #token ":\n")\
@@ -287,12 +433,12 @@ dwg_json_##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj) \
 
 #define DWG_OBJECT(token) \
 static int \
-dwg_json_ ##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj) \
+dwg_json_ ##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
 { \
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4;\
   int error = 0;\
   Bit_Chain *hdl_dat = dat;\
-  Dwg_Data* dwg = obj->parent; \
+  const Dwg_Data *dwg = obj->parent; \
   Dwg_Object_##token *_obj;\
   LOG_INFO("Object " #token ":\n")\
   _obj = obj->tio.object->tio.token;\
@@ -308,8 +454,8 @@ dwg_json_ ##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj) \
 /* returns 0 on success
  */
 static int
-dwg_json_variable_type(Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
-                       Dwg_Object *restrict  obj)
+dwg_json_variable_type(const Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
+                       const Dwg_Object *restrict obj)
 {
   int i;
   Dwg_Class *klass;
@@ -331,8 +477,10 @@ dwg_json_variable_type(Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
 }
 
 static int
-dwg_json_object(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
+dwg_json_object(Bit_Chain *restrict dat, const Dwg_Object *restrict obj)
 {
+  if (!obj->tio.object) // not decoded
+    return DWG_ERR_INVALIDTYPE;
   switch (obj->type)
     {
     case DWG_TYPE_TEXT:
@@ -502,7 +650,7 @@ dwg_json_object(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
       else if (DWG_ERR_UNHANDLEDCLASS &
                dwg_json_variable_type(obj->parent, dat, obj))
         {
-          Dwg_Data *dwg = obj->parent;
+          const Dwg_Data *dwg = obj->parent;
           int is_entity;
           int i = obj->type - 500;
           Dwg_Class *klass = NULL;
@@ -538,17 +686,19 @@ dwg_json_object(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
 
 /*
 static void
-json_common_entity_handle_data(Bit_Chain *restrict dat, Dwg_Object *restrict obj)
+json_common_entity_handle_data(Bit_Chain *restrict dat, const Dwg_Object *restrict obj)
 {
   (void)dat; (void)obj;
 }
 */
 
 static int
-json_header_write(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+json_header_write(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
-  Dwg_Header_Variables* _obj = &dwg->header_vars;
-  Dwg_Object* obj = NULL;
+  /* not written to: the spec's encoder defaults are under
+     IF_ENCODE_FROM_EARLIER, which is if (0) here */
+  Dwg_Header_Variables *_obj = (Dwg_Header_Variables *)&dwg->header_vars;
+  const Dwg_Object *obj = NULL;
   //const int minimal = 0;
   char buf[4096];
   double ms;
@@ -559,15 +709,15 @@ json_header_write(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       ? "UTF-8"
       : "ANSI_1252";
 
-  SECTION(HEADER);
+  KEY(HEADER);
+  HASH;
   #include "header_variables.spec"
-  NOCOMMA;
-  ENDSEC();
+  ENDHASH;
   return 0;
 }
 
 static int
-json_classes_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+json_classes_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   BITCODE_BS i;
 
@@ -576,6 +726,7 @@ json_classes_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   for (i=0; i < dwg->num_classes; i++)
     {
       Dwg_Class *_obj = &dwg->dwg_class[i];
+      ELEM;
       HASH;
       FIELD_BS (number, 0);
       FIELD_TV (dxfname, 1);
@@ -587,16 +738,14 @@ json_classes_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       FIELD_BS (item_class_id, 281);
       // Is-an-entity. 1f2 for entities, 1f3 for objects
       //VALUE (281, dwg->dwg_class[i].item_class_id == 0x1F2 ? 1 : 0);
-      NOCOMMA;
       ENDHASH;
     }
-  NOCOMMA;
   ENDSEC();
   return 0;
 }
 
 static int
-json_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+json_tables_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   (void)dwg;
 
@@ -607,7 +756,7 @@ json_tables_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 static int
-json_blocks_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+json_blocks_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   (void)dwg;
 
@@ -617,28 +766,78 @@ json_blocks_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
   return 0;
 }
 
+/* Objects per chunk of the parallel output */
+#define JSON_CHUNK_OBJECTS 512
+
+static void
+json_entities_chunk(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg,
+                    BITCODE_BL from, const BITCODE_BL to)
+{
+  for (; from < to; from++)
+    {
+      ELEM;
+      HASH;
+      dwg_json_object(dat, &dwg->object[from]);
+      ENDHASH;
+    }
+}
+
+/* With dwg->num_threads, fixed chunks of objects are written in parallel
+   into memory, and then appended in order, so the output is the same. */
 static int
-json_entities_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+json_entities_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
-  BITCODE_BL i;
+  int error = 0;
+#ifdef _OPENMP
+  const long num_chunks
+      = (long)((dwg->num_objects + JSON_CHUNK_OBJECTS - 1) / JSON_CHUNK_OBJECTS);
+  Bit_Chain *chunks;
+#endif
 
   SECTION(ENTITIES);
-  for (i=0; i < dwg->num_objects; i++)
+#ifdef _OPENMP
+  chunks = dwg->num_threads > 1 && num_chunks > 1
+           ? calloc(num_chunks, sizeof(Bit_Chain)) : NULL;
+  if (chunks)
     {
-      Dwg_Object *obj = &dwg->object[i];
-      HASH;
-      dwg_json_object(dat, obj);
-      NOCOMMA;
-      ENDHASH;
+      long c;
+#pragma omp parallel for schedule(dynamic) num_threads(dwg->num_threads)
+      for (c = 0; c < num_chunks; c++)
+        {
+          Bit_Chain *chunk = &chunks[c];
+          const BITCODE_BL from = (BITCODE_BL)c * JSON_CHUNK_OBJECTS;
+          const BITCODE_BL to = from + JSON_CHUNK_OBJECTS < dwg->num_objects
+                                ? from + JSON_CHUNK_OBJECTS : dwg->num_objects;
+          *chunk = *dat;
+          // only the very first object follows the [
+          if (c)
+            chunk->bit = JSON_DEPTH(dat);
+          chunk->fh = NULL;
+          chunk->sink = NULL;
+          if (!bit_sink_begin(chunk, JSON_BUFSIZE))
+            json_entities_chunk(chunk, dwg, from, to);
+        }
+      for (c = 0; c < num_chunks; c++)
+        {
+          if (!chunks[c].chain)
+            error |= DWG_ERR_OUTOFMEM;
+          else
+            bit_sink_write(dat, (char*)chunks[c].chain, chunks[c].byte);
+          free(chunks[c].chain);
+        }
+      free(chunks);
+      dat->bit = JSON_DEPTH(dat);
     }
-  NOCOMMA;
+  else
+#endif
+    json_entities_chunk(dat, dwg, 0, dwg->num_objects);
   ENDSEC();
-  return 0;
+  return error;
 }
 
 /* The object map: we skip this
 static int
-json_objects_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+json_objects_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   BITCODE_BL i;
 
@@ -652,7 +851,7 @@ json_objects_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 */
 
 static int
-json_preview_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+json_preview_write (Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   (void)dat; (void)dwg;
   //...
@@ -660,14 +859,22 @@ json_preview_write (Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
 }
 
 EXPORT int
-dwg_write_json(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
+dwg_write_json(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg)
 {
   const int minimal = dwg->opts & 0x10;
-  struct Dwg_Header *obj = &dwg->header;
+  const struct Dwg_Header *obj = &dwg->header;
+  const Bit_Chain orig = *dat;
+  int error = 0;
 
-  fprintf (dat->fh, "{\n"
-                     "  \"created_by\": \"%s\",\n", PACKAGE_STRING);
-  dat->bit++;
+  if (bit_sink_begin(dat, JSON_BUFSIZE))
+    {
+      *dat = orig;
+      return DWG_ERR_OUTOFMEM;
+    }
+  dat->bit = 0;
+
+  HASH;
+  FIELD_TEXT (created_by, PACKAGE_STRING);
   // a minimal header requires only $ACADVER, $HANDSEED, and then ENTITIES
   // see https://pythonhosted.org/ezdxf/dxfinternals/filestructure.html
   json_header_write (dat, dwg);
@@ -700,11 +907,15 @@ dwg_write_json(Bit_Chain *restrict dat, Dwg_Data *restrict dwg)
       goto fail;
   }
 
-  dat->bit--;
-  fprintf (dat->fh, "}\n");
-  return 0;
+  ENDHASH;
+  JSON_PUTS("\n");
+  goto done;
+
  fail:
-  return 1;
+  error = 1;
+ done:
+  dat->bit = orig.bit;
+  return bit_sink_end(dat, &orig, error);
 }
 
 #undef IS_PRINT
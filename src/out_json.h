@@ -21,7 +21,8 @@
 #include "dwg.h"
 #include "bits.h"
 
-EXPORT int dwg_write_json(Bit_Chain *restrict dat, Dwg_Data *restrict dwg);
-EXPORT int dwg_write_geojson(Bit_Chain *restrict dat, Dwg_Data *restrict dwg);
+EXPORT int dwg_write_json(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg);
+EXPORT int dwg_write_geojson(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg);
+EXPORT int dwg_write_geojsonseq(Bit_Chain *restrict dat, const Dwg_Data *restrict dwg);
 
 #endif
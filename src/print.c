@@ -32,7 +32,7 @@
 #include "logging.h"
 
 /* the current version per spec block */
-static unsigned int cur_ver = 0;
+static THREAD_LOCAL unsigned int cur_ver = 0;
 
 /*--------------------------------------------------------------------------------
  * MACROS
@@ -263,11 +263,12 @@ static unsigned int cur_ver = 0;
   { \
     Bit_Chain sav_dat = *dat; \
     dat = str_dat;
+/* the string stream is located on a copy, obj is read-only here */
 #define START_STRING_STREAM \
-  obj->has_strings = bit_read_B(dat); \
-  if (obj->has_strings) { \
+  if (bit_read_B(dat)) { \
     Bit_Chain sav_dat = *dat; \
-    obj_string_stream(dat, obj, dat);
+    Dwg_Object _str_obj = *obj; \
+    obj_string_stream(dat, &_str_obj, dat);
 #define END_STRING_STREAM \
     *dat = sav_dat; \
   }
@@ -277,14 +278,14 @@ static unsigned int cur_ver = 0;
 
 #define DWG_ENTITY(token) \
 static int \
-dwg_print_##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj)\
+dwg_print_##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj)\
 {\
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4; \
   Dwg_Entity_##token *ent, *_obj;\
   Dwg_Object_Entity *_ent;\
   Bit_Chain *hdl_dat = dat;\
   Bit_Chain* str_dat = dat;\
-  Dwg_Data* dwg = obj->parent;\
+  const Dwg_Data *dwg = obj->parent;\
   int error = 0; \
   LOG_INFO("Entity " #token ":\n")\
   _ent = obj->tio.entity;\
@@ -298,13 +299,13 @@ dwg_print_##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj)\
 
 #define DWG_OBJECT(token) \
 static int \
-dwg_print_ ##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj) \
+dwg_print_ ##token (Bit_Chain *restrict dat, const Dwg_Object *restrict obj) \
 { \
   BITCODE_BL vcount, rcount1, rcount2, rcount3, rcount4;\
   Dwg_Object_##token *_obj;\
   Bit_Chain *hdl_dat = dat;\
   Bit_Chain* str_dat = dat;\
-  Dwg_Data* dwg = obj->parent;\
+  const Dwg_Data *dwg = obj->parent;\
   int error = 0; \
   LOG_INFO("Object " #token ":\n")\
   _obj = obj->tio.object->tio.token;\
@@ -321,7 +322,8 @@ dwg_print_ ##token (Bit_Chain *restrict dat, Dwg_Object *restrict obj) \
    Dispatches on the variable types.
  */
 static int
-dwg_print_variable_type(Dwg_Data * dwg, Bit_Chain * dat, Dwg_Object* obj)
+dwg_print_variable_type(const Dwg_Data *restrict dwg, Bit_Chain *restrict dat,
+                        const Dwg_Object *restrict obj)
 {
   int i;
   int is_entity;
@@ -346,7 +348,7 @@ dwg_print_variable_type(Dwg_Data * dwg, Bit_Chain * dat, Dwg_Object* obj)
    Dispatches on the fixed types.
 */
 int
-dwg_print_object(Bit_Chain* dat, Dwg_Object *obj)
+dwg_print_object(Bit_Chain *restrict dat, const Dwg_Object *restrict obj)
 {
   int error = 0;
   //Bit_Chain * dat = (Bit_Chain *)obj->parent->bit_chain;
@@ -523,7 +525,7 @@ dwg_print_object(Bit_Chain* dat, Dwg_Object *obj)
       else if ((error = dwg_print_variable_type(obj->parent, dat, obj))
                & DWG_ERR_UNHANDLEDCLASS)
         {
-          Dwg_Data *dwg = obj->parent;
+          const Dwg_Data *dwg = obj->parent;
           int is_entity = 0;
           int i = obj->type - 500;
           Dwg_Class *klass = NULL;
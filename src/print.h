@@ -24,6 +24,6 @@
 #include "bits.h"
 
 int
-dwg_print_object(Bit_Chain* dat, Dwg_Object *obj);
+dwg_print_object(Bit_Chain *restrict dat, const Dwg_Object *restrict obj);
 
 #endif
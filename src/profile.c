@@ -0,0 +1,231 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * profile.c: per-field bit-cost profiler for the decoder.
+ *            (type, field) pairs are the spec literals, so they are hashed
+ *            by address, with linear probing as in hash.c.
+ *            Not thread-safe, only for instrumented builds.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "profile.h"
+
+typedef struct _dwg_profile_entry {
+  const char *type;
+  const char *field;
+  uint64_t calls;
+  uint64_t bits;
+  uint64_t ticks;
+} Dwg_Profile_Entry;
+
+static Dwg_Profile_Entry *entries;
+static uint32_t num_entries;
+static uint32_t size_entries; /* power of 2 */
+static const char *cur_type;
+
+static uint32_t
+profile_hash (const char *type, const char *field)
+{
+  uint64_t h = ((uintptr_t)type * 31) ^ (uintptr_t)field;
+  h ^= h >> 17;
+  h *= 0x9E3779B97F4A7C15ULL;
+  return (uint32_t)(h >> 32);
+}
+
+static Dwg_Profile_Entry *
+profile_find (const char *type, const char *field)
+{
+  uint32_t i = profile_hash (type, field) & (size_entries - 1);
+  while (entries[i].field)
+    {
+      if (entries[i].field == field && entries[i].type == type)
+        return &entries[i];
+      i = (i + 1) & (size_entries - 1);
+    }
+  return &entries[i];
+}
+
+static int
+profile_grow (void)
+{
+  Dwg_Profile_Entry *old = entries;
+  uint32_t old_size = size_entries;
+  uint32_t i;
+
+  size_entries = old_size ? old_size * 2 : 1024;
+  entries = calloc (size_entries, sizeof (Dwg_Profile_Entry));
+  if (!entries)
+    {
+      entries = old;
+      size_entries = old_size;
+      return 1;
+    }
+  for (i = 0; i < old_size; i++)
+    if (old[i].field)
+      *profile_find (old[i].type, old[i].field) = old[i];
+  free (old);
+  return 0;
+}
+
+void
+dwg_profile_type (const char *type)
+{
+  cur_type = type;
+}
+
+void
+dwg_profile_add (const char *field, const unsigned long bits,
+                 const uint64_t ticks)
+{
+  Dwg_Profile_Entry *e;
+  if (num_entries * 4 >= size_entries * 3 && profile_grow ())
+    return;
+  e = profile_find (cur_type, field);
+  if (!e->field)
+    {
+      e->type = cur_type;
+      e->field = field;
+      num_entries++;
+    }
+  e->calls++;
+  e->bits += bits;
+  e->ticks += ticks;
+}
+
+void
+dwg_profile_reset (void)
+{
+  free (entries);
+  entries = NULL;
+  num_entries = size_entries = 0;
+  cur_type = NULL;
+}
+
+static int
+profile_cmp (const void *a, const void *b)
+{
+  const Dwg_Profile_Entry *ea = (const Dwg_Profile_Entry *)a;
+  const Dwg_Profile_Entry *eb = (const Dwg_Profile_Entry *)b;
+  if (ea->ticks != eb->ticks)
+    return ea->ticks < eb->ticks ? 1 : -1;
+  return ea->bits < eb->bits ? 1 : ea->bits > eb->bits ? -1 : 0;
+}
+
+/* Compact the hash into a dense array, sorted by ticks. */
+static Dwg_Profile_Entry *
+profile_sorted_fields (uint32_t *num)
+{
+  Dwg_Profile_Entry *sorted;
+  uint32_t i, n = 0;
+
+  sorted = calloc (num_entries ? num_entries : 1, sizeof (Dwg_Profile_Entry));
+  if (!sorted)
+    return NULL;
+  for (i = 0; i < size_entries; i++)
+    if (entries[i].field)
+      sorted[n++] = entries[i];
+  qsort (sorted, n, sizeof (Dwg_Profile_Entry), profile_cmp);
+  *num = n;
+  return sorted;
+}
+
+/* Sum up the fields per type, sorted by ticks. */
+static Dwg_Profile_Entry *
+profile_sorted_types (const Dwg_Profile_Entry *fields, const uint32_t num,
+                      uint32_t *numtypes)
+{
+  Dwg_Profile_Entry *types;
+  uint32_t i, j, n = 0;
+
+  types = calloc (num ? num : 1, sizeof (Dwg_Profile_Entry));
+  if (!types)
+    return NULL;
+  for (i = 0; i < num; i++)
+    {
+      for (j = 0; j < n; j++)
+        if (types[j].type == fields[i].type)
+          break;
+      if (j == n)
+        {
+          types[n].type = fields[i].type;
+          types[n].field = "";
+          n++;
+        }
+      types[j].calls += fields[i].calls;
+      types[j].bits += fields[i].bits;
+      types[j].ticks += fields[i].ticks;
+    }
+  qsort (types, n, sizeof (Dwg_Profile_Entry), profile_cmp);
+  *numtypes = n;
+  return types;
+}
+
+#define TYPE_NAME(e) ((e)->type ? (e)->type : "-")
+
+void
+dwg_profile_report (FILE *fp, const int json)
+{
+  Dwg_Profile_Entry *fields, *types;
+  uint32_t i, num, numtypes;
+
+  fields = profile_sorted_fields (&num);
+  if (!fields)
+    return;
+  types = profile_sorted_types (fields, num, &numtypes);
+  if (!types)
+    {
+      free (fields);
+      return;
+    }
+
+  if (json)
+    {
+      fprintf (fp, "{\n  \"types\": [");
+      for (i = 0; i < numtypes; i++)
+        fprintf (fp,
+                 "%s\n    { \"type\": \"%s\", \"calls\": %" PRIu64
+                 ", \"bits\": %" PRIu64 ", \"ticks\": %" PRIu64 " }",
+                 i ? "," : "", TYPE_NAME (&types[i]), types[i].calls,
+                 types[i].bits, types[i].ticks);
+      fprintf (fp, "\n  ],\n  \"fields\": [");
+      for (i = 0; i < num; i++)
+        fprintf (fp,
+                 "%s\n    { \"type\": \"%s\", \"field\": \"%s\", \"calls\": %"
+                 PRIu64 ", \"bits\": %" PRIu64 ", \"ticks\": %" PRIu64 " }",
+                 i ? "," : "", TYPE_NAME (&fields[i]), fields[i].field,
+                 fields[i].calls, fields[i].bits, fields[i].ticks);
+      fprintf (fp, "\n  ]\n}\n");
+    }
+  else
+    {
+      fprintf (fp, "\n%-24s %12s %14s %16s %10s\n", "type", "calls", "bits",
+               "ticks", "ticks/call");
+      for (i = 0; i < numtypes; i++)
+        fprintf (fp, "%-24s %12" PRIu64 " %14" PRIu64 " %16" PRIu64 " %10"
+                 PRIu64 "\n", TYPE_NAME (&types[i]), types[i].calls,
+                 types[i].bits, types[i].ticks,
+                 types[i].ticks / types[i].calls);
+      fprintf (fp, "\n%-24s %-32s %12s %14s %16s %10s\n", "type", "field",
+               "calls", "bits", "ticks", "ticks/call");
+      for (i = 0; i < num; i++)
+        fprintf (fp, "%-24s %-32s %12" PRIu64 " %14" PRIu64 " %16" PRIu64
+                 " %10" PRIu64 "\n", TYPE_NAME (&fields[i]), fields[i].field,
+                 fields[i].calls, fields[i].bits, fields[i].ticks,
+                 fields[i].ticks / fields[i].calls);
+    }
+  free (types);
+  free (fields);
+}
@@ -0,0 +1,51 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * profile.h: per-field bit-cost profiler for the decoder.
+ * Only used with configure --enable-profile, which defines USE_PROFILE.
+ * The decoder macros in dec_macros.h then record for each (object type,
+ * field) pair the number of calls, the bits consumed and the ticks spent.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "common.h"
+
+/* Set the object type the following fields are accounted to.
+   NULL for fields outside of any object. */
+EXPORT void dwg_profile_type (const char *type);
+/* Account one call of field, which consumed bits in ticks. */
+EXPORT void dwg_profile_add (const char *field, const unsigned long bits,
+                             const uint64_t ticks);
+/* Print the per-type and per-field report, sorted by ticks.
+   As JSON if json is set, otherwise as text table. */
+EXPORT void dwg_profile_report (FILE *fp, const int json);
+/* Clear all recorded data. */
+EXPORT void dwg_profile_reset (void);
+
+/* cycle counter on x86, else cpu clock ticks */
+static inline uint64_t
+dwg_profile_ticks (void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  return __builtin_ia32_rdtsc ();
+#else
+  return (uint64_t)clock ();
+#endif
+}
+
+#endif
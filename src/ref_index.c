@@ -0,0 +1,202 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * ref_index.c: reverse reference index in CSR form.
+ *              Two passes over all objects: the first counts the referrers
+ *              per (target, role) row, the second fills them in, so the
+ *              sources of each row are in ascending object order.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "ref_index.h"
+
+/* Called for every reference of every object, twice. */
+static void
+ref_index_add(const Dwg_Data *restrict dwg, Dwg_Ref_Index *restrict idx,
+              Dwg_Object_Ref *restrict ref, const Dwg_Ref_Role role,
+              const Dwg_Object *restrict src, const int fill)
+{
+  Dwg_Object *target;
+  BITCODE_BL row;
+
+  if (!ref || !ref->absolute_ref)
+    return;
+  target = dwg_ref_object(dwg, ref);
+  if (!target || target->index >= idx->num_objects)
+    return;
+  row = target->index * DWG_REF_NUM_ROLES + role;
+  if (fill)
+    idx->sources[idx->offsets[row]++] = src->index;
+  else
+    idx->offsets[row + 1]++;
+}
+
+#define ADD(ref, role) ref_index_add(dwg, idx, ref, role, obj, fill)
+
+#define TABLE_OWNER(token, field)                                           \
+  case DWG_TYPE_##token:                                                    \
+    ADD(_obj->tio.token->field, DWG_REF_OWNER);                             \
+    break
+#define PARENT_OWNER(token) TABLE_OWNER(token, parenthandle)
+
+#define DIM_BLOCK(token)                                                    \
+  case DWG_TYPE_DIMENSION_##token:                                          \
+    ADD(_ent->tio.DIMENSION_##token->block, DWG_REF_BLOCK);                 \
+    break
+
+static void
+ref_index_object(const Dwg_Data *restrict dwg, Dwg_Ref_Index *restrict idx,
+                 const Dwg_Object *restrict obj, const int fill)
+{
+  BITCODE_BL i;
+
+  if (obj->supertype == DWG_SUPERTYPE_ENTITY && obj->tio.entity)
+    {
+      Dwg_Object_Entity *_ent = obj->tio.entity;
+      switch (_ent->entity_mode)
+        {
+        case 0:
+          ADD(_ent->subentity, DWG_REF_OWNER);
+          break;
+        case 1:
+          ADD(dwg->header_vars.BLOCK_RECORD_PSPACE, DWG_REF_OWNER);
+          break;
+        case 2:
+          ADD(dwg->header_vars.BLOCK_RECORD_MSPACE, DWG_REF_OWNER);
+          break;
+        default:
+          break;
+        }
+      ADD(_ent->layer, DWG_REF_LAYER);
+      ADD(_ent->ltype, DWG_REF_LTYPE);
+      if (_ent->reactors)
+        for (i = 0; i < _ent->num_reactors; i++)
+          ADD(_ent->reactors[i], DWG_REF_REACTOR);
+      if (!_ent->tio.UNUSED)
+        return;
+      switch ((int)obj->fixedtype) // only a few types have refs of a role
+        {
+        case DWG_TYPE_INSERT:
+          ADD(_ent->tio.INSERT->block_header, DWG_REF_BLOCK);
+          break;
+        case DWG_TYPE_MINSERT:
+          ADD(_ent->tio.MINSERT->block_header, DWG_REF_BLOCK);
+          break;
+          DIM_BLOCK(ORDINATE);
+          DIM_BLOCK(LINEAR);
+          DIM_BLOCK(ALIGNED);
+          DIM_BLOCK(ANG3PT);
+          DIM_BLOCK(ANG2LN);
+          DIM_BLOCK(RADIUS);
+          DIM_BLOCK(DIAMETER);
+        default:
+          break;
+        }
+    }
+  else if (obj->supertype == DWG_SUPERTYPE_OBJECT && obj->tio.object)
+    {
+      Dwg_Object_Object *_obj = obj->tio.object;
+      if (_obj->reactors)
+        for (i = 0; i < _obj->num_reactors; i++)
+          ADD(_obj->reactors[i], DWG_REF_REACTOR);
+      if (!_obj->tio.UNKNOWN_OBJ)
+        return;
+      switch ((int)obj->fixedtype) // only a few types have refs of a role
+        {
+          TABLE_OWNER(BLOCK_HEADER, block_control);
+          TABLE_OWNER(LAYER, layer_control);
+          TABLE_OWNER(STYLE, style_control);
+          TABLE_OWNER(LTYPE, linetype_control);
+          TABLE_OWNER(VIEW, view_control);
+          TABLE_OWNER(UCS, ucs_control);
+          TABLE_OWNER(VPORT, vport_control);
+          TABLE_OWNER(APPID, app_control);
+          TABLE_OWNER(DIMSTYLE, dimstyle_control);
+          TABLE_OWNER(VPORT_ENTITY_HEADER, vport_entity_control);
+          PARENT_OWNER(DICTIONARY);
+          PARENT_OWNER(DICTIONARYWDFLT);
+          PARENT_OWNER(DICTIONARYVAR);
+          PARENT_OWNER(XRECORD);
+          PARENT_OWNER(GROUP);
+          PARENT_OWNER(MLINESTYLE);
+          PARENT_OWNER(LAYOUT);
+          PARENT_OWNER(PLACEHOLDER);
+          PARENT_OWNER(PROXY_OBJECT);
+          PARENT_OWNER(IDBUFFER);
+          PARENT_OWNER(IMAGEDEF);
+          PARENT_OWNER(IMAGEDEF_REACTOR);
+          PARENT_OWNER(LAYER_INDEX);
+          PARENT_OWNER(RASTERVARIABLES);
+          PARENT_OWNER(SCALE);
+          PARENT_OWNER(SORTENTSTABLE);
+          PARENT_OWNER(SPATIAL_FILTER);
+          PARENT_OWNER(SPATIAL_INDEX);
+          PARENT_OWNER(WIPEOUTVARIABLES);
+          PARENT_OWNER(VISUALSTYLE);
+        default:
+          break;
+        }
+    }
+}
+
+void
+dwg_ref_index_free(Dwg_Data *restrict dwg)
+{
+  Dwg_Ref_Index *idx = &dwg->ref_index;
+  free(idx->offsets);
+  free(idx->sources);
+  memset(idx, 0, sizeof(Dwg_Ref_Index));
+}
+
+int
+dwg_ref_index_build(Dwg_Data *restrict dwg)
+{
+  Dwg_Ref_Index *idx = &dwg->ref_index;
+  BITCODE_BL i, num_rows;
+
+  if (idx->offsets && idx->num_objects == dwg->num_objects
+      && idx->generation == dwg->refs_generation)
+    return 0;
+  dwg_ref_index_free(dwg);
+  if (!dwg->num_objects)
+    return 0;
+
+  num_rows = dwg->num_objects * DWG_REF_NUM_ROLES;
+  idx->num_objects = dwg->num_objects;
+  idx->offsets = calloc(num_rows + 1, sizeof(BITCODE_BL));
+  if (!idx->offsets)
+    goto oom;
+  for (i = 0; i < dwg->num_objects; i++)
+    ref_index_object(dwg, idx, &dwg->object[i], 0);
+  for (i = 0; i < num_rows; i++)
+    idx->offsets[i + 1] += idx->offsets[i];
+  idx->sources = malloc((idx->offsets[num_rows] + 1) * sizeof(BITCODE_BL));
+  if (!idx->sources)
+    goto oom;
+  /* offsets[row] is the fill cursor, and ends up at the start of the next
+     row */
+  for (i = 0; i < dwg->num_objects; i++)
+    ref_index_object(dwg, idx, &dwg->object[i], 1);
+  memmove(&idx->offsets[1], idx->offsets, num_rows * sizeof(BITCODE_BL));
+  idx->offsets[0] = 0;
+  /* dwg_ref_object did not move anything */
+  idx->generation = dwg->refs_generation;
+  return 0;
+
+ oom:
+  dwg_ref_index_free(dwg);
+  return DWG_ERR_OUTOFMEM;
+}
@@ -0,0 +1,32 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * ref_index.h: reverse reference index, which objects reference an object
+ *              as owner, layer, ltype, block or reactor.
+ */
+
+#ifndef REF_INDEX_H
+#define REF_INDEX_H
+
+#include "config.h"
+#include "dwg.h"
+
+/* (Re)build dwg->ref_index, if missing or stale. Returns 0 or
+   DWG_ERR_OUTOFMEM. */
+int
+dwg_ref_index_build(Dwg_Data *restrict dwg);
+/* Free dwg->ref_index */
+void
+dwg_ref_index_free(Dwg_Data *restrict dwg);
+
+#endif
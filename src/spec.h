@@ -63,6 +63,9 @@
 #ifndef VALUE_BL
 # define VALUE_BL(value, dxf)
 #endif
+#ifndef VALUE_B
+# define VALUE_B(value, dxf) VALUE_RC(value, dxf)
+#endif
 // logging format overrides
 #ifndef FIELD_RLx
 # define FIELD_RLx(name, dxf) FIELD_RL(name, dxf)
@@ -137,6 +140,13 @@
 #undef  PRINT
 #define PRINT   if (1)
 #endif
+/* Fields derived from others are only set by the decoder and encoders.
+   The output passes get a read-only object, and may run concurrently. */
+#if defined(IS_PRINT)
+#define SET_DERIVED if (0)
+#else
+#define SET_DERIVED if (1)
+#endif
 #if defined(IS_DXF)
 #undef  DXF
 #undef  IF_IS_DXF
@@ -184,9 +194,11 @@
         FIELD_BS (xrefindex_plus1, 0); \
       } \
     } \
-    FIELD_VALUE(flag) = FIELD_VALUE(flag) | \
-                        FIELD_VALUE(xrefdep) << 4 | \
-                        FIELD_VALUE(xrefref) << 6; \
+    SET_DERIVED { \
+      FIELD_VALUE(flag) = FIELD_VALUE(flag) | \
+                          FIELD_VALUE(xrefdep) << 4 | \
+                          FIELD_VALUE(xrefref) << 6; \
+    } \
   }\
   RESET_VER
 
@@ -214,9 +226,11 @@
         FIELD_BS (xrefindex_plus1, 0); \
       } \
     } \
-    FIELD_VALUE(flag) = FIELD_VALUE(flag) | \
-                        FIELD_VALUE(xrefdep) << 4 | \
-                        FIELD_VALUE(xrefref) << 6; \
+    SET_DERIVED { \
+      FIELD_VALUE(flag) = FIELD_VALUE(flag) | \
+                          FIELD_VALUE(xrefdep) << 4 | \
+                          FIELD_VALUE(xrefref) << 6; \
+    } \
   }\
   RESET_VER
 #endif
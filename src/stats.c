@@ -0,0 +1,175 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * stats.c: decode statistics, timings per phase and counters per type.
+ *          The wall time is sampled at every phase switch, the cpu time
+ *          only at the coarse ones, and then distributed over the phases
+ *          seen since the last coarse switch, by their wall time.
+ *          The heap in use is also only sampled at the coarse switches,
+ *          so its peak is a lower bound.
+ */
+
+#define __STDC_WANT_LIB_EXT2__ 1 /* for strdup */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+
+#include "stats.h"
+
+/* fixed types, then FREED, UNKNOWN_ENT and UNKNOWN_OBJ */
+#define NUM_STATS_TYPES (DWG_TYPE_XREFPANELOBJECT + 4)
+
+static double
+stats_wall(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#else
+  return (double)time(NULL);
+#endif
+}
+
+static double
+stats_cpu(void)
+{
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static void
+stats_sample_alloc(Dwg_Stats *restrict stats)
+{
+#if defined(HAVE_MALLINFO2)
+  struct mallinfo2 mi = mallinfo2();
+  BITCODE_RLL used = (BITCODE_RLL)(mi.uordblks + mi.hblkhd);
+  if (used > stats->peak_alloc)
+    stats->peak_alloc = used;
+#else
+  (void)stats;
+#endif
+}
+
+void
+dwg_stats_init(Dwg_Data *restrict dwg)
+{
+  Dwg_Stats *stats = &dwg->stats;
+  // dwg may not be cleared yet, so nothing is freed here, only in dwg_free
+  memset(stats, 0, sizeof(Dwg_Stats));
+  stats->phase = DWG_PHASE_NONE;
+  stats->phase_wall = stats_wall();
+  stats->phase_cpu = stats_cpu();
+  stats_sample_alloc(stats);
+}
+
+Dwg_Stats_Phase
+dwg_stats_wall_phase(Dwg_Data *restrict dwg, const Dwg_Stats_Phase phase)
+{
+  Dwg_Stats *stats = &dwg->stats;
+  Dwg_Stats_Phase prev = stats->phase;
+  double wall = stats_wall();
+
+  stats->wall[prev] += wall - stats->phase_wall;
+  stats->span_wall[prev] += wall - stats->phase_wall;
+  stats->phase = phase;
+  stats->phase_wall = wall;
+  return prev;
+}
+
+Dwg_Stats_Phase
+dwg_stats_phase(Dwg_Data *restrict dwg, const Dwg_Stats_Phase phase)
+{
+  Dwg_Stats *stats = &dwg->stats;
+  double cpu = stats_cpu();
+  double span = 0.0;
+  Dwg_Stats_Phase prev = dwg_stats_wall_phase(dwg, phase);
+  int i;
+
+  for (i = 0; i < DWG_PHASE_MAX; i++)
+    span += stats->span_wall[i];
+  if (span > 0.0)
+    {
+      for (i = 0; i < DWG_PHASE_MAX; i++)
+        stats->cpu[i] += (cpu - stats->phase_cpu) * stats->span_wall[i] / span;
+    }
+  else
+    stats->cpu[prev] += cpu - stats->phase_cpu;
+  memset(stats->span_wall, 0, sizeof(stats->span_wall));
+  stats->phase_cpu = cpu;
+  stats_sample_alloc(stats);
+  return prev;
+}
+
+void
+dwg_stats_object(Dwg_Data *restrict dwg, const Dwg_Object *restrict obj,
+                 const int error)
+{
+  Dwg_Stats *stats = &dwg->stats;
+  Dwg_Stats_Type *type;
+  BITCODE_BL i;
+
+  if (!stats->type)
+    {
+      stats->type = calloc(NUM_STATS_TYPES, sizeof(Dwg_Stats_Type));
+      if (!stats->type)
+        return;
+      stats->num_types = NUM_STATS_TYPES;
+    }
+  if (obj->fixedtype >= DWG_TYPE_FREED)
+    i = DWG_TYPE_XREFPANELOBJECT + 1 + (obj->fixedtype - DWG_TYPE_FREED);
+  else if (obj->fixedtype <= DWG_TYPE_XREFPANELOBJECT)
+    i = obj->fixedtype;
+  else
+    i = NUM_STATS_TYPES - 1;
+  type = &stats->type[i];
+  if (!type->num_objects)
+    {
+      type->fixedtype = obj->fixedtype;
+      // a copy, the dxfname of a class is freed with the DWG
+      type->name = obj->dxfname ? strdup(obj->dxfname) : NULL;
+    }
+  type->num_objects++;
+  type->bytes += obj->size;
+
+  if (error > 0)
+    {
+      for (i = 0; i < DWG_STATS_NUM_ERRORS; i++)
+        if (error & (1 << i))
+          stats->errors[i]++;
+    }
+}
+
+void
+dwg_stats_done(Dwg_Data *restrict dwg, const int error)
+{
+  dwg_stats_phase(dwg, DWG_PHASE_NONE);
+  dwg->stats.error = error;
+}
+
+void
+dwg_stats_free(Dwg_Data *restrict dwg)
+{
+  BITCODE_BL i;
+  if (dwg->stats.type)
+    {
+      for (i = 0; i < dwg->stats.num_types; i++)
+        free(dwg->stats.type[i].name);
+      free(dwg->stats.type);
+    }
+  dwg->stats.type = NULL;
+  dwg->stats.num_types = 0;
+}
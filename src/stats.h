@@ -0,0 +1,47 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * stats.h: decode statistics, timings per phase and counters per type.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "config.h"
+#include "dwg.h"
+
+/* Clear the stats and start timing. Does not free the previous stats,
+   which may be uninitialized; dwg_free does that. */
+void
+dwg_stats_init(Dwg_Data *restrict dwg);
+/* Account the time since the last switch to the current phase and
+   start the new phase. Also samples the heap in use for peak_alloc.
+   Returns the previous phase. */
+Dwg_Stats_Phase
+dwg_stats_phase(Dwg_Data *restrict dwg, const Dwg_Stats_Phase phase);
+/* The same, but without sampling the cpu time, which is a syscall.
+   Used per object. */
+Dwg_Stats_Phase
+dwg_stats_wall_phase(Dwg_Data *restrict dwg, const Dwg_Stats_Phase phase);
+/* Count the decoded object and its errors. */
+void
+dwg_stats_object(Dwg_Data *restrict dwg, const Dwg_Object *restrict obj,
+                 const int error);
+/* Stop timing, and remember the result error. */
+void
+dwg_stats_done(Dwg_Data *restrict dwg, const int error);
+/* Free the per-type counters */
+void
+dwg_stats_free(Dwg_Data *restrict dwg);
+
+#endif
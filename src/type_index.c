@@ -0,0 +1,232 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * type_index.c: objects grouped by type in CSR form.
+ *               The objects are first ordered by their owning block with a
+ *               counting sort, which gives the owned entities of each
+ *               block, and then distributed into the type rows, so each
+ *               row is sorted by owner and index, and the objects of one
+ *               type in one block are a contiguous range.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "type_index.h"
+
+#define NO_OWNER ((BITCODE_BL)-1)
+#define NO_ROW ((BITCODE_BL)-1)
+
+BITCODE_BL
+dwg_type_index_row(const Dwg_Data *restrict dwg, const unsigned int type,
+                   const int is_class)
+{
+  if (is_class)
+    return type < dwg->num_classes ? DWG_TYPE_INDEX_FIXED_ROWS + type
+                                   : NO_ROW;
+  if (type <= DWG_TYPE_XREFPANELOBJECT)
+    return type;
+  if (type >= DWG_TYPE_FREED && type <= DWG_TYPE_UNKNOWN_OBJ)
+    return DWG_TYPE_XREFPANELOBJECT + 1 + (type - DWG_TYPE_FREED);
+  return NO_ROW;
+}
+
+/* The owning block header of each entity, by its entity_mode as in the
+   ref_index. Sub-entities like ATTRIB or VERTEX are owned by their parent
+   entity, and objects by no block. BLOCK and ENDBLK are not in the
+   entities of their block, as in r2004+. */
+static void
+type_index_owners(const Dwg_Data *restrict dwg, BITCODE_BL *restrict owner)
+{
+  BITCODE_BL i;
+
+  for (i = 0; i < dwg->num_objects; i++)
+    {
+      const Dwg_Object *obj = &dwg->object[i];
+      Dwg_Object_Entity *_ent;
+      Dwg_Object_Ref *ref;
+      Dwg_Object *hdr;
+
+      if (obj->supertype != DWG_SUPERTYPE_ENTITY || !(_ent = obj->tio.entity)
+          || obj->fixedtype == DWG_TYPE_BLOCK
+          || obj->fixedtype == DWG_TYPE_ENDBLK)
+        continue;
+      switch (_ent->entity_mode)
+        {
+        case 0:
+          ref = _ent->subentity;
+          break;
+        case 1:
+          ref = dwg->header_vars.BLOCK_RECORD_PSPACE;
+          break;
+        case 2:
+          ref = dwg->header_vars.BLOCK_RECORD_MSPACE;
+          break;
+        default:
+          ref = NULL;
+          break;
+        }
+      if (ref && ref->absolute_ref && (hdr = dwg_ref_object(dwg, ref))
+          && hdr->fixedtype == DWG_TYPE_BLOCK_HEADER)
+        owner[i] = hdr->index;
+    }
+}
+
+static BITCODE_BL
+type_index_class_row(const Dwg_Data *restrict dwg,
+                     const Dwg_Object *restrict obj)
+{
+  if (obj->type < 500)
+    return NO_ROW;
+  return dwg_type_index_row(dwg, obj->type - 500, 1);
+}
+
+void
+dwg_type_index_free(Dwg_Data *restrict dwg)
+{
+  Dwg_Type_Index *idx = &dwg->type_index;
+  free(idx->offsets);
+  free(idx->objects);
+  free(idx->owners);
+  free(idx->owned_offsets);
+  free(idx->owned);
+  memset(idx, 0, sizeof(Dwg_Type_Index));
+}
+
+int
+dwg_type_index_build(Dwg_Data *restrict dwg)
+{
+  Dwg_Type_Index *idx = &dwg->type_index;
+  BITCODE_BL *owner = NULL;
+  BITCODE_BL i, num_rows;
+
+  if (idx->offsets && idx->num_objects == dwg->num_objects
+      && idx->generation == dwg->refs_generation)
+    return 0;
+  dwg_type_index_free(dwg);
+  if (!dwg->num_objects)
+    return 0;
+
+  num_rows = DWG_TYPE_INDEX_FIXED_ROWS + dwg->num_classes;
+  owner = malloc(dwg->num_objects * sizeof(BITCODE_BL));
+  /* the starts per owner + 1, NO_OWNER first */
+  idx->owned_offsets = calloc(dwg->num_objects + 2, sizeof(BITCODE_BL));
+  /* all objects in owner order */
+  idx->owned = malloc(dwg->num_objects * sizeof(BITCODE_BL));
+  idx->offsets = calloc(num_rows + 1, sizeof(BITCODE_BL));
+  if (!owner || !idx->owned_offsets || !idx->owned || !idx->offsets)
+    goto oom;
+  memset(owner, 0xff, dwg->num_objects * sizeof(BITCODE_BL)); // NO_OWNER
+  type_index_owners(dwg, owner);
+
+  /* counting sort by owner */
+  for (i = 0; i < dwg->num_objects; i++)
+    idx->owned_offsets[owner[i] + 2]++;
+  for (i = 1; i < dwg->num_objects + 2; i++)
+    idx->owned_offsets[i] += idx->owned_offsets[i - 1];
+  /* owned_offsets[owner + 1] is the fill cursor, and ends up at the start
+     of owner + 1, the unowned objects come before owned_offsets[0] */
+  for (i = 0; i < dwg->num_objects; i++)
+    idx->owned[idx->owned_offsets[owner[i] + 1]++] = i;
+
+  for (i = 0; i < dwg->num_objects; i++)
+    {
+      const Dwg_Object *obj = &dwg->object[i];
+      BITCODE_BL row = dwg_type_index_row(dwg, obj->fixedtype, 0);
+      if (row != NO_ROW)
+        idx->offsets[row + 1]++;
+      row = type_index_class_row(dwg, obj);
+      if (row != NO_ROW)
+        idx->offsets[row + 1]++;
+    }
+  for (i = 0; i < num_rows; i++)
+    idx->offsets[i + 1] += idx->offsets[i];
+  idx->objects = malloc((idx->offsets[num_rows] + 1) * sizeof(BITCODE_BL));
+  idx->owners = malloc((idx->offsets[num_rows] + 1) * sizeof(BITCODE_BL));
+  if (!idx->objects || !idx->owners)
+    goto oom;
+  /* offsets[row] is the fill cursor, and ends up at the start of the next
+     row */
+  for (i = 0; i < dwg->num_objects; i++)
+    {
+      const BITCODE_BL o = idx->owned[i];
+      const Dwg_Object *obj = &dwg->object[o];
+      BITCODE_BL row = dwg_type_index_row(dwg, obj->fixedtype, 0);
+      if (row != NO_ROW)
+        {
+          idx->owners[idx->offsets[row]] = owner[o];
+          idx->objects[idx->offsets[row]++] = o;
+        }
+      row = type_index_class_row(dwg, obj);
+      if (row != NO_ROW)
+        {
+          idx->owners[idx->offsets[row]] = owner[o];
+          idx->objects[idx->offsets[row]++] = o;
+        }
+    }
+  memmove(&idx->offsets[1], idx->offsets, num_rows * sizeof(BITCODE_BL));
+  idx->offsets[0] = 0;
+  free(owner);
+  idx->num_objects = dwg->num_objects;
+  idx->num_rows = num_rows;
+  idx->generation = dwg->refs_generation;
+  return 0;
+
+ oom:
+  free(owner);
+  dwg_type_index_free(dwg);
+  return DWG_ERR_OUTOFMEM;
+}
+
+BITCODE_BL
+dwg_type_index_find(const Dwg_Data *restrict dwg, const BITCODE_BL row,
+                    const BITCODE_BL owner, const int by_owner,
+                    const BITCODE_BL **restrict objects)
+{
+  const Dwg_Type_Index *idx = &dwg->type_index;
+  BITCODE_BL lo, hi, from, mid;
+
+  *objects = NULL;
+  if (row >= idx->num_rows)
+    return 0;
+  from = idx->offsets[row];
+  hi = idx->offsets[row + 1];
+  if (by_owner)
+    {
+      /* NO_OWNER sorts first, as owner + 1 == 0 */
+      const BITCODE_BL key = owner + 1;
+      lo = from;
+      while (lo < hi) // lower bound
+        {
+          mid = lo + (hi - lo) / 2;
+          if (idx->owners[mid] + 1 < key)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+      from = lo;
+      hi = idx->offsets[row + 1];
+      while (lo < hi) // upper bound
+        {
+          mid = lo + (hi - lo) / 2;
+          if (idx->owners[mid] + 1 <= key)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+      hi = lo;
+    }
+  *objects = &idx->objects[from];
+  return hi - from;
+}
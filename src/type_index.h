@@ -0,0 +1,44 @@
+/*****************************************************************************/
+/*  LibreDWG - free implementation of the DWG file format                    */
+/*                                                                           */
+/*  Copyright (C) 2018 Free Software Foundation, Inc.                        */
+/*                                                                           */
+/*  This library is free software, licensed under the terms of the GNU       */
+/*  General Public License as published by the Free Software Foundation,     */
+/*  either version 3 of the License, or (at your option) any later version.  */
+/*  You should have received a copy of the GNU General Public License        */
+/*  along with this program.  If not, see <http://www.gnu.org/licenses/>.    */
+/*****************************************************************************/
+
+/*
+ * type_index.h: objects grouped by fixedtype and class, and within each
+ *               type by their owning block.
+ */
+
+#ifndef TYPE_INDEX_H
+#define TYPE_INDEX_H
+
+#include "config.h"
+#include "dwg.h"
+
+/* (Re)build dwg->type_index, if missing or stale. Returns 0 or
+   DWG_ERR_OUTOFMEM. */
+int
+dwg_type_index_build(Dwg_Data *restrict dwg);
+/* Free dwg->type_index */
+void
+dwg_type_index_free(Dwg_Data *restrict dwg);
+
+/* The row of a fixedtype, or of a class number with is_class */
+BITCODE_BL
+dwg_type_index_row(const Dwg_Data *restrict dwg, const unsigned int type,
+                   const int is_class);
+
+/* The objects of the row, optionally only those owned by the block header
+   with the index owner. Returns their number. */
+BITCODE_BL
+dwg_type_index_find(const Dwg_Data *restrict dwg, const BITCODE_BL row,
+                    const BITCODE_BL owner, const int by_owner,
+                    const BITCODE_BL **restrict objects);
+
+#endif
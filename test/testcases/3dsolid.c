@@ -35,7 +35,8 @@ api_process (dwg_object * obj)
           error, version, version);
 
   acis_data = dwg_ent_3dsolid_get_acis_data (_3dsolid, &error);
-  if (error == 0 && !strcmp((char*)acis_data, (char*)_3dsolid->acis_data))
+  if (error == 0 && acis_data == _3dsolid->acis_data
+      && acis_data_matches (_3dsolid, acis_data))
     pass ("3dsolid_get_acis_data");
   else
     fail ("3dsolid_get_acis_data %d \"%s\" <=> \"%s\"",
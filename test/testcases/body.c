@@ -29,7 +29,8 @@ api_process (dwg_object * obj)
     fail ("error in reading version");
 
   acis_data = dwg_ent_body_get_acis_data (body, &error);
-  if (!error  && acis_data == body->acis_data)  // error checks
+  if (!error  && acis_data == body->acis_data
+      && acis_data_matches (body, acis_data))  // error checks
     pass ("Working Properly");
   else
     fail ("error in reading acis data");
@@ -32,6 +32,11 @@ void api_process (dwg_object * obj);
 /// API based printing function declaration
 void print_api (dwg_object * obj);
 
+/// compares the acis_data of a 3DSOLID, REGION or BODY with its
+/// bytewise decrypted encr_sat_data
+int acis_data_matches (const dwg_ent_3dsolid * _obj,
+                       const unsigned char * acis_data);
+
 /// Main function
 int
 main (int argc, char *argv[])
@@ -152,3 +157,25 @@ print_api (dwg_object * obj)
 {
   api_process (obj);
 }
+
+/// The SAT version 1 data is obfuscated per byte, c > 32 as 159 - c.
+/// Returns 1 if acis_data is that text, 0 if not.
+int
+acis_data_matches (const dwg_ent_3dsolid * _obj,
+                   const unsigned char * acis_data)
+{
+  BITCODE_BL i, j, k = 0;
+
+  if (_obj->version != 1 || !_obj->num_blocks)
+    return acis_data == NULL;
+  if (!acis_data)
+    return 0;
+  for (i = 0; i < _obj->num_blocks; i++)
+    for (j = 0; j < _obj->block_size[i]; j++)
+      {
+        const unsigned char c = (unsigned char)_obj->encr_sat_data[i][j];
+        if (acis_data[k++] != (c > 32 ? (unsigned char)(159 - c) : c))
+          return 0;
+      }
+  return acis_data[k] == '\0';
+}
@@ -58,7 +58,8 @@ api_process (dwg_object * obj)
     fail ("error in reading version");
 
   acis_data = dwg_ent_region_get_acis_data (region, &error);
-  if (!error  && acis_data == region->acis_data)
+  if (!error  && acis_data == region->acis_data
+      && acis_data_matches (region, acis_data))
     pass ("Working Properly");
   else
     fail ("error in reading acis data");
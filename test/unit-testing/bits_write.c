@@ -0,0 +1,132 @@
+#include "../../src/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dwg.h"
+#include "bits.h"
+
+/// Writes values with the bits.c writers, and checks the written bits and
+/// the values read back. Assumes a little-endian host, as bits.c does.
+
+static unsigned char buf[64];
+
+static void
+reset(Bit_Chain *dat)
+{
+  memset(buf, 0, sizeof(buf));
+  memset(dat, 0, sizeof(Bit_Chain));
+  dat->chain = buf;
+  dat->size = sizeof(buf);
+  dat->version = R_2000;
+}
+
+static double
+from_bits(const uint64_t u)
+{
+  double d;
+  memcpy(&d, &u, sizeof(d));
+  return d;
+}
+
+/// bit_write_DD: 0 the default, 1 patches bytes 0-3, 2 bytes 4,5 and 0-3,
+/// 3 the full RD. Bytes 6 and 7 are never patched.
+static int
+test_DD(void)
+{
+  static const struct { uint64_t value, dflt; int code; } dds[] = {
+    { 0x3FF0000000000000ULL, 0x3FF0000000000000ULL, 0 },
+    { 0x3FF0000012345678ULL, 0x3FF0000000000000ULL, 1 },
+    { 0x3FF0123400000000ULL, 0x3FF0000000000000ULL, 2 },
+    { 0x3FF0123412345678ULL, 0x3FF0000000000000ULL, 2 },
+    // the low 4 bytes equal, but bytes 6 and 7 differ
+    { 0x4000000000000000ULL, 0x3FF0000000000000ULL, 3 },
+    { 0x3FF1000000000000ULL, 0x3FF0000000000000ULL, 3 },
+    { 0xC0F0123412345678ULL, 0x40F0123400000000ULL, 3 },
+  };
+  Bit_Chain dat;
+  unsigned i;
+  int failed = 0;
+
+  for (i = 0; i < sizeof(dds) / sizeof(dds[0]); i++)
+    {
+      const double value = from_bits(dds[i].value);
+      const double dflt = from_bits(dds[i].dflt);
+      BITCODE_BB code;
+      double d;
+
+      reset(&dat);
+      bit_write_DD(&dat, value, dflt);
+      dat.byte = dat.bit = 0;
+      code = bit_read_BB(&dat);
+      dat.byte = dat.bit = 0;
+      d = bit_read_DD(&dat, dflt);
+      if (code != dds[i].code || memcmp(&d, &value, sizeof(d)))
+        {
+          printf("not ok - bit_write_DD(%016llX, %016llX): code %d, "
+                 "expected %d, read %.17g\n",
+                 (unsigned long long)dds[i].value,
+                 (unsigned long long)dds[i].dflt, code, dds[i].code, d);
+          failed++;
+        }
+    }
+  if (!failed)
+    printf("ok - bit_write_DD\n");
+  return failed;
+}
+
+/// bit_write_MS: from 0x8000 on the low 15 bits come first, with the
+/// continuation bit, as bit_read_MS reads them
+static int
+test_MS(void)
+{
+  static const struct { BITCODE_MS value; unsigned char bytes[4]; int len; }
+  mss[] = {
+    { 0, { 0x00, 0x00 }, 2 },
+    { 0x7fff, { 0xff, 0x7f }, 2 },
+    { 0x8000, { 0x00, 0x80, 0x01, 0x00 }, 4 },
+    { 0x12345, { 0x45, 0xa3, 0x02, 0x00 }, 4 },
+    { 0x3fffffff, { 0xff, 0xff, 0xff, 0x7f }, 4 },
+  };
+  Bit_Chain dat;
+  unsigned i;
+  int failed = 0;
+
+  for (i = 0; i < sizeof(mss) / sizeof(mss[0]); i++)
+    {
+      BITCODE_MS ms;
+
+      reset(&dat);
+      bit_write_MS(&dat, mss[i].value);
+      if (dat.byte != (unsigned long)mss[i].len || dat.bit
+          || memcmp(buf, mss[i].bytes, mss[i].len))
+        {
+          printf("not ok - bit_write_MS(0x%x): %02X %02X %02X %02X\n",
+                 (unsigned)mss[i].value, buf[0], buf[1], buf[2], buf[3]);
+          failed++;
+          continue;
+        }
+      dat.byte = 0;
+      ms = bit_read_MS(&dat);
+      if (ms != mss[i].value)
+        {
+          printf("not ok - bit_read_MS(bit_write_MS(0x%x)) = 0x%x\n",
+                 (unsigned)mss[i].value, (unsigned)ms);
+          failed++;
+        }
+    }
+  if (!failed)
+    printf("ok - bit_write_MS\n");
+  return failed;
+}
+
+int
+main(void)
+{
+  int failed = 0;
+
+  failed += test_DD();
+  failed += test_MS();
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
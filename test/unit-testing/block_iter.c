@@ -0,0 +1,219 @@
+#include "../../src/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "dwg.h"
+#include "common.h"
+#include "dwg_api.h"
+
+/// Checks dwg_block_get_owned() and the dwg_block_iter_*() order of every
+/// BLOCK_HEADER. Since r2004 the owned set must be the entities list of
+/// the BLOCK_HEADER itself.
+
+static int
+cmp_index(const void *a, const void *b)
+{
+  const BITCODE_BL x = *(const BITCODE_BL *)a, y = *(const BITCODE_BL *)b;
+  return x < y ? -1 : x > y;
+}
+
+/// compare the owned set of hdr with its entities, and the iterator with
+/// the owned set. seen marks the owned objects of all blocks.
+/// Entities which were not decoded are counted as skipped.
+static int
+test_block(Dwg_Data *dwg, const Dwg_Object *hdr, char *seen,
+           BITCODE_BL *total, BITCODE_BL *skipped)
+{
+  Dwg_Object_BLOCK_HEADER *_hdr = hdr->tio.object->tio.BLOCK_HEADER;
+  const BITCODE_BL *idx;
+  Dwg_Block_Iter iter;
+  Dwg_Object *obj;
+  BITCODE_BL n, i, j;
+  int error;
+
+  n = dwg_block_get_owned(hdr, &idx, &error);
+  if (error || (n && !idx))
+    {
+      printf("not ok - dwg_block_get_owned %u: error\n", hdr->index);
+      return 1;
+    }
+  for (i = 0; i < n; i++)
+    {
+      obj = &dwg->object[idx[i]];
+      if (idx[i] >= dwg->num_objects
+          || obj->supertype != DWG_SUPERTYPE_ENTITY
+          || obj->fixedtype == DWG_TYPE_BLOCK
+          || obj->fixedtype == DWG_TYPE_ENDBLK || seen[idx[i]])
+        {
+          printf("not ok - dwg_block_get_owned %u: bad object %u\n",
+                 hdr->index, idx[i]);
+          return 1;
+        }
+      seen[idx[i]] = 1;
+    }
+  if (dwg->header.version >= R_2004)
+    {
+      BITCODE_BL *ents = (BITCODE_BL *)calloc(_hdr->num_owned + 1,
+                                              sizeof(BITCODE_BL));
+      BITCODE_BL num_ents = 0;
+      if (!ents)
+        return 1;
+      for (j = 0; j < _hdr->num_owned; j++)
+        {
+          obj = _hdr->entities ? dwg_ref_object(dwg, _hdr->entities[j])
+                               : NULL;
+          if (!obj)
+            {
+              printf("not ok - BLOCK_HEADER %u: entity %u not found\n",
+                     hdr->index, j);
+              free(ents);
+              return 1;
+            }
+          // skip the entities which failed to decode, or without their
+          // owner handle
+          if (obj->supertype != DWG_SUPERTYPE_ENTITY || !obj->tio.entity
+              || (obj->tio.entity->entity_mode == 0
+                  && !obj->tio.entity->subentity))
+            {
+              (*skipped)++;
+              continue;
+            }
+          ents[num_ents++] = obj->index;
+        }
+      qsort(ents, num_ents, sizeof(BITCODE_BL), cmp_index);
+      for (j = 0; j < num_ents && j < n; j++)
+        if (ents[j] != idx[j])
+          break;
+      if (j != num_ents || j != n)
+        {
+          printf("not ok - dwg_block_get_owned %u: %u owned, %u entities, "
+                 "first mismatch at %u\n", hdr->index, n, num_ents, j);
+          free(ents);
+          return 1;
+        }
+      free(ents);
+    }
+  *total += n;
+
+  if (dwg_block_iter_init(&iter, hdr))
+    {
+      printf("not ok - dwg_block_iter_init %u: error\n", hdr->index);
+      return 1;
+    }
+  for (j = 0; (obj = dwg_block_iter_next(&iter)); j++)
+    {
+      if (j >= n || obj != &dwg->object[idx[j]])
+        {
+          printf("not ok - dwg_block_iter_next %u: wrong object %u at %u\n",
+                 hdr->index, obj->index, j);
+          return 1;
+        }
+      if (j && obj->index <= dwg->object[idx[j - 1]].index)
+        {
+          printf("not ok - dwg_block_iter_next %u: not in object order\n",
+                 hdr->index);
+          return 1;
+        }
+    }
+  if (j != n)
+    {
+      printf("not ok - dwg_block_iter_next %u: %u entities, expected %u\n",
+             hdr->index, j, n);
+      return 1;
+    }
+  // at the end it stays at the end
+  if (dwg_block_iter_next(&iter))
+    {
+      printf("not ok - dwg_block_iter_next %u: past the end\n", hdr->index);
+      return 1;
+    }
+  return 0;
+}
+
+static int
+test_file(const char *filename)
+{
+  Dwg_Data dwg;
+  Dwg_Block_Iter iter;
+  Dwg_Object *mspace;
+  BITCODE_BL i, total = 0, skipped = 0;
+  int failed = 0, num_hdrs = 0;
+  char *seen;
+
+  memset(&dwg, 0, sizeof(Dwg_Data));
+  if (dwg_read_file(filename, &dwg) >= DWG_ERR_CRITICAL)
+    {
+      printf("not ok - %s: read error\n", filename);
+      return 1;
+    }
+  seen = (char *)calloc(dwg.num_objects + 1, 1);
+  for (i = 0; seen && i < dwg.num_objects; i++)
+    {
+      if (dwg.object[i].fixedtype != DWG_TYPE_BLOCK_HEADER)
+        continue;
+      num_hdrs++;
+      failed += test_block(&dwg, &dwg.object[i], seen, &total, &skipped);
+    }
+  free(seen);
+  mspace = dwg.header_vars.BLOCK_RECORD_MSPACE
+    ? dwg_ref_object(&dwg, dwg.header_vars.BLOCK_RECORD_MSPACE) : NULL;
+  if (!num_hdrs || !mspace)
+    {
+      printf("not ok - %s: no model space\n", filename);
+      failed++;
+    }
+  else if (!total)
+    {
+      printf("not ok - %s: no owned entities\n", filename);
+      failed++;
+    }
+  // a non BLOCK_HEADER is rejected
+  if (dwg.num_objects && dwg.object[0].fixedtype != DWG_TYPE_BLOCK_HEADER
+      && !dwg_block_iter_init(&iter, &dwg.object[0]))
+    {
+      printf("not ok - %s: dwg_block_iter_init accepts type %u\n",
+             filename, dwg.object[0].fixedtype);
+      failed++;
+    }
+  if (!failed)
+    printf("ok - %s: %d blocks, %u owned entities, %u skipped\n",
+           filename, num_hdrs, total, skipped);
+  dwg_free(&dwg);
+  return failed;
+}
+
+int
+main(void)
+{
+  char *input = getenv("INPUT");
+  char *testdata = getenv("TESTDATA");
+  struct stat attrib;
+  int failed = 0;
+
+  if (!input)
+    input = (char *)"example_2000.dwg";
+  if (stat(input, &attrib))
+    {
+      fprintf(stderr, "Env var INPUT not defined, %s not found\n", input);
+      return EXIT_FAILURE;
+    }
+  failed += test_file(input);
+  // r2004+ keeps the entities in the BLOCK_HEADER, r2000 chains them
+  if (testdata)
+    {
+      const char *files[] = { "example_2004.dwg", "example_2007.dwg",
+                              "example_2010.dwg", "example_2013.dwg",
+                              "example_2018.dwg", "sample_2018.dwg" };
+      char path[1024];
+      unsigned i;
+      for (i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+        {
+          snprintf(path, sizeof(path), "%s/%s", testdata, files[i]);
+          if (!stat(path, &attrib))
+            failed += test_file(path);
+        }
+    }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+#include "../../src/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "dwg.h"
+#include "bits.h"
+#include "out_json.h"
+#include "out_dxf.h"
+
+/// Writes all formats of one decoded DWG, first serially twice, then DXF
+/// and JSON into memory, then with the parallel chunks, then on concurrent
+/// threads, and checks that all outputs are identical.
+
+#ifndef DISABLE_DXF
+
+#define NUM_FORMATS 5
+#define NUM_TASKS (2 * NUM_FORMATS)
+
+static const char *formats[NUM_FORMATS] = { "dxf", "dxfb", "json", "geojson",
+                                           "geojsonseq" };
+
+typedef struct _output
+{
+  char *data;
+  long size;
+  int error;
+} Output;
+
+/// write dwg in format fmt to a tmpfile and read it back into out
+static void
+write_format(const Dwg_Data *dwg, int fmt, Output *out)
+{
+  Bit_Chain dat = { 0 };
+
+  memset(out, 0, sizeof(Output));
+  dat.fh = tmpfile();
+  if (!dat.fh)
+    {
+      out->error = DWG_ERR_IOERROR;
+      return;
+    }
+  dat.version = dat.from_version = dwg->header.version;
+  switch (fmt)
+    {
+    case 0: out->error = dwg_write_dxf(&dat, dwg); break;
+    case 1: out->error = dwg_write_dxfb(&dat, dwg); break;
+    case 2: out->error = dwg_write_json(&dat, dwg); break;
+    case 3: out->error = dwg_write_geojson(&dat, dwg); break;
+    default: out->error = dwg_write_geojsonseq(&dat, dwg); break;
+    }
+  fflush(dat.fh);
+  out->size = ftell(dat.fh);
+  if (out->size > 0 && (out->data = malloc(out->size)))
+    {
+      rewind(dat.fh);
+      if (fread(out->data, 1, out->size, dat.fh) != (size_t)out->size)
+        out->error = DWG_ERR_IOERROR;
+    }
+  fclose(dat.fh);
+}
+
+/// the sink of the *_write_sink functions, appending to an Output
+static int
+append_block(void *user, const unsigned char *data, size_t size)
+{
+  Output *out = (Output *)user;
+  char *grown = realloc(out->data, out->size + size);
+  if (!grown)
+    return 1;
+  memcpy(&grown[out->size], data, size);
+  out->data = grown;
+  out->size += (long)size;
+  return 0;
+}
+
+/// write dwg as DXF (fmt 0) or JSON (fmt 2) into memory, or through the sink
+static void
+write_memory(const Dwg_Data *dwg, int fmt, int sink, Output *out)
+{
+  unsigned char *data;
+  size_t size;
+
+  memset(out, 0, sizeof(Output));
+  if (sink)
+    out->error = fmt ? json_write_sink(dwg, append_block, out)
+                     : dxf_write_sink(dwg, append_block, out);
+  else
+    {
+      out->error = fmt ? json_write_data(dwg, &data, &size)
+                       : dxf_write_data(dwg, &data, &size);
+      out->data = (char *)data;
+      out->size = (long)size;
+    }
+}
+
+static int
+same_output(const Output *a, const Output *b)
+{
+  return a->error == b->error && a->size == b->size
+         && (!a->size || (a->data && b->data
+                          && !memcmp(a->data, b->data, a->size)));
+}
+
+/// Returns the number of failures
+static int
+test_file(const char *filename)
+{
+  Dwg_Data dwg;
+  Output ref[NUM_FORMATS], out[NUM_TASKS];
+  int i, failed = 0;
+
+  memset(&dwg, 0, sizeof(Dwg_Data));
+  if (dwg_read_file(filename, &dwg) >= DWG_ERR_CRITICAL)
+    {
+      printf("not ok - %s: read error\n", filename);
+      return 1;
+    }
+
+  // a pass must not change the dwg, so writing it again is the same
+  for (i = 0; i < NUM_FORMATS; i++)
+    write_format(&dwg, i, &ref[i]);
+  for (i = 0; i < NUM_FORMATS; i++)
+    {
+      Output again;
+      write_format(&dwg, i, &again);
+      if (!same_output(&ref[i], &again))
+        {
+          printf("not ok - %s: second %s differs\n", filename, formats[i]);
+          failed++;
+        }
+      free(again.data);
+    }
+
+  // the same in memory, and through a callback
+  for (i = 0; i < 4; i++)
+    {
+      Output mem;
+      const int fmt = i & 2;
+      write_memory(&dwg, fmt, i & 1, &mem);
+      if (!same_output(&ref[fmt], &mem))
+        {
+          printf("not ok - %s: %s %s differs\n", filename,
+                 i & 1 ? "sink" : "memory", formats[fmt]);
+          failed++;
+        }
+      free(mem.data);
+    }
+
+  // the JSON and DXF objects in parallel chunks, appended in order
+  dwg.num_threads = 4;
+  for (i = 0; i < NUM_FORMATS; i++)
+    {
+      Output chunked;
+      write_format(&dwg, i, &chunked);
+      if (!same_output(&ref[i], &chunked))
+        {
+          printf("not ok - %s: chunked %s differs\n", filename, formats[i]);
+          failed++;
+        }
+      free(chunked.data);
+    }
+  dwg.num_threads = 0;
+
+  // every format twice, on separate threads
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(4)
+#endif
+  for (i = 0; i < NUM_TASKS; i++)
+    write_format(&dwg, i % NUM_FORMATS, &out[i]);
+
+  for (i = 0; i < NUM_TASKS; i++)
+    {
+      if (!same_output(&ref[i % NUM_FORMATS], &out[i]))
+        {
+          printf("not ok - %s: concurrent %s differs\n", filename,
+                 formats[i % NUM_FORMATS]);
+          failed++;
+        }
+      free(out[i].data);
+    }
+  for (i = 0; i < NUM_FORMATS; i++)
+    free(ref[i].data);
+  if (!failed)
+    printf("ok - %s\n", filename);
+  dwg_free(&dwg);
+  return failed;
+}
+
+#endif
+
+int
+main(void)
+{
+  char *input = getenv("INPUT");
+  char *testdata = getenv("TESTDATA");
+  struct stat attrib;
+  int failed = 0;
+
+#ifdef DISABLE_DXF
+  (void)input; (void)testdata; (void)attrib; (void)failed;
+  return 77; // skipped
+#else
+  if (!input)
+    input = (char *)"example_2000.dwg";
+  if (stat(input, &attrib))
+    {
+      fprintf(stderr, "Env var INPUT not defined, %s not found\n", input);
+      return EXIT_FAILURE;
+    }
+  failed += test_file(input);
+  // a r2007+ DWG, with the converted UTF-8 table names
+  if (testdata)
+    {
+      char path[1024];
+      snprintf(path, sizeof(path), "%s/example_2018.dwg", testdata);
+      if (!stat(path, &attrib))
+        failed += test_file(path);
+    }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+#endif
+}
@@ -0,0 +1,197 @@
+#include "../../src/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "dwg.h"
+#include "bits.h"
+#ifndef DISABLE_DXF
+#include "in_dxf.h"
+#endif
+
+/// Imports example_2000.dxf, with its ENTITIES repeated to get several
+/// chunks of records, serially and with 4 threads, and checks that both
+/// DWGs are identical as JSON.
+
+#if defined(USE_WRITE) && !defined(DISABLE_DXF)
+
+/// copies of the ENTITIES records, over several chunks of 512
+#define NUM_COPIES 100
+
+typedef struct _output
+{
+  char *data;
+  size_t size;
+} Output;
+
+/// the sink of json_write_sink, appending to an Output
+static int
+append_block(void *user, const unsigned char *data, size_t size)
+{
+  Output *out = (Output *)user;
+  char *grown = realloc(out->data, out->size + size);
+  if (!grown)
+    return 1;
+  memcpy(&grown[out->size], data, size);
+  out->data = grown;
+  out->size += size;
+  return 0;
+}
+
+/// the input with the ENTITIES records repeated, each copy with new
+/// handles, or NULL. Each line ends with a LF.
+static char *
+repeat_entities(const char *dxf, size_t *sizep)
+{
+  const char *start = strstr(dxf, "\nENTITIES\n");
+  const char *end = start ? strstr(start, "\n  0\nENDSEC\n") : NULL;
+  unsigned long handle = 0x100000;
+  size_t size;
+  char *out;
+  int i;
+
+  if (!end)
+    return NULL;
+  start += strlen("\nENTITIES\n");
+  end++;
+  out = (char *)malloc(strlen(dxf) + NUM_COPIES * 2 * (end - start) + 1);
+  if (!out)
+    return NULL;
+  size = (size_t)(end - dxf);
+  memcpy(out, dxf, size);
+  for (i = 0; i < NUM_COPIES; i++)
+    {
+      const char *code = start;
+      // the group code and value lines
+      while (code < end)
+        {
+          const char *value = strchr(code, '\n') + 1;
+          const char *next = strchr(value, '\n') + 1;
+          memcpy(&out[size], code, (size_t)(value - code));
+          size += (size_t)(value - code);
+          if (!memcmp(code, "  5\n", 4))
+            size += (size_t)sprintf(&out[size], "%lX\n", handle++);
+          else
+            {
+              memcpy(&out[size], value, (size_t)(next - value));
+              size += (size_t)(next - value);
+            }
+          code = next;
+        }
+    }
+  strcpy(&out[size], end);
+  size += strlen(end);
+  *sizep = size;
+  return out;
+}
+
+/// imports the DXF in buf with threads, and writes it as JSON into out
+static int
+import_json(const char *buf, const size_t size, const unsigned threads,
+            Output *out, BITCODE_BL *num_objects)
+{
+  Bit_Chain dat = { 0 };
+  Dwg_Data dwg;
+  int error;
+
+  memset(&dwg, 0, sizeof(Dwg_Data));
+  memset(out, 0, sizeof(Output));
+  dwg.num_threads = threads;
+  dat.size = size;
+  dat.chain = (unsigned char *)malloc(size);
+  if (!dat.chain)
+    return DWG_ERR_OUTOFMEM;
+  memcpy(dat.chain, buf, size);
+  error = dwg_read_dxf(&dat, &dwg);
+  *num_objects = dwg.num_objects;
+  if (error < DWG_ERR_CRITICAL)
+    error |= json_write_sink(&dwg, append_block, out);
+  dwg_free(&dwg);
+  free(dat.chain);
+  return error;
+}
+
+static int
+test_file(const char *filename)
+{
+  struct stat attrib;
+  Output serial, parallel;
+  BITCODE_BL num_serial, num_parallel;
+  char *dxf, *big;
+  size_t size, i;
+  FILE *fp;
+  int error, failed = 0;
+
+  if (stat(filename, &attrib) || !(fp = fopen(filename, "rb")))
+    {
+      printf("ok - %s # SKIP not found\n", filename);
+      return 0;
+    }
+  dxf = (char *)malloc(attrib.st_size + 1);
+  if (!dxf || fread(dxf, 1, attrib.st_size, fp) != (size_t)attrib.st_size)
+    {
+      fclose(fp);
+      free(dxf);
+      printf("not ok - %s: could not read\n", filename);
+      return 1;
+    }
+  fclose(fp);
+  // with LF line ends only
+  for (i = 0, size = 0; i < (size_t)attrib.st_size; i++)
+    if (dxf[i] != '\r')
+      dxf[size++] = dxf[i];
+  dxf[size] = '\0';
+  big = repeat_entities(dxf, &size);
+  free(dxf);
+  if (!big)
+    {
+      printf("not ok - %s: no ENTITIES\n", filename);
+      return 1;
+    }
+
+  error = import_json(big, size, 1, &serial, &num_serial);
+  error |= import_json(big, size, 4, &parallel, &num_parallel);
+  if (error >= DWG_ERR_CRITICAL || !serial.size)
+    {
+      printf("not ok - %s: error 0x%x\n", filename, error);
+      failed++;
+    }
+  else if (num_serial != num_parallel || serial.size != parallel.size
+           || memcmp(serial.data, parallel.data, serial.size))
+    {
+      printf("not ok - %s: %u objects serially, %u with 4 threads, "
+             "the JSON differs\n", filename, num_serial, num_parallel);
+      failed++;
+    }
+  else if (num_serial < 2 * 512)
+    {
+      printf("not ok - %s: only %u objects, not several chunks\n", filename,
+             num_serial);
+      failed++;
+    }
+  else
+    printf("ok - %s: %u objects, the same serially and with 4 threads\n",
+           filename, num_serial);
+  free(serial.data);
+  free(parallel.data);
+  free(big);
+  return failed;
+}
+#endif
+
+int
+main(void)
+{
+  char *testdata = getenv("TESTDATA");
+  char path[1024];
+
+#if defined(USE_WRITE) && !defined(DISABLE_DXF)
+  snprintf(path, sizeof(path), "%s/example_2000.dxf",
+           testdata ? testdata : "../test-data");
+  return test_file(path) ? EXIT_FAILURE : EXIT_SUCCESS;
+#else
+  (void)testdata; (void)path;
+  return 77; // skipped
+#endif
+}
@@ -0,0 +1,300 @@
+#include "../../src/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "dwg.h"
+#include "bits.h"
+#include "numfmt.h"
+#ifndef DISABLE_DXF
+#include "in_dxf.h"
+#endif
+
+/// Checks the DXF number parsers of numfmt.c against strtod and strtol
+/// in the C locale, also in a decimal-comma locale, and the line ends of
+/// the DXF reader with CR LF and a LF inside a string value.
+
+/// fast path, strtod fallback with the moved '.', and inf/nan
+static const char *doubles[] = {
+  "0", "1.5", "-0.25", "  3.0e2 ", "1E-3", "+7.", ".5", "2.5\t", "4.0\r",
+  "-0.0", "123456789.123456789", "1e22", "9007199254740993",
+  "0.1234567890123456789012", "123456789012345678901234.5",
+  "1.7976931348623157e308", "4.9e-324", "2.2250738585072014e-308",
+  "1e400", "-1e-400", "0.000000000000000000000000000001",
+  "inf", "-inf", "INF", "infinity", "nan", "NAN"
+};
+/// no numbers
+static const char *not_doubles[] = {
+  "", " ", "abc", "1.2.3", "1e", "1,5", "--1", "1.5x", "0x10",
+  "12345678901234567890,5", "1.23456789012345678901,5"
+};
+
+static int
+same_double(const double a, const double b)
+{
+  if (isnan(a) || isnan(b))
+    return isnan(a) && isnan(b);
+  return !memcmp(&a, &b, sizeof(double));
+}
+
+/// the parsed values of doubles[] in the C locale, or the other
+static int
+test_doubles(const double *expected, const char *locale)
+{
+  unsigned i;
+  int failed = 0;
+  double d;
+
+  for (i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++)
+    {
+      d = 0.0;
+      if (!numfmt_parse_double(doubles[i], strlen(doubles[i]), &d)
+          || !same_double(d, expected[i]))
+        {
+          printf("not ok - numfmt_parse_double(\"%s\") = %.17g, "
+                 "expected %.17g in %s\n",
+                 doubles[i], d, expected[i], locale);
+          failed++;
+        }
+    }
+  for (i = 0; i < sizeof(not_doubles) / sizeof(not_doubles[0]); i++)
+    if (numfmt_parse_double(not_doubles[i], strlen(not_doubles[i]), &d))
+      {
+        printf("not ok - numfmt_parse_double(\"%s\") accepted in %s\n",
+               not_doubles[i], locale);
+        failed++;
+      }
+  // only the given length counts, the value is not NUL-terminated
+  if (!numfmt_parse_double("2.5e1000", 3, &d) || d != 2.5)
+    {
+      printf("not ok - numfmt_parse_double of a prefix in %s\n", locale);
+      failed++;
+    }
+  if (!failed)
+    printf("ok - numfmt_parse_double in %s\n", locale);
+  return failed;
+}
+
+static int
+test_longs(void)
+{
+  static const struct { const char *s; int ok; long value; } longs[] = {
+    { "0", 1, 0 }, { "  42 ", 1, 42 }, { "-7", 1, -7 }, { "+3", 1, 3 },
+    { "1071\r", 1, 1071 },
+    { "9223372036854775807", 1, 9223372036854775807L },
+    { "9223372036854775808", 0, 0 }, { "-", 0, 0 }, { "", 0, 0 },
+    { "1.0", 0, 0 }, { "12a", 0, 0 }, { "1 2", 0, 0 }
+  };
+  static const struct {
+    const char *s; int ok; unsigned long value;
+  } hex[] = {
+    { "0", 1, 0 }, { " 1F ", 1, 0x1F }, { "abcdef", 1, 0xabcdef },
+    { "7FFFFFFF", 1, 0x7FFFFFFF }, { "", 0, 0 }, { "G", 0, 0 },
+    { "0x1F", 0, 0 }, { "-1", 0, 0 }
+  };
+  unsigned i;
+  int failed = 0;
+  long l;
+  unsigned long u;
+
+  if (sizeof(long) < 8)
+    {
+      printf("ok - numfmt_parse_long # SKIP 32-bit long\n");
+      return 0;
+    }
+  for (i = 0; i < sizeof(longs) / sizeof(longs[0]); i++)
+    {
+      l = 0;
+      if (numfmt_parse_long(longs[i].s, strlen(longs[i].s), &l)
+              != longs[i].ok
+          || (longs[i].ok && l != longs[i].value))
+        {
+          printf("not ok - numfmt_parse_long(\"%s\") = %ld\n", longs[i].s,
+                 l);
+          failed++;
+        }
+    }
+  for (i = 0; i < sizeof(hex) / sizeof(hex[0]); i++)
+    {
+      u = 0;
+      if (numfmt_parse_hex(hex[i].s, strlen(hex[i].s), &u) != hex[i].ok
+          || (hex[i].ok && u != hex[i].value))
+        {
+          printf("not ok - numfmt_parse_hex(\"%s\") = %lX\n", hex[i].s, u);
+          failed++;
+        }
+    }
+  // 16 hex digits fit, 17 not
+  if (!numfmt_parse_hex("FFFFFFFFFFFFFFFF", 16, &u)
+      || u != 0xFFFFFFFFFFFFFFFFUL
+      || numfmt_parse_hex("10000000000000000", 17, &u))
+    {
+      printf("not ok - numfmt_parse_hex overflow\n");
+      failed++;
+    }
+  if (!failed)
+    printf("ok - numfmt_parse_long, numfmt_parse_hex\n");
+  return failed;
+}
+
+#if defined(USE_WRITE) && !defined(DISABLE_DXF)
+/// read the DXF in buf, as dxf_read_file does
+static int
+read_dxf(unsigned char *buf, const size_t size, Dwg_Data *dwg)
+{
+  Bit_Chain dat = { 0 };
+  memset(dwg, 0, sizeof(Dwg_Data));
+  dat.chain = buf;
+  dat.size = size;
+  return dwg_read_dxf(&dat, dwg);
+}
+
+/// the index of the DICTIONARY entry name, or -1
+static long
+find_dict_name(const Dwg_Data *dwg, const char *name)
+{
+  BITCODE_BL i, j;
+  for (i = 0; i < dwg->num_objects; i++)
+    {
+      const Dwg_Object *obj = &dwg->object[i];
+      Dwg_Object_DICTIONARY *_obj;
+      if (obj->fixedtype != DWG_TYPE_DICTIONARY)
+        continue;
+      _obj = obj->tio.object->tio.DICTIONARY;
+      for (j = 0; _obj->text && j < _obj->numitems; j++)
+        if (_obj->text[j] && !strcmp(_obj->text[j], name))
+          return (long)i;
+    }
+  return -1;
+}
+
+/// The same DXF with LF line ends, and with CR LF line ends and a LF in
+/// a dictionary entry name, must read the same objects, with the LF kept
+/// in the name.
+static int
+test_crlf(const char *filename)
+{
+  struct stat attrib;
+  unsigned char *lf, *crlf;
+  size_t size, i, m = 0, n = 0;
+  FILE *fp;
+  Dwg_Data dwg;
+  BITCODE_BL num_objects;
+  long found;
+  int error, failed = 0;
+  const char *name = "ACAD_GROUP";
+
+  if (stat(filename, &attrib) || !(fp = fopen(filename, "rb")))
+    {
+      printf("ok - CR LF # SKIP %s not found\n", filename);
+      return 0;
+    }
+  size = attrib.st_size;
+  lf = (unsigned char *)malloc(size + 1);
+  crlf = (unsigned char *)malloc(2 * size + 1);
+  if (!lf || !crlf || fread(lf, 1, size, fp) != size)
+    {
+      fclose(fp);
+      free(lf);
+      free(crlf);
+      printf("not ok - CR LF: could not read %s\n", filename);
+      return 1;
+    }
+  fclose(fp);
+  // the input may have either line ends, lf gets only LF
+  for (i = 0; i < size; i++)
+    {
+      if (lf[i] == '\r')
+        continue;
+      if (lf[i] == '\n')
+        crlf[n++] = '\r';
+      crlf[n++] = lf[i];
+      lf[m++] = lf[i];
+    }
+  crlf[n] = '\0';
+  size = m;
+
+  error = read_dxf(lf, size, &dwg);
+  num_objects = dwg.num_objects;
+  found = find_dict_name(&dwg, name);
+  dwg_free(&dwg);
+  if (error >= DWG_ERR_CRITICAL || found < 0)
+    {
+      printf("not ok - LF: error 0x%x, %s %s\n", error, name,
+             found < 0 ? "not found" : "found");
+      failed++;
+    }
+  else
+    {
+      // the _ of the name becomes a LF, which does not end the line
+      unsigned char *p = (unsigned char *)strstr((char *)crlf, name);
+      if (p)
+        p[4] = '\n';
+      error = read_dxf(crlf, n, &dwg);
+      if (error >= DWG_ERR_CRITICAL || dwg.num_objects != num_objects)
+        {
+          printf("not ok - CR LF: error 0x%x, %u objects, expected %u\n",
+                 error, dwg.num_objects, num_objects);
+          failed++;
+        }
+      else if (find_dict_name(&dwg, "ACAD\nGROUP") != found)
+        {
+          printf("not ok - CR LF: no LF kept in %s\n", name);
+          failed++;
+        }
+      dwg_free(&dwg);
+    }
+  if (!failed)
+    printf("ok - CR LF and LF line ends, %u objects\n", num_objects);
+  free(lf);
+  free(crlf);
+  return failed;
+}
+#else
+static int
+test_crlf(const char *filename)
+{
+  printf("ok - CR LF # SKIP no DXF import of %s\n", filename);
+  return 0;
+}
+#endif
+
+int
+main(void)
+{
+  static const char *comma_locales[] = {
+    "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "fr_FR.utf8",
+    "fr_FR", "German_Germany.1252"
+  };
+  double expected[sizeof(doubles) / sizeof(doubles[0])];
+  char *testdata = getenv("TESTDATA");
+  char path[1024];
+  unsigned i;
+  int failed = 0;
+
+  // the C locale is the reference
+  for (i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++)
+    expected[i] = strtod(doubles[i], NULL);
+  failed += test_doubles(expected, "the C locale");
+  failed += test_longs();
+
+  for (i = 0; i < sizeof(comma_locales) / sizeof(comma_locales[0]); i++)
+    if (setlocale(LC_NUMERIC, comma_locales[i])
+        && !strcmp(localeconv()->decimal_point, ","))
+      break;
+  if (i < sizeof(comma_locales) / sizeof(comma_locales[0]))
+    {
+      failed += test_doubles(expected, comma_locales[i]);
+      setlocale(LC_NUMERIC, "C");
+    }
+  else
+    printf("ok - numfmt_parse_double # SKIP no decimal-comma locale\n");
+
+  snprintf(path, sizeof(path), "%s/example_2000.dxf",
+           testdata ? testdata : "../test-data");
+  failed += test_crlf(path);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,335 @@
+#include "../../src/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "dwg.h"
+#include "common.h"
+
+/// Adds objects with dwg_add_object to a r2000 DWG, without a size or
+/// bitsize, writes it with the encoder, and checks that they read back:
+/// a LINE with its owner (entity_mode 0), one in model space (entity_mode
+/// 2), and an XRECORD above 0x7fff bytes, with a 4 byte MS size.
+/// Once more with their handles in reverse object order, which the
+/// object map must sort.
+
+#ifdef USE_WRITE
+
+#define TMP_DWG "encode_added.tmp.dwg"
+/// the 2 XRECORD strings, for an object size above 0x7fff
+#define LONG_STRING 20000
+#define REFS_PER_REALLOC 128
+
+/// New references are registered in dwg->object_ref, which frees them
+static Dwg_Object_Ref *
+new_ref(Dwg_Data *dwg, const unsigned int code, const Dwg_Object *obj)
+{
+  Dwg_Object_Ref *ref;
+  if (dwg->num_object_refs % REFS_PER_REALLOC == 0)
+    {
+      Dwg_Object_Ref **refs = realloc(dwg->object_ref,
+          (dwg->num_object_refs + REFS_PER_REALLOC) * sizeof(Dwg_Object_Ref*));
+      if (!refs)
+        return NULL;
+      dwg->object_ref = refs;
+    }
+  ref = calloc(1, sizeof(Dwg_Object_Ref));
+  if (!ref)
+    return NULL;
+  ref->obj = (Dwg_Object *)obj;
+  ref->handleref.code = code;
+  ref->handleref.size = obj->handle.size;
+  ref->handleref.value = obj->handle.value;
+  ref->absolute_ref = obj->handle.value;
+  dwg->object_ref[dwg->num_object_refs++] = ref;
+  return ref;
+}
+
+static unsigned int
+handle_size(unsigned long value)
+{
+  unsigned int size = 0;
+  for (; value; value >>= 8)
+    size++;
+  return size;
+}
+
+static int
+add_line(Dwg_Data *dwg, Dwg_Object *obj, const int entity_mode,
+         Dwg_Object *owner, Dwg_Object *layer)
+{
+  Dwg_Object_Entity *ent;
+  Dwg_Entity_LINE *_obj;
+  if (dwg_add_LINE(obj))
+    return 1;
+  obj->type = DWG_TYPE_LINE;
+  ent = obj->tio.entity;
+  ent->entity_mode = entity_mode;
+  ent->nolinks = 1;
+  ent->color.index = 256;
+  ent->linetype_scale = 1.0;
+  ent->lineweight = 29;
+  if (!entity_mode)
+    ent->subentity = new_ref(dwg, 4, owner);
+  ent->layer = new_ref(dwg, 5, layer);
+  _obj = ent->tio.LINE;
+  _obj->start.x = 1.0 + entity_mode;
+  _obj->start.y = 2.0;
+  _obj->end.x = 3.0;
+  _obj->end.y = 4.0;
+  _obj->extrusion.z = 1.0;
+  return !ent->layer || (!entity_mode && !ent->subentity);
+}
+
+static Dwg_Resbuf *
+add_string(Dwg_Resbuf **tail, const short type, const char c)
+{
+  Dwg_Resbuf *rbuf = *tail = calloc(1, sizeof(Dwg_Resbuf));
+  if (!rbuf || !(rbuf->value.str.u.data = malloc(LONG_STRING + 1)))
+    return NULL;
+  rbuf->type = type;
+  memset(rbuf->value.str.u.data, c, LONG_STRING);
+  rbuf->value.str.u.data[LONG_STRING] = '\0';
+  rbuf->value.str.size = LONG_STRING;
+  rbuf->value.str.codepage = 30;
+  return rbuf;
+}
+
+static int
+add_xrecord(Dwg_Data *dwg, Dwg_Object *obj, Dwg_Object *owner)
+{
+  Dwg_Object_XRECORD *_obj;
+  Dwg_Resbuf *rbuf;
+  if (dwg_add_XRECORD(obj))
+    return 1;
+  obj->type = DWG_TYPE_XRECORD;
+  _obj = obj->tio.object->tio.XRECORD;
+  _obj->cloning_flags = 1;
+  if (!(_obj->parenthandle = new_ref(dwg, 4, owner)))
+    return 1;
+  // 1 and 3: strings, 40: real, 70: int16, each after its RS type
+  if (!(rbuf = add_string(&_obj->xdata, 1, 'x'))
+      || !(rbuf = add_string(&rbuf->next, 3, 'y')))
+    return 1;
+  _obj->num_databytes = 2 * (2 + 2 + 1 + LONG_STRING);
+  if (!(rbuf = rbuf->next = calloc(1, sizeof(Dwg_Resbuf))))
+    return 1;
+  rbuf->type = 40;
+  rbuf->value.dbl = 2.5;
+  _obj->num_databytes += 2 + 8;
+  if (!(rbuf = rbuf->next = calloc(1, sizeof(Dwg_Resbuf))))
+    return 1;
+  rbuf->type = 70;
+  rbuf->value.i16 = 1234;
+  _obj->num_databytes += 2 + 2;
+  _obj->num_eed = 4;
+  return 0;
+}
+
+/// adds the 3 objects, with descending handles if reverse, and returns
+/// the handle of the first one, or 0
+static unsigned long
+add_objects(Dwg_Data *dwg, const int reverse)
+{
+  Dwg_Header_Variables *vars = &dwg->header_vars;
+  Dwg_Object *mspace, *clayer, *nod;
+  Dwg_Object *objs[3];
+  unsigned long handle;
+  BITCODE_BL first = dwg->num_objects, i;
+
+  for (i = 0; i < 3; i++)
+    if (dwg_add_object(dwg) > 0)
+      return 0;
+  // dwg->object may have moved
+  for (i = 0; i < dwg->num_object_refs; i++)
+    dwg->object_ref[i]->obj
+        = dwg_resolve_handle(dwg, dwg->object_ref[i]->absolute_ref);
+  mspace = dwg_ref_object(dwg, vars->BLOCK_RECORD_MSPACE);
+  clayer = dwg_ref_object(dwg, vars->CLAYER);
+  nod = dwg_ref_object(dwg, vars->DICTIONARY_NAMED_OBJECTS);
+  if (!mspace || !clayer || !nod || !vars->HANDSEED)
+    return 0;
+
+  handle = vars->HANDSEED->absolute_ref;
+  for (i = 0; i < 3; i++)
+    {
+      objs[i] = &dwg->object[reverse ? first + 2 - i : first + i];
+      objs[i]->handle.value = handle + i;
+      objs[i]->handle.size = handle_size(objs[i]->handle.value);
+    }
+  vars->HANDSEED->absolute_ref = handle + 3;
+  vars->HANDSEED->handleref.value = handle + 3;
+  vars->HANDSEED->handleref.size = handle_size(handle + 3);
+  if (add_line(dwg, objs[0], 0, mspace, clayer)
+      || add_line(dwg, objs[1], 2, NULL, clayer)
+      || add_xrecord(dwg, objs[2], nod))
+    return 0;
+  return handle;
+}
+
+/// the object of handle with type, or NULL
+static Dwg_Object *
+find_object(Dwg_Data *dwg, const unsigned long handle,
+            const Dwg_Object_Type type)
+{
+  Dwg_Object *obj = dwg_resolve_handle(dwg, handle);
+  if (!obj || obj->fixedtype != type || !obj->tio.object)
+    {
+      printf("not ok - handle %lX: %s, expected type %d\n", handle,
+             obj ? "wrong type" : "not found", (int)type);
+      return NULL;
+    }
+  return obj;
+}
+
+static int
+check_objects(Dwg_Data *dwg, const unsigned long handle)
+{
+  Dwg_Header_Variables *vars = &dwg->header_vars;
+  Dwg_Object *obj;
+  Dwg_Object_Entity *ent;
+  Dwg_Entity_LINE *line;
+  Dwg_Object_XRECORD *xrecord;
+  Dwg_Resbuf *rbuf;
+  int failed = 0;
+
+  if (!(obj = find_object(dwg, handle, DWG_TYPE_LINE)))
+    return 1;
+  ent = obj->tio.entity;
+  line = ent->tio.LINE;
+  if (ent->entity_mode != 0 || !ent->subentity || !vars->BLOCK_RECORD_MSPACE
+      || ent->subentity->absolute_ref
+             != vars->BLOCK_RECORD_MSPACE->absolute_ref
+      || line->start.x != 1.0 || line->end.y != 4.0)
+    {
+      printf("not ok - LINE %lX with its owner\n", handle);
+      failed++;
+    }
+
+  if (!(obj = find_object(dwg, handle + 1, DWG_TYPE_LINE)))
+    return 1;
+  ent = obj->tio.entity;
+  line = ent->tio.LINE;
+  if (ent->entity_mode != 2 || !ent->layer || !vars->CLAYER
+      || ent->layer->absolute_ref != vars->CLAYER->absolute_ref
+      || line->start.x != 3.0 || line->end.y != 4.0)
+    {
+      printf("not ok - LINE %lX in model space\n", handle + 1);
+      failed++;
+    }
+
+  if (!(obj = find_object(dwg, handle + 2, DWG_TYPE_XRECORD)))
+    return 1;
+  xrecord = obj->tio.object->tio.XRECORD;
+  rbuf = xrecord->xdata;
+  if (obj->size <= 0x7fff
+      || xrecord->num_databytes != 2 * (2 + 2 + 1 + LONG_STRING) + 2 + 8
+                                    + 2 + 2
+      || !rbuf || rbuf->type != 1 || rbuf->value.str.size != LONG_STRING
+      || !rbuf->value.str.u.data || rbuf->value.str.u.data[0] != 'x'
+      || !(rbuf = rbuf->next) || rbuf->type != 3
+      || rbuf->value.str.size != LONG_STRING || !rbuf->value.str.u.data
+      || rbuf->value.str.u.data[LONG_STRING - 1] != 'y'
+      || !(rbuf = rbuf->next) || rbuf->type != 40 || rbuf->value.dbl != 2.5
+      || !(rbuf = rbuf->next) || rbuf->type != 70
+      || rbuf->value.i16 != 1234)
+    {
+      printf("not ok - XRECORD %lX of %u bytes, its xdata\n", handle + 2,
+             obj->size);
+      failed++;
+    }
+  return failed;
+}
+
+static int
+test_file(const char *filename, const int reverse)
+{
+  Dwg_Data dwg;
+  unsigned char *data = NULL;
+  unsigned long handle;
+  size_t size = 0;
+  FILE *fh;
+  int error, failed;
+
+  memset(&dwg, 0, sizeof(Dwg_Data));
+  if (dwg_read_file(filename, &dwg) >= DWG_ERR_CRITICAL)
+    {
+      printf("not ok - %s: read error\n", filename);
+      dwg_free(&dwg);
+      return 1;
+    }
+  if (dwg.header.version != R_2000)
+    {
+      printf("ok - %s # SKIP not r2000\n", filename);
+      dwg_free(&dwg);
+      return 0;
+    }
+  handle = add_objects(&dwg, reverse);
+  if (!handle)
+    {
+      printf("not ok - %s: could not add the objects\n", filename);
+      dwg_free(&dwg);
+      return 1;
+    }
+  error = dwg_write_data(&dwg, &data, &size);
+  dwg_free(&dwg);
+  if (error >= DWG_ERR_CRITICAL || !data)
+    {
+      printf("not ok - %s: write error 0x%x\n", filename, error);
+      free(data);
+      return 1;
+    }
+  remove(TMP_DWG);
+  fh = fopen(TMP_DWG, "wb");
+  if (!fh || fwrite(data, 1, size, fh) != size)
+    {
+      printf("not ok - could not write " TMP_DWG "\n");
+      if (fh)
+        fclose(fh);
+      free(data);
+      return 1;
+    }
+  fclose(fh);
+  free(data);
+
+  memset(&dwg, 0, sizeof(Dwg_Data));
+  error = dwg_read_file(TMP_DWG, &dwg);
+  remove(TMP_DWG);
+  if (error >= DWG_ERR_CRITICAL)
+    {
+      printf("not ok - %s: reading the written DWG failed 0x%x\n", filename,
+             error);
+      dwg_free(&dwg);
+      return 1;
+    }
+  failed = check_objects(&dwg, handle);
+  if (!failed)
+    printf("ok - %s: the added objects read back%s\n", filename,
+           reverse ? ", with their handles in reverse order" : "");
+  dwg_free(&dwg);
+  return failed;
+}
+#endif
+
+int
+main(void)
+{
+  char *input = getenv("INPUT");
+  struct stat attrib;
+
+  if (!input)
+    input = (char *)"example_2000.dwg";
+  if (stat(input, &attrib))
+    {
+      fprintf(stderr, "Env var INPUT not defined, %s not found\n", input);
+      return EXIT_FAILURE;
+    }
+#ifdef USE_WRITE
+  if (test_file(input, 0) || test_file(input, 1))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+#else
+  return 77; // skipped
+#endif
+}